@@ -24,6 +24,15 @@
 CEXPORT const char* bingoVersion();
 
 // options = "id: <property-name>"
+// "sub_compression:true" stores sparse substructure fingerprint columns as lists of set bit positions
+// "sub_block_size:N" sets the size in bytes of a substructure fingerprint column; every 8*N records are
+// transposed into a pack of such columns (8192 by default)
+// "result_cache:N" keeps the results of N completed molecule substructure and similarity searches in the database;
+// they are reused by identical searches until the next insertion or deletion
+// "mol_cache:<MB>" keeps up to <MB> megabytes of recently decoded molecules in memory for substructure
+// matching and record access; it is also accepted by bingoLoadDatabaseFile to override the stored value
+// "match_features:true" stores precomputed atom and bond match features next to every molecule record;
+// substructure and exact matching read them instead of computing them from the decoded molecule
 CEXPORT int bingoCreateDatabaseFile(const char* location, const char* type, const char* options);
 CEXPORT int bingoLoadDatabaseFile(const char* location, const char* options);
 CEXPORT int bingoCloseDatabase(int db);
@@ -33,6 +42,11 @@ CEXPORT int bingoCloseDatabase(int db);
 //
 CEXPORT int bingoInsertRecordObj(int db, int obj);
 CEXPORT int bingoInsertIteratorObj(int db, int iterator_obj_id);
+// Options: "threads:N" prepares records in N worker threads and commits them in the iterator order.
+// Throughput is reported by the bulk_insert counters and timers of bingoProfilingGetStatistics.
+// "bulk_load:true" builds the similarity storage of an empty database at once, sorted by fingerprint
+// bit count; the records become visible to searches when the insertion is finished
+CEXPORT int bingoInsertIteratorObjWithOptions(int db, int iterator_obj_id, const char* options);
 CEXPORT int bingoInsertRecordObjWithId(int db, int obj, int id);
 CEXPORT int bingoInsertRecordObjWithExtFP(int db, int obj, int fp);
 CEXPORT int bingoInsertRecordObjWithIdAndExtFP(int db, int obj, int id, int fp);
@@ -52,6 +66,10 @@ CEXPORT int bingoSearchSimWithExtFP(int db, int query_obj, float min, float max,
 CEXPORT int bingoSearchSimTopN(int db, int query_obj, int limit, float min, const char* options);
 CEXPORT int bingoSearchSimTopNWithExtFP(int db, int query_obj, int limit, float min, int fp, const char* options);
 
+// Searches all the molecules, reactions or fingerprints from the query array during one index scan.
+// Results are grouped by query; bingoGetCurrentQueryIndex returns the array index of the current query
+CEXPORT int bingoSearchSimBatch(int db, int query_arr, float min, float max, const char* options);
+
 CEXPORT int bingoEnumerateId(int db);
 
 //
@@ -60,6 +78,11 @@ CEXPORT int bingoEnumerateId(int db);
 CEXPORT int bingoNext(int search_obj);
 CEXPORT int bingoGetCurrentId(int search_obj);
 CEXPORT float bingoGetCurrentSimilarityValue(int search_obj);
+CEXPORT int bingoGetCurrentQueryIndex(int search_obj);
+// Writes the query atom index mapped to each atom of the current molecule of a substructure search
+// (negative for atoms that are not mapped) and returns the number of the atoms. Only 'size'
+// values are written, so the function can be called with zero size to get the buffer size.
+CEXPORT int bingoGetCurrentMapping(int search_obj, int* mapping, int size);
 
 // Estimation methods
 CEXPORT int bingoEstimateRemainingResultsCount(int search_obj);
@@ -77,6 +100,8 @@ CEXPORT int bingoGetObject(int search_obj);
 
 CEXPORT int bingoEndSearch(int search_obj);
 
+// Substructure screening plans are reported by the sub_screen counters: the number of screened packs,
+// the number of columns intersected and the reason the screening of a pack stopped
 CEXPORT const char* bingoProfilingGetStatistics(int for_session);
 
 #endif // __indigo_bingo__
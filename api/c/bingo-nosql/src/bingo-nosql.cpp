@@ -18,11 +18,16 @@
 
 #include "bingo-nosql.h"
 
+#include <algorithm>
 #include <cstdio>
+#include <sstream>
 #include <string>
 
+#include "base_cpp/os_thread_wrapper.h"
+
 #include "bingo_index.h"
 #include "bingo_internal.h"
+#include "indigo_array.h"
 #include "indigo_internal.h"
 #include "indigo_molecule.h"
 #include "indigo_reaction.h"
@@ -225,20 +230,165 @@ static int _insertObjectToDatabase(int db, Indigo& self, IndigoObject& indigo_ob
     }
 }
 
-static int _insertIteratorToDatabase(int db, Indigo& self, IndigoObject& iter, long obj_id)
+namespace
+{
+    // Loads, aromatizes and fingerprints one record in a worker thread
+    class BulkInsertCommand : public OsCommand
+    {
+    public:
+        void clear() override
+        {
+            object.reset();
+        }
+
+        void execute(OsCommandResult& result) override;
+
+        int db;
+        const AromaticityOptions* arom_options;
+        std::unique_ptr<IndigoObject> object;
+    };
+
+    class BulkInsertResult : public OsCommandResult
+    {
+    public:
+        void clear() override
+        {
+            obj_data.reset();
+            error.clear();
+        }
+
+        std::unique_ptr<ObjectIndexData> obj_data;
+        std::string error;
+    };
+
+    // Reads records from the iterator in the calling thread and prepares their index
+    // data in the worker threads. Results are handled with HANDLING_ORDER_SERIAL, so
+    // records are committed in the iterator order and get the same ids as in the
+    // single-threaded insert.
+    class BulkInsertDispatcher : public OsCommandDispatcher
+    {
+    public:
+        BulkInsertDispatcher(int db, IndigoObject& iter, const AromaticityOptions& arom_options)
+            : OsCommandDispatcher(HANDLING_ORDER_SERIAL, true), _db(db), _iter(iter), _arom_options(arom_options)
+        {
+        }
+
+    protected:
+        OsCommand* _allocateCommand() override
+        {
+            auto* command = new BulkInsertCommand();
+            command->db = _db;
+            command->arom_options = &_arom_options;
+            return command;
+        }
+
+        OsCommandResult* _allocateResult() override
+        {
+            return new BulkInsertResult();
+        }
+
+        bool _setupCommand(OsCommand& command) override
+        {
+            auto& insert_command = static_cast<BulkInsertCommand&>(command);
+            while (true)
+            {
+                try
+                {
+                    insert_command.object.reset(_iter.next());
+                    return insert_command.object != nullptr;
+                }
+                catch (const Exception& e)
+                {
+                    std::cerr << e.message() << std::endl;
+                    profIncCounter("bulk_insert_failed", 1);
+                }
+            }
+        }
+
+        void _handleResult(OsCommandResult& result) override
+        {
+            auto& insert_result = static_cast<BulkInsertResult&>(result);
+            if (insert_result.obj_data == nullptr)
+            {
+                std::cerr << insert_result.error << std::endl;
+                profIncCounter("bulk_insert_failed", 1);
+                return;
+            }
+
+            profTimerStart(t, "bulk_insert_commit");
+            try
+            {
+                auto bingo_index_ptr = sf::xlock_safe_ptr(sf::slock_safe_ptr(_indexes())->at(_db));
+                (*bingo_index_ptr)->add(-1, *insert_result.obj_data);
+                profIncCounter("bulk_insert_records", 1);
+            }
+            catch (const Exception& e)
+            {
+                std::cerr << e.message() << std::endl;
+                profIncCounter("bulk_insert_failed", 1);
+            }
+        }
+
+        void _prepareThread() override
+        {
+            MMFAllocator::setDatabaseId(_db);
+        }
+
+    private:
+        int _db;
+        IndigoObject& _iter;
+        const AromaticityOptions& _arom_options;
+    };
+
+    void BulkInsertCommand::execute(OsCommandResult& result)
+    {
+        auto& insert_result = static_cast<BulkInsertResult&>(result);
+
+        profTimerStart(t, "bulk_insert_prepare");
+        try
+        {
+            if (!IndigoMolecule::is(*object))
+            {
+                throw BingoException("_insertIteratorToDatabase: Only molecule objects can be added to molecule index");
+            }
+            // The iterator object is aromatized in place, as in the single-threaded insert
+            object->getMolecule().aromatize(*arom_options);
+            IndexMolecule ind_mol(object->getMolecule(), *arom_options);
+
+            const auto bingo_indexes = sf::slock_safe_ptr(_indexes());
+            const auto bingo_index_ptr = sf::slock_safe_ptr(bingo_indexes->at(db));
+            insert_result.obj_data = std::make_unique<ObjectIndexData>((*bingo_index_ptr)->prepareIndexData(ind_mol));
+        }
+        catch (const Exception& e)
+        {
+            insert_result.error = e.message();
+        }
+    }
+}
+
+static int _insertIteratorToDatabase(int db, Indigo& self, IndigoObject& iter, long obj_id, int threads_count)
 {
     profTimerStart(t, "_insertObjectToDatabase");
-    auto bingo_index_ptr = sf::xlock_safe_ptr(sf::slock_safe_ptr(_indexes())->at(db));
-    const auto index_type = (*bingo_index_ptr)->getType();
+    const IndexType index_type = [db]() {
+        const auto bingo_indexes = sf::slock_safe_ptr(_indexes());
+        const auto bingo_index_ptr = sf::slock_safe_ptr(bingo_indexes->at(db));
+        return (*bingo_index_ptr)->getType();
+    }();
 
-    if (index_type == IndexType::MOLECULE)
+    if (index_type == IndexType::MOLECULE && threads_count > 0)
+    {
+        profTimerStart(tb, "bulk_insert");
+        BulkInsertDispatcher dispatcher(db, iter, self.arom_options);
+        dispatcher.run(threads_count);
+    }
+    else if (index_type == IndexType::MOLECULE)
     {
         int counter = 0;
         while (true)
         {
             try
             {
-                IndigoObject* next_obj_ptr = iter.next();
+                std::unique_ptr<IndigoObject> next_obj_ptr(iter.next());
                 if (next_obj_ptr == nullptr)
                 {
                     break;
@@ -255,8 +405,14 @@ static int _insertIteratorToDatabase(int db, Indigo& self, IndigoObject& iter, l
                 next_obj.getMolecule().aromatize(self.arom_options);
                 IndexMolecule ind_mol(next_obj.getMolecule(), self.arom_options);
                 profTimerStop(t1);
-                const auto obj_data = (*bingo_index_ptr)->prepareIndexData(ind_mol);
+                // Each record is committed separately so searches can run between them
+                const auto bingo_indexes = sf::slock_safe_ptr(_indexes());
+                const auto obj_data = [&]() {
+                    const auto bingo_index_ptr = sf::slock_safe_ptr(bingo_indexes->at(db));
+                    return (*bingo_index_ptr)->prepareIndexData(ind_mol);
+                }();
                 {
+                    auto bingo_index_ptr = sf::xlock_safe_ptr(bingo_indexes->at(db));
                     (*bingo_index_ptr)->add(obj_id, obj_data);
                 }
             }
@@ -432,7 +588,57 @@ CEXPORT int bingoInsertIteratorObj(int db, int iterator_obj_id)
         //        {
         //            obj_id = strtol(properties.at(key_name), NULL, 10);
         //        }
-        return _insertIteratorToDatabase(db, self, iterator_obj, obj_id);
+        return _insertIteratorToDatabase(db, self, iterator_obj, obj_id, 0);
+    }
+    BINGO_END(-1);
+}
+
+CEXPORT int bingoInsertIteratorObjWithOptions(int db, int iterator_obj_id, const char* options)
+{
+    BINGO_BEGIN_DB(db)
+    {
+        IndigoObject& iterator_obj = self.getObject(iterator_obj_id);
+
+        std::map<std::string, std::string> option_map;
+        std::vector<std::string> allowed_props = {"threads", "bulk_load"};
+        Properties::parseOptions(options, option_map, &allowed_props);
+
+        int threads_count = 0;
+        if (option_map.find("threads") != option_map.end())
+        {
+            std::stringstream threads_str(option_map["threads"]);
+            threads_str >> threads_count;
+
+            if (threads_str.fail() || threads_count < 0)
+                throw BingoException("bingoInsertIteratorObjWithOptions: incorrect threads count");
+        }
+
+        const bool bulk_load = (option_map.find("bulk_load") != option_map.end() && option_map["bulk_load"] == "true");
+        if (!bulk_load)
+            return _insertIteratorToDatabase(db, self, iterator_obj, -1, threads_count);
+
+        const auto set_bulk_load = [db](bool begin) {
+            auto bingo_index_ptr = sf::xlock_safe_ptr(sf::slock_safe_ptr(_indexes())->at(db));
+            if (begin)
+                (*bingo_index_ptr)->beginBulkLoad();
+            else
+                (*bingo_index_ptr)->endBulkLoad();
+        };
+
+        set_bulk_load(true);
+        int result;
+        try
+        {
+            result = _insertIteratorToDatabase(db, self, iterator_obj, -1, threads_count);
+        }
+        catch (...)
+        {
+            // Records inserted before the failure are still committed
+            set_bulk_load(false);
+            throw;
+        }
+        set_bulk_load(false);
+        return result;
     }
     BINGO_END(-1);
 }
@@ -504,22 +710,21 @@ CEXPORT int bingoGetRecordObj(int db, int id)
         const auto bingo_index_ptr = sf::slock_safe_ptr(bingo_indexes->at(db));
         const auto& bingo_index = *bingo_index_ptr;
 
-        int cf_len;
-        const byte* cf_buf = bingo_index->getObjectCf(id, cf_len);
         int indigo_obj_id = -1;
 
-        BufferScanner buf_scn(cf_buf, cf_len);
-
         if (bingo_index->getType() == IndexType::MOLECULE)
         {
             std::unique_ptr<IndigoMolecule> molptr = std::make_unique<IndigoMolecule>();
             Molecule& mol = molptr->mol;
-            CmfLoader cmf_loader(buf_scn);
-            cmf_loader.loadMolecule(mol);
+            bingo_index->getObjectMolecule(id, mol);
             indigo_obj_id = self.addObject(std::move(molptr));
         }
         else if (bingo_index->getType() == IndexType::REACTION)
         {
+            int cf_len;
+            const byte* cf_buf = bingo_index->getObjectCf(id, cf_len);
+            BufferScanner buf_scn(cf_buf, cf_len);
+
             std::unique_ptr<IndigoReaction> rxnptr = std::make_unique<IndigoReaction>();
 
             Reaction& rxn = rxnptr->rxn;
@@ -880,6 +1085,59 @@ CEXPORT int bingoSearchSimTopNWithExtFP(int db, int query_obj, int limit, float
     BINGO_END(-1);
 }
 
+CEXPORT int bingoSearchSimBatch(int db, int query_arr, float min, float max, const char* options)
+{
+    BINGO_BEGIN_DB(db)
+    {
+        IndigoArray& queries = IndigoArray::cast(self.getObject(query_arr));
+
+        auto matcher = [&]() {
+            const auto bingo_indexes = sf::slock_safe_ptr(_indexes());
+            const auto bingo_index_ptr = sf::slock_safe_ptr(bingo_indexes->at(db));
+            return ((*bingo_index_ptr)->createMatcherBatch("sim", options));
+        }();
+
+        matcher->setThreshold(min);
+
+        for (int i = 0; i < queries.objects.size(); i++)
+        {
+            IndigoObject& query = *queries.objects[i];
+
+            if (query.type == IndigoObject::FINGERPRINT)
+            {
+                matcher->addQueryFingerprint(query);
+                continue;
+            }
+
+            auto obj_ptr = std::unique_ptr<IndigoObject>(query.clone());
+            IndigoObject& obj = *obj_ptr;
+
+            if (IndigoMolecule::is(obj))
+            {
+                obj.getBaseMolecule().aromatize(self.arom_options);
+                MoleculeSimilarityQueryData query_data(obj.getMolecule(), min, max);
+                matcher->addQuery(query_data);
+            }
+            else if (IndigoReaction::is(obj))
+            {
+                obj.getBaseReaction().aromatize(self.arom_options);
+                ReactionSimilarityQueryData query_data(obj.getReaction(), min, max);
+                matcher->addQuery(query_data);
+            }
+            else
+                throw BingoException("bingoSearchSimBatch: only molecules, reactions and fingerprints can be used as batch queries");
+        }
+
+        {
+            auto searches_data = sf::xlock_safe_ptr(_searches_data());
+            auto search_id = searches_data->searches.insert(std::move(matcher));
+            searches_data->db[search_id] = db;
+            return search_id;
+        }
+    }
+    BINGO_END(-1);
+}
+
 CEXPORT int bingoEnumerateId(int db)
 {
     BINGO_BEGIN_DB(db)
@@ -921,6 +1179,9 @@ CEXPORT int bingoNext(int search_obj)
     BINGO_BEGIN_SEARCH(search_obj)
     {
         getMatcher(search_obj);
+        // Writers are blocked only while the next portion of results is read;
+        // the matcher itself ignores records committed after it was created
+        const auto bingo_index_ptr = sf::slock_safe_ptr(sf::slock_safe_ptr(_indexes())->at(searches_data->db.at(search_obj)));
         return matcher.next();
     }
     BINGO_END(-1);
@@ -946,6 +1207,32 @@ CEXPORT float bingoGetCurrentSimilarityValue(int search_obj)
     BINGO_END(-1);
 }
 
+CEXPORT int bingoGetCurrentQueryIndex(int search_obj)
+{
+    BINGO_BEGIN_SEARCH(search_obj)
+    {
+        getMatcherConst(search_obj);
+        return matcher.currentQueryIndex();
+    }
+    BINGO_END(-1);
+}
+
+CEXPORT int bingoGetCurrentMapping(int search_obj, int* mapping, int size)
+{
+    BINGO_BEGIN_SEARCH(search_obj)
+    {
+        getMatcher(search_obj);
+        const Array<int>* current_mapping = matcher.currentMoleculeMapping();
+        if (current_mapping == nullptr)
+            throw BingoException("bingoGetCurrentMapping(): the search is not a molecule substructure search");
+
+        for (int i = 0; i < std::min(size, current_mapping->size()); i++)
+            mapping[i] = (*current_mapping)[i];
+        return current_mapping->size();
+    }
+    BINGO_END(-1);
+}
+
 CEXPORT int bingoEstimateRemainingResultsCount(int search_obj)
 {
     BINGO_BEGIN_SEARCH(search_obj)
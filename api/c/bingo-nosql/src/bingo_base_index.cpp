@@ -30,6 +30,11 @@ static const char* _read_only_prop = "read_only";
 static const char* _max_mmf_size_prop = "max_mmf_size";
 static const char* _min_mmf_size_prop = "min_mmf_size";
 static const char* _mt_size_prop = "mt_size";
+static const char* _sub_compression_prop = "sub_compression";
+static const char* _sub_block_size_prop = "sub_block_size";
+static const char* _result_cache_prop = "result_cache";
+static const char* _mol_cache_prop = "mol_cache";
+static const char* _match_features_prop = "match_features";
 static const char* _id_key_prop = "key";
 static const size_t _min_mmf_size = 33554432;  // 32Mb
 static const size_t _max_mmf_size = 536870912; // 512Mb
@@ -38,14 +43,15 @@ static const int _sim_mt_size = 50000;
 
 namespace
 {
-    int tryGetDirLock(const std::string& loc_dir)
+    // Writers hold the lock exclusively, read-only sessions share it
+    int tryGetDirLock(const std::string& loc_dir, bool shared)
     {
 #ifndef _WIN32
         const auto lockName = loc_dir + "/lock";
         mode_t m = umask(0);
         int fd = open(lockName.c_str(), O_RDWR | O_CREAT, 0666);
         umask(m);
-        if (fd >= 0 && flock(fd, LOCK_EX | LOCK_NB) < 0)
+        if (fd >= 0 && flock(fd, (shared ? LOCK_SH : LOCK_EX) | LOCK_NB) < 0)
         {
             close(fd);
             fd = -1;
@@ -56,13 +62,15 @@ namespace
 #endif
     }
 
-    void releaseFileLock(int fd, const std::string& loc_dir)
+    void releaseFileLock(int fd, const std::string& loc_dir, bool shared)
     {
 #ifndef _WIN32
         const auto lockName = loc_dir + "/lock";
         if (fd < 0)
             return;
-        remove(lockName.c_str());
+        // Other read-only sessions may still hold the same lock file
+        if (!shared)
+            remove(lockName.c_str());
         close(fd);
 #endif
     }
@@ -81,8 +89,9 @@ void BaseIndex::create(const char* location, const MoleculeFingerprintParameters
     osDirCreate(location);
 
     _location = location;
+    _index_id = index_id;
 
-    _lock_fd = tryGetDirLock(_location);
+    _lock_fd = tryGetDirLock(_location, false);
     if (_lock_fd == -1)
     {
         throw Exception("Cannot lock Bingo database folder. Seems like it's already in use.");
@@ -100,6 +109,15 @@ void BaseIndex::create(const char* location, const MoleculeFingerprintParameters
     Properties::parseOptions(options, option_map);
     _checkOptions(option_map, true);
 
+    if (option_map.find(_sub_block_size_prop) != option_map.end())
+    {
+        std::istringstream isstr(option_map[_sub_block_size_prop]);
+        isstr >> sub_block_size;
+
+        if (isstr.fail() || sub_block_size <= 0 || sub_block_size % (int)sizeof(qword) != 0)
+            throw Exception("Creating index error: incorrect substructure block size");
+    }
+
     _read_only = _getAccessType(option_map);
 
     size_t min_mmf_size = _getMinMMfSize(option_map);
@@ -111,6 +129,7 @@ void BaseIndex::create(const char* location, const MoleculeFingerprintParameters
         MMFAllocator::create(_mmf_path.c_str(), min_mmf_size, max_mmf_size, _reaction_type, index_id);
     else
         throw Exception("incorrect index type");
+    _mmf_opened = true;
 
     _header.allocate();
 
@@ -126,13 +145,40 @@ void BaseIndex::create(const char* location, const MoleculeFingerprintParameters
     _mappingCreate();
 
     _header->cf_offset = ByteBufferStorage::create(_cf_storage, cf_block_size);
-    _header->sub_offset = TranspFpStorage::create(_sub_fp_storage, _fp_params.fingerprintSize(), sub_block_size, _small_base_size);
+    const bool sub_compression = (option_map.find(_sub_compression_prop) != option_map.end() && option_map[_sub_compression_prop] == "true");
+    _header->sub_offset = TranspFpStorage::create(_sub_fp_storage, _fp_params.fingerprintSize(), sub_block_size, _small_base_size, sub_compression);
     _header->sim_offset = SimStorage::create(_sim_fp_storage, _fp_params.fingerprintSizeSim(), mt_size, _small_base_size);
     _header->exact_offset = ExactStorage::create(_exact_storage);
     _header->gross_offset = GrossStorage::create(_gross_storage, cf_block_size);
 
+    int result_cache_capacity = 0;
+    if (option_map.find(_result_cache_prop) != option_map.end())
+    {
+        std::istringstream isstr(option_map[_result_cache_prop]);
+        isstr >> result_cache_capacity;
+
+        if (isstr.fail() || result_cache_capacity < 0)
+            throw Exception("Creating index error: incorrect result cache size");
+    }
+    if (result_cache_capacity > 0)
+        _header->result_cache_offset = ResultCache::create(_result_cache, result_cache_capacity);
+    else
+        _header->result_cache_offset = MMFAddress::null;
+
+    const bool match_features = (option_map.find(_match_features_prop) != option_map.end() && option_map[_match_features_prop] == "true");
+    if (match_features && _type != IndexType::MOLECULE)
+        throw Exception("Creating index error: match features are supported for molecules only");
+    if (match_features)
+        _header->features_offset = ByteBufferStorage::create(_features_storage, cf_block_size);
+    else
+        _header->features_offset = MMFAddress::null;
+
     _header->first_free_id = 0;
     _header->object_count = 0;
+    _header->generation = 0;
+
+    _createMoleculeCache(option_map);
+    _committed_count = 0;
 }
 
 void BaseIndex::load(const char* location, const char* options, int index_id)
@@ -144,8 +190,16 @@ void BaseIndex::load(const char* location, const char* options, int index_id)
 
     osDirCreate(location);
     _location = location;
+    _index_id = index_id;
+
+    std::map<std::string, std::string> option_map;
 
-    _lock_fd = tryGetDirLock(_location);
+    Properties::parseOptions(options, option_map);
+    _checkOptions(option_map, false);
+
+    _read_only = _getAccessType(option_map);
+
+    _lock_fd = tryGetDirLock(_location, _read_only);
     if (_lock_fd == -1)
     {
         throw Exception("Cannot lock Bingo database folder. Seems like it's already in use.");
@@ -156,14 +210,8 @@ void BaseIndex::load(const char* location, const char* options, int index_id)
     std::string _mapping_path = _location + _id_mapping_filename;
     std::string _mmf_path = _location + _mmf_file;
 
-    std::map<std::string, std::string> option_map;
-
-    Properties::parseOptions(options, option_map);
-    _checkOptions(option_map, false);
-
-    _read_only = _getAccessType(option_map);
-
     MMFAllocator::load(_mmf_path.c_str(), index_id, _read_only);
+    _mmf_opened = true;
 
     _header = MMFPtr<_Header>(MMFAddress(0, MMFAllocator::MAX_HEADER_LEN + MMFAllocator::getAllocatorDataSize()));
 
@@ -172,7 +220,7 @@ void BaseIndex::load(const char* location, const char* options, int index_id)
     const char* ver = _properties->get(_version_prop);
 
     if (strcmp(ver, BINGO_VERSION) != 0)
-        throw Exception("BaseIndex: load(): incorrect database version");
+        throw Exception("BaseIndex: load(): incorrect database version %s, expected %s; the database has to be recreated", ver, BINGO_VERSION);
 
     const char* type_str = (_type == IndexType::MOLECULE ? _molecule_type : _reaction_type);
     if (strcmp(_properties->get("base_type"), type_str) != 0)
@@ -194,6 +242,16 @@ void BaseIndex::load(const char* location, const char* options, int index_id)
     TranspFpStorage::load(_sub_fp_storage, _header.ptr()->sub_offset);
     ByteBufferStorage::load(_cf_storage, _header.ptr()->cf_offset);
     GrossStorage::load(_gross_storage, _header.ptr()->gross_offset);
+    ResultCache::load(_result_cache, _header.ptr()->result_cache_offset);
+    if (_header->features_offset != MMFAddress::null)
+        ByteBufferStorage::load(_features_storage, _header.ptr()->features_offset);
+
+    // The molecule cache size given at creation is used unless it is given again
+    if (option_map.find(_mol_cache_prop) == option_map.end() && _properties->getNoThrow(_mol_cache_prop) != nullptr)
+        option_map[_mol_cache_prop] = _properties->get(_mol_cache_prop);
+    _createMoleculeCache(option_map);
+
+    _committed_count = _header->object_count;
 }
 
 int BaseIndex::add(int obj_id, const ObjectIndexData& _obj_data)
@@ -206,12 +264,18 @@ int BaseIndex::add(int obj_id, const ObjectIndexData& _obj_data)
     if (obj_id != -1 && back_id_mapping.get(obj_id) != (size_t)-1)
         throw Exception("insert fail: This id was already used");
 
+    SimStorage& sim_storage = _sim_fp_storage.ref();
+    const int sim_cells = (sim_storage.isSmallBase() ? 0 : sim_storage.getCellCount());
+
     profTimerStart(t_after, "exclusive_write");
     {
         profTimerStart(t_in, "add_obj_data");
         _insertIndexData(_obj_data);
     }
 
+    if ((sim_storage.isSmallBase() ? 0 : sim_storage.getCellCount()) != sim_cells)
+        _sim_layout_version++;
+
     {
         profTimerStart(t_in, "mapping_changing_1");
         if (obj_id == -1)
@@ -227,11 +291,16 @@ int BaseIndex::add(int obj_id, const ObjectIndexData& _obj_data)
     }
 
     int base_id = _header->object_count;
-    _header->object_count++;
     {
         profTimerStart(t_in, "mapping_changing_2");
         _mappingAdd(obj_id, base_id);
     }
+    _header->object_count++;
+    _header->generation++;
+
+    // Searches started from now on may see the record
+    if (!_bulk_load)
+        _committed_count.store(base_id + 1, std::memory_order_release);
 
     return obj_id;
 }
@@ -242,6 +311,38 @@ void BaseIndex::optimize()
         throw Exception("optimize fail: Read only index can't be changed");
 
     _sim_fp_storage.ptr()->optimize();
+    _sim_layout_version++;
+}
+
+void BaseIndex::beginBulkLoad()
+{
+    if (_read_only)
+        throw Exception("bulk load fail: Read only index can't be changed");
+
+    if (_header->object_count > 0)
+        return;
+
+    _bulk_load = true;
+}
+
+void BaseIndex::endBulkLoad()
+{
+    if (!_bulk_load)
+        return;
+
+    _bulk_load = false;
+
+    {
+        profTimerStart(t, "bulk_load_sim_storage");
+        _sim_fp_storage.ptr()->bulkLoad(_bulk_sim_fps.data(), _bulk_sim_ids.data(), _bulk_sim_ids.size());
+    }
+    std::vector<byte>().swap(_bulk_sim_fps);
+    std::vector<int>().swap(_bulk_sim_ids);
+
+    _sim_layout_version++;
+    // Results cached during the load don't include the records published here
+    _header->generation++;
+    _committed_count.store(_header->object_count, std::memory_order_release);
 }
 
 void BaseIndex::remove(int obj_id)
@@ -254,8 +355,43 @@ void BaseIndex::remove(int obj_id)
     if (obj_id < 0 || back_id_mapping.get(obj_id) == (size_t)-1)
         throw Exception("There is no object with this id");
 
+    if (_molecule_cache)
+        _molecule_cache->remove(back_id_mapping.get(obj_id));
     _cf_storage->remove(back_id_mapping.get(obj_id));
+    if (hasMatchFeatures())
+        _features_storage->remove(back_id_mapping.get(obj_id));
     _mappingRemove(obj_id);
+    _header->generation++;
+}
+
+int BaseIndex::getGeneration() const
+{
+    return _header->generation;
+}
+
+bool BaseIndex::hasResultCache() const
+{
+    return !MMFPtr<ResultCache>(_result_cache).isNull();
+}
+
+bool BaseIndex::findCachedResult(const Array<char>& key, int generation, Array<int>& ids, Array<float>& sim_values)
+{
+    std::lock_guard<std::mutex> lock(_result_cache_lock);
+    if (!_result_cache->find(key, generation, ids, sim_values))
+    {
+        profIncCounter("result_cache_misses", 1);
+        return false;
+    }
+    return true;
+}
+
+void BaseIndex::storeCachedResult(const Array<char>& key, int generation, const Array<int>& ids, const Array<float>& sim_values)
+{
+    if (_read_only || generation != _header->generation)
+        return;
+
+    std::lock_guard<std::mutex> lock(_result_cache_lock);
+    _result_cache->store(key, generation, ids, sim_values);
 }
 
 const MoleculeFingerprintParameters& BaseIndex::getFingerprintParams() const
@@ -303,6 +439,16 @@ int BaseIndex::getObjectsCount() const
     return _header->object_count;
 }
 
+int BaseIndex::getCommittedObjectsCount() const
+{
+    return _committed_count.load(std::memory_order_acquire);
+}
+
+int BaseIndex::getSimLayoutVersion() const
+{
+    return _sim_layout_version.load(std::memory_order_acquire);
+}
+
 const byte* BaseIndex::getObjectCf(int id, int& len)
 {
     const byte* cf_buf = _cf_storage->get(_back_id_mapping_ptr.ref().get(id), len);
@@ -313,6 +459,52 @@ const byte* BaseIndex::getObjectCf(int id, int& len)
     return cf_buf;
 }
 
+void BaseIndex::getObjectMolecule(int id, Molecule& mol)
+{
+    size_t base_id = _back_id_mapping_ptr.ref().get(id);
+
+    if (_molecule_cache && _molecule_cache->copy(base_id, mol))
+        return;
+
+    int cf_len;
+    const byte* cf_buf = getObjectCf(id, cf_len);
+    BufferScanner buf_scn(cf_buf, cf_len);
+    CmfLoader cmf_loader(buf_scn);
+    cmf_loader.loadMolecule(mol);
+
+    if (_molecule_cache)
+    {
+        std::unique_ptr<Molecule> cached = std::make_unique<Molecule>();
+        cached->clone(mol, 0, 0);
+        _molecule_cache->put(base_id, std::move(cached));
+    }
+}
+
+MoleculeCache* BaseIndex::getMoleculeCache()
+{
+    return _molecule_cache.get();
+}
+
+bool BaseIndex::hasMatchFeatures() const
+{
+    return !MMFPtr<ByteBufferStorage>(_features_storage).isNull();
+}
+
+bool BaseIndex::getObjectFeatures(int id, MoleculeMatchFeatures& features)
+{
+    if (!hasMatchFeatures())
+        return false;
+
+    int len;
+    const byte* buf = _features_storage->get(id, len);
+    if (len <= 0)
+        return false;
+
+    BufferScanner scanner(buf, len);
+    features.load(scanner);
+    return true;
+}
+
 const char* BaseIndex::getIdPropertyName() const
 {
     return _properties.ref().getNoThrow(_id_key_prop);
@@ -328,6 +520,11 @@ IndexType BaseIndex::getType() const
     return _type;
 }
 
+int BaseIndex::getIndexId() const
+{
+    return _index_id;
+}
+
 IndexType BaseIndex::determineType(const char* location)
 {
     std::string path(location);
@@ -338,23 +535,29 @@ IndexType BaseIndex::determineType(const char* location)
 
     // bool res = file.good();
 
-    char type[_type_len];
+    char type[_type_len] = {};
     file.seekg(0);
-    file.read(type, _type_len);
+    file.read(type, _type_len - 1);
 
     if (strcmp(type, _molecule_type) == 0)
         return IndexType::MOLECULE;
     else if (strcmp(type, _reaction_type) == 0)
         return IndexType::REACTION;
     else
-        throw Exception("BingoIndex: determineType(): Database format is not compatible with this version.");
+        throw Exception("BingoIndex: determineType(): Database format '%s' is not compatible with this version (%s); the database has to be recreated.", type,
+                        BINGO_VERSION);
 }
 
 BaseIndex::~BaseIndex()
 {
-    releaseFileLock(_lock_fd, _location);
+    releaseFileLock(_lock_fd, _location, _read_only);
     _lock_fd = -1;
-    MMFAllocator::getAllocator().close();
+    // Index that failed to open must not close an allocator of another database
+    if (_mmf_opened)
+    {
+        MMFAllocator::setDatabaseId(_index_id);
+        MMFAllocator::getAllocator().close();
+    }
 }
 
 void BaseIndex::_checkOptions(std::map<std::string, std::string>& option_map, bool is_create)
@@ -364,10 +567,12 @@ void BaseIndex::_checkOptions(std::map<std::string, std::string>& option_map, bo
         if (is_create)
         {
             if ((it->first.compare(_read_only_prop) != 0) && (it->first.compare(_mt_size_prop) != 0) && (it->first.compare(_min_mmf_size_prop) != 0) &&
-                (it->first.compare(_max_mmf_size_prop) != 0) && (it->first.compare(_id_key_prop) != 0))
+                (it->first.compare(_max_mmf_size_prop) != 0) && (it->first.compare(_id_key_prop) != 0) && (it->first.compare(_sub_compression_prop) != 0) &&
+                (it->first.compare(_result_cache_prop) != 0) && (it->first.compare(_mol_cache_prop) != 0) && (it->first.compare(_match_features_prop) != 0) &&
+                (it->first.compare(_sub_block_size_prop) != 0))
                 throw Exception("Creating index error: incorrect input options");
         }
-        else if ((it->first.compare(_read_only_prop)) != 0 && (it->first.compare(_id_key_prop) != 0))
+        else if ((it->first.compare(_read_only_prop)) != 0 && (it->first.compare(_id_key_prop) != 0) && (it->first.compare(_mol_cache_prop) != 0))
             throw Exception("Loading index error: incorrect input options");
     }
 }
@@ -423,6 +628,23 @@ bool BaseIndex::_getAccessType(std::map<std::string, std::string>& option_map)
     return false;
 }
 
+void BaseIndex::_createMoleculeCache(std::map<std::string, std::string>& option_map)
+{
+    if (_type != IndexType::MOLECULE || option_map.find(_mol_cache_prop) == option_map.end())
+        return;
+
+    // The budget is given in megabytes
+    unsigned long budget = 0;
+    std::istringstream isstr(option_map[_mol_cache_prop]);
+    isstr >> budget;
+
+    if (isstr.fail())
+        throw Exception("BaseIndex: incorrect molecule cache size");
+
+    if (budget > 0)
+        _molecule_cache = std::make_unique<MoleculeCache>(budget * 1048576);
+}
+
 void BaseIndex::_saveProperties(const MoleculeFingerprintParameters& fp_params, int sub_block_size, int sim_block_size, int cf_block_size,
                                 std::map<std::string, std::string>& option_map)
 {
@@ -467,6 +689,12 @@ ObjectIndexData BaseIndex::prepareIndexData(IndexObject& obj) const
         obj.buildHash(obj_data.hash);
     }
 
+    if (hasMatchFeatures())
+    {
+        profTimerStart(t, "prepare_features");
+        obj.buildMatchFeatures(obj_data.cf_str, obj_data.features_str);
+    }
+
     return obj_data;
 }
 
@@ -496,16 +724,27 @@ ObjectIndexData BaseIndex::prepareIndexDataWithExtFP(IndexObject& obj, IndigoObj
 
     obj.buildHash(obj_data.hash);
 
+    if (hasMatchFeatures())
+        obj.buildMatchFeatures(obj_data.cf_str, obj_data.features_str);
+
     return obj_data;
 }
 
 void BaseIndex::_insertIndexData(const ObjectIndexData& obj_data)
 {
     _sub_fp_storage.ptr()->add(obj_data.sub_fp.ptr());
-    _sim_fp_storage.ptr()->add(obj_data.sim_fp.ptr(), _header->object_count);
+    if (_bulk_load)
+    {
+        _bulk_sim_fps.insert(_bulk_sim_fps.end(), obj_data.sim_fp.ptr(), obj_data.sim_fp.ptr() + obj_data.sim_fp.size());
+        _bulk_sim_ids.push_back(_header->object_count);
+    }
+    else
+        _sim_fp_storage.ptr()->add(obj_data.sim_fp.ptr(), _header->object_count);
     _cf_storage.ptr()->add((byte*)obj_data.cf_str.ptr(), obj_data.cf_str.size(), _header->object_count);
     _exact_storage.ptr()->add(obj_data.hash, _header->object_count);
     _gross_storage.ptr()->add(obj_data.gross_str, _header->object_count);
+    if (hasMatchFeatures())
+        _features_storage.ptr()->add((byte*)obj_data.features_str.ptr(), obj_data.features_str.size(), _header->object_count);
 }
 
 void BaseIndex::_mappingLoad()
@@ -1,7 +1,13 @@
 #ifndef __bingo_base_index__
 #define __bingo_base_index__
 
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
 #include "molecule/molecule_fingerprint.h"
+#include "molecule/molecule_match_features.h"
 
 #include "indigo_internal.h"
 
@@ -9,17 +15,20 @@
 #include "bingo_exact_storage.h"
 #include "bingo_fp_storage.h"
 #include "bingo_gross_storage.h"
+#include "bingo_molecule_cache.h"
 #include "bingo_object.h"
 #include "bingo_properties.h"
+#include "bingo_result_cache.h"
 #include "bingo_sim_storage.h"
 #include "mmf/mmf_mapping.h"
 
-#define BINGO_VERSION "v0.72"
+#define BINGO_VERSION "v0.73"
 
 namespace bingo
 {
     class Matcher;
     class MatcherQueryData;
+    class BaseSimilarityBatchMatcher;
 
     enum class IndexType
     {
@@ -34,6 +43,7 @@ namespace bingo
         Array<byte> sim_fp;
         Array<char> cf_str;
         Array<char> gross_str;
+        Array<char> features_str;
         dword hash;
     };
 
@@ -52,6 +62,9 @@ namespace bingo
             MMFAddress gross_offset;
             int object_count;
             int first_free_id;
+            MMFAddress result_cache_offset;
+            int generation;
+            MMFAddress features_offset;
         };
 
     public:
@@ -62,6 +75,7 @@ namespace bingo
         virtual std::unique_ptr<Matcher> createMatcherTopN(const char* type, MatcherQueryData* query_data, const char* options, int limit) = 0;
         virtual std::unique_ptr<Matcher> createMatcherTopNWithExtFP(const char* type, MatcherQueryData* query_data, const char* options, int limit,
                                                                     IndigoObject& fp) = 0;
+        virtual std::unique_ptr<BaseSimilarityBatchMatcher> createMatcherBatch(const char* type, const char* options) = 0;
 
         void create(const char* location, const MoleculeFingerprintParameters& fp_params, const char* options, int index_id);
 
@@ -71,6 +85,13 @@ namespace bingo
 
         void optimize();
 
+        // Records added until endBulkLoad() keep their similarity fingerprints aside; the similarity
+        // storage is then laid out at once, sorted by bit count. The records become visible to
+        // searches in endBulkLoad(). Does nothing if the index is not empty.
+        void beginBulkLoad();
+
+        void endBulkLoad();
+
         void remove(int id);
 
         const MoleculeFingerprintParameters& getFingerprintParams() const;
@@ -91,14 +112,44 @@ namespace bingo
 
         int getObjectsCount() const;
 
+        // Number of records visible to searches started now. A record is
+        // published only after all storages and id mappings contain it.
+        int getCommittedObjectsCount() const;
+
+        // Changes whenever similarity storage cells are rebuilt or reordered
+        int getSimLayoutVersion() const;
+
+        // Changes with every insertion and deletion; cached search results are valid only for it
+        int getGeneration() const;
+
+        bool hasResultCache() const;
+
+        bool findCachedResult(const Array<char>& key, int generation, Array<int>& ids, Array<float>& sim_values);
+
+        // Does nothing for read-only indexes and for results of the previous generations
+        void storeCachedResult(const Array<char>& key, int generation, const Array<int>& ids, const Array<float>& sim_values);
+
         const byte* getObjectCf(int id, int& len);
 
+        // Decodes the molecule record, reusing the cached molecule if there is one
+        void getObjectMolecule(int id, Molecule& mol);
+
+        // Cache of decoded molecules for the internal ids; nullptr if it is disabled
+        MoleculeCache* getMoleculeCache();
+
+        bool hasMatchFeatures() const;
+
+        // Loads the match features stored for the internal id; returns false if there are none
+        bool getObjectFeatures(int id, MoleculeMatchFeatures& features);
+
         const char* getIdPropertyName() const;
 
         const char* getVersion();
 
         IndexType getType() const;
 
+        int getIndexId() const;
+
         static IndexType determineType(const char* location);
 
         ObjectIndexData prepareIndexData(IndexObject& obj) const;
@@ -119,10 +170,21 @@ namespace bingo
         MMFPtr<GrossStorage> _gross_storage;
         MMFPtr<ByteBufferStorage> _cf_storage;
         MMFPtr<Properties> _properties;
+        MMFPtr<ResultCache> _result_cache;
+        MMFPtr<ByteBufferStorage> _features_storage;
 
         MoleculeFingerprintParameters _fp_params;
         std::string _location;
+        int _index_id = -1;
         int _lock_fd = -1;
+        bool _mmf_opened = false;
+        bool _bulk_load = false;
+        std::vector<byte> _bulk_sim_fps;
+        std::vector<int> _bulk_sim_ids;
+        std::atomic<int> _committed_count{0};
+        std::atomic<int> _sim_layout_version{0};
+        std::mutex _result_cache_lock;
+        std::unique_ptr<MoleculeCache> _molecule_cache;
 
         static void _checkOptions(std::map<std::string, std::string>& option_map, bool is_create);
 
@@ -132,6 +194,8 @@ namespace bingo
 
         static bool _getAccessType(std::map<std::string, std::string>& option_map);
 
+        void _createMoleculeCache(std::map<std::string, std::string>& option_map);
+
         void _saveProperties(const MoleculeFingerprintParameters& fp_params, int sub_block_size, int sim_block_size, int cf_block_size,
                              std::map<std::string, std::string>& option_map);
 
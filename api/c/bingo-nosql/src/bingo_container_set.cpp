@@ -68,6 +68,44 @@ void ContainerSet::buildContainer()
     _inc_count = 0;
 }
 
+void ContainerSet::bulkLoad(const byte* fingerprints, const int* ids, const int* bit_counts, const int* order, int count)
+{
+    if (_set.size() > 0 || _inc_count > 0)
+        throw indigo::Exception("ContainerSet: bulk load is possible only into empty set");
+
+    int built_count = count - count % _container_size;
+
+    for (int begin = 0; begin < built_count; begin += _container_size)
+    {
+        profIncCounter("trees_count", 1);
+
+        MMFPtr<byte> cont_fingerprints;
+        cont_fingerprints.allocate(_container_size * _fp_size);
+        MMFPtr<int> cont_indices;
+        cont_indices.allocate(_container_size);
+
+        // Fingerprints are sorted by bit count, so the tree gets tighter bounds than the cell
+        int min_ones_count = bit_counts[order[begin]];
+        int max_ones_count = bit_counts[order[begin + _container_size - 1]];
+
+        for (int i = 0; i < _container_size; i++)
+        {
+            int idx = order[begin + i];
+            memcpy(cont_fingerprints.ptr() + i * _fp_size, fingerprints + idx * _fp_size, _fp_size);
+            cont_indices[i] = ids[idx];
+        }
+
+        MultibitTree& cont = _set.push<int>(_fp_size);
+        cont.build(cont_fingerprints, cont_indices, _container_size, min_ones_count, max_ones_count);
+    }
+
+    for (int i = built_count; i < count; i++)
+    {
+        int idx = order[i];
+        add(fingerprints + idx * _fp_size, ids[idx], bit_counts[idx]);
+    }
+}
+
 void ContainerSet::splitSet(ContainerSet& new_set)
 {
     if (_set.size() > 0)
@@ -134,6 +172,14 @@ void ContainerSet::findSimilar(const byte* query, SimCoef& sim_coef, double min_
     idx++;
 }
 
+void ContainerSet::findSimilarBatch(SimBatchQueries& queries, SimCoef& sim_coef, double min_coef)
+{
+    for (int i = 0; i < _set.size(); i++)
+        _set[i].findSimilarBatch(queries, sim_coef, min_coef);
+
+    queries.findSimilarLinear(_increment.ptr(), _indices.ptr(), _inc_count, -1, sim_coef, min_coef);
+}
+
 void ContainerSet::optimize()
 {
     if (_inc_count < _container_size / 10)
@@ -189,9 +235,8 @@ int ContainerSet::_findSimilarInc(const byte* query, SimCoef& sim_coef, double m
     for (int i = 0; i < _inc_count; i++)
     {
         byte* fp = inc + i * _fp_size;
-        int fp_bit_number = bitGetOnesCount(fp, _fp_size);
 
-        double coef = sim_coef.calcCoef(fp, query, query_bit_number, fp_bit_number);
+        double coef = sim_coef.calcCoef(query, fp, query_bit_number, -1);
         if (coef < min_coef)
             continue;
 
@@ -32,10 +32,16 @@ namespace bingo
 
         void buildContainer();
 
+        // Fills an empty set with the fingerprints taken in the given order. Full containers
+        // are built directly, the rest goes to the increment
+        void bulkLoad(const byte* fingerprints, const int* ids, const int* bit_counts, const int* order, int count);
+
         void splitSet(ContainerSet& new_set);
 
         void findSimilar(const byte* query, SimCoef& sim_coef, double min_coef, indigo::Array<SimResult>& sim_indices);
 
+        void findSimilarBatch(SimBatchQueries& queries, SimCoef& sim_coef, double min_coef);
+
         void optimize();
 
         int getSimilar(const byte* query, SimCoef& sim_coef, double min_coef, indigo::Array<SimResult>& sim_fp_indices, int cont_idx);
@@ -8,10 +8,7 @@ EuclidCoef::EuclidCoef(int fp_size) : _fp_size(fp_size)
 
 double EuclidCoef::calcCoef(const byte* target, const byte* query, int target_bit_count, int query_bit_count)
 {
-    int common_bits = bitCommonOnes(target, query, _fp_size);
-
-    if (target_bit_count == -1)
-        target_bit_count = bitGetOnesCount(target, _fp_size);
+    int common_bits = _calcCommonBits(target, query, _fp_size, target_bit_count, query_bit_count);
 
     return (double)common_bits / target_bit_count;
 }
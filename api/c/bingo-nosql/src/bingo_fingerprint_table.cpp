@@ -1,5 +1,7 @@
 #include "bingo_fingerprint_table.h"
 
+#include <algorithm>
+
 using namespace bingo;
 
 FingerprintTable::FingerprintTable(int fp_size, const indigo::Array<int>& borders, int mt_size) : _table(100), _fp_size(fp_size), _mt_size(mt_size)
@@ -37,6 +39,52 @@ void FingerprintTable::load(MMFPtr<FingerprintTable>& ptr, MMFAddress offset)
     ptr = MMFPtr<FingerprintTable>(offset);
 }
 
+MMFAddress FingerprintTable::createSorted(MMFPtr<FingerprintTable>& ptr, int fp_size, int mt_size, const byte* fingerprints, const int* ids, int count)
+{
+    profTimerStart(t, "FingerprintTable sorted build");
+
+    std::vector<int> bit_counts(count);
+    for (int i = 0; i < count; i++)
+        bit_counts[i] = bitGetOnesCount(fingerprints + i * fp_size, fp_size);
+
+    std::vector<int> order(count);
+    for (int i = 0; i < count; i++)
+        order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&bit_counts](int a, int b) { return bit_counts[a] < bit_counts[b]; });
+
+    // The same number of cells as the incremental splitting would produce, with borders at
+    // the quantiles of the bit count distribution
+    const int max_cell_count = 100;
+    int cell_count = std::max(1, std::min(max_cell_count, count / mt_size));
+
+    indigo::Array<int> borders;
+    borders.push(0);
+    for (int i = 1; i < cell_count; i++)
+    {
+        int border = bit_counts[order[(long long)count * i / cell_count]];
+        if (border > borders.top())
+            borders.push(border);
+    }
+    borders.push(fp_size * 8 + 1);
+
+    ptr.allocate();
+    new (ptr.ptr()) FingerprintTable(fp_size, borders, mt_size);
+
+    FingerprintTable& table = ptr.ref();
+    int begin = 0;
+    for (int i = 0; i < table._table.size(); i++)
+    {
+        int end = begin;
+        while (end < count && bit_counts[order[end]] <= table._table[i].getMaxBorder())
+            end++;
+
+        table._table[i].bulkLoad(fingerprints, ids, bit_counts.data(), order.data() + begin, end - begin);
+        begin = end;
+    }
+
+    return ptr.getAddress();
+}
+
 void FingerprintTable::add(const byte* fingerprint, int id)
 {
     int fp_bit_count = bitGetOnesCount(fingerprint, _fp_size);
@@ -84,6 +132,38 @@ void FingerprintTable::findSimilar(const byte* query, SimCoef& sim_coef, double
     }
 }
 
+void FingerprintTable::findSimilarBatch(SimBatchQueries& queries, SimCoef& sim_coef, double min_coef)
+{
+    int query_count = queries.bit_counts.size();
+
+    QS_DEF(indigo::Array<int>, min_cells);
+    QS_DEF(indigo::Array<int>, max_cells);
+    min_cells.clear_resize(query_count);
+    max_cells.clear_resize(query_count);
+
+    for (int i = 0; i < query_count; i++)
+        getCellsInterval(queries.fingerprints + i * _fp_size, sim_coef, min_coef, min_cells[i], max_cells[i]);
+
+    // Every cell is visited once and only by the queries whose bounds allow hits in it
+    for (int i = 0; i < _table.size(); i++)
+    {
+        queries.active.clear();
+        for (int j = 0; j < query_count; j++)
+        {
+            if (min_cells[j] == -1 || i < min_cells[j] || i > max_cells[j])
+                continue;
+            if (sim_coef.calcUpperBound(queries.bit_counts[j], _table[i].getMinBorder(), _table[i].getMaxBorder()) < min_coef)
+                continue;
+            queries.active.push(j);
+        }
+
+        if (queries.active.size() == 0)
+            continue;
+
+        _table[i].findSimilarBatch(queries, sim_coef, min_coef);
+    }
+}
+
 void FingerprintTable::optimize()
 {
     for (int i = 0; i < _table.size(); i++)
@@ -111,10 +191,10 @@ void FingerprintTable::getCellsInterval(const byte* query, SimCoef& sim_coef, do
 
     for (int i = 0; i < _table.size(); i++)
     {
-        if ((min_cell == -1) && (sim_coef.calcUpperBound(query_bit_count, _table[i].getMinBorder(), _table[i].getMaxBorder()) > min_coef))
+        if ((min_cell == -1) && (sim_coef.calcUpperBound(query_bit_count, _table[i].getMinBorder(), _table[i].getMaxBorder()) >= min_coef))
             min_cell = i;
 
-        if ((min_cell != -1) && (sim_coef.calcUpperBound(query_bit_count, _table[i].getMinBorder(), _table[i].getMaxBorder()) > min_coef))
+        if ((min_cell != -1) && (sim_coef.calcUpperBound(query_bit_count, _table[i].getMinBorder(), _table[i].getMaxBorder()) >= min_coef))
             max_cell = i;
     }
 }
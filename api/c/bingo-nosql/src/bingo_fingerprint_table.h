@@ -26,10 +26,16 @@ namespace bingo
 
         static void load(MMFPtr<FingerprintTable>& ptr, MMFAddress offset);
 
+        // Creates a table from all the fingerprints at once. Fingerprints are sorted by bit count,
+        // cell borders are taken from that distribution and each cell is filled in one pass.
+        static MMFAddress createSorted(MMFPtr<FingerprintTable>& ptr, int fp_size, int mt_size, const byte* fingerprints, const int* ids, int count);
+
         void add(const byte* fingerprint, int id);
 
         void findSimilar(const byte* query, SimCoef& sim_coef, double min_coef, indigo::Array<SimResult>& sim_fp_indices);
 
+        void findSimilarBatch(SimBatchQueries& queries, SimCoef& sim_coef, double min_coef);
+
         void optimize();
 
         int getCellCount() const;
@@ -1,13 +1,21 @@
 #include "bingo_fp_storage.h"
 
 #include "base_c/bitarray.h"
+#include "base_cpp/exception.h"
 #include "base_cpp/profiling.h"
 #include "base_cpp/tlscont.h"
 
 using namespace bingo;
 
-TranspFpStorage::TranspFpStorage(int fp_size, int block_size, int small_base_size) : _fp_size(fp_size), _block_size(block_size)
+// Compressed block header is the number of ones, followed by either their 16-bit positions or the bitmap
+static const int _compressed_header_size = sizeof(int);
+
+TranspFpStorage::TranspFpStorage(int fp_size, int block_size, int small_base_size, bool compressed)
+    : _fp_size(fp_size), _block_size(block_size), _compressed(compressed)
 {
+    if (_compressed && block_size * 8 > UINT16_MAX + 1)
+        throw indigo::Exception("TranspFpStorage: block size %d is too large for the compressed storage", block_size);
+
     _pack_count = 0;
     _storage.resize(fp_size * 8);
     _block_count = 0;
@@ -20,10 +28,10 @@ TranspFpStorage::TranspFpStorage(int fp_size, int block_size, int small_base_siz
     _fp_bit_usage_counts.resize(_fp_size * 8);
 }
 
-MMFAddress TranspFpStorage::create(MMFPtr<TranspFpStorage>& ptr, int fp_size, int block_size, int small_base_size)
+MMFAddress TranspFpStorage::create(MMFPtr<TranspFpStorage>& ptr, int fp_size, int block_size, int small_base_size, bool compressed)
 {
     ptr.allocate();
-    new (ptr.ptr()) TranspFpStorage(fp_size, block_size, small_base_size);
+    new (ptr.ptr()) TranspFpStorage(fp_size, block_size, small_base_size, compressed);
     return ptr.getAddress();
 }
 
@@ -60,9 +68,38 @@ int TranspFpStorage::getBlockSize() const
 
 const byte* TranspFpStorage::getBlock(int idx)
 {
+    if (_compressed)
+        throw indigo::Exception("TranspFpStorage: compressed blocks can't be accessed as bitmaps");
+
     return _storage[idx].ptr();
 }
 
+bool TranspFpStorage::isCompressed() const
+{
+    return _compressed;
+}
+
+int TranspFpStorage::getCompressedBlock(int idx, const byte*& bitmap, const uint16_t*& positions)
+{
+    const byte* block = _storage[idx].ptr();
+
+    int ones_count;
+    memcpy(&ones_count, block, sizeof(ones_count));
+
+    if (ones_count * (int)sizeof(uint16_t) < _block_size)
+    {
+        bitmap = nullptr;
+        positions = reinterpret_cast<const uint16_t*>(block + _compressed_header_size);
+    }
+    else
+    {
+        bitmap = block + _compressed_header_size;
+        positions = nullptr;
+    }
+
+    return ones_count;
+}
+
 int TranspFpStorage::getBlockCount() const
 {
     return _block_count;
@@ -101,22 +138,66 @@ void TranspFpStorage::_addIncToStorage()
         for (int fp_idx = 0; fp_idx < _inc_fp_count; fp_idx++)
             bitSetBit(&block_buf[0], fp_idx, bitGetBit(_inc_buffer.ptr() + fp_idx * _fp_size, bit_idx));
 
+        int block_idx = (_pack_count * _fp_size * 8) + bit_idx;
+
+        int usage_count = bitGetOnesCount(&block_buf[0], _block_size);
         if (_pack_count == 0)
         {
             // Update bit usage count
-            _fp_bit_usage_counts[bit_idx] = bitGetOnesCount(&block_buf[0], _block_size);
+            _fp_bit_usage_counts[bit_idx] = usage_count;
         }
+        _pack_bit_usage_counts.resize(block_idx + 1);
+        _pack_bit_usage_counts[block_idx] = usage_count;
 
-        int block_idx = (_pack_count * _fp_size * 8) + bit_idx;
         _storage.resize(block_idx + 1);
-        _storage[block_idx].allocate(_block_size);
-        memcpy(_storage[block_idx].ptr(), &block_buf[0], _block_size);
+        if (_compressed)
+        {
+            _storage[block_idx] = _compressBlock(&block_buf[0]);
+        }
+        else
+        {
+            _storage[block_idx].allocate(_block_size);
+            memcpy(_storage[block_idx].ptr(), &block_buf[0], _block_size);
+        }
         _block_count++;
     }
 
     _pack_count++;
 }
 
+MMFPtr<byte> TranspFpStorage::_compressBlock(const byte* block)
+{
+    int ones_count = bitGetOnesCount(block, _block_size);
+    bool sparse = ones_count * (int)sizeof(uint16_t) < _block_size;
+
+    int data_size = (sparse ? ones_count * (int)sizeof(uint16_t) : _block_size);
+    // Keep the following allocations aligned
+    int alloc_size = (_compressed_header_size + data_size + 3) & ~3;
+
+    MMFPtr<byte> compressed;
+    compressed.allocate(alloc_size);
+    byte* data = compressed.ptr();
+    memcpy(data, &ones_count, sizeof(ones_count));
+
+    if (sparse)
+    {
+        uint16_t* positions = reinterpret_cast<uint16_t*>(data + _compressed_header_size);
+        int pos_idx = 0;
+        for (int i = 0; i < _block_size; i++)
+        {
+            if (block[i] == 0)
+                continue;
+            for (int bit = 0; bit < 8; bit++)
+                if (block[i] & (1 << bit))
+                    positions[pos_idx++] = (uint16_t)(i * 8 + bit);
+        }
+    }
+    else
+        memcpy(data + _compressed_header_size, block, _block_size);
+
+    return compressed;
+}
+
 /*
 void TranspFpStorage::create (int fp_size, const char *info_filename)
 {
@@ -153,6 +234,11 @@ MMFArray<int>& TranspFpStorage::getFpBitUsageCounts()
     return _fp_bit_usage_counts;
 }
 
+int TranspFpStorage::getPackBitUsageCount(int pack_idx, int bit_idx)
+{
+    return _pack_bit_usage_counts[pack_idx * _fp_size * 8 + bit_idx];
+}
+
 int TranspFpStorage::getPackCount() const
 {
     return _pack_count;
@@ -1,6 +1,7 @@
 #ifndef __bingo_fp_storage__
 #define __bingo_fp_storage__
 
+#include <cstdint>
 #include <fstream>
 #include <vector>
 
@@ -12,9 +13,9 @@ namespace bingo
     class TranspFpStorage
     {
     public:
-        TranspFpStorage(int fp_size, int block_size, int small_base_size);
+        TranspFpStorage(int fp_size, int block_size, int small_base_size, bool compressed = false);
 
-        static MMFAddress create(MMFPtr<TranspFpStorage>& ptr, int fp_size, int block_size, int small_base_size);
+        static MMFAddress create(MMFPtr<TranspFpStorage>& ptr, int fp_size, int block_size, int small_base_size, bool compressed = false);
 
         static void load(MMFPtr<TranspFpStorage>& ptr, MMFAddress offset);
 
@@ -24,6 +25,12 @@ namespace bingo
 
         const byte* getBlock(int idx);
 
+        bool isCompressed() const;
+
+        // Returns the number of ones in the compressed block. Sparse blocks are returned
+        // as the sorted positions of the ones, the others as a plain bitmap
+        int getCompressedBlock(int idx, const byte*& bitmap, const uint16_t*& positions);
+
         int getBlockCount() const;
 
         const byte* getIncrement() const;
@@ -38,6 +45,9 @@ namespace bingo
 
         MMFArray<int>& getFpBitUsageCounts();
 
+        // Number of records of the pack that have the bit set
+        int getPackBitUsageCount(int pack_idx, int bit_idx);
+
     protected:
         int _fp_size;
         int _block_count;
@@ -53,9 +63,15 @@ namespace bingo
 
         MMFArray<int> _fp_bit_usage_counts;
 
+        bool _compressed;
+
+        MMFArray<int> _pack_bit_usage_counts;
+
         void _createFpStorage(int fp_size, int inc_fp_capacity, const char* inc_filename);
 
         void _addIncToStorage();
+
+        MMFPtr<byte> _compressBlock(const byte* block);
     };
 }; // namespace bingo
 
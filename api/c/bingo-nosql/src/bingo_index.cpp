@@ -5,24 +5,84 @@
 
 using namespace bingo;
 
+namespace
+{
+    // Identifies the search in the index result cache; returns false if the search can't be cached
+    bool buildResultCacheKey(BaseIndex& index, const char* type, MatcherQueryData* query_data, const char* options, Array<char>& key)
+    {
+        if (!index.hasResultCache() || query_data == nullptr)
+            return false;
+
+        Array<char> query_key;
+        if (!query_data->getQueryObject().buildCacheKey(query_key))
+            return false;
+
+        ArrayOutput output(key);
+        output.printf("%s\n%s\n", type, options != nullptr ? options : "");
+
+        SimilarityQueryData* sim_query_data = dynamic_cast<SimilarityQueryData*>(query_data);
+        if (sim_query_data != nullptr)
+            output.printf("%.9g %.9g\n", sim_query_data->getMin(), sim_query_data->getMax());
+
+        output.write(query_key.ptr(), query_key.size());
+        return true;
+    }
+
+    std::unique_ptr<Matcher> findCachedMatcher(BaseIndex& index, const Array<char>& key, MatcherQueryData* query_data)
+    {
+        Array<int> ids;
+        Array<float> sim_values;
+        if (!index.findCachedResult(key, index.getGeneration(), ids, sim_values))
+            return nullptr;
+
+        // Substructure queries are kept for the mappings of the hits, the others aren't needed
+        std::unique_ptr<SubstructureQueryData> sub_query_data(dynamic_cast<SubstructureQueryData*>(query_data));
+        if (sub_query_data == nullptr)
+            delete query_data;
+        return std::make_unique<MolCachedMatcher>(index, ids, sim_values, std::move(sub_query_data));
+    }
+}
+
 MoleculeIndex::MoleculeIndex() : BaseIndex(IndexType::MOLECULE)
 {
 }
 
 std::unique_ptr<Matcher> MoleculeIndex::createMatcher(const char* type, MatcherQueryData* query_data, const char* options)
 {
+    // Cached results are returned before the query is even screened
+    Array<char> cache_key;
+    const bool cacheable = (strcmp(type, "sub") == 0 || strcmp(type, "sim") == 0) && buildResultCacheKey(*this, type, query_data, options, cache_key);
+
     if (strcmp(type, "sub") == 0)
     {
+        if (cacheable)
+        {
+            auto cached = findCachedMatcher(*this, cache_key, query_data);
+            if (cached)
+                return cached;
+        }
+
         std::unique_ptr<MoleculeSubMatcher> matcher = std::make_unique<MoleculeSubMatcher>(*this);
         matcher->setOptions(options);
         matcher->setQueryData(dynamic_cast<SubstructureQueryData*>(query_data));
+        if (cacheable)
+            return std::make_unique<ResultCachingMatcher>(*this, cache_key, false, std::move(matcher));
         return matcher;
     }
     else if (strcmp(type, "sim") == 0)
     {
+        if (cacheable)
+        {
+            auto cached = findCachedMatcher(*this, cache_key, query_data);
+            if (cached)
+                return cached;
+        }
+
         std::unique_ptr<MoleculeSimMatcher> matcher = std::make_unique<MoleculeSimMatcher>(*this);
         matcher->setOptions(options);
         matcher->setQueryData(dynamic_cast<SimilarityQueryData*>(query_data));
+        if (cacheable)
+            return std::make_unique<ResultCachingMatcher>(*this, cache_key, true, std::move(matcher));
         return matcher;
     }
     else if (strcmp(type, "exact") == 0)
@@ -97,6 +157,20 @@ std::unique_ptr<Matcher> MoleculeIndex::createMatcherTopNWithExtFP(const char* t
     return nullptr;
 }
 
+std::unique_ptr<BaseSimilarityBatchMatcher> MoleculeIndex::createMatcherBatch(const char* type, const char* options)
+{
+    if (strcmp(type, "sim") == 0)
+    {
+        std::unique_ptr<MoleculeSimBatchMatcher> matcher = std::make_unique<MoleculeSimBatchMatcher>(*this);
+        matcher->setOptions(options);
+        return matcher;
+    }
+    else
+        throw Exception("createMatcher: undefined type");
+
+    return nullptr;
+}
+
 ReactionIndex::ReactionIndex() : BaseIndex(IndexType::REACTION)
 {
 }
@@ -181,3 +255,17 @@ std::unique_ptr<Matcher> ReactionIndex::createMatcherTopNWithExtFP(const char* t
 
     return nullptr;
 }
+
+std::unique_ptr<BaseSimilarityBatchMatcher> ReactionIndex::createMatcherBatch(const char* type, const char* options)
+{
+    if (strcmp(type, "sim") == 0)
+    {
+        std::unique_ptr<ReactionSimBatchMatcher> matcher = std::make_unique<ReactionSimBatchMatcher>(*this);
+        matcher->setOptions(options);
+        return matcher;
+    }
+    else
+        throw Exception("createMatcher: undefined type");
+
+    return nullptr;
+}
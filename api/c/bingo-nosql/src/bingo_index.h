@@ -16,6 +16,7 @@ namespace bingo
         std::unique_ptr<Matcher> createMatcherTopN(const char* type, MatcherQueryData* query_data, const char* options, int limit) final;
         std::unique_ptr<Matcher> createMatcherTopNWithExtFP(const char* type, MatcherQueryData* query_data, const char* options, int limit,
                                                             IndigoObject& fp) final;
+        std::unique_ptr<BaseSimilarityBatchMatcher> createMatcherBatch(const char* type, const char* options) final;
     };
 
     class ReactionIndex final : public BaseIndex
@@ -28,6 +29,7 @@ namespace bingo
         std::unique_ptr<Matcher> createMatcherTopN(const char* type, MatcherQueryData* query_data, const char* options, int limit) final;
         std::unique_ptr<Matcher> createMatcherTopNWithExtFP(const char* type, MatcherQueryData* query_data, const char* options, int limit,
                                                             IndigoObject& fp) final;
+        std::unique_ptr<BaseSimilarityBatchMatcher> createMatcherBatch(const char* type, const char* options) final;
     };
 } // namespace bingo
 
@@ -18,6 +18,15 @@ using namespace bingo;
 
 static const char* _matcher_params_prop = "";
 static const char* _matcher_part_prop = "part";
+static const char* _matcher_threads_prop = "threads";
+
+// Number of packs given to each worker thread during one parallel search round
+static const int _parallel_packs_per_thread = 2;
+// Columns screened per pack until the time of a candidate check is known
+static const int _default_screening_columns = 15;
+static const int _min_match_time_samples = 20;
+// Larger results are not worth the space in the result cache
+static const int _max_cached_results = 100000;
 
 GrossQueryData::GrossQueryData(Array<char>& gross_str) : _obj(gross_str)
 {
@@ -147,6 +156,8 @@ BaseMatcher::BaseMatcher(BaseIndex& index, IndigoObject*& current_obj) : _index(
     _current_id = -1;
     _part_id = -1;
     _part_count = -1;
+    _threads_count = 0;
+    _snapshot_count = _index.getCommittedObjectsCount();
 }
 
 BaseMatcher::~BaseMatcher()
@@ -186,6 +197,17 @@ float BaseMatcher::currentSimValue() const
     throw Exception("BaseMatcher: Matcher does not support this method");
 }
 
+int BaseMatcher::currentQueryIndex() const
+{
+    // Single-query matchers
+    return 0;
+}
+
+const Array<int>* BaseMatcher::currentMoleculeMapping()
+{
+    return nullptr;
+}
+
 int BaseMatcher::containersCount() const
 {
     throw Exception("BaseMatcher: Matcher does not support this method");
@@ -222,6 +244,7 @@ void BaseMatcher::setOptions(const char* options)
     std::vector<std::string> allowed_props;
     allowed_props.push_back(_matcher_params_prop);
     allowed_props.push_back(_matcher_part_prop);
+    allowed_props.push_back(_matcher_threads_prop);
     Properties::parseOptions(options, option_map, &allowed_props);
 
     if (option_map.find(_matcher_params_prop) != option_map.end())
@@ -248,10 +271,27 @@ void BaseMatcher::setOptions(const char* options)
         _part_count = part_count;
         _initPartition();
     }
+
+    if (option_map.find(_matcher_threads_prop) != option_map.end())
+    {
+        std::stringstream threads_str;
+        threads_str << option_map[_matcher_threads_prop];
+
+        int threads_count;
+        threads_str >> threads_count;
+
+        if (threads_str.fail() || threads_count < 0)
+            throw Exception("BaseMatcher: setOptions: incorrect threads count");
+
+        _threads_count = threads_count;
+    }
 }
 
 bool BaseMatcher::_isCurrentObjectExist()
 {
+    if (_current_id >= _snapshot_count)
+        return false;
+
     int cf_len;
     _index.getCfStorage().get(_current_id, cf_len);
 
@@ -268,6 +308,9 @@ bool BaseMatcher::_loadCurrentObject()
         if (_current_obj == nullptr)
             throw Exception("BaseMatcher: Matcher's current object was destroyed");
 
+        if (_current_id >= _snapshot_count)
+            return false;
+
         profTimerStart(t_get_cmf, "loadCurObj_get_cf");
         ByteBufferStorage& cf_storage = _index.getCfStorage();
 
@@ -337,6 +380,160 @@ float BaseMatcher::esimateRemainingTime(float& delta)
     return left_obj_count * mean_time;
 }
 
+//
+// Parallel substructure search
+//
+
+namespace bingo
+{
+    // Screens one pack of the substructure fingerprint storage and verifies its candidates
+    class SubstructureSearchCommand : public OsCommand
+    {
+    public:
+        void execute(OsCommandResult& result) override;
+
+        int pack_idx;
+        BaseSubstructureMatcher* matcher;
+        std::unique_ptr<SubstructureCandidateChecker> checker;
+
+    private:
+        Array<int> _candidates;
+        Array<int> _mapping;
+    };
+
+    class SubstructureSearchResult : public OsCommandResult
+    {
+    public:
+        void clear() override
+        {
+            hits.clear();
+            mappings.clear();
+            mapping_offsets.clear();
+            match_times.clear();
+            candidates_count = 0;
+        }
+
+        Array<int> hits;
+        Array<int> mappings;
+        Array<int> mapping_offsets;
+        Array<float> match_times;
+        int candidates_count;
+    };
+
+    // Processes a window of packs with HANDLING_ORDER_SERIAL, so the hits
+    // are returned in the same order as in the single-threaded search
+    class SubstructureSearchDispatcher : public OsCommandDispatcher
+    {
+    public:
+        SubstructureSearchDispatcher(BaseSubstructureMatcher& matcher) : OsCommandDispatcher(HANDLING_ORDER_SERIAL, true), _matcher(matcher)
+        {
+            _next_pack = 0;
+            _end_pack = 0;
+        }
+
+        void processPacks(int begin, int end, int threads_count)
+        {
+            _next_pack = begin;
+            _end_pack = end;
+            run(threads_count);
+        }
+
+    protected:
+        OsCommand* _allocateCommand() override
+        {
+            auto* command = new SubstructureSearchCommand();
+            command->matcher = &_matcher;
+            command->checker = _matcher._createCandidateChecker();
+            return command;
+        }
+
+        OsCommandResult* _allocateResult() override
+        {
+            return new SubstructureSearchResult();
+        }
+
+        bool _setupCommand(OsCommand& command) override
+        {
+            if (_next_pack >= _end_pack)
+                return false;
+
+            static_cast<SubstructureSearchCommand&>(command).pack_idx = _next_pack++;
+            return true;
+        }
+
+        void _handleResult(OsCommandResult& result) override
+        {
+            auto& search_result = static_cast<SubstructureSearchResult&>(result);
+
+            int mappings_offset = _matcher._parallel_mappings.size();
+            for (int i = 0; i < search_result.mapping_offsets.size(); i++)
+                _matcher._parallel_mapping_offsets.push(search_result.mapping_offsets[i] + mappings_offset);
+            _matcher._parallel_mappings.concat(search_result.mappings);
+
+            _matcher._parallel_hits.concat(search_result.hits);
+            _matcher._cand_count += search_result.candidates_count;
+
+            for (int i = 0; i < search_result.hits.size(); i++)
+                _matcher._match_probability_esimate.addValue(1);
+            _matcher._match_probability_esimate.setCount(_matcher._match_probability_esimate.getCount() + search_result.candidates_count -
+                                                         search_result.hits.size());
+
+            for (int i = 0; i < search_result.match_times.size(); i++)
+                _matcher._match_time_esimate.addValue(search_result.match_times[i]);
+        }
+
+        void _prepareThread() override
+        {
+            // Memory mapped storage is resolved through the thread-local allocator
+            MMFAllocator::setDatabaseId(_matcher._index.getIndexId());
+        }
+
+    private:
+        BaseSubstructureMatcher& _matcher;
+        int _next_pack;
+        int _end_pack;
+    };
+}
+
+void SubstructureSearchCommand::execute(OsCommandResult& result)
+{
+    auto& search_result = static_cast<SubstructureSearchResult&>(result);
+
+    matcher->_findPackCandidates(pack_idx, _candidates);
+    search_result.candidates_count = _candidates.size();
+
+    ByteBufferStorage& cf_storage = matcher->_index.getCfStorage();
+
+    for (int i = 0; i < _candidates.size(); i++)
+    {
+        int cf_len;
+        const char* cf_str = (const char*)cf_storage.get(_candidates[i], cf_len);
+
+        if (cf_len == -1)
+            continue;
+
+        try
+        {
+            qword match_start = nanoClock();
+            BufferScanner buf_scn(cf_str, cf_len);
+
+            if (checker->check(_candidates[i], buf_scn, _mapping))
+            {
+                search_result.hits.push(_candidates[i]);
+                search_result.mapping_offsets.push(search_result.mappings.size());
+                search_result.mappings.concat(_mapping);
+            }
+            search_result.match_times.push(nanoHowManySeconds(nanoClock() - match_start));
+        }
+        catch (Exception& ex)
+        {
+            const int db_id = matcher->_index.getIdMapping()[_candidates[i]];
+            ex.appendMessage(" on id=%d", db_id);
+            throw;
+        }
+    }
+}
+
 //
 // BaseSubstructureMatcher
 //
@@ -350,12 +547,22 @@ BaseSubstructureMatcher::BaseSubstructureMatcher(/*const */ BaseIndex& index, In
     _current_cand_id = -1;
     _current_pack = -1;
     _final_pack = _fp_storage.getPackCount() + 1;
+    _current_hit_id = -1;
 
     _cand_count = 0;
+    _screening_time_count = 0;
+    _screening_time_mean = 0;
+}
+
+BaseSubstructureMatcher::~BaseSubstructureMatcher()
+{
 }
 
 bool BaseSubstructureMatcher::next()
 {
+    if (_threads_count > 0)
+        return _nextParallel();
+
     // int fp_size_in_bits = _fp_size * 8;
     // static int sub_cnt = 0;
 
@@ -370,7 +577,8 @@ bool BaseSubstructureMatcher::next()
             _current_pack++;
             if (_current_pack < _final_pack)
             {
-                _findPackCandidates(_current_pack);
+                _updateScreeningEstimate();
+                _findPackCandidates(_current_pack, _candidates);
                 _cand_count += _candidates.size();
             }
             else
@@ -407,6 +615,44 @@ bool BaseSubstructureMatcher::next()
     return false;
 }
 
+bool BaseSubstructureMatcher::_nextParallel()
+{
+    _current_hit_id++;
+    while (_current_hit_id >= _parallel_hits.size())
+    {
+        if (_current_pack + 1 >= _final_pack)
+        {
+            profIncCounter("sub_count_cand", _cand_count);
+            return false;
+        }
+
+        profTimerStart(tp, "sub_parallel_round");
+
+        if (_dispatcher == nullptr)
+            _dispatcher = std::make_unique<SubstructureSearchDispatcher>(*this);
+
+        int begin_pack = _current_pack + 1;
+        int end_pack = std::min(_final_pack, begin_pack + _threads_count * _parallel_packs_per_thread);
+
+        _parallel_hits.clear();
+        _parallel_mappings.clear();
+        _parallel_mapping_offsets.clear();
+        _current_hit_id = 0;
+        _updateScreeningEstimate();
+        _dispatcher->processPacks(begin_pack, end_pack, _threads_count);
+        _current_pack = end_pack - 1;
+    }
+
+    _current_id = _parallel_hits[_current_hit_id];
+    profIncCounter("sub_found", 1);
+
+    // Worker threads match their own copies, so the result object is loaded here
+    _loadCurrentObject();
+    _setCurrentMapping(_parallel_mappings.ptr() + _parallel_mapping_offsets[_current_hit_id]);
+    sub_cnt++;
+    return true;
+}
+
 void BaseSubstructureMatcher::setQueryData(SubstructureQueryData* query_data)
 {
     _query_data.reset(query_data);
@@ -431,21 +677,25 @@ void BaseSubstructureMatcher::setQueryData(SubstructureQueryData* query_data)
               [&](int i1, int i2) { return fp_bit_usage[i1] < fp_bit_usage[i2]; });
 }
 
-void BaseSubstructureMatcher::_findPackCandidates(int pack_idx)
+void BaseSubstructureMatcher::_findPackCandidates(int pack_idx, Array<int>& candidates)
 {
     if (pack_idx == _fp_storage.getPackCount())
     {
-        _findIncCandidates();
+        _findIncCandidates(candidates);
         return;
     }
 
-    profTimerStart(t, "sub_find_cand_pack");
+    TranspFpStorage& fp_storage = _index.getSubStorage();
 
-    _candidates.clear();
+    if (fp_storage.isCompressed())
+    {
+        _findPackCandidatesCompressed(pack_idx, candidates);
+        return;
+    }
 
-    TranspFpStorage& fp_storage = _index.getSubStorage();
+    profTimerStart(t, "sub_find_cand_pack");
 
-    // const byte *query_fp = _query_fp.ptr();
+    candidates.clear();
 
     const byte* block;
 
@@ -455,18 +705,23 @@ void BaseSubstructureMatcher::_findPackCandidates(int pack_idx)
     fit_bits.clear_resize(fp_storage.getBlockSize());
     fit_bits.fill(255);
 
+    Array<int> bits;
+    _getPackScreeningBits(pack_idx, bits);
+
     profTimerStart(tgs, "sub_find_cand_pack_get_search");
     int left = 0, right = fp_storage.getBlockSize() - 1;
+    int fit_count = fp_storage.getBlockSize() * 8;
+    float columns_time = 0;
 
-    // Filter only based on the first 10 bits
-    // TODO: collect time infromation about the reading and matching measurements and
-    // and balance between reading new block or check filtered items without reading new block
-    for (int i = 0; i < _query_fp_bits_used.size() && i < 15; i++)
+    for (int i = 0; i < bits.size(); i++)
     {
-        int j = _query_fp_bits_used[i];
+        if (i > 0 && !_isNextColumnWorthy(pack_idx, bits[i], i, fit_count, columns_time / i))
+            break;
+
+        qword column_start = nanoClock();
 
         profTimerStart(tgb, "sub_find_cand_pack_get_block");
-        block = fp_storage.getBlock(pack_idx * fp_size_in_bits + j);
+        block = fp_storage.getBlock(pack_idx * fp_size_in_bits + bits[i]);
         profTimerStop(tgb);
 
         profTimerStart(tgu, "sub_find_cand_pack_fit_update");
@@ -477,33 +732,186 @@ void BaseSubstructureMatcher::_findPackCandidates(int pack_idx)
         while (left <= right && fit_bits[right] == 0)
             right--;
 
+        fit_count = (left <= right ? bitGetOnesCount(fit_bits.ptr() + left, right - left + 1) : 0);
+        profTimerStop(tgu);
+
+        columns_time += nanoHowManySeconds(nanoClock() - column_start);
+        profIncCounter("sub_screen_columns", 1);
+
         if (left > right)
+        {
             // Not more results
+            profIncCounter("sub_screen_stop_empty", 1);
             break;
-
-        profTimerStop(tgu);
+        }
     }
     profTimerStop(tgs);
 
-    for (int k = 0; k < 8 * fp_storage.getBlockSize(); k++)
+    int pack_offset = pack_idx * fp_storage.getBlockSize() * 8;
+    int pack_end = std::min(8 * fp_storage.getBlockSize(), _snapshot_count - pack_offset);
+    for (int k = 0; k < pack_end; k++)
         if (bitGetBit(fit_bits.ptr(), k))
-            _candidates.push(k + pack_idx * fp_storage.getBlockSize() * 8);
+            candidates.push(k + pack_offset);
+}
+
+void BaseSubstructureMatcher::_findPackCandidatesCompressed(int pack_idx, Array<int>& candidates)
+{
+    profTimerStart(t, "sub_find_cand_pack_compressed");
+
+    candidates.clear();
+
+    TranspFpStorage& fp_storage = _index.getSubStorage();
+
+    int fp_size_in_bits = _fp_size * 8;
+    int pack_offset = pack_idx * fp_storage.getBlockSize() * 8;
+    int pack_end = std::min(8 * fp_storage.getBlockSize(), _snapshot_count - pack_offset);
+
+    // Candidates are kept as a bitmap until the first sparse block, and as sorted positions after it
+    Array<byte> fit_bits;
+    fit_bits.clear_resize(fp_storage.getBlockSize());
+    fit_bits.fill(255);
+    bool fit_bitmap = true;
+
+    Array<int> fit_positions, next_positions;
+
+    Array<int> bits;
+    _getPackScreeningBits(pack_idx, bits);
+
+    int fit_count = fp_storage.getBlockSize() * 8;
+    float columns_time = 0;
+
+    for (int i = 0; i < bits.size(); i++)
+    {
+        if (i > 0 && !_isNextColumnWorthy(pack_idx, bits[i], i, fit_count, columns_time / i))
+            break;
+
+        qword column_start = nanoClock();
+
+        const byte* bitmap;
+        const uint16_t* positions;
+        int ones_count = fp_storage.getCompressedBlock(pack_idx * fp_size_in_bits + bits[i], bitmap, positions);
+
+        if (fit_bitmap && bitmap != nullptr)
+        {
+            bitAnd(fit_bits.ptr(), bitmap, fit_bits.size());
+        }
+        else if (fit_bitmap)
+        {
+            fit_positions.clear();
+            for (int k = 0; k < ones_count; k++)
+                if (bitGetBit(fit_bits.ptr(), positions[k]))
+                    fit_positions.push(positions[k]);
+            fit_bitmap = false;
+        }
+        else if (bitmap != nullptr)
+        {
+            int count = 0;
+            for (int k = 0; k < fit_positions.size(); k++)
+                if (bitGetBit(bitmap, fit_positions[k]))
+                    fit_positions[count++] = fit_positions[k];
+            fit_positions.resize(count);
+        }
+        else
+        {
+            next_positions.clear();
+            int k = 0, l = 0;
+            while (k < fit_positions.size() && l < ones_count)
+            {
+                if (fit_positions[k] < positions[l])
+                    k++;
+                else if (fit_positions[k] > positions[l])
+                    l++;
+                else
+                {
+                    next_positions.push(fit_positions[k]);
+                    k++;
+                    l++;
+                }
+            }
+            fit_positions.swap(next_positions);
+        }
+
+        fit_count = (fit_bitmap ? bitGetOnesCount(fit_bits.ptr(), fit_bits.size()) : fit_positions.size());
+
+        columns_time += nanoHowManySeconds(nanoClock() - column_start);
+        profIncCounter("sub_screen_columns", 1);
+
+        if (fit_count == 0)
+        {
+            // Not more results
+            profIncCounter("sub_screen_stop_empty", 1);
+            break;
+        }
+    }
+
+    if (fit_bitmap)
+    {
+        for (int k = 0; k < pack_end; k++)
+            if (bitGetBit(fit_bits.ptr(), k))
+                candidates.push(k + pack_offset);
+    }
+    else
+    {
+        for (int k = 0; k < fit_positions.size() && fit_positions[k] < pack_end; k++)
+            candidates.push(fit_positions[k] + pack_offset);
+    }
+}
+
+void BaseSubstructureMatcher::_getPackScreeningBits(int pack_idx, Array<int>& bits)
+{
+    profIncCounter("sub_screen_packs", 1);
+
+    // The rarest bits of the pack filter out the most records
+    TranspFpStorage& fp_storage = _index.getSubStorage();
+    bits.copy(_query_fp_bits_used);
+    std::sort(bits.ptr(), bits.ptr() + bits.size(),
+              [&](int i1, int i2) { return fp_storage.getPackBitUsageCount(pack_idx, i1) < fp_storage.getPackBitUsageCount(pack_idx, i2); });
+}
+
+bool BaseSubstructureMatcher::_isNextColumnWorthy(int pack_idx, int next_bit, int columns_count, int candidates_count, float column_time) const
+{
+    if (_screening_time_count < _min_match_time_samples)
+    {
+        if (columns_count < _default_screening_columns)
+            return true;
+
+        profIncCounter("sub_screen_stop_limit", 1);
+        return false;
+    }
+
+    // Expect the column to keep the same share of the candidates as of the whole pack
+    TranspFpStorage& fp_storage = _index.getSubStorage();
+    float next_bit_ratio = (float)fp_storage.getPackBitUsageCount(pack_idx, next_bit) / (fp_storage.getBlockSize() * 8);
+    float saved_time = candidates_count * (1 - next_bit_ratio) * _screening_time_mean;
+
+    if (saved_time > column_time)
+        return true;
+
+    profIncCounter("sub_screen_stop_cost", 1);
+    return false;
+}
+
+void BaseSubstructureMatcher::_updateScreeningEstimate()
+{
+    _screening_time_count = _match_time_esimate.getCount();
+    _screening_time_mean = _match_time_esimate.mean();
 }
 
-void BaseSubstructureMatcher::_findIncCandidates()
+void BaseSubstructureMatcher::_findIncCandidates(Array<int>& candidates)
 {
     profTimerStart(t, "sub_find_cand_inc");
-    _candidates.clear();
+    candidates.clear();
 
     const TranspFpStorage& fp_storage = _index.getSubStorage();
 
     int inc_block_id_offset = fp_storage.getPackCount() * fp_storage.getBlockSize() * 8;
     const byte* inc = fp_storage.getIncrement();
-    for (int i = 0; i < fp_storage.getIncrementSize(); i++)
+    int inc_count = std::min(fp_storage.getIncrementSize(), _snapshot_count - inc_block_id_offset);
+    for (int i = 0; i < inc_count; i++)
     {
         const byte* fp = inc + i * _fp_size;
         if (bitTestOnes(_query_fp.ptr(), fp, _fp_size))
-            _candidates.push(i + inc_block_id_offset);
+            candidates.push(i + inc_block_id_offset);
     }
 }
 
@@ -535,15 +943,101 @@ void BaseSubstructureMatcher::_initPartition()
     }
 }
 
+namespace
+{
+    class MoleculeSubCandidateChecker : public SubstructureCandidateChecker
+    {
+    public:
+        MoleculeSubCandidateChecker(QueryMolecule& query_mol, BaseIndex& index) : _index(index), _cache(index.getMoleculeCache())
+        {
+            _query_mol.clone(query_mol);
+        }
+
+        bool check(int id, Scanner& cf_scanner, Array<int>& mapping) override
+        {
+            std::unique_ptr<Molecule> target_mol;
+            if (_cache != nullptr)
+                target_mol = _cache->take(id);
+
+            if (!target_mol)
+            {
+                target_mol = std::make_unique<Molecule>();
+                CmfLoader cmf_loader(cf_scanner);
+                cmf_loader.loadMolecule(*target_mol);
+            }
+
+            MoleculeSubstructureMatcher msm(*target_mol);
+            if (_index.getObjectFeatures(id, _features))
+                msm.setTargetFeatures(&_features);
+            msm.setQuery(_query_mol);
+            bool found = msm.find();
+
+            if (found)
+            {
+                mapping.clear();
+                mapping.push(target_mol->vertexCount());
+                mapping.concat(msm.getTargetMapping(), target_mol->vertexCount());
+            }
+
+            if (_cache != nullptr)
+                _cache->put(id, std::move(target_mol));
+            return found;
+        }
+
+    private:
+        QueryMolecule _query_mol;
+        BaseIndex& _index;
+        MoleculeCache* _cache;
+        MoleculeMatchFeatures _features;
+    };
+
+    class ReactionSubCandidateChecker : public SubstructureCandidateChecker
+    {
+    public:
+        ReactionSubCandidateChecker(QueryReaction& query_rxn)
+        {
+            _query_rxn.clone(query_rxn);
+        }
+
+        bool check(int id, Scanner& cf_scanner, Array<int>& mapping) override
+        {
+            CrfLoader crf_loader(cf_scanner);
+            crf_loader.loadReaction(_target_rxn);
+
+            ReactionSubstructureMatcher rsm(_target_rxn);
+            rsm.setQuery(_query_rxn);
+            if (!rsm.find())
+                return false;
+
+            mapping.clear();
+            mapping.push(_target_rxn.end());
+            mapping.push(_query_rxn.count());
+            for (int i = _query_rxn.begin(); i != _query_rxn.end(); i = _query_rxn.next(i))
+            {
+                int count = _query_rxn.getQueryMolecule(i).vertexCount();
+
+                mapping.push(rsm.getTargetMoleculeIndex(i));
+                mapping.push(count);
+                mapping.concat(rsm.getQueryMoleculeMapping(i), count);
+            }
+            return true;
+        }
+
+    private:
+        QueryReaction _query_rxn;
+        Reaction _target_rxn;
+    };
+}
+
 MoleculeSubMatcher::MoleculeSubMatcher(/*const */ BaseIndex& index)
     : BaseSubstructureMatcher(index, (IndigoObject*&)_current_mol), _current_mol(new IndexCurrentMolecule(_current_mol))
 {
     _mapping.clear();
 }
 
-const Array<int>& MoleculeSubMatcher::currentMapping()
+const Array<int>* MoleculeSubMatcher::currentMoleculeMapping()
 {
-    return _mapping;
+    return &_mapping;
 }
 
 bool MoleculeSubMatcher::_tryCurrent() // const
@@ -551,6 +1045,10 @@ bool MoleculeSubMatcher::_tryCurrent() // const
     SubstructureMoleculeQuery& query = (SubstructureMoleculeQuery&)(_query_data->getQueryObject());
     QueryMolecule& query_mol = (QueryMolecule&)(query.getMolecule());
 
+    MoleculeCache* cache = _index.getMoleculeCache();
+    if (cache != nullptr)
+        return _tryCurrentCached(*cache, query_mol);
+
     if (!_loadCurrentObject())
         return false;
 
@@ -562,6 +1060,8 @@ bool MoleculeSubMatcher::_tryCurrent() // const
     profTimerStart(tr_m, "sub_try_matching");
     MoleculeSubstructureMatcher msm(target_mol);
 
+    if (_index.getObjectFeatures(_current_id, _features))
+        msm.setTargetFeatures(&_features);
     msm.setQuery(query_mol);
 
     bool find_res = msm.find();
@@ -578,6 +1078,66 @@ bool MoleculeSubMatcher::_tryCurrent() // const
     return false;
 }
 
+bool MoleculeSubMatcher::_tryCurrentCached(MoleculeCache& cache, QueryMolecule& query_mol)
+{
+    if (!_isCurrentObjectExist())
+        return false;
+
+    if (_current_obj == 0)
+        throw Exception("MoleculeSubMatcher: Matcher's current object was destroyed");
+
+    std::unique_ptr<Molecule> target_mol = cache.take(_current_id);
+    if (!target_mol)
+    {
+        profTimerStart(t_load, "loadCurObj_load_cf");
+        int cf_len;
+        const char* cf_str = (const char*)_index.getCfStorage().get(_current_id, cf_len);
+        BufferScanner buf_scn(cf_str, cf_len);
+        target_mol = std::make_unique<Molecule>();
+        try
+        {
+            CmfLoader cmf_loader(buf_scn);
+            cmf_loader.loadMolecule(*target_mol);
+        }
+        catch (Exception& ex)
+        {
+            const int db_id = _index.getIdMapping()[_current_id];
+            ex.appendMessage(" on id=%d", db_id);
+            throw;
+        }
+    }
+
+    profTimerStart(tr_m, "sub_try_matching");
+    MoleculeSubstructureMatcher msm(*target_mol);
+    if (_index.getObjectFeatures(_current_id, _features))
+        msm.setTargetFeatures(&_features);
+    msm.setQuery(query_mol);
+    bool find_res = msm.find();
+    profTimerStop(tr_m);
+
+    // Only the hits are copied to the current object returned to the user
+    if (find_res)
+    {
+        _current_obj->getMolecule().clone(*target_mol, 0, 0);
+        _mapping.copy(msm.getTargetMapping(), target_mol->vertexCount());
+    }
+
+    cache.put(_current_id, std::move(target_mol));
+    return find_res;
+}
+
+std::unique_ptr<SubstructureCandidateChecker> MoleculeSubMatcher::_createCandidateChecker()
+{
+    SubstructureMoleculeQuery& query = (SubstructureMoleculeQuery&)(_query_data->getQueryObject());
+    return std::make_unique<MoleculeSubCandidateChecker>((QueryMolecule&)(query.getMolecule()), _index);
+}
+
+void MoleculeSubMatcher::_setCurrentMapping(const int* mapping)
+{
+    // Target atoms count followed by the mapping
+    _mapping.copy(mapping + 1, mapping[0]);
+}
+
 ReactionSubMatcher::ReactionSubMatcher(/*const */ BaseIndex& index)
     : BaseSubstructureMatcher(index, (IndigoObject*&)_current_rxn), _current_rxn(new IndexCurrentReaction(_current_rxn))
 {
@@ -602,27 +1162,110 @@ bool ReactionSubMatcher::_tryCurrent() // const
 
     Reaction& target_rxn = _current_obj->getReaction();
 
-    ReactionSubstructureMatcher rsm(target_rxn);
+    ReactionSubstructureMatcher rsm(target_rxn);
+
+    rsm.setQuery(query_rxn);
+
+    if (rsm.find())
+    {
+        _mapping.resize(target_rxn.end());
+        for (int i = target_rxn.begin(); i != target_rxn.end(); i = target_rxn.next(i))
+            _mapping[i].clear();
+
+        for (int i = query_rxn.begin(); i != query_rxn.end(); i = query_rxn.next(i))
+        {
+            int target_mol_idx = rsm.getTargetMoleculeIndex(i);
+
+            _mapping[target_mol_idx].copy(rsm.getQueryMoleculeMapping(i), query_rxn.getQueryMolecule(i).vertexCount());
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
+std::unique_ptr<SubstructureCandidateChecker> ReactionSubMatcher::_createCandidateChecker()
+{
+    SubstructureReactionQuery& query = (SubstructureReactionQuery&)_query_data->getQueryObject();
+    return std::make_unique<ReactionSubCandidateChecker>((QueryReaction&)(query.getReaction()));
+}
+
+void ReactionSubMatcher::_setCurrentMapping(const int* mapping)
+{
+    // Target molecules end and query molecules count, followed by the target
+    // molecule index and the atom mapping of every query molecule
+    int end = *mapping++;
+    int count = *mapping++;
+
+    _mapping.resize(end);
+    for (int i = 0; i < end; i++)
+        _mapping[i].clear();
+
+    for (int i = 0; i < count; i++)
+    {
+        int target_mol_idx = *mapping++;
+        int size = *mapping++;
+
+        _mapping[target_mol_idx].copy(mapping, size);
+        mapping += size;
+    }
+}
+
+static std::unique_ptr<SimCoef> _createSimCoef(const char* parameters, int fp_size)
+{
+    std::stringstream param_str;
+    param_str << parameters;
+
+    std::string type;
+
+    param_str >> type;
+
+    if (param_str.fail())
+        throw Exception("BaseSimilarityMatcher: setParameters: incorrect similarity parameters");
+
+    if (type.compare("tanimoto") == 0)
+    {
+        if (!param_str.eof())
+            throw Exception("BaseSimilarityMatcher: setParameters: tanimoto metric has no parameters");
+
+        return std::make_unique<TanimotoCoef>(fp_size);
+    }
+    else if (type.compare("euclid-sub") == 0)
+    {
+        if (!param_str.eof())
+            throw Exception("BaseSimilarityMatcher: setParameters: euclid-sub metric has no parameters");
+
+        return std::make_unique<EuclidCoef>(fp_size);
+    }
+    else if (type.compare("tversky") == 0)
+    {
+        double alpha, beta;
+
+        if (!param_str.eof())
+        {
+            param_str >> alpha;
 
-    rsm.setQuery(query_rxn);
+            if (param_str.fail())
+                throw Exception("BaseSimilarityMatcher: setParameters: incorrect similarity parameters. Allowed 'tversky <alpha> <beta>'");
 
-    if (rsm.find())
-    {
-        _mapping.resize(target_rxn.end());
-        for (int i = target_rxn.begin(); i != target_rxn.end(); i = target_rxn.next(i))
-            _mapping[i].clear();
+            param_str >> beta;
 
-        for (int i = query_rxn.begin(); i != query_rxn.end(); i = query_rxn.next(i))
+            if (param_str.fail())
+                throw Exception("BaseSimilarityMatcher: setParameters: incorrect similarity parameters. Allowed 'tversky <alpha> <beta>'");
+        }
+        else
         {
-            int target_mol_idx = rsm.getTargetMoleculeIndex(i);
-
-            _mapping[target_mol_idx].copy(rsm.getQueryMoleculeMapping(i), query_rxn.getQueryMolecule(i).vertexCount());
+            alpha = beta = 0.5;
         }
 
-        return true;
-    }
+        if (fabs(alpha + beta - 1) > EPSILON)
+            throw Exception("BaseSimilarityMatcher: setParameters: Tversky parameters have to satisfy the condition: alpha + beta = 1 ");
 
-    return false;
+        return std::make_unique<TverskyCoef>(fp_size, alpha, beta);
+    }
+    else
+        throw Exception("BaseSimilarityMatcher: setParameters: incorrect similarity parameters. Allowed types: tanimoto, euclid-sub, tversky [<alpha> <beta>]");
 }
 
 BaseSimilarityMatcher::BaseSimilarityMatcher(/*const */ BaseIndex& index, IndigoObject*& current_obj) : BaseMatcher(index, current_obj)
@@ -639,6 +1282,7 @@ BaseSimilarityMatcher::BaseSimilarityMatcher(/*const */ BaseIndex& index, Indigo
     _current_sim_value = -1;
     _fp_size = _index.getFingerprintParams().fingerprintSizeSim();
     _sim_coef = std::make_unique<TanimotoCoef>(_fp_size);
+    _layout_version = _index.getSimLayoutVersion();
 }
 
 bool BaseSimilarityMatcher::next()
@@ -657,6 +1301,17 @@ bool BaseSimilarityMatcher::next()
 
         if (_current_portion_id >= _current_portion.size())
         {
+            if (_layout_version != _index.getSimLayoutVersion())
+            {
+                Array<byte> returned_ids;
+                returned_ids.swap(_returned_ids);
+                resetThresholdLimit(_query_data->getMin());
+                _returned_ids.swap(returned_ids);
+
+                if (_current_cell == -1)
+                    return false;
+            }
+
             _current_portion_id = 0;
             _current_container++;
 
@@ -699,7 +1354,7 @@ bool BaseSimilarityMatcher::next()
 
         _current_portion_id++;
 
-        bool is_obj_exist = _isCurrentObjectExist();
+        bool is_obj_exist = _isCurrentObjectExist() && _markReturned(_current_id);
 
         if (!is_obj_exist)
         {
@@ -713,6 +1368,16 @@ bool BaseSimilarityMatcher::next()
     }
 }
 
+bool BaseSimilarityMatcher::_markReturned(int id)
+{
+    if (_returned_ids.size() <= id / 8)
+        _returned_ids.expandFill(id / 8 + 1, 0);
+    if (bitGetBit(_returned_ids.ptr(), id))
+        return false;
+    bitSetBit(_returned_ids.ptr(), id, 1);
+    return true;
+}
+
 void BaseSimilarityMatcher::setQueryData(SimilarityQueryData* query_data)
 {
     _query_data.reset(query_data);
@@ -793,6 +1458,8 @@ void BaseSimilarityMatcher::resetThresholdLimit(float min)
     _current_portion_id = 0;
     _current_portion.clear();
     _current_sim_value = -1;
+    _layout_version = _index.getSimLayoutVersion();
+    _returned_ids.clear();
 
     if (sim_storage.isSmallBase())
         return;
@@ -817,58 +1484,7 @@ void BaseSimilarityMatcher::_setParameters(const char* parameters)
     if (_query_data.get() != 0)
         throw Exception("BaseSimilarityMatcher: setParameters: query data have been already set");
 
-    std::stringstream param_str;
-    param_str << parameters;
-
-    std::string type;
-
-    param_str >> type;
-
-    if (param_str.fail())
-        throw Exception("BaseSimilarityMatcher: setParameters: incorrect similarity parameters");
-
-    if (type.compare("tanimoto") == 0)
-    {
-        if (!param_str.eof())
-            throw Exception("BaseSimilarityMatcher: setParameters: tanimoto metric has no parameters");
-
-        _sim_coef = std::make_unique<TanimotoCoef>(_fp_size);
-    }
-    else if (type.compare("euclid-sub") == 0)
-    {
-        if (!param_str.eof())
-            throw Exception("BaseSimilarityMatcher: setParameters: euclid-sub metric has no parameters");
-
-        _sim_coef = std::make_unique<EuclidCoef>(_fp_size);
-    }
-    else if (type.compare("tversky") == 0)
-    {
-        double alpha, beta;
-
-        if (!param_str.eof())
-        {
-            param_str >> alpha;
-
-            if (param_str.fail())
-                throw Exception("BaseSimilarityMatcher: setParameters: incorrect similarity parameters. Allowed 'tversky <alpha> <beta>'");
-
-            param_str >> beta;
-
-            if (param_str.fail())
-                throw Exception("BaseSimilarityMatcher: setParameters: incorrect similarity parameters. Allowed 'tversky <alpha> <beta>'");
-        }
-        else
-        {
-            alpha = beta = 0.5;
-        }
-
-        if (fabs(alpha + beta - 1) > EPSILON)
-            throw Exception("BaseSimilarityMatcher: setParameters: Tversky parameters have to satisfy the condition: alpha + beta = 1 ");
-
-        _sim_coef = std::make_unique<TverskyCoef>(_fp_size, alpha, beta);
-    }
-    else
-        throw Exception("BaseSimilarityMatcher: setParameters: incorrect similarity parameters. Allowed types: tanimoto, euclid-sub, tversky [<alpha> <beta>]");
+    _sim_coef = _createSimCoef(parameters, _fp_size);
 }
 
 void BaseSimilarityMatcher::_initPartition()
@@ -942,6 +1558,126 @@ ReactionSimMatcher::ReactionSimMatcher(/*const */ BaseIndex& index)
 {
 }
 
+BaseSimilarityBatchMatcher::BaseSimilarityBatchMatcher(/*const */ BaseIndex& index, IndigoObject*& current_obj) : BaseMatcher(index, current_obj)
+{
+    _current_id = -1;
+    _fp_size = _index.getFingerprintParams().fingerprintSizeSim();
+    _sim_coef = std::make_unique<TanimotoCoef>(_fp_size);
+    _min = 0;
+    _query_count = 0;
+    _searched = false;
+    _current_query = 0;
+    _current_result_id = 0;
+    _current_sim_value = -1;
+}
+
+void BaseSimilarityBatchMatcher::setThreshold(float min)
+{
+    _min = min;
+}
+
+void BaseSimilarityBatchMatcher::addQuery(MatcherQueryData& query_data)
+{
+    if (_searched)
+        throw Exception("BaseSimilarityBatchMatcher: addQuery: search has been already started");
+
+    Array<byte> fp;
+    query_data.getQueryObject().buildFingerprint(_index.getFingerprintParams(), 0, &fp);
+    _query_fps.concat(fp);
+    _query_count++;
+}
+
+void BaseSimilarityBatchMatcher::addQueryFingerprint(IndigoObject& fp)
+{
+    if (_searched)
+        throw Exception("BaseSimilarityBatchMatcher: addQueryFingerprint: search has been already started");
+
+    IndigoFingerprint& ext_fp = IndigoFingerprint::cast(fp);
+    if (ext_fp.bytes.size() != _fp_size)
+        throw Exception("BaseSimilarityBatchMatcher: external fingerprint is incompatible with current database");
+
+    _query_fps.concat(ext_fp.bytes);
+    _query_count++;
+}
+
+void BaseSimilarityBatchMatcher::_search()
+{
+    profTimerStart(tsimbatch, "sim_batch_search");
+
+    _queries.init(_query_fps.ptr(), _query_count, _fp_size);
+    if (_query_count > 0)
+        _index.getSimStorage().findSimilarBatch(_queries, *_sim_coef, _min);
+
+    _searched = true;
+}
+
+bool BaseSimilarityBatchMatcher::next()
+{
+    if (!_searched)
+        _search();
+
+    while (_current_query < _query_count)
+    {
+        const Array<SimResult>& results = _queries.results[_current_query];
+
+        if (_current_result_id >= results.size())
+        {
+            _current_query++;
+            _current_result_id = 0;
+            continue;
+        }
+
+        _current_id = results[_current_result_id].id;
+        _current_sim_value = results[_current_result_id].sim_value;
+        _current_result_id++;
+
+        if (!_isCurrentObjectExist())
+            continue;
+
+        _loadCurrentObject();
+        return true;
+    }
+
+    return false;
+}
+
+int BaseSimilarityBatchMatcher::currentQueryIndex() const
+{
+    return _current_query;
+}
+
+float BaseSimilarityBatchMatcher::currentSimValue() const
+{
+    return _current_sim_value;
+}
+
+void BaseSimilarityBatchMatcher::_setParameters(const char* parameters)
+{
+    if (_query_count > 0)
+        throw Exception("BaseSimilarityBatchMatcher: setParameters: queries have been already added");
+
+    _sim_coef = _createSimCoef(parameters, _fp_size);
+}
+
+void BaseSimilarityBatchMatcher::_initPartition()
+{
+    throw Exception("BaseSimilarityBatchMatcher: partitioning is not supported for batch search");
+}
+
+BaseSimilarityBatchMatcher::~BaseSimilarityBatchMatcher()
+{
+}
+
+MoleculeSimBatchMatcher::MoleculeSimBatchMatcher(/*const */ BaseIndex& index)
+    : BaseSimilarityBatchMatcher(index, (IndigoObject*&)_current_mol), _current_mol(new IndexCurrentMolecule(_current_mol))
+{
+}
+
+ReactionSimBatchMatcher::ReactionSimBatchMatcher(/*const */ BaseIndex& index)
+    : BaseSimilarityBatchMatcher(index, (IndigoObject*&)_current_rxn), _current_rxn(new IndexCurrentReaction(_current_rxn))
+{
+}
+
 TopNSimMatcher::TopNSimMatcher(BaseIndex& index, IndigoObject*& current_obj) : BaseSimilarityMatcher(index, current_obj)
 {
     _idx = -1;
@@ -1400,6 +2136,13 @@ bool MolExactMatcher::_tryCurrent() /* const */
         mem.flags = _flags;
         mem.rms_threshold = _rms_threshold;
 
+        if (_index.getObjectFeatures(_current_id, _target_features))
+        {
+            if (!_query_features.fits(query_mol))
+                _query_features.build(query_mol);
+            mem.setFeatures(&_query_features, &_target_features);
+        }
+
         return mem.find();
     }
 }
@@ -1623,3 +2366,179 @@ void EnumeratorMatcher::_setParameters(const char* params)
 void EnumeratorMatcher::_initPartition()
 {
 }
+
+MolCachedMatcher::MolCachedMatcher(BaseIndex& index, const Array<int>& ids, const Array<float>& sim_values, std::unique_ptr<SubstructureQueryData> query_data)
+    : BaseMatcher(index, (IndigoObject*&)_current_mol), _current_mol(new IndexCurrentMolecule(_current_mol)), _query_data(std::move(query_data))
+{
+    _ids.copy(ids);
+    _sim_values.copy(sim_values);
+    _current_idx = -1;
+    _mapping_idx = -1;
+}
+
+bool MolCachedMatcher::next()
+{
+    MMFMapping& back_id_mapping = _index.getBackIdMapping();
+
+    while (++_current_idx < _ids.size())
+    {
+        size_t base_id = back_id_mapping.get(_ids[_current_idx]);
+        if (base_id == (size_t)-1)
+            continue;
+
+        _current_id = (int)base_id;
+        if (_loadCurrentObject())
+            return true;
+    }
+
+    return false;
+}
+
+float MolCachedMatcher::currentSimValue() const
+{
+    return _sim_values[_current_idx];
+}
+
+const Array<int>* MolCachedMatcher::currentMoleculeMapping()
+{
+    if (_query_data == nullptr)
+        return nullptr;
+
+    if (_mapping_idx != _current_idx)
+    {
+        if (_current_obj == 0)
+            throw Exception("MolCachedMatcher: Matcher's current object was destroyed");
+
+        SubstructureMoleculeQuery& query = (SubstructureMoleculeQuery&)(_query_data->getQueryObject());
+        Molecule& target_mol = _current_obj->getMolecule();
+
+        MoleculeSubstructureMatcher msm(target_mol);
+        msm.setQuery((QueryMolecule&)(query.getMolecule()));
+        if (!msm.find())
+            throw Exception("MolCachedMatcher: cached hit does not match the query");
+
+        _mapping.copy(msm.getTargetMapping(), target_mol.vertexCount());
+        _mapping_idx = _current_idx;
+    }
+    return &_mapping;
+}
+
+void MolCachedMatcher::_setParameters(const char* params)
+{
+}
+
+void MolCachedMatcher::_initPartition()
+{
+}
+
+ResultCachingMatcher::ResultCachingMatcher(BaseIndex& index, const Array<char>& key, bool similarity, std::unique_ptr<Matcher> matcher)
+    : _index(index), _generation(index.getGeneration()), _similarity(similarity), _recording(true), _matcher(std::move(matcher))
+{
+    _key.copy(key);
+}
+
+bool ResultCachingMatcher::next()
+{
+    if (_matcher->next())
+    {
+        if (_recording && _ids.size() >= _max_cached_results)
+        {
+            _recording = false;
+            _ids.clear();
+            _sim_values.clear();
+        }
+
+        if (_recording)
+        {
+            _ids.push(_matcher->currentId());
+            _sim_values.push(_similarity ? _matcher->currentSimValue() : 0);
+        }
+        return true;
+    }
+
+    // Searches stopped before the end are not cached
+    if (_recording)
+    {
+        _index.storeCachedResult(_key, _generation, _ids, _sim_values);
+        _recording = false;
+    }
+    return false;
+}
+
+int ResultCachingMatcher::currentId() const
+{
+    return _matcher->currentId();
+}
+
+IndigoObject* ResultCachingMatcher::currentObject()
+{
+    return _matcher->currentObject();
+}
+
+const BaseIndex& ResultCachingMatcher::getIndex()
+{
+    return _matcher->getIndex();
+}
+
+float ResultCachingMatcher::currentSimValue() const
+{
+    return _matcher->currentSimValue();
+}
+
+int ResultCachingMatcher::currentQueryIndex() const
+{
+    return _matcher->currentQueryIndex();
+}
+
+const Array<int>* ResultCachingMatcher::currentMoleculeMapping()
+{
+    return _matcher->currentMoleculeMapping();
+}
+
+void ResultCachingMatcher::setOptions(const char* options)
+{
+    _recording = false;
+    _matcher->setOptions(options);
+}
+
+void ResultCachingMatcher::resetThresholdLimit(float min)
+{
+    // Results for the other threshold don't match the key
+    _recording = false;
+    _matcher->resetThresholdLimit(min);
+}
+
+int ResultCachingMatcher::esimateRemainingResultsCount(int& delta)
+{
+    return _matcher->esimateRemainingResultsCount(delta);
+}
+
+float ResultCachingMatcher::esimateRemainingTime(float& delta)
+{
+    return _matcher->esimateRemainingTime(delta);
+}
+
+int ResultCachingMatcher::containersCount() const
+{
+    return _matcher->containersCount();
+}
+
+int ResultCachingMatcher::cellsCount() const
+{
+    return _matcher->cellsCount();
+}
+
+int ResultCachingMatcher::currentCell() const
+{
+    return _matcher->currentCell();
+}
+
+int ResultCachingMatcher::minCell() const
+{
+    return _matcher->minCell();
+}
+
+int ResultCachingMatcher::maxCell() const
+{
+    return _matcher->maxCell();
+}
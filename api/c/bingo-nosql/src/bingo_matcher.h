@@ -9,6 +9,8 @@
 #include "indigo_molecule.h"
 #include "indigo_reaction.h"
 
+
+#include "base_cpp/os_thread_wrapper.h"
 #include "math/statistics.h"
 #include "molecule/molecule_exact_matcher.h"
 #include "molecule/molecule_substructure_matcher.h"
@@ -169,6 +171,9 @@ namespace bingo
         virtual IndigoObject* currentObject() = 0;
         virtual const BaseIndex& getIndex() = 0;
         virtual float currentSimValue() const = 0;
+        virtual int currentQueryIndex() const = 0;
+        // Query atoms of the current object atoms, or null if the search has no atom mapping
+        virtual const Array<int>* currentMoleculeMapping() = 0;
         virtual void setOptions(const char* options) = 0;
         virtual void resetThresholdLimit(float min) = 0;
 
@@ -196,6 +201,10 @@ namespace bingo
 
         float currentSimValue() const override;
 
+        int currentQueryIndex() const override;
+
+        const Array<int>* currentMoleculeMapping() override;
+
         void setOptions(const char* options) override;
         void resetThresholdLimit(float min) override;
 
@@ -214,6 +223,10 @@ namespace bingo
         int _current_id;
         int _part_id;
         int _part_count;
+        int _threads_count;
+
+        // Records committed after the matcher was created are not visible to it
+        int _snapshot_count;
 
         // Variables used for estimation
         MeanEstimator _match_probability_esimate, _match_time_esimate;
@@ -228,6 +241,22 @@ namespace bingo
         ~BaseMatcher() override;
     };
 
+    // Checks substructure candidates independently of the matcher state.
+    // Each parallel search command owns its own checker with a private
+    // copy of the query, so checkers can be used in different threads.
+    class SubstructureCandidateChecker
+    {
+    public:
+        // On success, the mapping of the embedding found is written to 'mapping'
+        // in the form read by BaseSubstructureMatcher::_setCurrentMapping()
+        virtual bool check(int id, Scanner& cf_scanner, Array<int>& mapping) = 0;
+
+        virtual ~SubstructureCandidateChecker(){};
+    };
+
+    class SubstructureSearchCommand;
+    class SubstructureSearchDispatcher;
+
     class BaseSubstructureMatcher : public BaseMatcher
     {
     public:
@@ -237,6 +266,8 @@ namespace bingo
 
         void setQueryData(SubstructureQueryData* query_data);
 
+        ~BaseSubstructureMatcher() override;
+
     protected:
         int _fp_size;
         int _cand_count;
@@ -244,23 +275,53 @@ namespace bingo
         Array<byte> _query_fp;
         Array<int> _query_fp_bits_used;
 
-        void _findPackCandidates(int pack_idx);
+        void _findPackCandidates(int pack_idx, Array<int>& candidates);
+
+        void _findPackCandidatesCompressed(int pack_idx, Array<int>& candidates);
+
+        void _getPackScreeningBits(int pack_idx, Array<int>& bits);
+
+        bool _isNextColumnWorthy(int pack_idx, int next_bit, int columns_count, int candidates_count, float column_time) const;
 
-        void _findIncCandidates();
+        void _updateScreeningEstimate();
+
+        void _findIncCandidates(Array<int>& candidates);
 
         virtual bool _tryCurrent() /* const */ = 0;
 
+        virtual std::unique_ptr<SubstructureCandidateChecker> _createCandidateChecker() = 0;
+
+        virtual void _setCurrentMapping(const int* mapping) = 0;
+
         void _setParameters(const char* params) override;
 
         void _initPartition() override;
 
     private:
+        friend class SubstructureSearchCommand;
+        friend class SubstructureSearchDispatcher;
+
         Array<int> _candidates;
         int _current_cand_id;
         int _current_pack;
         int _final_pack;
         const TranspFpStorage& _fp_storage;
         int sub_cnt;
+
+        // Match time estimate used by the screening; the worker threads read
+        // it while the results of the other threads are handled
+        int _screening_time_count;
+        float _screening_time_mean;
+
+        // Hits found by the worker threads for the current window of packs,
+        // and their mappings
+        Array<int> _parallel_hits;
+        Array<int> _parallel_mappings;
+        Array<int> _parallel_mapping_offsets;
+        int _current_hit_id;
+        std::unique_ptr<SubstructureSearchDispatcher> _dispatcher;
+
+        bool _nextParallel();
     };
 
     class MoleculeSubMatcher : public BaseSubstructureMatcher
@@ -268,14 +329,21 @@ namespace bingo
     public:
         MoleculeSubMatcher(/*const */ BaseIndex& index);
 
-        const Array<int>& currentMapping();
+        const Array<int>* currentMoleculeMapping() override;
 
     private:
         Array<int> _mapping;
 
         bool _tryCurrent() /*const*/ override;
 
+        bool _tryCurrentCached(MoleculeCache& cache, QueryMolecule& query_mol);
+
+        std::unique_ptr<SubstructureCandidateChecker> _createCandidateChecker() override;
+
+        void _setCurrentMapping(const int* mapping) override;
+
         IndexCurrentMolecule* _current_mol;
+        MoleculeMatchFeatures _features;
     };
 
     class ReactionSubMatcher : public BaseSubstructureMatcher
@@ -290,6 +358,10 @@ namespace bingo
 
         bool _tryCurrent() /*const*/ override;
 
+        std::unique_ptr<SubstructureCandidateChecker> _createCandidateChecker() override;
+
+        void _setCurrentMapping(const int* mapping) override;
+
         IndexCurrentReaction* _current_rxn;
     };
 
@@ -335,6 +407,14 @@ namespace bingo
         Array<SimResult> _current_portion;
         int _current_portion_id;
 
+        // Concurrent inserts may split cells; the scan is restarted then and
+        // the records that were already returned are skipped. One bit per id,
+        // grown on demand
+        int _layout_version;
+        Array<byte> _returned_ids;
+
+        bool _markReturned(int id);
+
         // float _current_sim_value;
 
         std::unique_ptr<SimCoef> _sim_coef;
@@ -366,6 +446,66 @@ namespace bingo
         IndexCurrentReaction* _current_rxn;
     };
 
+    // Evaluates several similarity queries during one scan of the index.
+    // Results are returned grouped by query, in the order queries were added.
+    class BaseSimilarityBatchMatcher : public BaseMatcher
+    {
+    public:
+        BaseSimilarityBatchMatcher(BaseIndex& index, IndigoObject*& current_obj);
+
+        bool next() override;
+
+        void setThreshold(float min);
+
+        void addQuery(MatcherQueryData& query_data);
+
+        void addQueryFingerprint(IndigoObject& fp);
+
+        int currentQueryIndex() const override;
+
+        float currentSimValue() const override;
+
+        ~BaseSimilarityBatchMatcher() override;
+
+    private:
+        int _fp_size;
+        float _min;
+        std::unique_ptr<SimCoef> _sim_coef;
+
+        Array<byte> _query_fps;
+        int _query_count;
+        bool _searched;
+        SimBatchQueries _queries;
+
+        int _current_query;
+        int _current_result_id;
+        float _current_sim_value;
+
+        void _search();
+
+        void _setParameters(const char* params) override;
+
+        void _initPartition() override;
+    };
+
+    class MoleculeSimBatchMatcher : public BaseSimilarityBatchMatcher
+    {
+    public:
+        MoleculeSimBatchMatcher(/*const */ BaseIndex& index);
+
+    private:
+        IndexCurrentMolecule* _current_mol;
+    };
+
+    class ReactionSimBatchMatcher : public BaseSimilarityBatchMatcher
+    {
+    public:
+        ReactionSimBatchMatcher(/*const */ BaseIndex& index);
+
+    private:
+        IndexCurrentReaction* _current_rxn;
+    };
+
     class TopNSimMatcher : public BaseSimilarityMatcher
     {
     public:
@@ -449,6 +589,9 @@ namespace bingo
 
         bool _tautomer;
         IndigoTautomerParams _tautomer_params;
+
+        MoleculeMatchFeatures _query_features;
+        MoleculeMatchFeatures _target_features;
     };
 
     class RxnExactMatcher : public BaseExactMatcher
@@ -524,6 +667,71 @@ namespace bingo
         IndigoObject* _indigoObject;
         int _id_numbers;
     };
+
+    // Returns the results of a search stored in the index result cache
+    class MolCachedMatcher : public BaseMatcher
+    {
+    public:
+        // The query is kept for the mappings of substructure hits and may be null
+        MolCachedMatcher(BaseIndex& index, const Array<int>& ids, const Array<float>& sim_values, std::unique_ptr<SubstructureQueryData> query_data);
+
+        bool next() override;
+
+        float currentSimValue() const override;
+
+        // The mapping is not cached, so it is found again for the current hit
+        const Array<int>* currentMoleculeMapping() override;
+
+    protected:
+        void _setParameters(const char* params) override;
+        void _initPartition() override;
+
+    private:
+        IndexCurrentMolecule* _current_mol;
+        Array<int> _ids;
+        Array<float> _sim_values;
+        int _current_idx;
+
+        std::unique_ptr<SubstructureQueryData> _query_data;
+        Array<int> _mapping;
+        int _mapping_idx;
+    };
+
+    // Forwards the search to the matcher and stores its results in the index
+    // result cache once the search is completed
+    class ResultCachingMatcher : public Matcher
+    {
+    public:
+        ResultCachingMatcher(BaseIndex& index, const Array<char>& key, bool similarity, std::unique_ptr<Matcher> matcher);
+
+        bool next() override;
+        int currentId() const override;
+        IndigoObject* currentObject() override;
+        const BaseIndex& getIndex() override;
+        float currentSimValue() const override;
+        int currentQueryIndex() const override;
+        const Array<int>* currentMoleculeMapping() override;
+        void setOptions(const char* options) override;
+        void resetThresholdLimit(float min) override;
+
+        int esimateRemainingResultsCount(int& delta) override;
+        float esimateRemainingTime(float& delta) override;
+        int containersCount() const override;
+        int cellsCount() const override;
+        int currentCell() const override;
+        int minCell() const override;
+        int maxCell() const override;
+
+    private:
+        BaseIndex& _index;
+        Array<char> _key;
+        int _generation;
+        bool _similarity;
+        bool _recording;
+        Array<int> _ids;
+        Array<float> _sim_values;
+        std::unique_ptr<Matcher> _matcher;
+    };
 }; // namespace bingo
 
 #endif // __bingo_matcher__
@@ -0,0 +1,97 @@
+#include "bingo_molecule_cache.h"
+
+#include "base_cpp/profiling.h"
+
+using namespace bingo;
+using namespace indigo;
+
+// Rough memory usage of an atom and a bond with their graph and layout data
+static const size_t _atom_size_estimate = 160;
+static const size_t _bond_size_estimate = 96;
+
+MoleculeCache::MoleculeCache(size_t memory_budget) : _memory_budget(memory_budget), _memory_used(0)
+{
+}
+
+std::unique_ptr<Molecule> MoleculeCache::take(int id)
+{
+    std::lock_guard<std::mutex> lock(_lock);
+
+    auto it = _positions.find(id);
+    if (it == _positions.end())
+    {
+        profIncCounter("mol_cache_misses", 1);
+        return nullptr;
+    }
+
+    profIncCounter("mol_cache_hits", 1);
+    std::unique_ptr<Molecule> mol = std::move(it->second->mol);
+    _memory_used -= it->second->size;
+    _entries.erase(it->second);
+    _positions.erase(it);
+    return mol;
+}
+
+void MoleculeCache::put(int id, std::unique_ptr<Molecule> mol)
+{
+    size_t size = _estimateSize(*mol);
+    if (size > _memory_budget)
+        return;
+
+    std::lock_guard<std::mutex> lock(_lock);
+
+    // Another thread may have put its own copy meanwhile
+    auto it = _positions.find(id);
+    if (it != _positions.end())
+    {
+        _memory_used -= it->second->size;
+        _entries.erase(it->second);
+        _positions.erase(it);
+    }
+
+    while (_memory_used + size > _memory_budget)
+    {
+        _memory_used -= _entries.back().size;
+        _positions.erase(_entries.back().id);
+        _entries.pop_back();
+    }
+
+    _entries.push_front(_Entry{id, size, std::move(mol)});
+    _positions[id] = _entries.begin();
+    _memory_used += size;
+}
+
+bool MoleculeCache::copy(int id, Molecule& mol)
+{
+    std::lock_guard<std::mutex> lock(_lock);
+
+    auto it = _positions.find(id);
+    if (it == _positions.end())
+    {
+        profIncCounter("mol_cache_misses", 1);
+        return false;
+    }
+
+    profIncCounter("mol_cache_hits", 1);
+    mol.clone(*it->second->mol, 0, 0);
+    _entries.splice(_entries.begin(), _entries, it->second);
+    return true;
+}
+
+void MoleculeCache::remove(int id)
+{
+    std::lock_guard<std::mutex> lock(_lock);
+
+    auto it = _positions.find(id);
+    if (it == _positions.end())
+        return;
+
+    _memory_used -= it->second->size;
+    _entries.erase(it->second);
+    _positions.erase(it);
+}
+
+size_t MoleculeCache::_estimateSize(const Molecule& mol)
+{
+    return sizeof(Molecule) + mol.vertexCount() * _atom_size_estimate + mol.edgeCount() * _bond_size_estimate;
+}
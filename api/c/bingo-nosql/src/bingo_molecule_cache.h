@@ -0,0 +1,51 @@
+#ifndef __bingo_molecule_cache__
+#define __bingo_molecule_cache__
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "molecule/molecule.h"
+
+namespace bingo
+{
+    // LRU cache of decoded molecules keyed by the internal record id.
+    // A molecule is taken out of the cache while it is used, so a thread never
+    // shares a cached molecule with another one. The memory budget is applied to
+    // an estimate of the molecule sizes.
+    class MoleculeCache
+    {
+    public:
+        explicit MoleculeCache(size_t memory_budget);
+
+        // Returns nullptr if the molecule is not cached
+        std::unique_ptr<indigo::Molecule> take(int id);
+
+        // Puts the molecule back, evicting the least recently used ones over the budget
+        void put(int id, std::unique_ptr<indigo::Molecule> mol);
+
+        // Copies the cached molecule without taking it; returns false if it is not cached
+        bool copy(int id, indigo::Molecule& mol);
+
+        void remove(int id);
+
+    private:
+        struct _Entry
+        {
+            int id;
+            size_t size;
+            std::unique_ptr<indigo::Molecule> mol;
+        };
+
+        std::mutex _lock;
+        std::list<_Entry> _entries;
+        std::unordered_map<int, std::list<_Entry>::iterator> _positions;
+        size_t _memory_budget;
+        size_t _memory_used;
+
+        static size_t _estimateSize(const indigo::Molecule& mol);
+    };
+} // namespace bingo
+
+#endif //__bingo_molecule_cache__
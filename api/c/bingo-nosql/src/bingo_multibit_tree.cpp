@@ -140,6 +140,54 @@ void MultibitTree::_build()
     is_mb.zerofill();
 
     _tree_ptr = _buildNode(indices, is_mb, 0);
+
+    _reorderByLeaves();
+}
+
+void MultibitTree::_reorderByLeaves()
+{
+    // Fingerprints are stored in the order of the leaves, so a leaf is scanned sequentially
+    QS_DEF(Array<int>, order);
+    order.clear();
+    _collectLeaves(_tree_ptr, order);
+
+    if (order.size() != _fp_count)
+        throw Exception("MultibitTree: leaves don't cover all the fingerprints");
+
+    QS_DEF(Array<byte>, fingerprints);
+    fingerprints.copy(_fingerprints_ptr.ptr(), _fp_count * _fp_size);
+    QS_DEF(Array<int>, indices);
+    indices.copy(_indices_ptr.ptr(), _fp_count);
+
+    byte* fp_buf = _fingerprints_ptr.ptr();
+    int* indices_buf = _indices_ptr.ptr();
+    for (int i = 0; i < order.size(); i++)
+    {
+        memcpy(fp_buf + i * _fp_size, fingerprints.ptr() + order[i] * _fp_size, _fp_size);
+        indices_buf[i] = indices[order[i]];
+    }
+}
+
+void MultibitTree::_collectLeaves(MMFPtr<_MultibitNode> node_ptr, Array<int>& order)
+{
+    if (node_ptr.isNull())
+        return;
+
+    _MultibitNode* node = node_ptr.ptr();
+
+    if (node->fp_indices_count != 0)
+    {
+        int* fp_indices = node->fp_indices_array.ptr();
+        for (int i = 0; i < node->fp_indices_count; i++)
+        {
+            order.push(fp_indices[i]);
+            fp_indices[i] = order.size() - 1;
+        }
+        return;
+    }
+
+    _collectLeaves(node->left, order);
+    _collectLeaves(node->right, order);
 }
 
 void MultibitTree::_findLinear(_MultibitNode* node, const byte* query, int query_bit_number, SimCoef& sim_coef, double min_coef, Array<SimResult>& sim_indices,
@@ -154,9 +202,8 @@ void MultibitTree::_findLinear(_MultibitNode* node, const byte* query, int query
     for (int i = 0; i < node->fp_indices_count; i++)
     {
         const byte* fp = fingerprints + fp_indices[i] * _fp_size;
-        int f_bit_number = bitGetOnesCount(fp, _fp_size);
 
-        double coef = sim_coef.calcCoef(query, fp, query_bit_number, f_bit_number);
+        double coef = sim_coef.calcCoef(query, fp, query_bit_number, fp_bit_number);
         if (coef < min_coef)
             continue;
 
@@ -243,3 +290,12 @@ int MultibitTree::findSimilar(const byte* query, SimCoef& sim_coef, double min_c
 
     return sim_fp_indices.size();
 }
+
+void MultibitTree::findSimilarBatch(SimBatchQueries& queries, SimCoef& sim_coef, double min_coef)
+{
+    profTimerStart(tms, "multibit_tree_search_batch");
+
+    // Tree pruning is specific to a single query, so the whole container is scanned once for all of them
+    int fp_bit_number = (_min_fp_bit_number == _max_fp_bit_number ? _min_fp_bit_number : -1);
+    queries.findSimilarLinear(_fingerprints_ptr.ptr(), _indices_ptr.ptr(), _fp_count, fp_bit_number, sim_coef, min_coef);
+}
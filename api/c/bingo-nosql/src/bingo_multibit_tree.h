@@ -22,6 +22,8 @@ namespace bingo
 
         int findSimilar(const byte* query, SimCoef& sim_coef, double min_coef, indigo::Array<SimResult>& sim_fp_indices);
 
+        void findSimilarBatch(SimBatchQueries& queries, SimCoef& sim_coef, double min_coef);
+
     private:
         struct _MatchBit
         {
@@ -79,6 +81,10 @@ namespace bingo
 
         void _build();
 
+        void _reorderByLeaves();
+
+        void _collectLeaves(MMFPtr<_MultibitNode> node_ptr, indigo::Array<int>& order);
+
         void _findLinear(_MultibitNode* node, const byte* query, int query_bit_number, SimCoef& sim_coef, double min_coef,
                          indigo::Array<SimResult>& sim_indices, int fp_bit_number = -1);
 
@@ -10,11 +10,14 @@
 #include "reaction/reaction_substructure_matcher.h"
 
 #include "molecule/cmf_loader.h"
+#include "molecule/canonical_smiles_saver.h"
 #include "molecule/cmf_saver.h"
 #include "molecule/molecule.h"
 #include "molecule/molecule_fingerprint.h"
 #include "molecule/molecule_gross_formula.h"
+#include "molecule/molecule_match_features.h"
 #include "molecule/molecule_substructure_matcher.h"
+#include "molecule/molfile_saver.h"
 
 using namespace indigo;
 using namespace bingo;
@@ -53,11 +56,44 @@ SubstructureMoleculeQuery::SubstructureMoleculeQuery(/* const */ QueryMolecule&
     _mol.clone(mol, 0, 0);
 }
 
+bool SubstructureMoleculeQuery::buildCacheKey(Array<char>& key) /* const */
+{
+    // There are no canonical SMARTS, so the query is identified by its full Molfile
+    try
+    {
+        ArrayOutput output(key);
+        MolfileSaver saver(output);
+        saver.mode = MolfileSaver::MODE_3000;
+        saver.skip_date = true;
+        saver.saveQueryMolecule(_mol);
+        return true;
+    }
+    catch (Exception&)
+    {
+        return false;
+    }
+}
+
 SimilarityMoleculeQuery::SimilarityMoleculeQuery(/* const */ Molecule& mol) : BaseMoleculeQuery(_mol, false)
 {
     _mol.clone(mol, 0, 0);
 }
 
+bool SimilarityMoleculeQuery::buildCacheKey(Array<char>& key) /* const */
+{
+    try
+    {
+        ArrayOutput output(key);
+        CanonicalSmilesSaver saver(output);
+        saver.saveMolecule(_mol);
+        return true;
+    }
+    catch (Exception&)
+    {
+        return false;
+    }
+}
+
 GrossQuery::GrossQuery(/* const */ Array<char>& str)
 {
     _gross_str.copy(str);
@@ -150,6 +186,23 @@ bool IndexMolecule::buildHash(dword& hash)
     return true;
 }
 
+bool IndexMolecule::buildMatchFeatures(const Array<char>& cf, Array<char>& features)
+{
+    // Atoms are renumbered by the cmf saver, so the features are taken from the decoded molecule
+    Molecule mol;
+    BufferScanner scanner(cf);
+    CmfLoader cmf_loader(scanner);
+    cmf_loader.loadMolecule(mol);
+
+    MoleculeMatchFeatures match_features;
+    match_features.build(mol);
+
+    ArrayOutput output(features);
+    match_features.save(output);
+
+    return true;
+}
+
 IndexReaction::IndexReaction(/* const */ Reaction& rxn, const AromaticityOptions& arom_options)
 {
     _rxn.clone(rxn);
@@ -25,6 +25,13 @@ namespace bingo
         virtual bool buildFingerprint(const indigo::MoleculeFingerprintParameters& fp_params, indigo::Array<byte>* sub_fp,
                                       indigo::Array<byte>* sim_fp) /* const */
             = 0;
+
+        // Identifies the query in the search result cache; returns false if the query can't be cached
+        virtual bool buildCacheKey(indigo::Array<char>& key) /* const */
+        {
+            return false;
+        }
+
         virtual ~QueryObject(){};
     };
 
@@ -55,6 +62,8 @@ namespace bingo
 
     public:
         SubstructureMoleculeQuery(/* const */ indigo::QueryMolecule& mol);
+
+        bool buildCacheKey(indigo::Array<char>& key) /* const */ override;
     };
 
     class SimilarityMoleculeQuery : public BaseMoleculeQuery
@@ -64,6 +73,8 @@ namespace bingo
 
     public:
         SimilarityMoleculeQuery(/* const */ indigo::Molecule& mol);
+
+        bool buildCacheKey(indigo::Array<char>& key) /* const */ override;
     };
 
     class GrossQuery : public QueryObject
@@ -129,6 +140,12 @@ namespace bingo
 
         virtual bool buildHash(dword& hash) /* const */ = 0;
 
+        // Match features of the object as it is decoded from its cf string
+        virtual bool buildMatchFeatures(const indigo::Array<char>& cf, indigo::Array<char>& features)
+        {
+            return false;
+        }
+
         virtual ~IndexObject(){};
     };
 
@@ -148,6 +165,8 @@ namespace bingo
         bool buildCfString(indigo::Array<char>& cf) /*const*/ override;
 
         bool buildHash(dword& hash) /* const */ override;
+
+        bool buildMatchFeatures(const indigo::Array<char>& cf, indigo::Array<char>& features) override;
     };
 
     class IndexReaction : public IndexObject
@@ -0,0 +1,102 @@
+#include "bingo_result_cache.h"
+
+#include <cstring>
+
+#include "base_cpp/profiling.h"
+
+using namespace bingo;
+using namespace indigo;
+
+ResultCache::ResultCache(int capacity) : _capacity(capacity)
+{
+    _entries.resize(capacity);
+}
+
+MMFAddress ResultCache::create(MMFPtr<ResultCache>& ptr, int capacity)
+{
+    if (capacity <= 0)
+        throw Exception("ResultCache: incorrect capacity %d", capacity);
+
+    ptr.allocate();
+    new (ptr.ptr()) ResultCache(capacity);
+
+    return ptr.getAddress();
+}
+
+void ResultCache::load(MMFPtr<ResultCache>& ptr, MMFAddress offset)
+{
+    ptr = MMFPtr<ResultCache>(offset);
+}
+
+bool ResultCache::find(const Array<char>& key, int generation, Array<int>& ids, Array<float>& sim_values)
+{
+    profTimerStart(t, "result_cache_find");
+
+    dword hash = _calcHash(key);
+    _Entry& entry = _entries[hash % _capacity];
+
+    if (entry.generation != generation || entry.hash != hash || entry.key_len != key.size())
+        return false;
+
+    if (key.size() > 0 && memcmp(entry.key.ptr(), key.ptr(), key.size()) != 0)
+        return false;
+
+    ids.clear();
+    sim_values.clear();
+    if (entry.count > 0)
+    {
+        ids.copy(entry.ids.ptr(), entry.count);
+        sim_values.copy(entry.sim_values.ptr(), entry.count);
+    }
+
+    profIncCounter("result_cache_hits", 1);
+    return true;
+}
+
+void ResultCache::store(const Array<char>& key, int generation, const Array<int>& ids, const Array<float>& sim_values)
+{
+    profTimerStart(t, "result_cache_store");
+
+    dword hash = _calcHash(key);
+    _Entry& entry = _entries[hash % _capacity];
+
+    // The entry is invalid while it is being rewritten
+    entry.generation = -1;
+
+    if (entry.key_capacity < key.size())
+    {
+        entry.key.allocate(key.size());
+        entry.key_capacity = key.size();
+    }
+    if (key.size() > 0)
+        memcpy(entry.key.ptr(), key.ptr(), key.size());
+    entry.key_len = key.size();
+
+    if (entry.capacity < ids.size())
+    {
+        entry.ids.allocate(ids.size());
+        entry.sim_values.allocate(ids.size());
+        entry.capacity = ids.size();
+    }
+    if (ids.size() > 0)
+    {
+        memcpy(entry.ids.ptr(), ids.ptr(), ids.size() * sizeof(int));
+        memcpy(entry.sim_values.ptr(), sim_values.ptr(), ids.size() * sizeof(float));
+    }
+    entry.count = ids.size();
+
+    entry.hash = hash;
+    entry.generation = generation;
+}
+
+dword ResultCache::_calcHash(const Array<char>& key)
+{
+    // FNV-1a
+    dword hash = 2166136261u;
+    for (int i = 0; i < key.size(); i++)
+    {
+        hash ^= (byte)key[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
@@ -0,0 +1,49 @@
+#ifndef __bingo_result_cache__
+#define __bingo_result_cache__
+
+#include "base_cpp/array.h"
+
+#include "mmf/mmf_array.h"
+#include "mmf/mmf_ptr.h"
+
+namespace bingo
+{
+    // Results of completed searches keyed by the query and the index generation.
+    // Every key has a single slot, a new result replaces the previous one in it.
+    // Slot buffers are reused when the new result fits into them, as the MMF
+    // storage never releases memory.
+    class ResultCache
+    {
+    public:
+        ResultCache(int capacity);
+
+        static MMFAddress create(MMFPtr<ResultCache>& ptr, int capacity);
+
+        static void load(MMFPtr<ResultCache>& ptr, MMFAddress offset);
+
+        bool find(const indigo::Array<char>& key, int generation, indigo::Array<int>& ids, indigo::Array<float>& sim_values);
+
+        void store(const indigo::Array<char>& key, int generation, const indigo::Array<int>& ids, const indigo::Array<float>& sim_values);
+
+    private:
+        struct _Entry
+        {
+            dword hash = 0;
+            int generation = -1;
+            MMFPtr<char> key;
+            int key_len = 0;
+            int key_capacity = 0;
+            MMFPtr<int> ids;
+            MMFPtr<float> sim_values;
+            int count = 0;
+            int capacity = 0;
+        };
+
+        int _capacity;
+        MMFArray<_Entry> _entries;
+
+        static dword _calcHash(const indigo::Array<char>& key);
+    };
+} // namespace bingo
+
+#endif //__bingo_result_cache__
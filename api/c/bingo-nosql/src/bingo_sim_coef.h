@@ -1,7 +1,11 @@
 #ifndef __sim_coef__
 #define __sim_coef__
 
+#include <algorithm>
+
+#include "base_c/bitarray.h"
 #include "base_c/defs.h"
+#include "base_cpp/obj_array.h"
 
 namespace bingo
 {
@@ -29,6 +33,79 @@ namespace bingo
         virtual double calcUpperBound(int query_bit_count, int min_target_bit_count, int max_target_bit_count) = 0;
 
         virtual double calcUpperBound(int query_bit_count, int min_target_bit_count, int max_target_bit_count, int m10, int m01) = 0;
+
+    protected:
+        // Counts common bits and fills unknown (-1) bit counts in the same pass over the fingerprints
+        static int _calcCommonBits(const byte* target, const byte* query, int fp_size, int& target_bit_count, int& query_bit_count)
+        {
+            return bitCommonOnesWithCounts(target, query, fp_size, target_bit_count == -1 ? &target_bit_count : 0,
+                                           query_bit_count == -1 ? &query_bit_count : 0);
+        }
+    };
+
+    // Query fingerprints that are searched together during one pass over the
+    // similarity storage. Results are collected separately for every query.
+    struct SimBatchQueries
+    {
+        const byte* fingerprints;
+        int fp_size;
+        indigo::Array<int> bit_counts;
+        // Queries that can have hits in the cell being scanned
+        indigo::Array<int> active;
+        indigo::ObjArray<indigo::Array<SimResult>> results;
+
+        void init(const byte* query_fingerprints, int query_count, int query_fp_size)
+        {
+            fingerprints = query_fingerprints;
+            fp_size = query_fp_size;
+            bit_counts.clear();
+            active.clear();
+            results.clear();
+            for (int i = 0; i < query_count; i++)
+            {
+                bit_counts.push(bitGetOnesCount(fingerprints + i * fp_size, fp_size));
+                results.push();
+            }
+        }
+
+        void activateAll()
+        {
+            active.clear();
+            for (int i = 0; i < bit_counts.size(); i++)
+                active.push(i);
+        }
+
+        // Compares the active queries with a contiguous block of target fingerprints.
+        // Targets are taken in tiles that stay in cache while all the queries are checked.
+        template <typename IdType>
+        void findSimilarLinear(const byte* targets, const IdType* ids, int target_count, int target_bit_count, SimCoef& sim_coef, double min_coef)
+        {
+            const int tile_size = std::max(1, _tile_bytes / fp_size);
+
+            for (int tile_begin = 0; tile_begin < target_count; tile_begin += tile_size)
+            {
+                int tile_end = std::min(target_count, tile_begin + tile_size);
+
+                for (int i = 0; i < active.size(); i++)
+                {
+                    int query_idx = active[i];
+                    const byte* query = fingerprints + query_idx * fp_size;
+                    indigo::Array<SimResult>& query_results = results[query_idx];
+
+                    for (int j = tile_begin; j < tile_end; j++)
+                    {
+                        double coef = sim_coef.calcCoef(query, targets + j * fp_size, bit_counts[query_idx], target_bit_count);
+                        if (coef < min_coef)
+                            continue;
+
+                        query_results.push(SimResult((int)ids[j], (float)coef));
+                    }
+                }
+            }
+        }
+
+    private:
+        static const int _tile_bytes = 16384;
     };
 }; // namespace bingo
 
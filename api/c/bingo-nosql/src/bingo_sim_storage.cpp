@@ -46,6 +46,21 @@ void SimStorage::add(const byte* fingerprint, int id)
     }
 }
 
+void SimStorage::bulkLoad(const byte* fingerprints, const int* ids, int count)
+{
+    if (_fingerprint_table.getAddress() != MMFAddress::null || _inc_fp_count > 0)
+        throw Exception("SimStorage: bulk load is possible only into empty storage");
+
+    if (count < _inc_size)
+    {
+        for (int i = 0; i < count; i++)
+            add(fingerprints + i * _fp_size, ids[i]);
+        return;
+    }
+
+    FingerprintTable::createSorted(_fingerprint_table, _fp_size, _mt_size, fingerprints, ids, count);
+}
+
 void SimStorage::optimize()
 {
     if (_fingerprint_table.getAddress() == MMFAddress::null)
@@ -113,7 +128,7 @@ int SimStorage::getIncSimilar(const byte* query, SimCoef& sim_coef, double min_c
 {
     for (int i = 0; i < _inc_fp_count; i++)
     {
-        double coef = sim_coef.calcCoef(_inc_buffer.ptr() + (i * _fp_size), query, -1, -1);
+        double coef = sim_coef.calcCoef(query, _inc_buffer.ptr() + (i * _fp_size), -1, -1);
         if (coef < min_coef)
             continue;
         size_t id = _inc_id_buffer[i];
@@ -124,6 +139,18 @@ int SimStorage::getIncSimilar(const byte* query, SimCoef& sim_coef, double min_c
     return sim_fp_indices.size();
 }
 
+void SimStorage::findSimilarBatch(SimBatchQueries& queries, SimCoef& sim_coef, double min_coef)
+{
+    if (isSmallBase())
+    {
+        queries.activateAll();
+        queries.findSimilarLinear(_inc_buffer.ptr(), _inc_id_buffer.ptr(), _inc_fp_count, -1, sim_coef, min_coef);
+        return;
+    }
+
+    _fingerprint_table->findSimilarBatch(queries, sim_coef, min_coef);
+}
+
 SimStorage::~SimStorage()
 {
 }
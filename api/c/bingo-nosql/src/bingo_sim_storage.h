@@ -25,6 +25,9 @@ namespace bingo
 
         void add(const byte* fingerprint, int id);
 
+        // Fills an empty storage with all the fingerprints at once
+        void bulkLoad(const byte* fingerprints, const int* ids, int count);
+
         void optimize();
 
         int getCellCount() const;
@@ -43,6 +46,8 @@ namespace bingo
 
         int getIncSimilar(const byte* query, SimCoef& sim_coef, double min_coef, indigo::Array<SimResult>& sim_fp_indices);
 
+        void findSimilarBatch(SimBatchQueries& queries, SimCoef& sim_coef, double min_coef);
+
         ~SimStorage();
 
     private:
@@ -8,10 +8,13 @@ TanimotoCoef::TanimotoCoef(int fp_size) : _fp_size(fp_size)
 
 double TanimotoCoef::calcCoef(const byte* target, const byte* query, int target_bit_count, int query_bit_count)
 {
-    int common_bits = bitCommonOnes(target, query, _fp_size);
-    int unique_bits = bitDifferentOnes(target, query, _fp_size);
+    int common_bits = _calcCommonBits(target, query, _fp_size, target_bit_count, query_bit_count);
+    int union_bits = target_bit_count + query_bit_count - common_bits;
 
-    return (double)common_bits / (common_bits + unique_bits);
+    if (union_bits == 0)
+        return 0;
+
+    return (double)common_bits / union_bits;
 }
 
 double TanimotoCoef::calcUpperBound(int query_bit_count, int min_target_bit_count, int max_target_bit_count)
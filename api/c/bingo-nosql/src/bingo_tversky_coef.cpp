@@ -16,12 +16,7 @@ TverskyCoef::TverskyCoef(int fp_size, double a, double b) : _fp_size(fp_size)
 
 double TverskyCoef::calcCoef(const byte* target, const byte* query, int target_bit_count, int query_bit_count)
 {
-    int common_bits = bitCommonOnes(target, query, _fp_size);
-
-    if (target_bit_count == -1)
-        target_bit_count = bitGetOnesCount(target, _fp_size);
-    if (query_bit_count == -1)
-        query_bit_count = bitGetOnesCount(query, _fp_size);
+    int common_bits = _calcCommonBits(target, query, _fp_size, target_bit_count, query_bit_count);
 
     return (double)common_bits / ((target_bit_count - common_bits) * _alpha + (query_bit_count - common_bits) * _beta + common_bits);
 }
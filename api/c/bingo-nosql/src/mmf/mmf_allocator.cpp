@@ -151,6 +151,8 @@ void MMFAllocator::close()
 {
     auto allocators = sf::xlock_safe_ptr(_allocators());
     allocators->erase(_current_db_id);
+    _current_db_id = -1;
+    _current_allocator = nullptr;
 }
 
 MMFAllocator& MMFAllocator::getAllocator()
@@ -821,6 +821,15 @@ CEXPORT const char* indigoCheckAmbiguousH(int handle);
 //                 fingerprint types included
 CEXPORT int indigoFingerprint(int item, const char* type);
 
+// Builds fingerprints of many molecules at once and writes them one after
+// another into a buffer, which is valid until the next call in this thread.
+// 'items' is an array of molecules or an iterator; at most 'max_count' next
+// molecules are taken from an iterator (all of them if max_count <= 0).
+// The types are the same as in indigoFingerprint(). The work is spread over
+// "fingerprint-threads" threads.
+// Returns the number of fingerprints in the buffer, or -1 on error.
+CEXPORT int indigoFingerprintBatch(int items, const char* type, int max_count, char** buf, int* size);
+
 // Counts the nonzero (i.e. one) bits in a fingerprint
 CEXPORT int indigoCountBits(int fingerprint);
 
@@ -917,9 +926,15 @@ CEXPORT int indigoUnignoreAllAtoms(int matcher);
 
 // Returns a new 'match' object on success, zero on fail
 //    matcher is an matcher object returned by indigoSubstructureMatcher
+// Molecule queries are searched for on "match-threads" threads when the
+// option is greater than one; the match found may then differ between runs.
 CEXPORT int indigoMatch(int matcher, int query);
 
 // Counts the number of embeddings of the query structure into the target
+// The search uses "match-threads" threads like indigoMatch.
+// With the "match-candidate-domains" option the candidate target atoms of
+// every query atom are found before the search, which prunes it faster on
+// queries that do not match.
 CEXPORT int indigoCountMatches(int matcher, int query);
 
 // Counts the number of embeddings of the query structure into the target
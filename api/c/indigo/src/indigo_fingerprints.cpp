@@ -19,16 +19,21 @@
 #include "indigo_fingerprints.h"
 
 #include "base_c/bitarray.h"
+#include "base_cpp/os_thread_wrapper.h"
 #include "base_cpp/output.h"
 #include "base_cpp/scanner.h"
+#include "indigo_array.h"
 #include "indigo_io.h"
 #include "indigo_molecule.h"
 #include "indigo_reaction.h"
 #include "molecule/molecule_fingerprint.h"
 #include "reaction/reaction.h"
 #include "reaction/reaction_fingerprint.h"
+#include <algorithm>
+#include <climits>
 #include <math.h>
 #include <memory>
+#include <vector>
 
 IndigoFingerprint::IndigoFingerprint() : IndigoObject(FINGERPRINT)
 {
@@ -153,6 +158,141 @@ CEXPORT int indigoFingerprint(int item, const char* type)
     INDIGO_END(-1);
 }
 
+namespace
+{
+    // Molecules of a batch and the place for their fingerprints
+    struct FingerprintBatch
+    {
+        std::vector<IndigoObject*> objects;
+        const char* type;
+        byte* output;
+        int fp_size;
+    };
+
+    // One builder serves the whole range, so its memory is allocated once
+    void buildFingerprints(const FingerprintBatch& batch, int begin, int end)
+    {
+        Indigo& self = indigoGetInstance();
+        std::unique_ptr<MoleculeFingerprintBuilder> builder;
+
+        for (int i = begin; i < end; i++)
+        {
+            IndigoObject& obj = *batch.objects[i];
+            if (!IndigoBaseMolecule::is(obj))
+                throw IndigoError("indigoFingerprintBatch(): accepting only molecules, got %s", obj.debugInfo());
+
+            BaseMolecule& mol = obj.getBaseMolecule();
+            if (builder == nullptr)
+                builder = std::make_unique<MoleculeFingerprintBuilder>(mol, self.fp_params);
+
+            _indigoParseMoleculeFingerprintType(*builder, batch.type, mol.isQueryMolecule());
+            builder->process(mol);
+            memcpy(batch.output + (size_t)i * batch.fp_size, builder->get(), batch.fp_size);
+        }
+    }
+
+    class FingerprintCommand : public OsCommand
+    {
+    public:
+        void execute(OsCommandResult& /*result*/) override
+        {
+            buildFingerprints(*batch, begin, end);
+        }
+
+        const FingerprintBatch* batch = nullptr;
+        int begin = 0;
+        int end = 0;
+    };
+
+    class FingerprintDispatcher : public OsCommandDispatcher
+    {
+    public:
+        FingerprintDispatcher(const FingerprintBatch& batch, int range_size)
+            : OsCommandDispatcher(HANDLING_ORDER_ANY, true), _batch(batch), _range_size(range_size), _next(0)
+        {
+        }
+
+    protected:
+        OsCommand* _allocateCommand() override
+        {
+            return new FingerprintCommand();
+        }
+
+        bool _setupCommand(OsCommand& command) override
+        {
+            int count = (int)_batch.objects.size();
+            if (_next == count)
+                return false;
+
+            auto& fp_command = static_cast<FingerprintCommand&>(command);
+            fp_command.batch = &_batch;
+            fp_command.begin = _next;
+            fp_command.end = std::min(_next + _range_size, count);
+            _next = fp_command.end;
+            return true;
+        }
+
+    private:
+        const FingerprintBatch& _batch;
+        int _range_size;
+        int _next;
+    };
+}
+
+CEXPORT int indigoFingerprintBatch(int items, const char* type, int max_count, char** buf, int* size)
+{
+    INDIGO_BEGIN
+    {
+        IndigoObject& obj = self.getObject(items);
+        FingerprintBatch batch;
+        std::vector<std::unique_ptr<IndigoObject>> taken;
+
+        if (IndigoArray::is(obj))
+        {
+            IndigoArray& arr = IndigoArray::cast(obj);
+            for (int i = 0; i < arr.objects.size(); i++)
+                batch.objects.push_back(arr.objects[i]);
+        }
+        else
+        {
+            while (max_count <= 0 || (int)taken.size() < max_count)
+            {
+                std::unique_ptr<IndigoObject> next(obj.next());
+                if (next == nullptr)
+                    break;
+                batch.objects.push_back(next.get());
+                taken.push_back(std::move(next));
+            }
+        }
+
+        auto& tmp = self.getThreadTmpData();
+        int count = (int)batch.objects.size();
+        batch.type = type;
+        batch.fp_size = self.fp_params.fingerprintSize();
+        size_t total_size = (size_t)count * batch.fp_size;
+        if (total_size > INT_MAX)
+            throw IndigoError("indigoFingerprintBatch(): %d fingerprints of %d bytes do not fit in one buffer", count, batch.fp_size);
+        tmp.string.clear_resize((int)total_size);
+        batch.output = (byte*)tmp.string.ptr();
+
+        int threads = std::min(self.fingerprint_threads, count);
+        if (threads <= 1)
+            buildFingerprints(batch, 0, count);
+        else
+        {
+            // Ranges are small enough to balance molecules of different size
+            // between the threads, and large enough to reuse the builders
+            FingerprintDispatcher dispatcher(batch, std::max(1, std::min(64, count / (threads * 4))));
+            dispatcher.run(threads);
+        }
+
+        *buf = tmp.string.ptr();
+        *size = tmp.string.size();
+        return count;
+    }
+    INDIGO_END(-1);
+}
+
 CEXPORT int indigoLoadFingerprintFromBuffer(const byte* buffer, int size)
 {
     INDIGO_BEGIN
@@ -210,9 +350,8 @@ void IndigoFingerprint::toBuffer(Array<char>& buf)
 
 static float _indigoSimilarity2(const byte* arr1, const byte* arr2, int size, const char* metrics)
 {
-    int ones1 = bitGetOnesCount(arr1, size);
-    int ones2 = bitGetOnesCount(arr2, size);
-    int common_ones = bitCommonOnes(arr1, arr2, size);
+    int ones1, ones2;
+    int common_ones = bitCommonOnesWithCounts(arr1, arr2, size, &ones1, &ones2);
 
     if (metrics == 0 || metrics[0] == 0 || strcasecmp(metrics, "tanimoto") == 0)
     {
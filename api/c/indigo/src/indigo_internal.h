@@ -29,6 +29,7 @@
 
 #include "indigo.h"
 #include "indigo_abbreviations.h"
+#include "indigo_object_table.h"
 
 #include "base_cpp/cancellation_handler.h"
 #include "base_cpp/exception.h"
@@ -339,6 +340,13 @@ public:
 
     int cancellation_timeout; // default is 0 seconds - no timeout
 
+    int iteration_threads;        // default is zero -- records are parsed and gzip is inflated in the calling thread
+    bool iteration_ordered;       // default is true -- parsed records are returned in the file order
+    bool iteration_offset_index;  // default is false -- record offsets of iterated files are not saved
+    int fingerprint_threads;      // default is zero -- batch fingerprints are built in the calling thread
+    int match_threads;            // default is zero -- indigoMatch and indigoCountMatches search in the calling thread
+    bool match_candidate_domains; // default is false -- query atoms are matched only during the search
+
     void updateCancellationHandler();
 
     void initMolfileSaver(MolfileSaver& saver);
@@ -370,12 +378,7 @@ private:
     static INDIGO_ERROR_HANDLER& error_handler();
     static void*& error_handler_context();
 
-    struct ObjectsHolder
-    {
-        std::unordered_map<int, std::unique_ptr<IndigoObject>> objects;
-        int next_id = 1;
-    };
-    sf::safe_shared_hide_obj<ObjectsHolder> _objects_holder;
+    IndigoObjectTable _objects;
     int _indigo_id;
     std::unique_ptr<abbreviations::IndigoAbbreviations> _abbreviations = nullptr;
 };
@@ -90,7 +90,7 @@ CEXPORT int indigoReadFile(const char* filename)
 {
     INDIGO_BEGIN
     {
-        return self.addObject(new IndigoScanner(new FileScanner(self.filename_encoding, filename)));
+        return self.addObject(new IndigoScanner(MappedFileScanner::open(self.filename_encoding, filename).release()));
     }
     INDIGO_END(-1);
 }
@@ -17,6 +17,9 @@
  ***************************************************************************/
 
 #include "indigo_loaders.h"
+#include "base_cpp/os_thread_wrapper.h"
+#include "base_cpp/output.h"
+#include "base_cpp/record_offset_index.h"
 #include "base_cpp/scanner.h"
 #include "indigo_io.h"
 #include "indigo_molecule.h"
@@ -74,16 +77,238 @@ IndigoJSONMolecule::~IndigoJSONMolecule()
 {
 }
 
+namespace
+{
+    class ParseCommand : public OsCommand
+    {
+    public:
+        void execute(OsCommandResult& result) override;
+
+        IndigoObject* object = nullptr;
+        int index = -1;
+    };
+
+    class ParseResult : public OsCommandResult
+    {
+    public:
+        int index = -1;
+    };
+
+    // Parses the records of a batch and collects their indices in the order
+    // the results are handled
+    class ParseDispatcher : public OsCommandDispatcher
+    {
+    public:
+        ParseDispatcher(std::vector<IndigoObject*>& objects, bool ordered, std::vector<int>& order)
+            : OsCommandDispatcher(ordered ? HANDLING_ORDER_SERIAL : HANDLING_ORDER_ANY, true), _objects(objects), _order(order), _next(0)
+        {
+        }
+
+    protected:
+        OsCommand* _allocateCommand() override
+        {
+            return new ParseCommand();
+        }
+
+        OsCommandResult* _allocateResult() override
+        {
+            return new ParseResult();
+        }
+
+        bool _setupCommand(OsCommand& command) override
+        {
+            if (_next == (int)_objects.size())
+                return false;
+
+            auto& parse_command = static_cast<ParseCommand&>(command);
+            parse_command.object = _objects[_next];
+            parse_command.index = _next++;
+            return true;
+        }
+
+        void _handleResult(OsCommandResult& result) override
+        {
+            _order.push_back(static_cast<ParseResult&>(result).index);
+        }
+
+    private:
+        std::vector<IndigoObject*>& _objects;
+        std::vector<int>& _order;
+        int _next;
+    };
+
+    void ParseCommand::execute(OsCommandResult& result)
+    {
+        try
+        {
+            if (IndigoBaseMolecule::is(*object))
+                object->getBaseMolecule();
+            else if (IndigoBaseReaction::is(*object))
+                object->getBaseReaction();
+        }
+        catch (Exception&)
+        {
+            // The record stays unparsed and throws again when it is accessed
+        }
+        static_cast<ParseResult&>(result).index = index;
+    }
+}
+
+IndigoObject* IndigoParallelParser::next(const ReadFunc& read)
+{
+    Indigo& self = indigoGetInstance();
+
+    if (_ready.empty())
+    {
+        if (_error)
+        {
+            std::exception_ptr error = _error;
+            _error = nullptr;
+            std::rethrow_exception(error);
+        }
+
+        if (self.iteration_threads <= 0)
+            return read(_last_offset);
+
+        _parseBatch(read, self.iteration_threads, self.iteration_ordered);
+        if (_ready.empty())
+            return nullptr;
+    }
+
+    Record record = std::move(_ready.front());
+    _ready.pop_front();
+    _last_offset = record.end_offset;
+    return record.object.release();
+}
+
+bool IndigoParallelParser::empty() const
+{
+    return _ready.empty() && !_error;
+}
+
+void IndigoParallelParser::clear()
+{
+    _ready.clear();
+    _error = nullptr;
+}
+
+long long IndigoParallelParser::tell() const
+{
+    return _last_offset;
+}
+
+void IndigoParallelParser::_parseBatch(const ReadFunc& read, int threads, bool ordered)
+{
+    // Batches are large enough to keep all the threads busy with records of
+    // different size, and small enough to return the first record quickly
+    const int batch_size = threads * 32;
+
+    std::vector<Record> batch;
+    try
+    {
+        while ((int)batch.size() < batch_size)
+        {
+            Record record;
+            record.object.reset(read(record.end_offset));
+            if (record.object == nullptr)
+                break;
+            batch.push_back(std::move(record));
+        }
+    }
+    catch (...)
+    {
+        if (batch.empty())
+            throw;
+        // Records read before the error are returned first, as in the serial iteration
+        _error = std::current_exception();
+    }
+
+    if (batch.empty())
+        return;
+
+    std::vector<IndigoObject*> objects;
+    for (auto& record : batch)
+        objects.push_back(record.object.get());
+
+    std::vector<int> order;
+    ParseDispatcher dispatcher(objects, ordered, order);
+    dispatcher.run(threads);
+
+    for (int index : order)
+        _ready.push_back(std::move(batch[index]));
+}
+
+void IndigoOffsetIndexFile::open(const char* filename, Scanner& source)
+{
+    Indigo& self = indigoGetInstance();
+    if (!self.iteration_offset_index)
+        return;
+
+    _source_path = filename;
+    _path = filename;
+    _path += ".offsets";
+    _source = &source;
+}
+
+bool IndigoOffsetIndexFile::load(Array<long long>& offsets, long long& end_offset)
+{
+    if (_path.empty())
+        return false;
+
+    try
+    {
+        FileScanner input(indigoGetInstance().filename_encoding, _path.c_str());
+        _saved = RecordOffsetIndex::load(input, *_source, indigoGetInstance().filename_encoding, _source_path.c_str(), offsets, end_offset);
+    }
+    catch (Exception&)
+    {
+        // no index yet
+        _saved = false;
+    }
+    return _saved;
+}
+
+void IndigoOffsetIndexFile::save(const Array<long long>& offsets, long long end_offset)
+{
+    if (_path.empty() || _saved)
+        return;
+
+    // The index is only an optimization, so a read-only location is not an error
+    _saved = true;
+    try
+    {
+        FileOutput output(indigoGetInstance().filename_encoding, _path.c_str());
+        RecordOffsetIndex::save(output, *_source, indigoGetInstance().filename_encoding, _source_path.c_str(), offsets, end_offset);
+    }
+    catch (Exception&)
+    {
+    }
+}
+
 IndigoSdfLoader::IndigoSdfLoader(Scanner& scanner) : IndigoObject(SDF_LOADER)
 {
     sdf_loader = std::make_unique<SdfLoader>(scanner);
+    sdf_loader->setDecompressionThreads(indigoGetInstance().iteration_threads);
+    // Data items are parsed by the records when they are requested
+    sdf_loader->parse_properties = false;
 }
 
 IndigoSdfLoader::IndigoSdfLoader(const char* filename) : IndigoObject(SDF_LOADER)
 {
     // AutoPtr guard in case of exception in SdfLoader (happens in case of empty file)
-    _own_scanner = std::make_unique<FileScanner>(indigoGetInstance().filename_encoding, filename);
+    _own_scanner = MappedFileScanner::open(indigoGetInstance().filename_encoding, filename);
     sdf_loader = std::make_unique<SdfLoader>(*_own_scanner);
+    sdf_loader->setDecompressionThreads(indigoGetInstance().iteration_threads);
+    // Data items are parsed by the records when they are requested
+    sdf_loader->parse_properties = false;
+
+    Array<long long> offsets;
+    long long end_offset;
+    _index.open(filename, *_own_scanner);
+    if (_index.load(offsets, end_offset))
+        sdf_loader->setOffsets(offsets, end_offset);
+    // Records are read at saved offsets
+    sdf_loader->setRandomAccess(indigoGetInstance().iteration_offset_index);
 }
 
 IndigoSdfLoader::~IndigoSdfLoader()
@@ -93,6 +318,7 @@ IndigoSdfLoader::~IndigoSdfLoader()
 IndigoRdfData::IndigoRdfData(int type, Array<char>& data, int index, long long offset) : IndigoObject(type)
 {
     _loaded = false;
+    _properties_in_data = false;
     _data.copy(data);
 
     _index = index;
@@ -102,6 +328,7 @@ IndigoRdfData::IndigoRdfData(int type, Array<char>& data, int index, long long o
 IndigoRdfData::IndigoRdfData(int type, Array<char>& data, PropertiesMap& properties, int index, long long offset) : IndigoObject(type)
 {
     _loaded = false;
+    _properties_in_data = false;
     _data.copy(data);
 
     _properties.copy(properties);
@@ -110,15 +337,99 @@ IndigoRdfData::IndigoRdfData(int type, Array<char>& data, PropertiesMap& propert
     _offset = offset;
 }
 
+IndigoRdfData::IndigoRdfData(int type, const SdfRecord& record, const std::shared_ptr<Scanner>& source, int index, long long offset)
+    : IndigoObject(type)
+{
+    _loaded = false;
+    _properties_in_data = true;
+    if (source != nullptr)
+    {
+        _source = source;
+        _source_record = record;
+    }
+    else
+        record.getData(_data);
+
+    _index = index;
+    _offset = offset;
+}
+
 IndigoRdfData::~IndigoRdfData()
 {
 }
 
+void IndigoRdfData::_getText(const char*& text, int& size)
+{
+    if (_source != nullptr)
+    {
+        text = _source_record.ptr();
+        size = _source_record.size();
+    }
+    else
+    {
+        text = _data.ptr();
+        size = _data.size();
+    }
+}
+
 Array<char>& IndigoRdfData::getRawData()
 {
+    if (_source != nullptr)
+    {
+        _source_record.getData(_data);
+        _source.reset();
+    }
     return _data;
 }
 
+PropertiesMap& IndigoRdfData::getProperties()
+{
+    if (_properties_in_data)
+    {
+        SdfRecord record;
+        const char* text;
+        int size;
+        _getText(text, size);
+        record.reset(text, size);
+        record.getProperties(_properties);
+        _properties_in_data = false;
+    }
+    return _properties;
+}
+
+bool IndigoRdfData::hasProperty(const char* name)
+{
+    if (!_properties_in_data)
+        return _properties.contains(name);
+
+    SdfRecord record;
+    const char* text;
+    int size;
+    _getText(text, size);
+    record.reset(text, size);
+    return record.getProperty(name, text, size);
+}
+
+void IndigoRdfData::getProperty(const char* name, Array<char>& value)
+{
+    if (_properties_in_data)
+    {
+        SdfRecord record;
+        const char* text;
+        int size;
+        _getText(text, size);
+        record.reset(text, size);
+        if (record.getProperty(name, text, size))
+        {
+            SdfRecord::copyValue(text, size, value);
+            value.push(0);
+            return;
+        }
+    }
+    // Throws the usual error when there is no such property
+    value.readString(_properties.at(name), true);
+}
+
 long long IndigoRdfData::tell()
 {
     return _offset;
@@ -134,12 +445,25 @@ IndigoRdfMolecule::IndigoRdfMolecule(Array<char>& data, PropertiesMap& propertie
 {
 }
 
+IndigoRdfMolecule::IndigoRdfMolecule(Array<char>& data, int index, long long offset) : IndigoRdfData(RDF_MOLECULE, data, index, offset)
+{
+    _properties_in_data = true;
+}
+
+IndigoRdfMolecule::IndigoRdfMolecule(const SdfRecord& record, const std::shared_ptr<Scanner>& source, int index, long long offset)
+    : IndigoRdfData(RDF_MOLECULE, record, source, index, offset)
+{
+}
+
 Molecule& IndigoRdfMolecule::getMolecule()
 {
     if (!_loaded)
     {
         Indigo& self = indigoGetInstance();
-        BufferScanner scanner(_data);
+        const char* text;
+        int size;
+        _getText(text, size);
+        BufferScanner scanner(text, size);
         MolfileLoader loader(scanner);
 
         loader.stereochemistry_options = self.stereochemistry_options;
@@ -168,7 +492,10 @@ const char* IndigoRdfMolecule::getName()
 
     Indigo& self = indigoGetInstance();
 
-    BufferScanner scanner(_data);
+    const char* text;
+    int size;
+    _getText(text, size);
+    BufferScanner scanner(text, size);
     auto& tmp = self.getThreadTmpData();
     scanner.readLine(tmp.string, true);
     return tmp.string.ptr();
@@ -244,45 +571,82 @@ IndigoRdfReaction::~IndigoRdfReaction()
 {
 }
 
-IndigoObject* IndigoSdfLoader::next()
+IndigoObject* IndigoSdfLoader::_readNext()
 {
     if (sdf_loader->isEOF())
+    {
+        _index.save(sdf_loader->offsets(), sdf_loader->maxOffset());
         return 0;
+    }
 
     int counter = sdf_loader->currentNumber();
     long long offset = sdf_loader->tell();
 
-    sdf_loader->readNext();
+    SdfRecord record;
+    sdf_loader->readNextRecord(record);
+
+    // Records of a mapped file keep the mapping instead of a copy of the text
+    if (_own_scanner != nullptr && sdf_loader->recordsInBuffer())
+        return new IndigoRdfMolecule(record, _own_scanner, counter, offset);
+    return new IndigoRdfMolecule(record, nullptr, counter, offset);
+}
 
-    return new IndigoRdfMolecule(sdf_loader->data, sdf_loader->properties, counter, offset);
+IndigoObject* IndigoSdfLoader::next()
+{
+    return _parser.next([this](long long& end_offset) {
+        IndigoObject* object = _readNext();
+        end_offset = sdf_loader->tell();
+        return object;
+    });
 }
 
 IndigoObject* IndigoSdfLoader::at(int index)
 {
+    _parser.clear();
+    sdf_loader->setRandomAccess(true);
     sdf_loader->readAt(index);
 
-    return new IndigoRdfMolecule(sdf_loader->data, sdf_loader->properties, index, 0LL);
+    return new IndigoRdfMolecule(sdf_loader->data, index, 0LL);
+}
+
+int IndigoSdfLoader::count()
+{
+    int res = sdf_loader->count();
+    _index.save(sdf_loader->offsets(), sdf_loader->maxOffset());
+    return res;
 }
 
 bool IndigoSdfLoader::hasNext()
 {
-    return !sdf_loader->isEOF();
+    return !_parser.empty() || !sdf_loader->isEOF();
 }
 
 long long IndigoSdfLoader::tell()
 {
+    if (!_parser.empty())
+        return _parser.tell();
     return sdf_loader->tell();
 }
 
 IndigoRdfLoader::IndigoRdfLoader(Scanner& scanner) : IndigoObject(RDF_LOADER)
 {
     rdf_loader = std::make_unique<RdfLoader>(scanner);
+    rdf_loader->setDecompressionThreads(indigoGetInstance().iteration_threads);
 }
 
 IndigoRdfLoader::IndigoRdfLoader(const char* filename) : IndigoObject(RDF_LOADER)
 {
-    _own_scanner = std::make_unique<FileScanner>(indigoGetInstance().filename_encoding, filename);
+    _own_scanner = MappedFileScanner::open(indigoGetInstance().filename_encoding, filename);
     rdf_loader = std::make_unique<RdfLoader>(*_own_scanner);
+    rdf_loader->setDecompressionThreads(indigoGetInstance().iteration_threads);
+
+    Array<long long> offsets;
+    long long end_offset;
+    _index.open(filename, *_own_scanner);
+    if (_index.load(offsets, end_offset))
+        rdf_loader->setOffsets(offsets, end_offset);
+    // Records are read at saved offsets
+    rdf_loader->setRandomAccess(indigoGetInstance().iteration_offset_index);
 }
 
 IndigoRdfLoader::~IndigoRdfLoader()
@@ -292,7 +656,10 @@ IndigoRdfLoader::~IndigoRdfLoader()
 IndigoObject* IndigoRdfLoader::next()
 {
     if (rdf_loader->isEOF())
+    {
+        _index.save(rdf_loader->offsets(), rdf_loader->maxOffset());
         return 0;
+    }
 
     int counter = rdf_loader->currentNumber();
     long long offset = rdf_loader->tell();
@@ -307,6 +674,7 @@ IndigoObject* IndigoRdfLoader::next()
 
 IndigoObject* IndigoRdfLoader::at(int index)
 {
+    rdf_loader->setRandomAccess(true);
     rdf_loader->readAt(index);
 
     if (rdf_loader->isMolecule())
@@ -315,6 +683,13 @@ IndigoObject* IndigoRdfLoader::at(int index)
         return new IndigoRdfReaction(rdf_loader->data, rdf_loader->properties, index, 0LL);
 }
 
+int IndigoRdfLoader::count()
+{
+    int res = rdf_loader->count();
+    _index.save(rdf_loader->offsets(), rdf_loader->maxOffset());
+    return res;
+}
+
 long long IndigoRdfLoader::tell()
 {
     return rdf_loader->tell();
@@ -423,12 +798,15 @@ IndigoMultilineSmilesLoader::IndigoMultilineSmilesLoader(Scanner& scanner) : Ind
 
 IndigoMultilineSmilesLoader::IndigoMultilineSmilesLoader(const char* filename) : IndigoObject(MULTILINE_SMILES_LOADER), CP_INIT, TL_CP_GET(_offsets)
 {
-    _own_scanner = std::make_unique<FileScanner>(indigoGetInstance().filename_encoding, filename);
+    _own_scanner = MappedFileScanner::open(indigoGetInstance().filename_encoding, filename);
     _scanner = _own_scanner.get();
 
     _current_number = 0;
     _max_offset = 0LL;
     _offsets.clear();
+
+    _index.open(filename, *_own_scanner);
+    _index.load(_offsets, _max_offset);
 }
 
 IndigoMultilineSmilesLoader::~IndigoMultilineSmilesLoader()
@@ -445,10 +823,13 @@ void IndigoMultilineSmilesLoader::_advance()
         _max_offset = _scanner->tell();
 }
 
-IndigoObject* IndigoMultilineSmilesLoader::next()
+IndigoObject* IndigoMultilineSmilesLoader::_readNext()
 {
     if (_scanner->isEOF())
+    {
+        _index.save(_offsets, _max_offset);
         return 0;
+    }
 
     long long offset = _scanner->tell();
     int counter = _current_number;
@@ -461,13 +842,24 @@ IndigoObject* IndigoMultilineSmilesLoader::next()
         return new IndigoSmilesReaction(_str, counter, offset);
 }
 
+IndigoObject* IndigoMultilineSmilesLoader::next()
+{
+    return _parser.next([this](long long& end_offset) {
+        IndigoObject* object = _readNext();
+        end_offset = _scanner->tell();
+        return object;
+    });
+}
+
 bool IndigoMultilineSmilesLoader::hasNext()
 {
-    return !_scanner->isEOF();
+    return !_parser.empty() || !_scanner->isEOF();
 }
 
 long long IndigoMultilineSmilesLoader::tell()
 {
+    if (!_parser.empty())
+        return _parser.tell();
     return _scanner->tell();
 }
 
@@ -493,22 +885,24 @@ int IndigoMultilineSmilesLoader::count()
         _current_number = cn;
     }
 
+    _index.save(_offsets, _max_offset);
     return res;
 }
 
 IndigoObject* IndigoMultilineSmilesLoader::at(int index)
 {
+    _parser.clear();
     if (index < _offsets.size())
     {
         _scanner->seek(_offsets[index], SEEK_SET);
         _current_number = index;
-        return next();
+        return _readNext();
     }
     _scanner->seek(_max_offset, SEEK_SET);
     _current_number = _offsets.size();
     while (index > _offsets.size())
         _advance();
-    return next();
+    return _readNext();
 }
 
 CEXPORT int indigoIterateSDF(int reader)
@@ -741,7 +1135,7 @@ IndigoMultipleCmlLoader::IndigoMultipleCmlLoader(Scanner& scanner) : IndigoObjec
 
 IndigoMultipleCmlLoader::IndigoMultipleCmlLoader(const char* filename) : IndigoObject(MULTIPLE_CML_LOADER)
 {
-    _own_scanner = std::make_unique<FileScanner>(filename);
+    _own_scanner = MappedFileScanner::open(ENCODING_ASCII, filename);
     loader = std::make_unique<MultipleCmlLoader>(*_own_scanner);
 }
 
@@ -893,7 +1287,7 @@ IndigoMultipleCdxLoader::IndigoMultipleCdxLoader(Scanner& scanner) : IndigoObjec
 
 IndigoMultipleCdxLoader::IndigoMultipleCdxLoader(const char* filename) : IndigoObject(MULTIPLE_CDX_LOADER)
 {
-    _own_scanner = std::make_unique<FileScanner>(filename);
+    _own_scanner = MappedFileScanner::open(ENCODING_ASCII, filename);
     loader = std::make_unique<MultipleCdxLoader>(*_own_scanner);
 }
 
@@ -21,12 +21,18 @@
 
 #include "indigo_internal.h"
 
+#include <deque>
+#include <exception>
+#include <functional>
+#include <string>
+
 #include <rapidjson/document.h>
 
 #include "base_cpp/properties_map.h"
 #include "molecule/molecule.h"
 #include "molecule/molecule_json_loader.h"
 #include "molecule/query_molecule.h"
+#include "molecule/sdf_loader.h"
 #include "reaction/reaction.h"
 
 class IndigoRdfData : public IndigoObject
@@ -34,22 +40,34 @@ class IndigoRdfData : public IndigoObject
 public:
     IndigoRdfData(int type, Array<char>& data, int index, long long offset);
     IndigoRdfData(int type, Array<char>& data, PropertiesMap& properties, int index, long long offset);
+    // SDF record with the data items in its text. The record is copied unless
+    // the source is given: then it stays in the source buffer, which the
+    // object keeps alive, until the raw data is requested
+    IndigoRdfData(int type, const SdfRecord& record, const std::shared_ptr<Scanner>& source, int index, long long offset);
     ~IndigoRdfData() override;
 
     Array<char>& getRawData();
     //   RedBlackStringObjMap< Array<char> > * getProperties () override {return &_properties.getProperties();}
-    PropertiesMap& getProperties() override
-    {
-        return _properties;
-    }
+    PropertiesMap& getProperties() override;
+
+    // Look a property up without building the properties map of an SDF record
+    bool hasProperty(const char* name);
+    void getProperty(const char* name, Array<char>& value);
 
     int getIndex() override;
     long long tell();
 
 protected:
+    // Text of the record, in _data or in the source buffer
+    void _getText(const char*& text, int& size);
+
     Array<char> _data;
+    std::shared_ptr<Scanner> _source;
+    SdfRecord _source_record;
 
     PropertiesMap _properties;
+    // The data items of SDF records are parsed from _data when requested
+    bool _properties_in_data;
     bool _loaded;
     int _index;
     long long _offset;
@@ -59,6 +77,9 @@ class IndigoRdfMolecule : public IndigoRdfData
 {
 public:
     IndigoRdfMolecule(Array<char>& data, PropertiesMap& properties, int index, long long offset);
+    // SDF record with the data items in data
+    IndigoRdfMolecule(Array<char>& data, int index, long long offset);
+    IndigoRdfMolecule(const SdfRecord& record, const std::shared_ptr<Scanner>& source, int index, long long offset);
     ~IndigoRdfMolecule() override;
 
     Molecule& getMolecule() override;
@@ -85,6 +106,57 @@ protected:
     Reaction _rxn;
 };
 
+// Parses the records of a loader ahead of the caller when the
+// "iteration-threads" option is set. Records are split by the loader in the
+// calling thread in batches, and each batch is parsed by a thread pool.
+// Records that fail to parse are returned as is, so the error is raised on
+// access like in the serial iteration.
+class IndigoParallelParser
+{
+public:
+    // Reads the next unparsed record and the offset after it; returns nullptr at the end
+    typedef std::function<IndigoObject*(long long& end_offset)> ReadFunc;
+
+    IndigoObject* next(const ReadFunc& read);
+    bool empty() const;
+    void clear();
+
+    // Offset after the last returned record
+    long long tell() const;
+
+protected:
+    struct Record
+    {
+        std::unique_ptr<IndigoObject> object;
+        long long end_offset;
+    };
+
+    void _parseBatch(const ReadFunc& read, int threads, bool ordered);
+
+    std::deque<Record> _ready;
+    long long _last_offset = 0;
+    // Reading error that happened after some records of the batch were read
+    std::exception_ptr _error;
+};
+
+// Sidecar file "<filename>.offsets" with the record offsets of an iterated
+// file. It is used when the "iteration-offset-index" option is enabled: the
+// offsets are loaded when the file is opened and saved after its first full
+// scan, so random access does not have to read the preceding records.
+class IndigoOffsetIndexFile
+{
+public:
+    void open(const char* filename, Scanner& source);
+    bool load(Array<long long>& offsets, long long& end_offset);
+    void save(const Array<long long>& offsets, long long end_offset);
+
+protected:
+    std::string _path;
+    std::string _source_path;
+    Scanner* _source = nullptr;
+    bool _saved = false;
+};
+
 class IndigoSdfLoader : public IndigoObject
 {
 public:
@@ -95,10 +167,16 @@ public:
     bool hasNext() override;
     IndigoObject* at(int index);
     long long tell();
+    int count();
     std::unique_ptr<SdfLoader> sdf_loader;
 
 protected:
-    std::unique_ptr<Scanner> _own_scanner;
+    IndigoObject* _readNext();
+
+    // Shared with the records of a mapped file
+    std::shared_ptr<Scanner> _own_scanner;
+    IndigoParallelParser _parser;
+    IndigoOffsetIndexFile _index;
 };
 
 /*
@@ -130,11 +208,13 @@ public:
     IndigoObject* at(int index);
 
     long long tell();
+    int count();
 
     std::unique_ptr<RdfLoader> rdf_loader;
 
 protected:
     std::unique_ptr<Scanner> _own_scanner;
+    IndigoOffsetIndexFile _index;
 };
 
 class IndigoJSONMolecule : public IndigoObject
@@ -202,8 +282,11 @@ protected:
     Scanner* _scanner;
     Array<char> _str;
     std::unique_ptr<Scanner> _own_scanner;
+    IndigoParallelParser _parser;
+    IndigoOffsetIndexFile _index;
 
     void _advance();
+    IndigoObject* _readNext();
 
     CP_DECL;
     TL_CP_DECL(Array<long long>, _offsets);
@@ -787,7 +787,11 @@ IndigoMoleculeSubstructureMatcher& IndigoMoleculeSubstructureMatcher::cast(Indig
 
 IndigoMoleculeSubstructureMatchIter* IndigoMoleculeSubstructureMatcher::getMatchIterator(Indigo& self, int query, bool for_iteration, int max_embeddings)
 {
-    return iterateQueryMatches(self.getObject(query), self.embedding_edges_uniqueness, self.find_unique_embeddings, for_iteration, max_embeddings);
+    IndigoMoleculeSubstructureMatchIter* iter =
+        iterateQueryMatches(self.getObject(query), self.embedding_edges_uniqueness, self.find_unique_embeddings, for_iteration, max_embeddings);
+
+    iter->matcher.use_candidate_domains = self.match_candidate_domains;
+    return iter;
 }
 
 IndigoTautomerSubstructureMatchIter* IndigoMoleculeSubstructureMatcher::getTautomerMatchIterator(Indigo& self, int query, bool for_iteration,
@@ -874,6 +878,7 @@ CEXPORT int indigoMatch(int target_matcher, int query)
                 std::unique_ptr<IndigoMoleculeSubstructureMatchIter> match_iter(matcher.getMatchIterator(self, query, false, 1));
 
                 match_iter->matcher.find_unique_embeddings = false;
+                match_iter->matcher.parallel_threads = self.match_threads;
 
                 if (!match_iter->hasNext())
                     return 0;
@@ -966,6 +971,7 @@ CEXPORT int indigoCountMatchesWithLimit(int target_matcher, int query, int embed
 
             std::unique_ptr<IndigoMoleculeSubstructureMatchIter> match_iter(matcher.getMatchIterator(self, query, false, self.max_embeddings));
 
+            match_iter->matcher.parallel_threads = self.match_threads;
             return match_iter->countMatches(embeddings_limit);
         }
         if (obj.type == IndigoObject::REACTION_SUBSTRUCTURE_MATCHER)
@@ -0,0 +1,262 @@
+/****************************************************************************
+ * Copyright (C) from 2009 to Present EPAM Systems.
+ *
+ * This file is part of Indigo toolkit.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ***************************************************************************/
+
+#include "indigo_object_table.h"
+#include "indigo_internal.h"
+
+#include <mutex>
+#include <unordered_map>
+
+namespace
+{
+    std::atomic<uint64_t> table_serial{1};
+
+    // Live tables by serial, to return cached slots when a thread switches
+    // to another table or exits. Used only on these rare paths.
+    std::mutex registry_lock;
+    std::unordered_map<uint64_t, IndigoObjectTable*>& registry()
+    {
+        static std::unordered_map<uint64_t, IndigoObjectTable*> tables;
+        return tables;
+    }
+}
+
+// Slots freed by this thread, reused first by its next allocations.
+// The cache belongs to one table at a time.
+struct IndigoObjectTable::FreeSlotCache
+{
+    enum
+    {
+        SIZE = 64
+    };
+
+    ~FreeSlotCache()
+    {
+        flush();
+    }
+
+    void flush()
+    {
+        if (count == 0)
+            return;
+
+        std::lock_guard<std::mutex> lock(registry_lock);
+        auto it = registry().find(serial);
+        if (it != registry().end())
+            for (int i = 0; i < count; i++)
+                it->second->_push(it->second->_free_head, indices[i]);
+        count = 0;
+    }
+
+    uint64_t serial = 0;
+    int count = 0;
+    uint32_t indices[SIZE];
+};
+
+static thread_local IndigoObjectTable::FreeSlotCache free_slot_cache;
+
+IndigoObjectTable::IndigoObjectTable() : _next_index(1), _free_head(0), _retired_head(0), _count(0), _serial(table_serial.fetch_add(1))
+{
+    for (auto& page : _pages)
+        page.store(nullptr, std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> lock(registry_lock);
+    registry()[_serial] = this;
+}
+
+IndigoObjectTable::~IndigoObjectTable()
+{
+    {
+        std::lock_guard<std::mutex> lock(registry_lock);
+        registry().erase(_serial);
+    }
+
+    clear();
+    for (auto& page : _pages)
+        delete[] page.load(std::memory_order_relaxed);
+}
+
+const IndigoObjectTable::Slot* IndigoObjectTable::_findSlot(uint32_t index) const
+{
+    const Slot* page = _pages[index >> PAGE_BITS].load(std::memory_order_acquire);
+    if (page == nullptr)
+        return nullptr;
+    return page + (index & (PAGE_SIZE - 1));
+}
+
+IndigoObjectTable::Slot& IndigoObjectTable::_getSlot(uint32_t index)
+{
+    std::atomic<Slot*>& entry = _pages[index >> PAGE_BITS];
+    Slot* page = entry.load(std::memory_order_acquire);
+    if (page == nullptr)
+    {
+        Slot* new_page = new Slot[PAGE_SIZE];
+        if (entry.compare_exchange_strong(page, new_page, std::memory_order_acq_rel))
+            page = new_page;
+        else
+            delete[] new_page;
+    }
+    return page[index & (PAGE_SIZE - 1)];
+}
+
+int IndigoObjectTable::_handle(uint32_t index, const Slot& slot)
+{
+    return (int)(((slot.generation.load(std::memory_order_relaxed) & GENERATION_MASK) << INDEX_BITS) | index);
+}
+
+uint32_t IndigoObjectTable::_pop(std::atomic<uint64_t>& stack)
+{
+    uint64_t head = stack.load(std::memory_order_acquire);
+    while ((uint32_t)head != 0)
+    {
+        uint32_t index = (uint32_t)head;
+        uint64_t next = ((head >> 32) + 1) << 32 | _findSlot(index)->next_free.load(std::memory_order_relaxed);
+        if (stack.compare_exchange_weak(head, next, std::memory_order_acq_rel, std::memory_order_acquire))
+            return index;
+    }
+    return 0;
+}
+
+void IndigoObjectTable::_push(std::atomic<uint64_t>& stack, uint32_t index)
+{
+    Slot& slot = _getSlot(index);
+    uint64_t head = stack.load(std::memory_order_relaxed);
+    uint64_t next;
+    do
+    {
+        slot.next_free.store((uint32_t)head, std::memory_order_relaxed);
+        next = ((head >> 32) + 1) << 32 | index;
+    } while (!stack.compare_exchange_weak(head, next, std::memory_order_release, std::memory_order_relaxed));
+}
+
+uint32_t IndigoObjectTable::_allocateIndex()
+{
+    FreeSlotCache& cache = free_slot_cache;
+    if (cache.serial == _serial && cache.count > 0)
+        return cache.indices[--cache.count];
+
+    uint32_t index = _pop(_free_head);
+    if (index != 0)
+        return index;
+
+    if (_next_index.load(std::memory_order_relaxed) <= INDEX_MASK)
+    {
+        index = _next_index.fetch_add(1, std::memory_order_acq_rel);
+        if (index <= INDEX_MASK)
+            return index;
+    }
+
+    // Handles of the retired slots may be matched again only from here on
+    index = _pop(_retired_head);
+    if (index == 0)
+        throw IndigoError("too many objects: %d", _count.load());
+    return index;
+}
+
+void IndigoObjectTable::_freeIndex(uint32_t index, uint32_t generation)
+{
+    // Generations in handles repeat after this, so the slot is put aside
+    if ((generation & GENERATION_MASK) == 0)
+    {
+        _push(_retired_head, index);
+        return;
+    }
+
+    FreeSlotCache& cache = free_slot_cache;
+    if (cache.serial != _serial)
+    {
+        cache.flush();
+        cache.serial = _serial;
+    }
+
+    if (cache.count < FreeSlotCache::SIZE)
+        cache.indices[cache.count++] = index;
+    else
+        _push(_free_head, index);
+}
+
+int IndigoObjectTable::add(std::unique_ptr<IndigoObject>&& obj)
+{
+    uint32_t index = _allocateIndex();
+    Slot& slot = _getSlot(index);
+    slot.object.store(obj.release(), std::memory_order_release);
+    _count.fetch_add(1, std::memory_order_relaxed);
+    return _handle(index, slot);
+}
+
+IndigoObject* IndigoObjectTable::get(int handle) const
+{
+    if (handle <= 0)
+        return nullptr;
+
+    const Slot* slot = _findSlot(handle & INDEX_MASK);
+    if (slot == nullptr)
+        return nullptr;
+
+    IndigoObject* obj = slot->object.load(std::memory_order_acquire);
+    if (obj == nullptr || (slot->generation.load(std::memory_order_acquire) & GENERATION_MASK) != ((uint32_t)handle >> INDEX_BITS))
+        return nullptr;
+    return obj;
+}
+
+void IndigoObjectTable::remove(int handle)
+{
+    IndigoObject* obj = get(handle);
+    if (obj == nullptr)
+        return;
+
+    // Only the thread that takes the object out of the slot deletes it
+    uint32_t index = handle & INDEX_MASK;
+    Slot& slot = _getSlot(index);
+    if (!slot.object.compare_exchange_strong(obj, nullptr, std::memory_order_acq_rel))
+        return;
+
+    // The slot is reused only after the generation is changed
+    uint32_t generation = slot.generation.fetch_add(1, std::memory_order_release) + 1;
+    _count.fetch_sub(1, std::memory_order_relaxed);
+    delete obj;
+    _freeIndex(index, generation);
+}
+
+void IndigoObjectTable::clear()
+{
+    uint32_t end = std::min(_next_index.load(std::memory_order_acquire), (uint32_t)INDEX_MASK + 1);
+    for (uint32_t index = 1; index < end; index++)
+    {
+        const Slot* found = _findSlot(index);
+        if (found == nullptr || found->object.load(std::memory_order_acquire) == nullptr)
+            continue;
+
+        Slot& slot = _getSlot(index);
+        IndigoObject* obj = slot.object.exchange(nullptr, std::memory_order_acq_rel);
+        if (obj == nullptr)
+            continue;
+        uint32_t generation = slot.generation.fetch_add(1, std::memory_order_release) + 1;
+        _count.fetch_sub(1, std::memory_order_relaxed);
+        delete obj;
+        if ((generation & GENERATION_MASK) == 0)
+            _push(_retired_head, index);
+        else
+            _push(_free_head, index);
+    }
+}
+
+int IndigoObjectTable::count() const
+{
+    return _count.load(std::memory_order_relaxed);
+}
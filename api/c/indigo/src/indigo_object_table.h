@@ -0,0 +1,101 @@
+/****************************************************************************
+ * Copyright (C) from 2009 to Present EPAM Systems.
+ *
+ * This file is part of Indigo toolkit.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ***************************************************************************/
+
+#ifndef __indigo_object_table__
+#define __indigo_object_table__
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+class IndigoObject;
+
+// Table of the objects of an Indigo session, addressed by int handles.
+// Slots are kept in pages that are never moved or freed while the table
+// exists, so lookup takes only atomic loads. A handle holds the slot index
+// and the generation of the slot, which changes when the object is removed,
+// so handles of removed objects are not resolved to objects that reuse the
+// slot. Freed slots go to a small per-thread cache first and to a lock-free
+// stack shared by all threads after that. A slot is retired when its
+// generation wraps around, and retired slots are reused only when no other
+// index is left.
+class IndigoObjectTable
+{
+public:
+    IndigoObjectTable();
+    ~IndigoObjectTable();
+
+    int add(std::unique_ptr<IndigoObject>&& obj);
+    // Returns nullptr if there is no such object
+    IndigoObject* get(int handle) const;
+    void remove(int handle);
+    void clear();
+    int count() const;
+
+    struct FreeSlotCache;
+
+    template <typename Func> void forEach(Func func) const
+    {
+        for (uint32_t index = 1; index < _next_index.load(std::memory_order_acquire) && index <= INDEX_MASK; index++)
+        {
+            const Slot* slot = _findSlot(index);
+            if (slot != nullptr && slot->object.load(std::memory_order_acquire) != nullptr)
+                func(_handle(index, *slot));
+        }
+    }
+
+private:
+    enum : uint32_t
+    {
+        INDEX_BITS = 24,
+        INDEX_MASK = (1u << INDEX_BITS) - 1,
+        GENERATION_MASK = 0x7F,
+        PAGE_BITS = 12,
+        PAGE_SIZE = 1u << PAGE_BITS,
+        PAGE_COUNT = 1u << (INDEX_BITS - PAGE_BITS)
+    };
+
+    struct Slot
+    {
+        std::atomic<IndigoObject*> object{nullptr};
+        std::atomic<uint32_t> generation{0};
+        std::atomic<uint32_t> next_free{0};
+    };
+
+    const Slot* _findSlot(uint32_t index) const;
+    Slot& _getSlot(uint32_t index);
+    static int _handle(uint32_t index, const Slot& slot);
+
+    uint32_t _allocateIndex();
+    void _freeIndex(uint32_t index, uint32_t generation);
+    uint32_t _pop(std::atomic<uint64_t>& head);
+    void _push(std::atomic<uint64_t>& head, uint32_t index);
+
+    std::atomic<Slot*> _pages[PAGE_COUNT];
+    // Index 0 is not used, so handles are positive
+    std::atomic<uint32_t> _next_index;
+    // Tops of the free and retired slot stacks in the low 32 bits and
+    // counters against the ABA problem in the high 32 bits
+    std::atomic<uint64_t> _free_head;
+    std::atomic<uint64_t> _retired_head;
+    std::atomic<int> _count;
+    // Distinguishes the tables in per-thread caches
+    const uint64_t _serial;
+};
+
+#endif
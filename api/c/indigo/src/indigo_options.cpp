@@ -315,6 +315,12 @@ void IndigoOptionHandlerSetter::setBasicOptionHandlers(const qword id)
 
     mgr->setOptionHandlerInt("aam-timeout", SETTER_GETTER_INT_OPTION(indigo.aam_cancellation_timeout));
     mgr->setOptionHandlerInt("timeout", SETTER_GETTER_INT_OPTION(indigo.cancellation_timeout));
+    mgr->setOptionHandlerInt("iteration-threads", SETTER_GETTER_INT_OPTION(indigo.iteration_threads));
+    mgr->setOptionHandlerBool("iteration-ordered", SETTER_GETTER_BOOL_OPTION(indigo.iteration_ordered));
+    mgr->setOptionHandlerBool("iteration-offset-index", SETTER_GETTER_BOOL_OPTION(indigo.iteration_offset_index));
+    mgr->setOptionHandlerInt("fingerprint-threads", SETTER_GETTER_INT_OPTION(indigo.fingerprint_threads));
+    mgr->setOptionHandlerInt("match-threads", SETTER_GETTER_INT_OPTION(indigo.match_threads));
+    mgr->setOptionHandlerBool("match-candidate-domains", SETTER_GETTER_BOOL_OPTION(indigo.match_candidate_domains));
 
     mgr->setOptionHandlerBool("serialize-preserve-ordering", SETTER_GETTER_BOOL_OPTION(indigo.preserve_ordering_in_serialize));
 
@@ -18,6 +18,7 @@
 
 #include "indigo_properties.h"
 #include "base_cpp/properties_map.h"
+#include "indigo_loaders.h"
 
 CEXPORT int indigoHasProperty(int handle, const char* prop)
 {
@@ -28,6 +29,9 @@ CEXPORT int indigoHasProperty(int handle, const char* prop)
 
         IndigoObject& obj = self.getObject(handle);
 
+        if (obj.type == IndigoObject::RDF_MOLECULE)
+            return ((IndigoRdfData&)obj).hasProperty(prop);
+
         auto& props = obj.getProperties();
 
         return props.contains(prop);
@@ -43,9 +47,15 @@ CEXPORT const char* indigoGetProperty(int handle, const char* prop)
             throw IndigoError("indigoGetProperty(): null or empty property given");
 
         IndigoObject& obj = self.getObject(handle);
-        auto& props = obj.getProperties();
-
         auto& tmp = self.getThreadTmpData();
+
+        if (obj.type == IndigoObject::RDF_MOLECULE)
+        {
+            ((IndigoRdfData&)obj).getProperty(prop, tmp.string);
+            return tmp.string.ptr();
+        }
+
+        auto& props = obj.getProperties();
         tmp.string.readString(props.at(prop), true);
         return tmp.string.ptr();
     }
@@ -18,6 +18,9 @@
 
 #include <gtest/gtest.h>
 
+#include <thread>
+#include <vector>
+
 #include <molecule/molecule_mass.h>
 
 #include <indigo-renderer.h>
@@ -293,3 +296,144 @@ TEST_F(IndigoApiBasicTest, submolecule_test_general)
         ASSERT_STREQ("", e.message());
     }
 }
+
+TEST_F(IndigoApiBasicTest, object_handles)
+{
+    int m = indigoLoadMoleculeFromString("CCO");
+    ASSERT_EQ(3, indigoCountAtoms(m));
+    indigoFree(m);
+    ASSERT_EQ(0, indigoCountReferences());
+
+    // The slot of the freed object is reused, but the old handle is not valid
+    int other = indigoLoadMoleculeFromString("CC");
+    ASSERT_NE(m, other);
+    ASSERT_THROW(indigoCountAtoms(m), Exception);
+    ASSERT_EQ(2, indigoCountAtoms(other));
+
+    // More reuses of one slot than there are generations in a handle
+    int stale = indigoLoadMoleculeFromString("C");
+    indigoFree(stale);
+    for (int i = 0; i < 300; i++)
+    {
+        int reused = indigoLoadMoleculeFromString("C");
+        ASSERT_NE(stale, reused);
+        ASSERT_THROW(indigoCountAtoms(stale), Exception);
+        indigoFree(reused);
+    }
+    ASSERT_EQ(2, indigoCountAtoms(other));
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 8; i++)
+    {
+        threads.emplace_back([this, i]() {
+            indigoSetSessionId(session);
+            std::vector<int> handles;
+            for (int j = 0; j < 1000; j++)
+            {
+                handles.push_back(indigoLoadMoleculeFromString(i % 2 ? "C1CCCCC1" : "CC"));
+                if (j % 3 == 0)
+                {
+                    indigoFree(handles.front());
+                    handles.erase(handles.begin());
+                }
+            }
+            for (int handle : handles)
+            {
+                ASSERT_EQ(i % 2 ? 6 : 2, indigoCountAtoms(handle));
+                indigoFree(handle);
+            }
+        });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    ASSERT_EQ(1, indigoCountReferences());
+
+    indigoFreeAllObjects();
+    ASSERT_EQ(0, indigoCountReferences());
+    ASSERT_THROW(indigoCountAtoms(other), Exception);
+}
+
+TEST_F(IndigoApiBasicTest, parallel_match)
+{
+    // Cyclic peptide with many symmetric embeddings of the queries, and
+    // fullerene, where the searches are long enough to be split
+    const char* targets[] = {"C1C(=O)NC(C)C(=O)NC(CO)C(=O)NC(Cc2ccccc2)C(=O)NC(CC(C)C)C(=O)NC(CS)C(=O)NC(CCCCN)C(=O)NC(C)C(=O)N1",
+                             "c12c3c4c5c1c6c7c8c2c9c1c3c2c3c4c4c%10c5c5c6c6c7c7c%11c8c9c8c9c1c2c1c2c3c4c3c4c%10c5c5c6c6c7c7c%11c8c8c9c1c1c2c3c2c4c5c6c3c7c8c1c23"};
+    const char* queries[] = {"NCC(=O)NCC(=O)", "C(=O)NCC(=O)NCC(=O)NCC(=O)N", "[#6]~[#6]~[#6]", "c1ccccc1C", "NC(CO)C(=O)NC(CCCCN)", "[N;R]", "[#6]~[#6]~[#6]~[#6]~[#6]~[#6]~[#6]", "[#6]1~[#6]~[#6]~[#6]~[#6]~1"};
+
+    for (const char* smiles : targets)
+    {
+        int mol = indigoLoadMoleculeFromString(smiles);
+
+        for (const char* smarts : queries)
+        {
+            int q = indigoLoadSmartsFromString(smarts);
+
+            indigoSetOptionInt("match-threads", 0);
+            int match = indigoSubstructureMatcher(mol, "");
+            int count = indigoCountMatches(match, q);
+            int found = indigoMatch(match, q);
+
+            indigoSetOptionInt("match-threads", 4);
+            int parallel_match = indigoSubstructureMatcher(mol, "");
+            ASSERT_EQ(count, indigoCountMatches(parallel_match, q)) << smarts;
+            ASSERT_EQ(count, indigoCountMatchesWithLimit(parallel_match, q, count));
+            if (count > 1)
+                ASSERT_EQ(count - 1, indigoCountMatchesWithLimit(parallel_match, q, count - 1));
+
+            int parallel_found = indigoMatch(parallel_match, q);
+            ASSERT_EQ(found != 0, parallel_found != 0) << smarts;
+
+            if (parallel_found != 0)
+            {
+                // Every query bond must be mapped to a target bond
+                int bonds = indigoIterateBonds(q);
+                int bond;
+                while ((bond = indigoNext(bonds)))
+                {
+                    ASSERT_NE(0, indigoMapBond(parallel_found, bond)) << smarts;
+                }
+            }
+        }
+    }
+    indigoSetOptionInt("match-threads", 0);
+}
+
+TEST_F(IndigoApiBasicTest, candidate_domains_match)
+{
+    const char* targets[] = {"C1C(=O)NC(C)C(=O)NC(CO)C(=O)NC(Cc2ccccc2)C(=O)NC(CS)C(=O)N1", "OC(=O)c1ccc(Cl)cc1.CCN(CC)CC", "C1CC2CCC1CC2"};
+    const char* queries[] = {"NCC(=O)NCC(=O)", "[#6]~[#6]~[#6]", "c1ccccc1C", "[N;R]", "C(=O)O.N(C)(C)C", "[H]OC", "C1CCCCC1", "C#N", "c1ccncc1", "[Cl]c1ccccc1Br"};
+
+    for (const char* smiles : targets)
+    {
+        int mol = indigoLoadMoleculeFromString(smiles);
+
+        for (const char* smarts : queries)
+        {
+            int q = indigoLoadSmartsFromString(smarts);
+
+            indigoSetOptionBool("match-candidate-domains", false);
+            int match = indigoSubstructureMatcher(mol, "");
+            int count = indigoCountMatches(match, q);
+            int found = indigoMatch(match, q);
+
+            indigoSetOptionBool("match-candidate-domains", true);
+            int domains_match = indigoSubstructureMatcher(mol, "");
+            ASSERT_EQ(count, indigoCountMatches(domains_match, q)) << smiles << " " << smarts;
+            ASSERT_EQ(found != 0, indigoMatch(domains_match, q) != 0) << smiles << " " << smarts;
+
+            int iterated = 0;
+            int matches = indigoIterateMatches(domains_match, q);
+            while (indigoNext(matches))
+                iterated++;
+            ASSERT_EQ(count, iterated) << smiles << " " << smarts;
+
+            indigoSetOptionInt("match-threads", 4);
+            ASSERT_EQ(count, indigoCountMatches(domains_match, q)) << smiles << " " << smarts;
+            indigoSetOptionInt("match-threads", 0);
+        }
+    }
+    indigoSetOptionBool("match-candidate-domains", false);
+}
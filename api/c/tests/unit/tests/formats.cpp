@@ -16,6 +16,10 @@
  * limitations under the License.
  ***************************************************************************/
 
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
 #include <gtest/gtest.h>
 
 #include <molecule/molecule_mass.h>
@@ -282,3 +286,152 @@ TEST_F(IndigoApiFormatsTest, noFile)
         },
         Exception);
 }
+
+TEST_F(IndigoApiFormatsTest, offsetIndex)
+{
+    const string path = "offset_index_test.sdf";
+    const string index_path = path + ".offsets";
+    {
+        ifstream src(dataPath("molecules/resonance/resonance.sdf"), ios::binary);
+        ofstream dst(path, ios::binary);
+        dst << src.rdbuf();
+    }
+    remove(index_path.c_str());
+
+    try
+    {
+        indigoSetOption("iteration-offset-index", "true");
+
+        vector<string> records;
+        int loader = indigoIterateSDFile(path.c_str());
+        int item;
+        while ((item = indigoNext(loader)) != 0)
+        {
+            records.push_back(indigoRawData(item));
+            indigoFree(item);
+        }
+        indigoFree(loader);
+        ASSERT_TRUE(ifstream(index_path).good());
+
+        // The saved index gives random access and the count without a scan
+        loader = indigoIterateSDFile(path.c_str());
+        item = indigoAt(loader, (int)records.size() - 1);
+        EXPECT_STREQ(records.back().c_str(), indigoRawData(item));
+        item = indigoAt(loader, 3);
+        EXPECT_STREQ(records[3].c_str(), indigoRawData(item));
+        EXPECT_EQ((int)records.size(), indigoCount(loader));
+        indigoFree(loader);
+
+        // The index of a modified file is ignored
+        {
+            ofstream dst(path, ios::binary | ios::app);
+            dst << "\n  -INDIGO-\n\n  1  0  0  0  0  0  0  0  0  0999 V2000\n"
+                   "    0.0000    0.0000    0.0000 C   0  0  0  0  0  0  0  0  0  0  0  0\nM  END\n$$$$\n";
+        }
+        loader = indigoIterateSDFile(path.c_str());
+        EXPECT_EQ((int)records.size() + 1, indigoCount(loader));
+        item = indigoAt(loader, (int)records.size());
+        EXPECT_EQ(1, indigoCountAtoms(item));
+        indigoFree(loader);
+    }
+    catch (Exception& e)
+    {
+        ASSERT_STREQ("", e.message());
+    }
+    remove(path.c_str());
+    remove(index_path.c_str());
+}
+
+TEST_F(IndigoApiFormatsTest, sdfProperties)
+{
+    const char sdf[] = "\n  -INDIGO-\n\n  1  0  0  0  0  0  0  0  0  0999 V2000\n"
+                       "    0.0000    0.0000    0.0000 C   0  0  0  0  0  0  0  0  0  0  0  0\nM  END\n"
+                       ">  <NAME>\nmethane\n\n"
+                       ">  <NOTE>  (1)\nfirst line\nsecond line\n\n"
+                       ">  <NAME>\nmarsh gas\n\n"
+                       "$$$$\n";
+    try
+    {
+        int reader = indigoLoadString(sdf);
+        int loader = indigoIterateSDF(reader);
+        int item = indigoNext(loader);
+        ASSERT_NE(0, item);
+
+        // Single lookups read the record data, the last item of a name wins
+        EXPECT_EQ(1, indigoHasProperty(item, "NAME"));
+        EXPECT_EQ(0, indigoHasProperty(item, "MASS"));
+        EXPECT_STREQ("marsh gas", indigoGetProperty(item, "NAME"));
+        EXPECT_STREQ("first line\nsecond line", indigoGetProperty(item, "NOTE"));
+        EXPECT_THROW(indigoGetProperty(item, "MASS"), Exception);
+
+        vector<string> names;
+        int props = indigoIterateProperties(item);
+        int prop;
+        while ((prop = indigoNext(props)) != 0)
+        {
+            names.push_back(indigoName(prop));
+            indigoFree(prop);
+        }
+        indigoFree(props);
+        EXPECT_EQ((vector<string>{"NAME", "NOTE"}), names);
+        EXPECT_STREQ("marsh gas", indigoGetProperty(item, "NAME"));
+
+        // The record data keeps the data items as they are in the file
+        EXPECT_NE(nullptr, strstr(indigoRawData(item), ">  <NOTE>  (1)"));
+        indigoFree(item);
+        indigoFree(loader);
+        indigoFree(reader);
+    }
+    catch (Exception& e)
+    {
+        ASSERT_STREQ("", e.message());
+    }
+}
+
+TEST_F(IndigoApiFormatsTest, sdfFileRecords)
+{
+    const string path = "sdf_file_records_test.sdf";
+    const string record = "\r\n  -INDIGO-\r\n\r\n  1  0  0  0  0  0  0  0  0  0999 V2000\r\n"
+                          "    0.0000    0.0000    0.0000 C   0  0  0  0  0  0  0  0  0  0  0  0\r\nM  END\r\n"
+                          ">  <NOTE>\r\nfirst line\r\nsecond line\r\n\r\n"
+                          "$$$$\r\n";
+    const string sdf = record + record;
+    {
+        ofstream dst(path, ios::binary);
+        dst << sdf;
+    }
+
+    try
+    {
+        vector<int> items;
+        int loader = indigoIterateSDFile(path.c_str());
+        int item;
+        while ((item = indigoNext(loader)) != 0)
+            items.push_back(item);
+        indigoFree(loader);
+        ASSERT_EQ(2, (int)items.size());
+
+        // Records of a mapped file stay valid without the iterator
+        int reader = indigoLoadString(sdf.c_str());
+        loader = indigoIterateSDF(reader);
+        for (int file_item : items)
+        {
+            item = indigoNext(loader);
+            ASSERT_NE(0, item);
+            EXPECT_STREQ("", indigoName(file_item));
+            EXPECT_STREQ("first line\nsecond line", indigoGetProperty(file_item, "NOTE"));
+            EXPECT_STREQ(indigoGetProperty(item, "NOTE"), indigoGetProperty(file_item, "NOTE"));
+            EXPECT_EQ(1, indigoCountAtoms(file_item));
+            EXPECT_STREQ(string(indigoRawData(item)).c_str(), indigoRawData(file_item));
+            indigoFree(item);
+            indigoFree(file_item);
+        }
+        indigoFree(loader);
+        indigoFree(reader);
+    }
+    catch (Exception& e)
+    {
+        ASSERT_STREQ("", e.message());
+    }
+    remove(path.c_str());
+}
@@ -18,6 +18,9 @@
 
 #include <gtest/gtest.h>
 
+#include <string>
+#include <vector>
+
 #include <indigo_internal.h>
 
 #include "common.h"
@@ -55,13 +58,7 @@ TEST_F(IndigoSimilarityTest, generate_fingerprints)
             ASSERT_NE(-1, indigoFingerprint(mol, type));
         }
 
-        const char* similarity_type_names[] = {
-            "sim",   "chem", "ecfp2", "ecfp4",
-            "ecfp6", "ecfp8"
-
-            //      TODO: implement FCFP fingerprints
-            //            "fcfp2", "fcfp4", "fcfp6", "fcfp8"
-        };
+        const char* similarity_type_names[] = {"sim", "chem", "ecfp2", "ecfp4", "ecfp6", "ecfp8", "fcfp2", "fcfp4", "fcfp6", "fcfp8"};
 
         for (auto& mode : similarity_type_names)
         {
@@ -220,3 +217,71 @@ TEST_F(IndigoSimilarityTest, similarity_sim_ECFP8_mode)
     EXPECT_GT(0.99, indigoSimilarity(f1, f2, "tanimoto"));
     EXPECT_EQ(1.00, indigoSimilarity(f2, f3, "tanimoto"));
 }
+
+TEST_F(IndigoSimilarityTest, fingerprint_batch)
+{
+    const std::string path = dataPath("molecules/basic/Compound_0000001_0000250.sdf.gz");
+
+    for (const auto& type : {"sim", "sub", "sub-tau"})
+    {
+        // Reference fingerprints built one by one
+        std::vector<std::string> expected;
+        int array = indigoCreateArray();
+        int iter = indigoIterateSDFile(path.c_str());
+        int mol;
+        while ((mol = indigoNext(iter)) > 0)
+        {
+            int fp = indigoFingerprint(mol, type);
+            char* buf;
+            int size;
+            indigoToBuffer(fp, &buf, &size);
+            expected.emplace_back(buf, size);
+            indigoArrayAdd(array, mol);
+            indigoFree(fp);
+            indigoFree(mol);
+        }
+        indigoFree(iter);
+        const int total = (int)expected.size();
+        ASSERT_EQ(245, total);
+
+        for (int threads : {0, 4})
+        {
+            indigoSetOptionInt("fingerprint-threads", threads);
+
+            char* buf;
+            int size;
+            ASSERT_EQ(total, indigoFingerprintBatch(array, type, 0, &buf, &size));
+            ASSERT_EQ(0, size % total);
+            const int fp_size = size / total;
+            for (int i = 0; i < total; i++)
+            {
+                ASSERT_EQ(expected[i], std::string(buf + i * fp_size, fp_size));
+            }
+
+            // Iterators are consumed in parts of at most max_count molecules
+            iter = indigoIterateSDFile(path.c_str());
+            int done = 0;
+            int count;
+            while ((count = indigoFingerprintBatch(iter, type, 100, &buf, &size)) > 0)
+            {
+                ASSERT_EQ(count * fp_size, size);
+                for (int i = 0; i < count; i++)
+                {
+                    ASSERT_EQ(expected[done + i], std::string(buf + i * fp_size, fp_size));
+                }
+                done += count;
+            }
+            ASSERT_EQ(total, done);
+            indigoFree(iter);
+        }
+        indigoFree(array);
+    }
+
+    int reaction = indigoLoadReactionFromString("CC>>CO");
+    int array = indigoCreateArray();
+    indigoArrayAdd(array, m1);
+    indigoArrayAdd(array, reaction);
+    char* buf;
+    int size;
+    ASSERT_THROW(indigoFingerprintBatch(array, "sub", 0, &buf, &size), Exception);
+}
@@ -95,10 +95,10 @@ int BingoNoSQL<target_t, query_t>::insertRecord(const target_t& entity)
 }
 
 template <typename target_t, typename query_t>
-int BingoNoSQL<target_t, query_t>::insertIterator(const IndigoIterator<target_t>& iterator)
+int BingoNoSQL<target_t, query_t>::insertIterator(const IndigoIterator<target_t>& iterator, const std::string& options)
 {
     session->setSessionId();
-    return session->_checkResult(bingoInsertIteratorObj(id, iterator.id()));
+    return session->_checkResult(bingoInsertIteratorObjWithOptions(id, iterator.id(), options.c_str()));
 }
 
 template <typename target_t, typename query_t>
@@ -131,6 +131,21 @@ BingoResultIterator<target_t> BingoNoSQL<target_t, query_t>::searchSim(const tar
     return {session->_checkResult(bingoSearchSim(id, query.id(), min, max, options.c_str())), session};
 }
 
+template <typename target_t, typename query_t>
+BingoResultIterator<target_t> BingoNoSQL<target_t, query_t>::searchSimBatch(const std::vector<target_t>& queries, const double min, const double max,
+                                                                            const IndigoSimilarityMetric metric) const
+{
+    session->setSessionId();
+    const int query_arr = session->_checkResult(indigoCreateArray());
+    for (const auto& query : queries)
+    {
+        session->_checkResult(indigoArrayAdd(query_arr, query.id()));
+    }
+    const int search_id = bingoSearchSimBatch(id, query_arr, min, max, to_string(metric));
+    indigoFree(query_arr);
+    return {session->_checkResult(search_id), session};
+}
+
 template <typename target_t, typename query_t>
 std::string BingoNoSQL<target_t, query_t>::getStatistics(bool for_session) const
 {
@@ -25,6 +25,7 @@
 #include "IndigoSimilarityMetric.h"
 
 #include <string>
+#include <vector>
 
 namespace indigo_cpp
 {
@@ -49,7 +50,7 @@ namespace indigo_cpp
         void close();
 
         int insertRecord(const target_t& entity);
-        int insertIterator(const IndigoIterator<target_t>& iterator);
+        int insertIterator(const IndigoIterator<target_t>& iterator, const std::string& options = "");
         void deleteRecord(int recordId);
 
         BingoResultIterator<target_t> searchSub(const query_t& query, const std::string& options = "") const;
@@ -57,6 +58,8 @@ namespace indigo_cpp
         BingoResultIterator<target_t> searchSim(const target_t& query, double min, double max = 1.0,
                                                 IndigoSimilarityMetric metric = IndigoSimilarityMetric::TANIMOTO) const;
         BingoResultIterator<target_t> searchSim(const target_t& query, const double min, const double max, const std::string& options = "") const;
+        BingoResultIterator<target_t> searchSimBatch(const std::vector<target_t>& queries, double min, double max = 1.0,
+                                                     IndigoSimilarityMetric metric = IndigoSimilarityMetric::TANIMOTO) const;
 
         IndigoSessionPtr session;
 
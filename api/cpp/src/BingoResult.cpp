@@ -42,6 +42,22 @@ double BingoResult<target_t>::getSimilarityValue() const
     return session->_checkResultFloat(bingoGetCurrentSimilarityValue(id));
 }
 
+template <typename target_t>
+int BingoResult<target_t>::getQueryIndex() const
+{
+    session->setSessionId();
+    return session->_checkResult(bingoGetCurrentQueryIndex(id));
+}
+
+template <typename target_t>
+std::vector<int> BingoResult<target_t>::getMapping() const
+{
+    session->setSessionId();
+    std::vector<int> mapping(session->_checkResult(bingoGetCurrentMapping(id, nullptr, 0)));
+    session->_checkResult(bingoGetCurrentMapping(id, mapping.data(), (int)mapping.size()));
+    return mapping;
+}
+
 template <typename target_t>
 target_t BingoResult<target_t>::getTarget()
 {
@@ -21,6 +21,7 @@
 #include "IndigoSession.h"
 
 #include <string>
+#include <vector>
 
 namespace indigo_cpp
 {
@@ -34,6 +35,11 @@ namespace indigo_cpp
 
         double getSimilarityValue() const;
 
+        int getQueryIndex() const;
+
+        // Query atom index for every atom of the target of a substructure search result
+        std::vector<int> getMapping() const;
+
         target_t getTarget();
 
     private:
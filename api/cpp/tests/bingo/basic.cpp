@@ -18,7 +18,15 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <utility>
+#include <vector>
+
 #include <BingoNoSQL.h>
+#include <bingo-nosql.h>
+#include <IndigoException.h>
 #include <IndigoIterator.h>
 #include <IndigoSession.h>
 
@@ -26,6 +34,70 @@
 
 using namespace indigo_cpp;
 
+namespace
+{
+    // Checks that a batch search returns exactly what separate searches return, grouped by query
+    void testSearchSimBatch(const BingoMolecule& bingo, const std::vector<IndigoMolecule>& queries, double min)
+    {
+        std::vector<std::vector<int>> expected(queries.size());
+        for (size_t i = 0; i < queries.size(); i++)
+        {
+            for (const auto& result : bingo.searchSim(queries[i], min))
+            {
+                expected[i].push_back(result.getId());
+            }
+            std::sort(expected[i].begin(), expected[i].end());
+        }
+
+        std::vector<std::vector<int>> actual(queries.size());
+        int last_query_index = 0;
+        for (const auto& result : bingo.searchSimBatch(queries, min))
+        {
+            const auto query_index = result.getQueryIndex();
+            ASSERT_GE(query_index, last_query_index);
+            ASSERT_LT(query_index, static_cast<int>(queries.size()));
+            EXPECT_GE(result.getSimilarityValue(), min);
+            actual[query_index].push_back(result.getId());
+            last_query_index = query_index;
+        }
+        for (auto& ids : actual)
+        {
+            std::sort(ids.begin(), ids.end());
+        }
+
+        EXPECT_EQ(expected, actual);
+    }
+
+    // Checks that substructure search over compressed fingerprints returns what the plain storage returns
+    void testSearchSubCompressed(const std::string& options)
+    {
+        auto session = IndigoSession::create();
+        const TemporaryDirectory temp;
+        auto bingo = BingoMolecule::createDatabaseFile(session, temp.path("test.db"), options);
+        auto bingo_compressed = BingoMolecule::createDatabaseFile(session, temp.path("test_compressed.db"), options + ";sub_compression:true");
+
+        bingo.insertIterator(session->iterateSmilesFile(dataPath("molecules/basic/pubchem_slice_5000.smi")), "threads:4");
+        bingo_compressed.insertIterator(session->iterateSmilesFile(dataPath("molecules/basic/pubchem_slice_5000.smi")), "threads:4");
+
+        for (const auto& item : {"C1=CC=CC=C1", "OC(=O)C1=CC=CC=C1", "CN1C=NC2=C1C(=O)N(C)C(=O)N2C", "[Br]", "C1CC2CCC1C2"})
+        {
+            const auto query = session->loadQueryMolecule(item);
+            std::vector<int> expected;
+            for (const auto& result : bingo.searchSub(query))
+            {
+                expected.push_back(result.getId());
+            }
+            std::vector<int> actual;
+            for (const auto& result : bingo_compressed.searchSub(query))
+            {
+                actual.push_back(result.getId());
+            }
+            EXPECT_FALSE(expected.empty());
+            EXPECT_EQ(expected, actual);
+        }
+    }
+}
+
 TEST(Bingo, Create)
 {
     auto session = IndigoSession::create();
@@ -121,6 +193,306 @@ TEST(Bingo, SearchSim)
     }
 }
 
+TEST(Bingo, SearchSimBatch)
+{
+    auto session = IndigoSession::create();
+    auto bingo = BingoMolecule::createDatabaseFile(session, "test.db");
+
+    for (const auto& item : {"C1=CC=CC=C1", "C1=CN=CC=C1", "CC1=CC=CC=C1", "CCO", "CCCO"})
+    {
+        bingo.insertRecord(session->loadMolecule(item));
+    }
+
+    std::vector<IndigoMolecule> queries;
+    for (const auto& item : {"C1=CC=CC=C1", "CCO", "N#N"})
+    {
+        queries.push_back(session->loadMolecule(item));
+    }
+    testSearchSimBatch(bingo, queries, 0.3);
+}
+
+TEST(Bingo, SearchSimBatchLargeBase)
+{
+    auto session = IndigoSession::create();
+    auto bingo = BingoMolecule::createDatabaseFile(session, "test.db");
+
+    // More records than fit into the small base, so the fingerprint table is built
+    for (auto i = 0; i < 3; i++)
+    {
+        bingo.insertIterator(session->iterateSmilesFile(dataPath("molecules/basic/pubchem_slice_5000.smi")));
+    }
+
+    std::vector<IndigoMolecule> queries;
+    for (const auto& item : {"C1=CC=CC=C1", "OC(=O)C1=CC=CC=C1", "CN1C=NC2=C1C(=O)N(C)C(=O)N2C", "CCCCCCCC"})
+    {
+        queries.push_back(session->loadMolecule(item));
+    }
+    testSearchSimBatch(bingo, queries, 0.5);
+}
+
+TEST(Bingo, BulkLoadSim)
+{
+    const TemporaryDirectory temp;
+    const auto bulk_path = temp.path("bulk_load.smi");
+
+    // The bulk load builds the fingerprint table only for more records than fit into the small base
+    {
+        std::ifstream slice(dataPath("molecules/basic/pubchem_slice_5000.smi"));
+        std::stringstream slice_data;
+        slice_data << slice.rdbuf();
+        std::ofstream bulk_file(bulk_path);
+        for (auto i = 0; i < 3; i++)
+        {
+            bulk_file << slice_data.str();
+        }
+    }
+
+    auto session = IndigoSession::create();
+    auto bingo = BingoMolecule::createDatabaseFile(session, temp.path("test.db"), "mt_size:1000");
+    auto bingo_bulk = BingoMolecule::createDatabaseFile(session, temp.path("test_bulk.db"), "mt_size:1000");
+
+    for (auto i = 0; i < 4; i++)
+    {
+        bingo.insertIterator(session->iterateSmilesFile(dataPath("molecules/basic/pubchem_slice_5000.smi")));
+    }
+    bingo_bulk.insertIterator(session->iterateSmilesFile(bulk_path), "bulk_load:true;threads:2");
+    // Records inserted after the bulk load go to the built fingerprint table as usual
+    bingo_bulk.insertIterator(session->iterateSmilesFile(dataPath("molecules/basic/pubchem_slice_5000.smi")), "bulk_load:true");
+
+    for (const auto& item : {"C1=CC=CC=C1", "OC(=O)C1=CC=CC=C1", "CN1C=NC2=C1C(=O)N(C)C(=O)N2C", "CCCCCCCC"})
+    {
+        const auto query = session->loadMolecule(item);
+        std::vector<std::pair<int, double>> expected;
+        for (const auto& result : bingo.searchSim(query, 0.5))
+        {
+            expected.emplace_back(result.getId(), result.getSimilarityValue());
+        }
+        std::vector<std::pair<int, double>> actual;
+        for (const auto& result : bingo_bulk.searchSim(query, 0.5))
+        {
+            actual.emplace_back(result.getId(), result.getSimilarityValue());
+        }
+        std::sort(expected.begin(), expected.end());
+        std::sort(actual.begin(), actual.end());
+        EXPECT_EQ(expected, actual);
+    }
+}
+
+TEST(Bingo, SearchSubCompressed)
+{
+    testSearchSubCompressed("");
+}
+
+// Small blocks make the 5000 records fill several packs of transposed fingerprints, so the compressed blocks are searched
+TEST(Bingo, SearchSubCompressedPack)
+{
+    testSearchSubCompressed("sub_block_size:64");
+}
+
+TEST(Bingo, SearchSubScreening)
+{
+    auto session = IndigoSession::create();
+    const TemporaryDirectory temp;
+    const auto ids = [&session](const BingoMolecule& bingo, const char* query, const std::string& options) {
+        std::vector<int> result;
+        for (const auto& item : bingo.searchSub(session->loadQueryMolecule(query), options))
+        {
+            result.push_back(item.getId());
+        }
+        return result;
+    };
+
+    // With the default block size all the records stay in the increment, which is not screened by columns
+    auto bingo_plain = BingoMolecule::createDatabaseFile(session, temp.path("test_plain.db"));
+    auto bingo = BingoMolecule::createDatabaseFile(session, temp.path("test.db"), "sub_block_size:64");
+    bingo_plain.insertIterator(session->iterateSmilesFile(dataPath("molecules/basic/pubchem_slice_5000.smi")));
+    bingo.insertIterator(session->iterateSmilesFile(dataPath("molecules/basic/pubchem_slice_5000.smi")));
+
+    // The later queries are screened after enough matches are timed to use the cost model
+    for (auto pass = 0; pass < 2; pass++)
+    {
+        for (const auto& item : {"C1=CC=CC=C1", "OC(=O)C1=CC=CC=C1", "CN1C=NC2=C1C(=O)N(C)C(=O)N2C", "[Br]", "C1CC2CCC1C2"})
+        {
+            const auto expected = ids(bingo_plain, item, "");
+            EXPECT_FALSE(expected.empty());
+            EXPECT_EQ(ids(bingo, item, ""), expected);
+            EXPECT_EQ(ids(bingo, item, "threads:4"), expected);
+        }
+    }
+
+    // Columns are read from the rarest bit of the pack, so a pack without some bit of the query
+    // is rejected by one column, while a pack that fits the query is screened by more of them
+    const auto columns = [&session, &ids](const char* molecule, const char* query) {
+        const TemporaryDirectory pack_temp;
+        auto bingo_pack = BingoMolecule::createDatabaseFile(session, pack_temp.path("test_pack.db"), "sub_block_size:8");
+        for (auto i = 0; i < 64; i++)
+        {
+            bingo_pack.insertRecord(session->loadMolecule(molecule));
+        }
+        indigoDbgResetProfiling(false);
+        ids(bingo_pack, query, "");
+        EXPECT_EQ(indigoDbgProfilingGetCounter("sub_screen_packs", false), 1);
+        return indigoDbgProfilingGetCounter("sub_screen_columns", false);
+    };
+    EXPECT_EQ(columns("CCCCCC", "BrC1=CC=CC=C1"), 1);
+    EXPECT_GT(columns("BrC1=CC=CC=C1", "BrC1=CC=CC=C1"), 1);
+}
+
+TEST(Bingo, ResultCache)
+{
+    auto session = IndigoSession::create();
+    const auto search = [&session](const BingoMolecule& bingo) {
+        std::vector<std::pair<int, double>> results;
+        for (const auto& result : bingo.searchSub(session->loadQueryMolecule("C1=CC=CC=C1")))
+        {
+            results.emplace_back(result.getId(), 0);
+        }
+        for (const auto& result : bingo.searchSim(session->loadMolecule("CC1=CC=CC=C1"), 0.3))
+        {
+            results.emplace_back(result.getId(), result.getSimilarityValue());
+        }
+        return results;
+    };
+
+    const TemporaryDirectory temp;
+    auto bingo_plain = BingoMolecule::createDatabaseFile(session, temp.path("test_plain.db"));
+    {
+        auto bingo = BingoMolecule::createDatabaseFile(session, temp.path("test.db"), "result_cache:16");
+        for (const auto& item : {"C1=CC=CC=C1", "CC1=CC=CC=C1", "C1=CN=CC=C1", "CCO", "OC1=CC=CC=C1"})
+        {
+            bingo.insertRecord(session->loadMolecule(item));
+            bingo_plain.insertRecord(session->loadMolecule(item));
+        }
+
+        const auto expected = search(bingo_plain);
+        EXPECT_FALSE(expected.empty());
+        EXPECT_EQ(search(bingo), expected);
+        EXPECT_EQ(search(bingo), expected);
+        EXPECT_NE(std::string(bingoProfilingGetStatistics(true)).find("result_cache_hits"), std::string::npos);
+
+        // Mappings are returned both while the results are cached and for the cached results
+        const auto mappings = [&session](const BingoMolecule& bingo) {
+            std::vector<std::vector<int>> results;
+            for (const auto& result : bingo.searchSub(session->loadQueryMolecule("C1=CC=NC=C1")))
+            {
+                results.push_back(result.getMapping());
+            }
+            return results;
+        };
+        const auto expected_mappings = mappings(bingo_plain);
+        EXPECT_FALSE(expected_mappings.empty());
+        EXPECT_EQ(mappings(bingo), expected_mappings);
+        EXPECT_EQ(mappings(bingo), expected_mappings);
+
+        // Insertions and deletions make the cached results stale
+        bingo.insertRecord(session->loadMolecule("CCC1=CC=CC=C1"));
+        bingo_plain.insertRecord(session->loadMolecule("CCC1=CC=CC=C1"));
+        EXPECT_EQ(search(bingo), search(bingo_plain));
+        bingo.deleteRecord(0);
+        bingo_plain.deleteRecord(0);
+        EXPECT_EQ(search(bingo), search(bingo_plain));
+        bingo.close();
+    }
+    {
+        // Cached results are stored in the database
+        auto bingo = BingoMolecule::loadDatabaseFile(session, temp.path("test.db"), "read_only:true");
+        EXPECT_EQ(search(bingo), search(bingo_plain));
+        EXPECT_EQ(search(bingo), search(bingo_plain));
+    }
+}
+
+TEST(Bingo, LoadOtherVersion)
+{
+    auto session = IndigoSession::create();
+    const TemporaryDirectory temp;
+    BingoMolecule::createDatabaseFile(session, temp.path("test.db")).close();
+    {
+        // The storage file starts with the database type and version, e.g. "molecule_v0.73"
+        std::fstream file(temp.path("test.db") + "/mmf_storage0", std::ios::binary | std::ios::in | std::ios::out);
+        file.seekp(std::string("molecule_v").size());
+        file.write("0.00", 4);
+    }
+    try
+    {
+        BingoMolecule::loadDatabaseFile(session, temp.path("test.db"));
+        FAIL() << "A database of another version is loaded";
+    }
+    catch (const IndigoException& e)
+    {
+        EXPECT_NE(std::string(e.what()).find("molecule_v0.00"), std::string::npos);
+    }
+}
+
+TEST(Bingo, MoleculeCache)
+{
+    auto session = IndigoSession::create();
+    const auto search = [&session](const BingoMolecule& bingo, const char* query, const std::string& options) {
+        std::vector<int> results;
+        for (const auto& result : bingo.searchSub(session->loadQueryMolecule(query), options))
+        {
+            results.push_back(result.getId());
+        }
+        return results;
+    };
+
+    const TemporaryDirectory temp;
+    auto bingo_plain = BingoMolecule::createDatabaseFile(session, temp.path("test_plain.db"));
+    auto bingo = BingoMolecule::createDatabaseFile(session, temp.path("test.db"), "mol_cache:64");
+    bingo_plain.insertIterator(session->iterateSmilesFile(dataPath("molecules/basic/pubchem_slice_5000.smi")));
+    bingo.insertIterator(session->iterateSmilesFile(dataPath("molecules/basic/pubchem_slice_5000.smi")));
+
+    // Candidates decoded by the first pass are served from the cache afterwards
+    for (auto pass = 0; pass < 2; pass++)
+    {
+        for (const auto& item : {"C1=CC=CC=C1", "OC(=O)C1=CC=CC=C1", "[Br]"})
+        {
+            const auto expected = search(bingo_plain, item, "");
+            EXPECT_FALSE(expected.empty());
+            EXPECT_EQ(search(bingo, item, ""), expected);
+            EXPECT_EQ(search(bingo, item, "threads:4"), expected);
+        }
+    }
+    EXPECT_NE(std::string(bingoProfilingGetStatistics(true)).find("mol_cache_hits"), std::string::npos);
+
+    bingo.deleteRecord(0);
+    bingo_plain.deleteRecord(0);
+    EXPECT_EQ(search(bingo, "C1=CC=CC=C1", ""), search(bingo_plain, "C1=CC=CC=C1", ""));
+}
+
+TEST(Bingo, MatchFeatures)
+{
+    auto session = IndigoSession::create();
+    const auto ids = [](BingoResultIterator<IndigoMolecule> results) {
+        std::vector<int> result;
+        for (const auto& item : results)
+        {
+            result.push_back(item.getId());
+        }
+        return result;
+    };
+
+    const TemporaryDirectory temp;
+    auto bingo_plain = BingoMolecule::createDatabaseFile(session, temp.path("test_plain.db"));
+    auto bingo = BingoMolecule::createDatabaseFile(session, temp.path("test.db"), "match_features:true");
+    bingo_plain.insertIterator(session->iterateSmilesFile(dataPath("molecules/basic/pubchem_slice_5000.smi")));
+    bingo.insertIterator(session->iterateSmilesFile(dataPath("molecules/basic/pubchem_slice_5000.smi")), "threads:4");
+
+    for (const auto& item : {"C1=CC=CC=C1", "[N,O;H1]C=O", "[#6;R2]", "[Br,I]", "[CH3][N+]"})
+    {
+        const auto query = session->loadQueryMolecule(item);
+        const auto expected = ids(bingo_plain.searchSub(query));
+        EXPECT_FALSE(expected.empty());
+        EXPECT_EQ(ids(bingo.searchSub(query)), expected);
+        EXPECT_EQ(ids(bingo.searchSub(query, "threads:4")), expected);
+    }
+
+    for (const auto& item : {"CC(=O)OC1=CC=CC=C1C(O)=O", "CN1C=NC2=C1C(=O)N(C)C(=O)N2C"})
+    {
+        const auto query = session->loadMolecule(item);
+        EXPECT_EQ(ids(bingo.searchExact(query)), ids(bingo_plain.searchExact(query)));
+    }
+}
+
 TEST(Bingo, CreateCloseLoad)
 {
     auto session = IndigoSession::create();
@@ -144,6 +516,36 @@ TEST(Bingo, CreateCloseLoad)
     }
 }
 
+TEST(Bingo, LoadReadOnlyShared)
+{
+    auto session = IndigoSession::create();
+    {
+        auto bingo = BingoMolecule::createDatabaseFile(session, "test.db");
+        for (const auto& item : {"C1=CC=CC=C1", "C1=CN=CC=C1"})
+        {
+            bingo.insertRecord(session->loadMolecule(item));
+        }
+        bingo.close();
+    }
+    {
+        // Several read-only sessions may share the database, a writer may not join them
+        auto reader_1 = BingoMolecule::loadDatabaseFile(session, "test.db", "read_only:true");
+        auto reader_2 = BingoMolecule::loadDatabaseFile(session, "test.db", "read_only:true");
+        EXPECT_THROW(BingoMolecule::loadDatabaseFile(session, "test.db"), IndigoException);
+
+        const auto m = session->loadMolecule("C1=CC=CC=C1");
+        for (auto* reader : {&reader_1, &reader_2})
+        {
+            auto counter = 0;
+            for (const auto& result : reader->searchSim(m, 0.3))
+            {
+                ++counter;
+            }
+            EXPECT_EQ(counter, 2);
+        }
+    }
+}
+
 TEST(Bingo, Aromatization)
 {
     auto session = IndigoSession::create();
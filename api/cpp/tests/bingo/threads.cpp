@@ -18,7 +18,11 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <atomic>
+#include <fstream>
 #include <random>
+#include <set>
 #include <thread>
 
 #include <BingoNoSQL.h>
@@ -193,6 +197,208 @@ TEST(BingoThreads, SearchMultipleThreads)
     }
 }
 
+TEST(BingoThreads, SearchSubParallel)
+{
+    auto session = IndigoSession::create();
+    const TemporaryDirectory temp;
+    auto bingo = BingoMolecule::createDatabaseFile(session, temp.path("test.db"));
+    for (auto i = 0; i < 4; i++)
+    {
+        testInsert(bingo, "molecules/basic/Compound_0000001_0000250.sdf.gz");
+    }
+    const auto q = session->loadQueryMolecule("C1=CC=CC=C1");
+    std::vector<int> serial_ids;
+    for (const auto& result : bingo.searchSub(q))
+    {
+        serial_ids.push_back(result.getId());
+    }
+    std::vector<int> parallel_ids;
+    for (const auto& result : bingo.searchSub(q, "threads:4"))
+    {
+        parallel_ids.push_back(result.getId());
+    }
+    EXPECT_GT(serial_ids.size(), 0);
+    EXPECT_EQ(serial_ids, parallel_ids);
+}
+
+// Small blocks split the records into packs that are dispatched to the threads in several rounds
+TEST(BingoThreads, SearchSubParallelPacks)
+{
+    auto session = IndigoSession::create();
+    const TemporaryDirectory temp;
+    auto bingo = BingoMolecule::createDatabaseFile(session, temp.path("test.db"), "sub_block_size:8");
+    for (auto i = 0; i < 4; i++)
+    {
+        testInsert(bingo, "molecules/basic/Compound_0000001_0000250.sdf.gz");
+    }
+    const auto q = session->loadQueryMolecule("C1=CC=CC=C1");
+    std::vector<int> serial_ids;
+    for (const auto& result : bingo.searchSub(q))
+    {
+        serial_ids.push_back(result.getId());
+    }
+    std::vector<int> parallel_ids;
+    for (const auto& result : bingo.searchSub(q, "threads:4"))
+    {
+        parallel_ids.push_back(result.getId());
+    }
+    EXPECT_GT(serial_ids.size(), 0);
+    EXPECT_EQ(serial_ids, parallel_ids);
+}
+
+TEST(BingoThreads, SearchSubParallelMapping)
+{
+    auto session = IndigoSession::create();
+    const TemporaryDirectory temp;
+    auto bingo = BingoMolecule::createDatabaseFile(session, temp.path("test.db"));
+    for (auto i = 0; i < 4; i++)
+    {
+        testInsert(bingo, "molecules/basic/Compound_0000001_0000250.sdf.gz");
+    }
+    const auto q = session->loadQueryMolecule("C1=CC=CC=C1");
+    std::vector<std::vector<int>> serial_mappings;
+    for (const auto& result : bingo.searchSub(q))
+    {
+        serial_mappings.push_back(result.getMapping());
+    }
+    std::vector<std::vector<int>> parallel_mappings;
+    for (const auto& result : bingo.searchSub(q, "threads:4"))
+    {
+        const auto mapping = result.getMapping();
+        EXPECT_EQ(std::count_if(mapping.begin(), mapping.end(), [](int idx) { return idx >= 0; }), 6);
+        parallel_mappings.push_back(mapping);
+    }
+    EXPECT_GT(serial_mappings.size(), 0);
+    EXPECT_EQ(serial_mappings, parallel_mappings);
+}
+
+TEST(BingoThreads, SearchSnapshot)
+{
+    auto session = IndigoSession::create();
+    auto bingo = BingoMolecule::createDatabaseFile(session, "test.db");
+    for (auto i = 0; i < 3; i++)
+    {
+        bingo.insertRecord(session->loadMolecule("C1=CC=CC=C1"));
+    }
+    const auto m = session->loadMolecule("C1=CC=CC=C1");
+    const auto q = session->loadQueryMolecule("C1=CC=CC=C1");
+
+    // Records inserted while a search is iterated are not visible to it
+    auto counter = 0;
+    for (const auto& result : bingo.searchSub(q))
+    {
+        bingo.insertRecord(session->loadMolecule("CC1=CC=CC=C1"));
+        ++counter;
+    }
+    EXPECT_EQ(counter, 3);
+
+    counter = 0;
+    for (const auto& result : bingo.searchSim(m, 0.1))
+    {
+        bingo.insertRecord(session->loadMolecule("CC1=CC=CC=C1"));
+        ++counter;
+    }
+    EXPECT_EQ(counter, 6);
+
+    checkCount(bingo, 12, "C1=CC=CC=C1");
+}
+
+TEST(BingoThreads, SearchWhileInsert)
+{
+    auto session = IndigoSession::create();
+    auto bingo = BingoMolecule::createDatabaseFile(session, "test.db");
+    testInsert(bingo, "molecules/basic/Compound_0000001_0000250.sdf.gz");
+    auto writer = std::thread(testInsert, std::ref(bingo), "molecules/basic/Compound_0000001_0000250.sdf.gz");
+    std::vector<std::thread> readers;
+    readers.reserve(8);
+    for (auto i = 0; i < 8; i++)
+    {
+        readers.emplace_back([&bingo]() {
+            auto counter = 0;
+            for (const auto& result : bingo.searchSub(bingo.session->loadQueryMolecule("C")))
+            {
+                ++counter;
+            }
+            EXPECT_GE(counter, 241);
+            EXPECT_LE(counter, 241 * 2);
+        });
+    }
+    for (auto& thread : readers)
+    {
+        thread.join();
+    }
+    writer.join();
+
+    checkCount(bingo, 241 * 2);
+}
+
+TEST(BingoThreads, SearchWhileBulkLoad)
+{
+    auto session = IndigoSession::create();
+    const TemporaryDirectory temp;
+    const auto smiles_path = temp.path("bulk_load.smi");
+    {
+        std::ofstream smiles_file(smiles_path);
+        for (auto i = 0; i < 20; i++)
+        {
+            smiles_file << "C1=CC=CC=C1" << std::string(i, 'C') << "\n";
+        }
+        // The last record is rejected only after a long parsing, so the searches run
+        // after all the records are added but before the bulk load publishes them
+        smiles_file << std::string(200000, 'C') << "1\n";
+    }
+
+    auto bingo = BingoMolecule::createDatabaseFile(session, temp.path("test.db"), "result_cache:16");
+    std::atomic<bool> loaded(false);
+    auto writer = std::thread([&]() {
+        bingo.insertIterator(session->iterateSmilesFile(smiles_path), "bulk_load:true");
+        loaded = true;
+    });
+    const auto q = session->loadQueryMolecule("C1=CC=CC=C1");
+    while (!loaded)
+    {
+        for (const auto& result : bingo.searchSub(q))
+        {
+        }
+    }
+    writer.join();
+
+    // Results cached during the bulk load are stale once it is finished
+    checkCount(bingo, 20, "C1=CC=CC=C1");
+}
+
+TEST(BingoThreads, InsertIteratorParallel)
+{
+    auto session = IndigoSession::create();
+    const TemporaryDirectory temp;
+    auto bingo_serial = BingoMolecule::createDatabaseFile(session, temp.path("test_serial.db"));
+    auto bingo_parallel = BingoMolecule::createDatabaseFile(session, temp.path("test_parallel.db"));
+    bingo_serial.insertIterator(session->iterateSDFile(dataPath("molecules/basic/Compound_0000001_0000250.sdf.gz")));
+    bingo_parallel.insertIterator(session->iterateSDFile(dataPath("molecules/basic/Compound_0000001_0000250.sdf.gz")), "threads:4");
+
+    // Records are committed in the iterator order, so both databases assign the same ids
+    auto counter = 0;
+    for (const auto& m : session->iterateSDFile(dataPath("molecules/basic/Compound_0000001_0000250.sdf.gz")))
+    {
+        std::set<int> serial_ids;
+        for (const auto& result : bingo_serial.searchExact(*m))
+        {
+            serial_ids.insert(result.getId());
+        }
+        std::set<int> parallel_ids;
+        for (const auto& result : bingo_parallel.searchExact(*m))
+        {
+            parallel_ids.insert(result.getId());
+        }
+        EXPECT_EQ(serial_ids.count(counter), 1);
+        EXPECT_EQ(serial_ids, parallel_ids);
+        ++counter;
+    }
+    EXPECT_EQ(counter, 245);
+
+    EXPECT_NE(bingo_parallel.getStatistics().find("bulk_insert_records"), std::string::npos);
+}
+
 TEST(BingoThreads, DISABLED_Insert_Pubchem_1M)
 {
     auto session = IndigoSession::create();
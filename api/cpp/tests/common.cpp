@@ -1,8 +1,55 @@
 #include "common.h"
 
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <direct.h>
+#include <windows.h>
+#else
+#include <ftw.h>
+#include <unistd.h>
+#endif
+
 namespace
 {
     const std::string dataPathPrefix = DATA_PATH;
+
+#ifdef _WIN32
+    void removeTree(const std::string& path)
+    {
+        WIN32_FIND_DATAA data;
+        HANDLE handle = FindFirstFileA((path + "\\*").c_str(), &data);
+        if (handle != INVALID_HANDLE_VALUE)
+        {
+            do
+            {
+                const std::string name = data.cFileName;
+                if (name == "." || name == "..")
+                {
+                    continue;
+                }
+                if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+                {
+                    removeTree(path + "\\" + name);
+                }
+                else
+                {
+                    DeleteFileA((path + "\\" + name).c_str());
+                }
+            } while (FindNextFileA(handle, &data));
+            FindClose(handle);
+        }
+        RemoveDirectoryA(path.c_str());
+    }
+#else
+    int removeEntry(const char* path, const struct stat*, int, struct FTW*)
+    {
+        return std::remove(path);
+    }
+#endif
 }
 
 using namespace indigo_cpp;
@@ -11,3 +58,39 @@ std::string indigo_cpp::dataPath(const char* dataPathSuffix)
 {
     return dataPathPrefix + "/" + dataPathSuffix;
 }
+
+TemporaryDirectory::TemporaryDirectory()
+{
+#ifdef _WIN32
+    static std::atomic<int> counter(0);
+    char temp_path[MAX_PATH];
+    GetTempPathA(MAX_PATH, temp_path);
+    _path = std::string(temp_path) + "indigo-test-" + std::to_string(GetCurrentProcessId()) + "-" + std::to_string(counter++);
+    if (_mkdir(_path.c_str()) != 0)
+    {
+        throw std::runtime_error("cannot create temporary directory " + _path);
+    }
+#else
+    const char* temp_path = std::getenv("TMPDIR");
+    std::string pattern = std::string(temp_path != nullptr ? temp_path : "/tmp") + "/indigo-test-XXXXXX";
+    if (mkdtemp(&pattern[0]) == nullptr)
+    {
+        throw std::runtime_error("cannot create temporary directory " + pattern);
+    }
+    _path = pattern;
+#endif
+}
+
+TemporaryDirectory::~TemporaryDirectory()
+{
+#ifdef _WIN32
+    removeTree(_path);
+#else
+    nftw(_path.c_str(), removeEntry, 16, FTW_DEPTH | FTW_PHYS);
+#endif
+}
+
+std::string TemporaryDirectory::path(const char* name) const
+{
+    return _path + "/" + name;
+}
@@ -16,6 +16,8 @@
  * limitations under the License.
  ***************************************************************************/
 
+#include <algorithm>
+
 #include <gtest/gtest.h>
 
 #include <IndigoIterator.h>
@@ -41,3 +43,44 @@ TEST(SDF, IterateSDFile)
     EXPECT_EQ(counter, 245);
     EXPECT_EQ(molecules.size(), 245);
 }
+
+namespace
+{
+    std::vector<std::string> collectSmiles(IndigoIterator<IndigoMolecule> iterator)
+    {
+        std::vector<std::string> result;
+        for (const auto& molecule : iterator)
+        {
+            try
+            {
+                result.push_back(molecule->canonicalSmiles());
+            }
+            catch (const std::exception& e)
+            {
+                result.push_back(e.what());
+            }
+        }
+        return result;
+    }
+}
+
+TEST(SDF, IterateParallel)
+{
+    auto session = IndigoSession::create();
+    const auto sdf_path = dataPath("molecules/basic/Compound_0000001_0000250.sdf.gz");
+    const auto smi_path = dataPath("molecules/basic/pubchem_slice_50.smi");
+
+    const auto sdf_serial = collectSmiles(session->iterateSDFile(sdf_path));
+    const auto smi_serial = collectSmiles(session->iterateSmilesFile(smi_path));
+
+    session->setOption("iteration-threads", 4);
+    EXPECT_EQ(sdf_serial, collectSmiles(session->iterateSDFile(sdf_path)));
+    EXPECT_EQ(smi_serial, collectSmiles(session->iterateSmilesFile(smi_path)));
+
+    session->setOption("iteration-ordered", false);
+    auto sdf_unordered = collectSmiles(session->iterateSDFile(sdf_path));
+    auto sdf_sorted = sdf_serial;
+    std::sort(sdf_unordered.begin(), sdf_unordered.end());
+    std::sort(sdf_sorted.begin(), sdf_sorted.end());
+    EXPECT_EQ(sdf_sorted, sdf_unordered);
+}
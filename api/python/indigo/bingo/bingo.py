@@ -197,6 +197,17 @@ class Bingo:
             self,
         )
 
+    def searchSimBatch(self, queries, minSim, maxSim, metric="tanimoto"):
+        return BingoObject(
+            IndigoLib.checkResult(
+                self._lib().bingoSearchSimBatch(
+                    self._id, queries.id, minSim, maxSim, metric.encode()
+                ),
+                BingoException,
+            ),
+            self,
+        )
+
     def enumerateId(self):
         return BingoObject(
             IndigoLib.checkResult(
@@ -108,6 +108,14 @@ class BingoLib:
             c_int,
             c_char_p,
         ]
+        BingoLib.lib.bingoSearchSimBatch.restype = c_int
+        BingoLib.lib.bingoSearchSimBatch.argtypes = [
+            c_int,
+            c_int,
+            c_float,
+            c_float,
+            c_char_p,
+        ]
         BingoLib.lib.bingoEnumerateId.restype = c_int
         BingoLib.lib.bingoEnumerateId.argtypes = [c_int]
         BingoLib.lib.bingoNext.restype = c_int
@@ -120,6 +128,8 @@ class BingoLib:
         BingoLib.lib.bingoEndSearch.argtypes = [c_int]
         BingoLib.lib.bingoGetCurrentSimilarityValue.restype = c_float
         BingoLib.lib.bingoGetCurrentSimilarityValue.argtypes = [c_int]
+        BingoLib.lib.bingoGetCurrentQueryIndex.restype = c_int
+        BingoLib.lib.bingoGetCurrentQueryIndex.argtypes = [c_int]
         BingoLib.lib.bingoOptimize.restype = c_int
         BingoLib.lib.bingoOptimize.argtypes = [c_int]
         BingoLib.lib.bingoEstimateRemainingResultsCount.restype = c_int
@@ -17,7 +17,18 @@
 __version__ = "1.7.4"
 
 import warnings
-from ctypes import CDLL, c_byte, c_double, c_float, c_int, c_ubyte, pointer
+from ctypes import (
+    CDLL,
+    POINTER,
+    byref,
+    c_byte,
+    c_double,
+    c_float,
+    c_int,
+    c_ubyte,
+    pointer,
+    string_at,
+)
 
 from .indigo_exception import IndigoException
 from .indigo_lib import IndigoLib
@@ -915,6 +926,38 @@ class Indigo:
             self._lib().indigoSimilarity(item1.id, item2.id, metrics.encode())
         )
 
+    def fingerprintBatch(self, items, type_, max_count=0):
+        """Builds fingerprints of many molecules at once. The work is spread
+        over "fingerprint-threads" threads.
+
+        Args:
+            items (IndigoObject): array of molecules or iterator
+            type_ (str): fingerprint type. One of the following: "sim", "sub",
+                         "sub-res", "sub-tau", "full"
+            max_count (int): maximal number of molecules taken from an
+                             iterator. Optional, defaults to 0 (all of them).
+
+        Returns:
+            list: fingerprints as bytes objects
+        """
+        c_size = c_int()
+        c_buf = POINTER(c_ubyte)()
+
+        count = IndigoLib.checkResult(
+            self._lib().indigoFingerprintBatch(
+                items.id,
+                type_.encode(),
+                max_count,
+                byref(c_buf),
+                byref(c_size),
+            )
+        )
+        if count == 0:
+            return []
+        data = string_at(c_buf, c_size.value)
+        fp_size = c_size.value // count
+        return [data[i * fp_size : (i + 1) * fp_size] for i in range(count)]
+
     def iterateSDFile(self, filename):
         """Returns iterator for SDF files
 
@@ -182,6 +182,14 @@ class IndigoLib:
         IndigoLib.lib.indigoCommonBits.argtypes = [c_int, c_int]
         IndigoLib.lib.indigoSimilarity.restype = c_float
         IndigoLib.lib.indigoSimilarity.argtypes = [c_int, c_int, c_char_p]
+        IndigoLib.lib.indigoFingerprintBatch.restype = c_int
+        IndigoLib.lib.indigoFingerprintBatch.argtypes = [
+            c_int,
+            c_char_p,
+            c_int,
+            POINTER(POINTER(c_ubyte)),
+            POINTER(c_int),
+        ]
         IndigoLib.lib.indigoIterateSDF.restype = c_int
         IndigoLib.lib.indigoIterateSDF.argtypes = [c_int]
         IndigoLib.lib.indigoIterateRDF.restype = c_int
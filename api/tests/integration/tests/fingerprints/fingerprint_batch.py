@@ -0,0 +1,48 @@
+import os
+import sys
+
+sys.path.append(
+    os.path.normpath(
+        os.path.join(os.path.abspath(__file__), "..", "..", "..", "common")
+    )
+)
+from env_indigo import *
+
+indigo = Indigo()
+smiles_path = joinPathPy("molecules/b2000.smi", __file__)
+
+
+def expected(mols, type_):
+    return [bytes(m.fingerprint(type_).toBuffer()) for m in mols]
+
+
+print("*** Fingerprint batch of an array ***")
+mols = [m.clone() for m in indigo.iterateSmilesFile(smiles_path)][:300]
+arr = indigo.createArray()
+for m in mols:
+    arr.arrayAdd(m)
+for threads in (1, 4):
+    indigo.setOption("fingerprint-threads", threads)
+    for type_ in ("sim", "sub", "full"):
+        fps = indigo.fingerprintBatch(arr, type_)
+        print(
+            "threads=%d type=%s count=%d size=%d same=%s"
+            % (
+                threads,
+                type_,
+                len(fps),
+                len(fps[0]),
+                fps == expected(mols, type_),
+            )
+        )
+
+print("*** Fingerprint batch of an iterator ***")
+indigo.setOption("fingerprint-threads", 4)
+it = indigo.iterateSmilesFile(smiles_path)
+first = indigo.fingerprintBatch(it, "sim", 100)
+second = indigo.fingerprintBatch(it, "sim", 100)
+print("counts: %d %d" % (len(first), len(second)))
+print("same: %s" % (first + second == expected(mols[:200], "sim")))
+
+print("*** Empty batch ***")
+print(indigo.fingerprintBatch(indigo.createArray(), "sim"))
@@ -21,6 +21,11 @@
 
 #include "base_c/bitarray.h"
 
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define BIT_POPCOUNT_DISPATCH
+#include <immintrin.h>
+#endif
+
 int bitGetBit(const void* bitarray, int bitno)
 {
     return ((((char*)bitarray)[bitno / 8] & (char)(1 << (bitno % 8))) == 0) ? 0 : 1;
@@ -123,16 +128,213 @@ int bitGetOnesCountDword(dword v)
     return (((v + (v >> 4)) & 0xF0F0F0F) * 0x1010101) >> 24; // count
 }
 
-int bitGetOnesCountQword(qword value)
+int bitGetOnesCountQword(qword v)
+{
+    v = v - ((v >> 1) & 0x5555555555555555ULL);
+    v = (v & 0x3333333333333333ULL) + ((v >> 2) & 0x3333333333333333ULL);
+    return (int)((((v + (v >> 4)) & 0x0F0F0F0F0F0F0F0FULL) * 0x0101010101010101ULL) >> 56);
+}
+
+static qword _bitLoadQword(const byte* data)
+{
+    qword value;
+    memcpy(&value, data, sizeof(qword));
+    return value;
+}
+
+// Popcount kernels used by bitGetOnesCount and bitCommonOnesWithCounts.
+// Every kernel processes the whole qwords it can and leaves the byte tail
+// to the caller, so all of them produce bit-identical results.
+// ones1 and ones2 are only accumulated when the pointers are not NULL.
+
+static int _bitOnesCountGeneric(const byte* data, int n_qwords)
+{
+    int count = 0, i;
+    for (i = 0; i < n_qwords; i++)
+        count += bitGetOnesCountQword(_bitLoadQword(data + i * sizeof(qword)));
+    return count;
+}
+
+static int _bitCommonOnesGeneric(const byte* bit1, const byte* bit2, int n_qwords, int* ones1, int* ones2)
+{
+    int common = 0, count1 = 0, count2 = 0, i;
+    for (i = 0; i < n_qwords; i++)
+    {
+        qword a = _bitLoadQword(bit1 + i * sizeof(qword));
+        qword b = _bitLoadQword(bit2 + i * sizeof(qword));
+        common += bitGetOnesCountQword(a & b);
+        if (ones1 != NULL)
+            count1 += bitGetOnesCountQword(a);
+        if (ones2 != NULL)
+            count2 += bitGetOnesCountQword(b);
+    }
+    if (ones1 != NULL)
+        *ones1 += count1;
+    if (ones2 != NULL)
+        *ones2 += count2;
+    return common;
+}
+
+#ifdef BIT_POPCOUNT_DISPATCH
+
+__attribute__((target("popcnt"))) static int _bitOnesCountPopcnt(const byte* data, int n_qwords)
+{
+    int count = 0, i;
+    for (i = 0; i < n_qwords; i++)
+        count += __builtin_popcountll(_bitLoadQword(data + i * sizeof(qword)));
+    return count;
+}
+
+__attribute__((target("popcnt"))) static int _bitCommonOnesPopcnt(const byte* bit1, const byte* bit2, int n_qwords, int* ones1, int* ones2)
+{
+    int common = 0, count1 = 0, count2 = 0, i;
+    for (i = 0; i < n_qwords; i++)
+    {
+        qword a = _bitLoadQword(bit1 + i * sizeof(qword));
+        qword b = _bitLoadQword(bit2 + i * sizeof(qword));
+        common += __builtin_popcountll(a & b);
+        if (ones1 != NULL)
+            count1 += __builtin_popcountll(a);
+        if (ones2 != NULL)
+            count2 += __builtin_popcountll(b);
+    }
+    if (ones1 != NULL)
+        *ones1 += count1;
+    if (ones2 != NULL)
+        *ones2 += count2;
+    return common;
+}
+
+// Nibble lookup popcount (Mula et al.): per-byte counts via pshufb, summed into 64-bit lanes with psadbw
+__attribute__((target("avx2"))) static inline __m256i _bitPopcount256(__m256i v)
+{
+    const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low_mask = _mm256_set1_epi8(0x0F);
+    __m256i lo = _mm256_and_si256(v, low_mask);
+    __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), low_mask);
+    __m256i cnt = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo), _mm256_shuffle_epi8(lookup, hi));
+    return _mm256_sad_epu8(cnt, _mm256_setzero_si256());
+}
+
+__attribute__((target("avx2"))) static inline int _bitSum256(__m256i v)
+{
+    __m128i sum = _mm_add_epi64(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    sum = _mm_add_epi64(sum, _mm_unpackhi_epi64(sum, sum));
+    return (int)_mm_cvtsi128_si64(sum);
+}
+
+__attribute__((target("avx2,popcnt"))) static int _bitOnesCountAvx2(const byte* data, int n_qwords)
+{
+    int n_blocks = n_qwords / 4, i;
+    __m256i acc = _mm256_setzero_si256();
+    for (i = 0; i < n_blocks; i++)
+        acc = _mm256_add_epi64(acc, _bitPopcount256(_mm256_loadu_si256((const __m256i*)(data + i * 32))));
+    return _bitSum256(acc) + _bitOnesCountPopcnt(data + n_blocks * 32, n_qwords - n_blocks * 4);
+}
+
+__attribute__((target("avx2,popcnt"))) static int _bitCommonOnesAvx2(const byte* bit1, const byte* bit2, int n_qwords, int* ones1, int* ones2)
+{
+    int n_blocks = n_qwords / 4, i;
+    __m256i acc = _mm256_setzero_si256();
+    __m256i acc1 = _mm256_setzero_si256();
+    __m256i acc2 = _mm256_setzero_si256();
+    for (i = 0; i < n_blocks; i++)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(bit1 + i * 32));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(bit2 + i * 32));
+        acc = _mm256_add_epi64(acc, _bitPopcount256(_mm256_and_si256(a, b)));
+        if (ones1 != NULL)
+            acc1 = _mm256_add_epi64(acc1, _bitPopcount256(a));
+        if (ones2 != NULL)
+            acc2 = _mm256_add_epi64(acc2, _bitPopcount256(b));
+    }
+    if (ones1 != NULL)
+        *ones1 += _bitSum256(acc1);
+    if (ones2 != NULL)
+        *ones2 += _bitSum256(acc2);
+    return _bitSum256(acc) + _bitCommonOnesPopcnt(bit1 + n_blocks * 32, bit2 + n_blocks * 32, n_qwords - n_blocks * 4, ones1, ones2);
+}
+
+__attribute__((target("avx512f,avx512vpopcntdq,popcnt"))) static int _bitOnesCountAvx512(const byte* data, int n_qwords)
+{
+    int n_blocks = n_qwords / 8, i;
+    __m512i acc = _mm512_setzero_si512();
+    for (i = 0; i < n_blocks; i++)
+        acc = _mm512_add_epi64(acc, _mm512_popcnt_epi64(_mm512_loadu_si512((const void*)(data + i * 64))));
+    return (int)_mm512_reduce_add_epi64(acc) + _bitOnesCountPopcnt(data + n_blocks * 64, n_qwords - n_blocks * 8);
+}
+
+__attribute__((target("avx512f,avx512vpopcntdq,popcnt"))) static int _bitCommonOnesAvx512(const byte* bit1, const byte* bit2, int n_qwords, int* ones1,
+                                                                                           int* ones2)
+{
+    int n_blocks = n_qwords / 8, i;
+    __m512i acc = _mm512_setzero_si512();
+    __m512i acc1 = _mm512_setzero_si512();
+    __m512i acc2 = _mm512_setzero_si512();
+    for (i = 0; i < n_blocks; i++)
+    {
+        __m512i a = _mm512_loadu_si512((const void*)(bit1 + i * 64));
+        __m512i b = _mm512_loadu_si512((const void*)(bit2 + i * 64));
+        acc = _mm512_add_epi64(acc, _mm512_popcnt_epi64(_mm512_and_si512(a, b)));
+        if (ones1 != NULL)
+            acc1 = _mm512_add_epi64(acc1, _mm512_popcnt_epi64(a));
+        if (ones2 != NULL)
+            acc2 = _mm512_add_epi64(acc2, _mm512_popcnt_epi64(b));
+    }
+    if (ones1 != NULL)
+        *ones1 += (int)_mm512_reduce_add_epi64(acc1);
+    if (ones2 != NULL)
+        *ones2 += (int)_mm512_reduce_add_epi64(acc2);
+    return (int)_mm512_reduce_add_epi64(acc) + _bitCommonOnesPopcnt(bit1 + n_blocks * 64, bit2 + n_blocks * 64, n_qwords - n_blocks * 8, ones1, ones2);
+}
+
+#endif
+
+typedef int (*_BitOnesCountKernel)(const byte* data, int n_qwords);
+typedef int (*_BitCommonOnesKernel)(const byte* bit1, const byte* bit2, int n_qwords, int* ones1, int* ones2);
+
+// The generic kernels are used until the library constructor below has checked
+// the CPU features. The pointers are written only while the library is being
+// loaded, so the calls never race with the selection.
+static _BitOnesCountKernel _bit_ones_count_kernel = _bitOnesCountGeneric;
+static _BitCommonOnesKernel _bit_common_ones_kernel = _bitCommonOnesGeneric;
+
+#ifdef BIT_POPCOUNT_DISPATCH
+__attribute__((constructor)) static void _bitSelectKernels(void)
 {
-    return bitGetOnesCountDword((dword)value) + bitGetOnesCountDword((dword)(value >> 32));
+    _BitOnesCountKernel ones_count = _bitOnesCountGeneric;
+    _BitCommonOnesKernel common_ones = _bitCommonOnesGeneric;
+
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vpopcntdq"))
+    {
+        ones_count = _bitOnesCountAvx512;
+        common_ones = _bitCommonOnesAvx512;
+    }
+    else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt"))
+    {
+        ones_count = _bitOnesCountAvx2;
+        common_ones = _bitCommonOnesAvx2;
+    }
+    else if (__builtin_cpu_supports("popcnt"))
+    {
+        ones_count = _bitOnesCountPopcnt;
+        common_ones = _bitCommonOnesPopcnt;
+    }
+
+    _bit_common_ones_kernel = common_ones;
+    _bit_ones_count_kernel = ones_count;
 }
+#endif
 
 int bitGetOnesCount(const byte* data, int size)
 {
-    int count = 0;
-    while (size-- > 0)
-        count += bitGetOnesCountByte(*data++);
+    int n_qwords = size / (int)sizeof(qword);
+    int count, i;
+
+    count = _bit_ones_count_kernel(data, n_qwords);
+    for (i = n_qwords * (int)sizeof(qword); i < size; i++)
+        count += bitGetOnesCountByte(data[i]);
     return count;
 }
 
@@ -218,28 +420,29 @@ int bitIdecticalBits(const byte* bit1, const byte* bit2, int n_bytes)
 
 int bitCommonOnes(const byte* bit1, const byte* bit2, int n_bytes)
 {
-    int qwords_count = n_bytes / sizeof(qword);
-    int bytes_left = n_bytes - qwords_count * sizeof(qword);
+    return bitCommonOnesWithCounts(bit1, bit2, n_bytes, NULL, NULL);
+}
 
-    int count = 0;
-    const qword* bit1_ptr = (const qword*)bit1;
-    const qword* bit2_ptr = (const qword*)bit2;
-    while (qwords_count-- > 0)
-    {
-        qword id = *bit1_ptr & *bit2_ptr;
-        count += bitGetOnesCountQword(id);
+int bitCommonOnesWithCounts(const byte* bit1, const byte* bit2, int n_bytes, int* ones1, int* ones2)
+{
+    int n_qwords = n_bytes / (int)sizeof(qword);
+    int common, i;
 
-        bit1_ptr++;
-        bit2_ptr++;
-    }
+    if (ones1 != NULL)
+        *ones1 = 0;
+    if (ones2 != NULL)
+        *ones2 = 0;
 
-    if (bytes_left != 0)
+    common = _bit_common_ones_kernel(bit1, bit2, n_qwords, ones1, ones2);
+    for (i = n_qwords * (int)sizeof(qword); i < n_bytes; i++)
     {
-        qword mask = ~(qword)0 >> (64 - 8 * bytes_left);
-        qword id = *bit1_ptr & *bit2_ptr & mask;
-        count += bitGetOnesCountQword(id);
+        common += bitGetOnesCountByte(bit1[i] & bit2[i]);
+        if (ones1 != NULL)
+            *ones1 += bitGetOnesCountByte(bit1[i]);
+        if (ones2 != NULL)
+            *ones2 += bitGetOnesCountByte(bit2[i]);
     }
-    return count;
+    return common;
 }
 
 int bitUniqueOnes(const byte* bit1, const byte* bit2, int n_bytes)
@@ -279,7 +482,7 @@ int bitDifferentOnes(const byte* bit1, const byte* bit2, int n_bytes)
     while (qwords_count-- > 0)
     {
         qword id = *bit1_ptr ^ *bit2_ptr;
-        count += bitGetOnesCount((byte*)&id, sizeof(qword));
+        count += bitGetOnesCountQword(id);
 
         bit1_ptr++;
         bit2_ptr++;
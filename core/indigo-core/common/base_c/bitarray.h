@@ -50,6 +50,9 @@ extern "C"
     DLLEXPORT int bitTestOnes(const byte* pattern, const byte* candidate, int n_bytes);
     DLLEXPORT int bitIdecticalBits(const byte* bit1, const byte* bit2, int n_bytes);
     DLLEXPORT int bitCommonOnes(const byte* bit1, const byte* bit2, int n_bytes);
+    // Number of common ones; optionally also the ones counts of both arrays (ones1/ones2 may be NULL).
+    // All counts are gathered in a single pass using the best popcount instructions available at runtime.
+    DLLEXPORT int bitCommonOnesWithCounts(const byte* bit1, const byte* bit2, int n_bytes, int* ones1, int* ones2);
     DLLEXPORT int bitUniqueOnes(const byte* bit1, const byte* bit2, int n_bytes);
 
     DLLEXPORT int bitDifferentOnes(const byte* bit1, const byte* bit2, int n_bytes);
@@ -32,7 +32,6 @@
 #include "base_cpp/profiling.h"
 #include "base_cpp/tlscont.h"
 #include <memory>
-#include <thread>
 
 using namespace indigo;
 
@@ -67,6 +66,13 @@ OsCommandDispatcher::OsCommandDispatcher(int handling_order, bool same_session_I
     _same_session_IDs = same_session_IDs;
 }
 
+OsCommandDispatcher::~OsCommandDispatcher()
+{
+    // Threads are still attached only if the main loop was interrupted by an internal error
+    for (auto& thread : _threads)
+        thread.detach();
+}
+
 void OsCommandDispatcher::run()
 {
     _run(3 * std::thread::hardware_concurrency() / 2 + 1);
@@ -85,6 +91,8 @@ void OsCommandDispatcher::_run(int nthreads)
 {
     _last_command_index = 0;
     _expected_command_index = 0;
+    // The dispatcher may be run again, and the results window still starts where the previous run ended
+    _storedResults.setOffset(0);
     _need_to_terminate = false;
     _exception_to_forward = NULL;
 
@@ -100,10 +108,7 @@ void OsCommandDispatcher::_run(int nthreads)
 
     // Create handling threads
     for (int i = 0; i < _left_thread_count; i++)
-    {
-        std::thread thread{[this]() { this->_threadFunc(); }};
-        thread.detach();
-    }
+        _threads.emplace_back([this]() { this->_threadFunc(); });
 
     _mainLoop();
 }
@@ -127,6 +132,8 @@ void OsCommandDispatcher::_mainLoop()
             _onMsgHandleException((Exception*)parameter);
     }
 
+    _joinThreads();
+
     if (_exception_to_forward != NULL)
     {
         Exception* cur = _exception_to_forward;
@@ -135,6 +142,16 @@ void OsCommandDispatcher::_mainLoop()
     }
 }
 
+void OsCommandDispatcher::_joinThreads()
+{
+    // Every thread has received MSG_NO_TASK, but it still calls _cleanupThread() on
+    // this object before exiting. Wait for them so that the dispatcher can be
+    // destroyed right after run() returns.
+    for (auto& thread : _threads)
+        thread.join();
+    _threads.clear();
+}
+
 void OsCommandDispatcher::markToTerminate()
 {
     _need_to_terminate = true;
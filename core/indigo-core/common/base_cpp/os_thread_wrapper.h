@@ -39,6 +39,9 @@
 // used many time.
 //
 
+#include <thread>
+#include <vector>
+
 #include "base_c/defs.h"
 #include "base_cpp/array.h"
 #include "base_cpp/cyclic_array.h"
@@ -77,7 +80,7 @@ namespace indigo
         };
 
         OsCommandDispatcher(int handling_order, bool same_session_IDs);
-        virtual ~OsCommandDispatcher(){};
+        virtual ~OsCommandDispatcher();
 
         void run();
         void run(int nthreads);
@@ -120,6 +123,7 @@ namespace indigo
         void _recvCommandAndResult(OsCommandResult*& result, OsCommand*& command);
 
         void _mainLoop();
+        void _joinThreads();
 
         OsCommand* _getVacantCommand();
         OsCommandResult* _getVacantResult();
@@ -135,6 +139,7 @@ namespace indigo
         PtrArray<OsCommandResult> _availableResults;
         CyclicArray<OsCommandResult*> _storedResults;
         Array<OsSemaphore*> _syspendedThreads;
+        std::vector<std::thread> _threads;
 
         Exception* _exception_to_forward;
 
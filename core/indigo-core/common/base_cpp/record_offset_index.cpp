@@ -0,0 +1,186 @@
+/****************************************************************************
+ * Copyright (C) from 2009 to Present EPAM Systems.
+ *
+ * This file is part of Indigo toolkit.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ***************************************************************************/
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
+
+#include "base_cpp/record_offset_index.h"
+#include "base_cpp/crc32.h"
+#include "base_cpp/output.h"
+#include "base_cpp/scanner.h"
+
+using namespace indigo;
+
+IMPL_ERROR(RecordOffsetIndex, "record offset index");
+
+static const char _signature[] = "IDXOFFS2";
+
+enum
+{
+    FINGERPRINT_BLOCK = 65536
+};
+
+static void _writeLong(Output& output, long long value)
+{
+    output.writeBinaryInt((int)(value >> 32));
+    output.writeBinaryInt((int)value);
+}
+
+static long long _readLong(Scanner& input)
+{
+    long long value = (long long)input.readBinaryDword() << 32;
+    return value | input.readBinaryDword();
+}
+
+void RecordOffsetIndex::_fingerprint(Scanner& source, Encoding filename_encoding, const char* source_filename, _Fingerprint& fingerprint)
+{
+    Array<char> block;
+    long long pos = source.tell();
+
+    fingerprint.length = source.length();
+
+    int head_size = (int)std::min(fingerprint.length, (long long)FINGERPRINT_BLOCK);
+    source.seek(0, SEEK_SET);
+    source.read(head_size, block);
+    fingerprint.head_crc = CRC32::get(block.ptr(), block.size());
+    fingerprint.gzipped = (head_size >= 2 && (byte)block[0] == 0x1f && (byte)block[1] == 0x8b);
+
+    int tail_size = (int)std::min(fingerprint.length, (long long)FINGERPRINT_BLOCK);
+    source.seek(fingerprint.length - tail_size, SEEK_SET);
+    source.read(tail_size, block);
+    fingerprint.tail_crc = CRC32::get(block.ptr(), block.size());
+
+    source.seek(pos, SEEK_SET);
+
+    // A file rewritten with the same size and the same head and tail still
+    // gets another modification time, and a replaced one gets another inode
+    fingerprint.mtime = 0;
+    fingerprint.inode = 0;
+    FILE* file = source_filename != nullptr ? openFile(filename_encoding, source_filename, "rb") : nullptr;
+    if (file == nullptr)
+        return;
+#ifdef _WIN32
+    // Inode numbers are not reported on Windows
+    struct _stat64 st;
+    if (_fstat64(_fileno(file), &st) == 0)
+        fingerprint.mtime = (long long)st.st_mtime * 1000000000LL;
+#else
+    struct stat st;
+    if (fstat(fileno(file), &st) == 0)
+    {
+#ifdef __APPLE__
+        fingerprint.mtime = (long long)st.st_mtimespec.tv_sec * 1000000000LL + st.st_mtimespec.tv_nsec;
+#else
+        fingerprint.mtime = (long long)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+#endif
+        fingerprint.inode = (long long)st.st_ino;
+    }
+#endif
+    fclose(file);
+}
+
+bool RecordOffsetIndex::_startsLine(Scanner& source, long long offset)
+{
+    if (offset == 0)
+        return true;
+    if (offset < 0 || offset > source.length())
+        return false;
+
+    long long pos = source.tell();
+    source.seek(offset - 1, SEEK_SET);
+    bool result = (source.readChar() == '\n');
+    source.seek(pos, SEEK_SET);
+    return result;
+}
+
+void RecordOffsetIndex::save(Output& output, Scanner& source, Encoding filename_encoding, const char* source_filename, const Array<long long>& offsets,
+                             long long end_offset)
+{
+    _Fingerprint fingerprint;
+    _fingerprint(source, filename_encoding, source_filename, fingerprint);
+
+    output.write(_signature, (int)strlen(_signature));
+    _writeLong(output, fingerprint.length);
+    output.writeBinaryInt((int)fingerprint.head_crc);
+    output.writeBinaryInt((int)fingerprint.tail_crc);
+    _writeLong(output, fingerprint.mtime);
+    _writeLong(output, fingerprint.inode);
+
+    // Offsets are increasing, so they are stored as deltas
+    output.writePackedUInt(offsets.size());
+    long long prev = 0;
+    for (int i = 0; i < offsets.size(); i++)
+    {
+        if (offsets[i] < prev || offsets[i] - prev > 0xFFFFFFFFLL)
+            throw Error("unexpected record offset %lld", offsets[i]);
+        output.writePackedUInt((unsigned int)(offsets[i] - prev));
+        prev = offsets[i];
+    }
+    if (end_offset < prev || end_offset - prev > 0xFFFFFFFFLL)
+        throw Error("unexpected end offset %lld", end_offset);
+    output.writePackedUInt((unsigned int)(end_offset - prev));
+}
+
+bool RecordOffsetIndex::load(Scanner& input, Scanner& source, Encoding filename_encoding, const char* source_filename, Array<long long>& offsets,
+                             long long& end_offset)
+{
+    try
+    {
+        char signature[sizeof(_signature) - 1];
+        input.read(sizeof(signature), signature);
+        if (memcmp(signature, _signature, sizeof(signature)) != 0)
+            return false;
+
+        _Fingerprint saved;
+        saved.length = _readLong(input);
+        saved.head_crc = input.readBinaryDword();
+        saved.tail_crc = input.readBinaryDword();
+        saved.mtime = _readLong(input);
+        saved.inode = _readLong(input);
+
+        _Fingerprint current;
+        _fingerprint(source, filename_encoding, source_filename, current);
+        if (saved.length != current.length || saved.head_crc != current.head_crc || saved.tail_crc != current.tail_crc || saved.mtime != current.mtime ||
+            saved.inode != current.inode)
+            return false;
+
+        int count = input.readPackedUInt();
+        offsets.clear_resize(count);
+        long long prev = 0;
+        for (int i = 0; i < count; i++)
+            offsets[i] = prev = prev + input.readPackedUInt();
+        end_offset = prev + input.readPackedUInt();
+
+        // Records start at line beginnings; the first, the middle and the last offsets are checked
+        // rather than all of them, so that the check does not read the whole file
+        if (current.gzipped)
+            return true;
+        if (end_offset > current.length)
+            throw Error("end offset %lld is out of the file", end_offset);
+        if (count > 0 && (!_startsLine(source, offsets[0]) || !_startsLine(source, offsets[count / 2]) || !_startsLine(source, offsets[count - 1])))
+            throw Error("offsets do not start records");
+        return true;
+    }
+    catch (Exception&)
+    {
+        offsets.clear();
+        return false;
+    }
+}
@@ -0,0 +1,79 @@
+/****************************************************************************
+ * Copyright (C) from 2009 to Present EPAM Systems.
+ *
+ * This file is part of Indigo toolkit.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ***************************************************************************/
+
+#ifndef __record_offset_index_h__
+#define __record_offset_index_h__
+
+#include "base_cpp/array.h"
+#include "base_cpp/exception.h"
+#include "base_cpp/io_base.h"
+
+#ifdef _WIN32
+#pragma warning(push)
+#pragma warning(disable : 4251)
+#endif
+
+namespace indigo
+{
+
+    class Output;
+    class Scanner;
+
+    // Offsets of all the records of a multi-record file (SDF, RDF, SMILES),
+    // saved separately from it so that the records can be accessed by index
+    // without scanning the file. The index is bound to the source file by its
+    // length, the checksums of its head and tail and, when the source file name
+    // is given, its modification time and inode. The index is rejected when
+    // they do not match or when a stored offset does not start a line of an
+    // uncompressed source.
+    class DLLEXPORT RecordOffsetIndex
+    {
+    public:
+        // end_offset is the position where the scan of the source stopped.
+        // source_filename may be null for sources that are not files.
+        static void save(Output& output, Scanner& source, Encoding filename_encoding, const char* source_filename, const Array<long long>& offsets,
+                         long long end_offset);
+
+        // Returns false if the index was built for another file or is damaged
+        static bool load(Scanner& input, Scanner& source, Encoding filename_encoding, const char* source_filename, Array<long long>& offsets,
+                         long long& end_offset);
+
+        DECL_ERROR;
+
+    private:
+        struct _Fingerprint
+        {
+            long long length;
+            dword head_crc;
+            dword tail_crc;
+            long long mtime; // nanoseconds, zero if unknown
+            long long inode; // zero if unknown
+            bool gzipped;    // offsets refer to the decompressed data then
+        };
+
+        static void _fingerprint(Scanner& source, Encoding filename_encoding, const char* source_filename, _Fingerprint& fingerprint);
+        static bool _startsLine(Scanner& source, long long offset);
+    };
+
+} // namespace indigo
+
+#ifdef _WIN32
+#pragma warning(pop)
+#endif
+
+#endif
@@ -26,6 +26,18 @@
 
 #include <cppcodec/base64_default_rfc4648.hpp>
 
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #include "base_c/defs.h"
 #include "base_cpp/scanner.h"
 #include "base_cpp/tlscont.h"
@@ -35,7 +47,8 @@ using namespace indigo;
 
 enum
 {
-    MAX_LINE_LENGTH = 1048576
+    MAX_LINE_LENGTH = 1048576,
+    FILE_CACHE_SIZE = 65536
 };
 
 IMPL_ERROR(Scanner, "scanner");
@@ -573,6 +586,7 @@ void FileScanner::_init(Encoding filename_encoding, const char* filename)
 {
     _file = 0;
     _file_len = 0LL;
+    _cache.clear_resize(FILE_CACHE_SIZE);
 
     if (filename == 0)
         throw Error("null filename");
@@ -614,7 +628,7 @@ void FileScanner::_validateCache()
     if (_cache_pos < _max_cache)
         return;
 
-    size_t nread = fread(_cache, 1, NELEM(_cache), _file);
+    size_t nread = fread(_cache.ptr(), 1, _cache.size(), _file);
     _max_cache = static_cast<int>(nread);
     _cache_pos = 0;
 }
@@ -632,7 +646,7 @@ long long FileScanner::tell()
 void FileScanner::read(int length, void* res)
 {
     int to_read_from_cache = std::min(length, _max_cache - _cache_pos);
-    memcpy(res, _cache + _cache_pos, to_read_from_cache);
+    memcpy(res, _cache.ptr() + _cache_pos, to_read_from_cache);
     _cache_pos += to_read_from_cache;
 
     if (to_read_from_cache != length)
@@ -714,7 +728,7 @@ FileScanner::~FileScanner()
 // BufferScanner
 //
 
-void BufferScanner::_init(const char* buffer, int size)
+void BufferScanner::_init(const char* buffer, long long size)
 {
     if (size < -1 || (size > 0 && buffer == 0))
         throw Error("incorrect parameters in BufferScanner constructor");
@@ -744,16 +758,26 @@ BufferScanner::BufferScanner(const byte* buffer, int buffer_size, bool is_base64
     _init((const char*)buffer, buffer_size);
 }
 
+BufferScanner::BufferScanner(const char* buffer, long long buffer_size, bool is_base64) : _is_base64(is_base64)
+{
+    _init(buffer, buffer_size);
+}
+
+BufferScanner::BufferScanner(const byte* buffer, long long buffer_size, bool is_base64) : _is_base64(is_base64)
+{
+    _init((const char*)buffer, buffer_size);
+}
+
 BufferScanner::BufferScanner(const char* str, bool is_base64) : _is_base64(is_base64)
 {
     if (str == 0)
         throw Error("null input");
-    _init(str, (int)strlen(str));
+    _init(str, (long long)strlen(str));
 }
 
 BufferScanner::BufferScanner(const Array<char>& arr, bool is_base64) : _is_base64(is_base64)
 {
-    _init(arr.ptr(), arr.size());
+    _init(arr.ptr(), (long long)arr.size());
 }
 
 BufferScanner::~BufferScanner()
@@ -810,18 +834,18 @@ void BufferScanner::skip(int n)
 void BufferScanner::seek(long long pos, int from)
 {
     if (from == SEEK_SET)
-        _offset = static_cast<int>(pos);
+        _offset = pos;
     else if (from == SEEK_CUR)
-        _offset += static_cast<int>(pos);
+        _offset += pos;
     else // SEEK_END
     {
         if (_size < 0)
             throw Error("can not seek from end: buffer is unlimited");
-        _offset = _size - static_cast<int>(pos);
+        _offset = _size - pos;
     }
 
     if ((_size >= 0 && _offset > _size) || _offset < 0)
-        throw Error("size = %d, offset = %d after seek()", _size, _offset);
+        throw Error("size = %lld, offset = %lld after seek()", _size, _offset);
 }
 
 byte BufferScanner::readByte()
@@ -832,6 +856,216 @@ byte BufferScanner::readByte()
     return _buffer[_offset++];
 }
 
+char BufferScanner::readChar()
+{
+    if (_size >= 0 && _offset >= _size)
+        throw Error("readChar(): end of buffer");
+
+    return _buffer[_offset++];
+}
+
+// Same as Scanner::appendLine() but looks for the line end directly in the buffer
+void BufferScanner::appendLine(Array<char>& out, bool append_zero)
+{
+    if (_size < 0)
+    {
+        Scanner::appendLine(out, append_zero);
+        return;
+    }
+
+    if (isEOF())
+        throw Error("appendLine(): end of stream");
+
+    if (out.size() > 0)
+        while (out.top() == 0)
+            out.pop();
+
+    const char* begin = _buffer + _offset;
+    const char* end = _buffer + _size;
+    const char* p = begin;
+
+    while (p < end && *p != '\n' && *p != '\r')
+        p++;
+
+    if (out.size() + (p - begin) > MAX_LINE_LENGTH)
+        throw Error("Line length is too long. Probably the file format is not correct.");
+
+    out.concat(begin, (int)(p - begin));
+
+    _offset = p - _buffer;
+    if (p < end)
+    {
+        _offset++;
+        if (*p == '\r' && p + 1 < end && p[1] == '\n')
+            _offset++;
+    }
+
+    if (append_zero)
+        out.push(0);
+}
+
+bool BufferScanner::skipLine()
+{
+    if (_size < 0)
+        return Scanner::skipLine();
+
+    if (isEOF())
+        return false;
+
+    const char* end = _buffer + _size;
+    const char* p = _buffer + _offset;
+
+    while (p < end && *p != '\n' && *p != '\r')
+        p++;
+
+    _offset = p - _buffer;
+    if (p == end)
+        return false;
+
+    _offset++;
+    if (p + 1 < end && p[1] == (*p == '\n' ? '\r' : '\n'))
+        _offset++;
+    return true;
+}
+
+//
+// MappedFileScanner
+//
+
+MappedFileScanner::MappedFileScanner(Encoding filename_encoding, const char* filename) : BufferScanner((const char*)0, 0LL)
+{
+    _map(filename_encoding, filename);
+}
+
+MappedFileScanner::MappedFileScanner(const char* filename) : BufferScanner((const char*)0, 0LL)
+{
+    _map(ENCODING_ASCII, filename);
+}
+
+#ifdef _WIN32
+
+void MappedFileScanner::_map(Encoding filename_encoding, const char* filename)
+{
+    _mapping = 0;
+    _mapping_size = 0;
+
+    if (filename == 0)
+        throw Error("null filename");
+
+    HANDLE file = INVALID_HANDLE_VALUE;
+    if (filename_encoding == ENCODING_UTF8)
+    {
+        wchar_t w_filename[1024];
+        MultiByteToWideChar(CP_UTF8, 0, filename, -1, w_filename, 1024);
+        file = CreateFileW(w_filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    }
+    else
+        file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+    if (file == INVALID_HANDLE_VALUE)
+        throw Error("can't open file %s", filename);
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || GetFileType(file) != FILE_TYPE_DISK)
+    {
+        CloseHandle(file);
+        throw Error("can't map file %s: not a regular file", filename);
+    }
+
+    if (size.QuadPart > 0)
+    {
+        // The view keeps the mapping alive after the handles are closed
+        HANDLE mapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping != NULL)
+        {
+            _mapping = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            CloseHandle(mapping);
+        }
+        CloseHandle(file);
+
+        if (_mapping == 0)
+            throw Error("can't map file %s", filename);
+        _mapping_size = size.QuadPart;
+    }
+    else
+        CloseHandle(file);
+
+    _init((const char*)_mapping, _mapping_size);
+}
+
+MappedFileScanner::~MappedFileScanner()
+{
+    if (_mapping != 0)
+        UnmapViewOfFile(_mapping);
+}
+
+#else
+
+void MappedFileScanner::_map(Encoding filename_encoding, const char* filename)
+{
+    _mapping = 0;
+    _mapping_size = 0;
+
+    if (filename == 0)
+        throw Error("null filename");
+
+    int fd = ::open(filename, O_RDONLY);
+    if (fd == -1)
+        throw Error("can't open file %s. Error: %s", filename, strerror(errno));
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+    {
+        close(fd);
+        throw Error("can't map file %s: not a regular file", filename);
+    }
+
+    if (st.st_size > 0)
+    {
+        if ((unsigned long long)st.st_size > std::numeric_limits<size_t>::max())
+        {
+            close(fd);
+            throw Error("can't map file %s: file is too large", filename);
+        }
+
+        // The mapping stays valid after the descriptor is closed
+        void* mapping = mmap(0, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+
+        if (mapping == MAP_FAILED)
+            throw Error("can't map file %s. Error: %s", filename, strerror(errno));
+
+        madvise(mapping, (size_t)st.st_size, MADV_SEQUENTIAL);
+        _mapping = mapping;
+        _mapping_size = st.st_size;
+    }
+    else
+        close(fd);
+
+    _init((const char*)_mapping, _mapping_size);
+}
+
+MappedFileScanner::~MappedFileScanner()
+{
+    if (_mapping != 0)
+        munmap(_mapping, (size_t)_mapping_size);
+}
+
+#endif
+
+std::unique_ptr<Scanner> MappedFileScanner::open(Encoding filename_encoding, const char* filename)
+{
+    try
+    {
+        return std::make_unique<MappedFileScanner>(filename_encoding, filename);
+    }
+    catch (Exception&)
+    {
+        // Pipes, devices and files that do not fit into the address space
+        return std::make_unique<FileScanner>(filename_encoding, filename);
+    }
+}
+
 void Scanner::_prefixFunction(Array<char>& str, Array<int>& prefix)
 {
     prefix.clear();
@@ -23,6 +23,7 @@
 #include "base_cpp/io_base.h"
 #include "base_cpp/obj_array.h"
 #include "base_cpp/reusable_obj_array.h"
+#include <memory>
 #include <stdio.h>
 
 namespace indigo
@@ -50,8 +51,8 @@ namespace indigo
         void read(int length, Array<char>& buf);
 
         void readLine(Array<char>& out, bool append_zero);
-        void appendLine(Array<char>& out, bool append_zero);
-        bool skipLine();
+        virtual void appendLine(Array<char>& out, bool append_zero);
+        virtual bool skipLine();
 
         virtual char readChar();
         word readBinaryWord();
@@ -112,7 +113,7 @@ namespace indigo
         FILE* _file;
         long long _file_len;
 
-        unsigned char _cache[1024];
+        Array<unsigned char> _cache;
         int _cache_pos, _max_cache;
 
         void _validateCache();
@@ -128,6 +129,8 @@ namespace indigo
     public:
         explicit BufferScanner(const char* buffer, int buffer_size, bool is_base64 = false);
         explicit BufferScanner(const byte* buffer, int buffer_size, bool is_base64 = false);
+        explicit BufferScanner(const char* buffer, long long buffer_size, bool is_base64 = false);
+        explicit BufferScanner(const byte* buffer, long long buffer_size, bool is_base64 = false);
         explicit BufferScanner(const char* str, bool is_base64 = false);
         explicit BufferScanner(const Array<char>& arr, bool is_base64 = false);
         ~BufferScanner() override;
@@ -140,21 +143,51 @@ namespace indigo
         long long length() override;
         long long tell() override;
         byte readByte() override;
+        char readChar() override;
+
+        void appendLine(Array<char>& out, bool append_zero) override;
+        bool skipLine() override;
 
         const void* curptr();
 
+    protected:
+        void _init(const char* buffer, long long length);
+
     private:
         const char* _buffer;
-        int _size;
-        int _offset;
+        long long _size;
+        long long _offset;
         bool _is_base64;
         Array<char> _base64_buffer;
-        void _init(const char* buffer, int length);
 
         // no implicit copy
         BufferScanner(const BufferScanner&);
     };
 
+    // Scanner over a read-only memory mapping of the whole file. Reading,
+    // skipping and seeking are done in memory without system calls, and the
+    // pages are read ahead by the OS because the mapping is sequential.
+    class DLLEXPORT MappedFileScanner : public BufferScanner
+    {
+    public:
+        MappedFileScanner(Encoding filename_encoding, const char* filename);
+        explicit MappedFileScanner(const char* filename);
+        ~MappedFileScanner() override;
+
+        // Returns MappedFileScanner for regular files that can be mapped and
+        // FileScanner for everything else
+        static std::unique_ptr<Scanner> open(Encoding filename_encoding, const char* filename);
+
+    private:
+        void _map(Encoding filename_encoding, const char* filename);
+
+        void* _mapping;
+        long long _mapping_size;
+
+        // no implicit copy
+        MappedFileScanner(const MappedFileScanner&);
+    };
+
 } // namespace indigo
 
 #endif
@@ -19,6 +19,8 @@
 #ifndef __tlscont_h__
 #define __tlscont_h__
 
+#include <atomic>
+#include <cstdint>
 #include <memory>
 #include <stack>
 #include <typeinfo>
@@ -76,42 +78,118 @@ namespace indigo
 #define TL_ALLOC_SESSION_ID() _SIDManager::getInst().allocSessionId()
 #define TL_RELEASE_SESSION_ID(id) _SIDManager::getInst().releaseSessionId(id)
 
-    // Container that keeps one instance of specified type per session
+    // Container that keeps one instance of specified type per session.
+    // The instance found last is remembered in a small per-thread cache, so
+    // repeated accesses from the same thread and session skip the locked map.
+    // Every removal changes the generation of the container, which drops
+    // the cached instances in all threads.
     template <typename T>
     class _SessionLocalContainer
     {
     public:
+        _SessionLocalContainer() : _generation(_nextGeneration())
+        {
+        }
+
         T& createOrGetLocalCopy(const qword id = TL_GET_SESSION_ID())
         {
+            T* cached = _findCached(id);
+            if (cached != nullptr)
+            {
+                return *cached;
+            }
+
             auto map = sf::xlock_safe_ptr(_map);
             if (!map->count(id))
             {
                 map->emplace(id, std::make_unique<T>());
             }
-            return *map->at(id);
+            T* copy = map->at(id).get();
+            _setCached(id, copy);
+            return *copy;
         }
 
         // FIXME:MK: it's not thread safe, decide what to do
         T& getLocalCopy(const qword id = TL_GET_SESSION_ID()) const
         {
+            T* cached = _findCached(id);
+            if (cached != nullptr)
+            {
+                return *cached;
+            }
+
             const auto map = sf::slock_safe_ptr(_map);
-            return *map->at(id);
+            T* copy = map->at(id).get();
+            _setCached(id, copy);
+            return *copy;
         }
 
         void removeLocalCopy(const qword id = TL_GET_SESSION_ID())
         {
             auto map = sf::xlock_safe_ptr(_map);
             map->erase(id);
+            _generation.store(_nextGeneration(), std::memory_order_release);
         }
 
         bool hasLocalCopy(const qword id = TL_GET_SESSION_ID()) const
         {
+            if (_findCached(id) != nullptr)
+            {
+                return true;
+            }
+
             const auto map = sf::slock_safe_ptr(_map);
             return map->count(id) > 0;
         }
 
     private:
+        struct _CacheEntry
+        {
+            const _SessionLocalContainer* owner;
+            qword id;
+            qword generation;
+            T* copy;
+        };
+
+        enum
+        {
+            _CACHE_SIZE = 8
+        };
+
+        static qword _nextGeneration()
+        {
+            static std::atomic<qword> last_generation(0);
+            return ++last_generation;
+        }
+
+        _CacheEntry& _cacheEntry() const
+        {
+            thread_local _CacheEntry cache[_CACHE_SIZE] = {};
+            return cache[(reinterpret_cast<uintptr_t>(this) / sizeof(void*)) % _CACHE_SIZE];
+        }
+
+        T* _findCached(qword id) const
+        {
+            const _CacheEntry& entry = _cacheEntry();
+            if (entry.owner == this && entry.id == id && entry.generation == _generation.load(std::memory_order_acquire))
+            {
+                return entry.copy;
+            }
+            return nullptr;
+        }
+
+        // Called under the map lock, so the generation can't change meanwhile
+        void _setCached(qword id, T* copy) const
+        {
+            _CacheEntry& entry = _cacheEntry();
+            entry.owner = this;
+            entry.id = id;
+            entry.generation = _generation.load(std::memory_order_acquire);
+            entry.copy = copy;
+        }
+
         sf::safe_shared_hide_obj<std::unordered_map<qword, std::unique_ptr<T>>> _map;
+        std::atomic<qword> _generation;
     };
 
 // Macros for working with global variables per each session
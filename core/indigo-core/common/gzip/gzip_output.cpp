@@ -18,6 +18,8 @@
 
 #include "gzip/gzip_output.h"
 
+#include <algorithm>
+
 using namespace indigo;
 
 IMPL_ERROR(GZipOutput, "GZip output");
@@ -117,3 +119,114 @@ long long GZipOutput::tell() const noexcept
 {
     return _total_written;
 }
+
+IMPL_ERROR(BlockGZipOutput, "block GZip output");
+
+CP_DEF(BlockGZipOutput);
+
+BlockGZipOutput::BlockGZipOutput(Output& dest, int level) : _dest(dest), CP_INIT, TL_CP_GET(_outbuf), TL_CP_GET(_inbuf)
+{
+    _zstream.zalloc = Z_NULL;
+    _zstream.zfree = Z_NULL;
+    _zstream.opaque = Z_NULL;
+    _zstream.next_in = Z_NULL;
+    _zstream.avail_in = 0;
+
+    // Blocks are raw deflate data; the gzip header and trailer are written here
+    int rc = deflateInit2(&_zstream, level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+
+    if (rc == Z_VERSION_ERROR)
+        throw Error("zlib version incompatible");
+    if (rc == Z_MEM_ERROR)
+        throw Error("not enough memory for zlib");
+    if (rc == Z_STREAM_ERROR)
+        throw Error("invalid parameter given to zlib");
+    if (rc != Z_OK)
+        throw Error("unknown zlib error code: %d", rc);
+
+    _outbuf.clear_resize(MAX_BLOCK_SIZE);
+    _inbuf.clear();
+    _total_written = 0;
+}
+
+BlockGZipOutput::~BlockGZipOutput()
+{
+    try
+    {
+        if (_inbuf.size() > 0)
+            _writeBlock();
+        // An empty block marks the end of BGZF data
+        _writeBlock();
+    }
+    catch (Exception&)
+    {
+    }
+
+    deflateEnd(&_zstream);
+}
+
+void BlockGZipOutput::write(const void* data, int size)
+{
+    const char* ptr = (const char*)data;
+
+    while (size > 0)
+    {
+        int n = std::min(size, (int)BLOCK_SIZE - _inbuf.size());
+        _inbuf.concat((const Bytef*)ptr, n);
+        ptr += n;
+        size -= n;
+
+        if (_inbuf.size() == BLOCK_SIZE)
+            _writeBlock();
+    }
+}
+
+void BlockGZipOutput::flush()
+{
+    if (_inbuf.size() > 0)
+        _writeBlock();
+    _dest.flush();
+}
+
+long long BlockGZipOutput::tell() const noexcept
+{
+    return _total_written;
+}
+
+void BlockGZipOutput::_writeBlock()
+{
+    static const int HEADER_SIZE = 18;
+    static const int TRAILER_SIZE = 8;
+
+    deflateReset(&_zstream);
+    _zstream.next_in = _inbuf.ptr();
+    _zstream.avail_in = _inbuf.size();
+    _zstream.next_out = _outbuf.ptr() + HEADER_SIZE;
+    _zstream.avail_out = _outbuf.size() - HEADER_SIZE - TRAILER_SIZE;
+
+    // BLOCK_SIZE is small enough for incompressible data to fit
+    int rc = deflate(&_zstream, Z_FINISH);
+    if (rc != Z_STREAM_END)
+        throw Error("unexpected zlib error (%d)", rc);
+
+    int block_size = HEADER_SIZE + (int)_zstream.total_out + TRAILER_SIZE;
+    uLong crc = crc32(0, _inbuf.ptr(), _inbuf.size());
+
+    // gzip header with the FEXTRA flag and the "BC" subfield
+    static const Bytef header[] = {0x1f, 0x8b, Z_DEFLATED, 4, 0, 0, 0, 0, 0, 0xff, 6, 0, 'B', 'C', 2, 0};
+    Bytef* ptr = _outbuf.ptr();
+    memcpy(ptr, header, sizeof(header));
+    ptr[16] = (Bytef)((block_size - 1) & 0xff);
+    ptr[17] = (Bytef)((block_size - 1) >> 8);
+
+    ptr = _outbuf.ptr() + block_size - TRAILER_SIZE;
+    for (int i = 0; i < 4; i++)
+    {
+        ptr[i] = (Bytef)(crc >> (8 * i));
+        ptr[4 + i] = (Bytef)((dword)_inbuf.size() >> (8 * i));
+    }
+
+    _dest.write(_outbuf.ptr(), block_size);
+    _total_written += block_size;
+    _inbuf.clear();
+}
@@ -56,6 +56,40 @@ namespace indigo
         TL_CP_DECL(Array<Bytef>, _inbuf);
     };
 
+    // Writes BGZF: a series of gzip members holding up to BLOCK_SIZE bytes
+    // each, with the compressed block size in the header. Any gzip reader can
+    // read it, and GZipScanner can seek in it and inflate it in parallel.
+    class BlockGZipOutput : public Output
+    {
+    public:
+        enum
+        {
+            BLOCK_SIZE = 65280,
+            MAX_BLOCK_SIZE = 65536
+        };
+
+        explicit BlockGZipOutput(Output& dest, int level);
+        ~BlockGZipOutput() override;
+
+        void write(const void* data, int size) override;
+        long long tell() const noexcept override;
+        // Closes the current block
+        void flush() override;
+
+        DECL_ERROR;
+
+    protected:
+        Output& _dest;
+        z_stream _zstream;
+        long long _total_written;
+
+        void _writeBlock();
+
+        CP_DECL;
+        TL_CP_DECL(Array<Bytef>, _outbuf);
+        TL_CP_DECL(Array<Bytef>, _inbuf);
+    };
+
 } // namespace indigo
 
 #endif
@@ -17,7 +17,13 @@
  ***************************************************************************/
 
 #include "gzip/gzip_scanner.h"
+
 #include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 using namespace indigo;
 
@@ -25,6 +31,148 @@ IMPL_ERROR(GZipScanner, "GZip scanner");
 
 CP_DEF(GZipScanner);
 
+namespace
+{
+    // Deflate data of one BGZF block and the place for its output
+    struct InflateTask
+    {
+        const Bytef* in;
+        int in_size;
+        Bytef* out;
+        int out_size;
+        dword crc;
+    };
+
+    void inflateBlock(const InflateTask& task)
+    {
+        if (task.out_size == 0)
+            return;
+
+        z_stream zstream;
+        zstream.zalloc = Z_NULL;
+        zstream.zfree = Z_NULL;
+        zstream.opaque = Z_NULL;
+        zstream.next_in = Z_NULL;
+        zstream.avail_in = 0;
+
+        if (inflateInit2(&zstream, -MAX_WBITS) != Z_OK)
+            throw GZipScanner::Error("can not initialize zlib");
+
+        zstream.next_in = (Bytef*)task.in;
+        zstream.avail_in = task.in_size;
+        zstream.next_out = task.out;
+        zstream.avail_out = task.out_size;
+
+        int rc = inflate(&zstream, Z_FINISH);
+        bool complete = (rc == Z_STREAM_END && zstream.avail_out == 0);
+        inflateEnd(&zstream);
+
+        if (!complete)
+            throw GZipScanner::Error("corrupted input data");
+        if (crc32(0, task.out, task.out_size) != task.crc)
+            throw GZipScanner::Error("block checksum mismatch");
+    }
+
+    dword readDword(const Bytef* ptr)
+    {
+        return ptr[0] | (ptr[1] << 8) | (ptr[2] << 16) | ((dword)ptr[3] << 24);
+    }
+}
+
+// Threads that inflate the blocks of every batch together with the reading
+// thread. They are started once per scanner, and wait for the next batch.
+struct GZipScanner::InflatePool
+{
+    explicit InflatePool(int threads)
+    {
+        for (int i = 0; i < threads; i++)
+            workers.emplace_back([this]() { threadFunc(); });
+    }
+
+    ~InflatePool()
+    {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stop = true;
+        }
+        start.notify_all();
+        for (auto& thread : workers)
+            thread.join();
+    }
+
+    // Inflates the tasks and rethrows the first error caught in any thread
+    void run(const std::vector<InflateTask>& batch)
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        tasks = &batch;
+        next = 0;
+        error = nullptr;
+        batch_number++;
+        start.notify_all();
+
+        inflateTasks(guard);
+        done.wait(guard, [this]() { return active == 0; });
+        tasks = nullptr;
+
+        if (error)
+            std::rethrow_exception(error);
+    }
+
+    void threadFunc()
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        int last_batch = 0;
+
+        while (true)
+        {
+            start.wait(guard, [&]() { return stop || batch_number != last_batch; });
+            if (stop)
+                return;
+            last_batch = batch_number;
+            inflateTasks(guard);
+        }
+    }
+
+    // Takes the tasks of the current batch until there are none left
+    void inflateTasks(std::unique_lock<std::mutex>& guard)
+    {
+        while (tasks != nullptr && next < (int)tasks->size())
+        {
+            const InflateTask& task = (*tasks)[next++];
+            active++;
+            guard.unlock();
+            std::exception_ptr task_error;
+            try
+            {
+                inflateBlock(task);
+            }
+            catch (...)
+            {
+                task_error = std::current_exception();
+            }
+            guard.lock();
+            if (task_error && !error)
+            {
+                error = task_error;
+                next = (int)tasks->size();
+            }
+            if (--active == 0)
+                done.notify_all();
+        }
+    }
+
+    std::vector<std::thread> workers;
+    std::mutex lock;
+    std::condition_variable start;
+    std::condition_variable done;
+    const std::vector<InflateTask>* tasks = nullptr;
+    int next = 0;
+    int active = 0;
+    int batch_number = 0;
+    bool stop = false;
+    std::exception_ptr error;
+};
+
 GZipScanner::GZipScanner(Scanner& source) : _source(source), CP_INIT, TL_CP_GET(_inbuf), TL_CP_GET(_outbuf)
 {
     _zstream.zalloc = Z_NULL;
@@ -45,12 +193,19 @@ GZipScanner::GZipScanner(Scanner& source) : _source(source), CP_INIT, TL_CP_GET(
     _outbuf.clear_resize(CHUNK_SIZE);
     _inbuf.clear_resize(CHUNK_SIZE);
     _outbuf_start = 0;
-    _inbuf_end = 0;
-    _uncompressed_total = 0;
+    _outbuf_end = 0;
+    _outbuf_offset = 0;
+    _inbuf_offset = _source.tell();
+    _mode = MODE_UNKNOWN;
+    _threads = 1;
+    _random_access = false;
+    _trailer_left = 0;
+    _member_end = true;
+    _raw = false;
     _eof = false;
+    _points.clear();
 
-    _zstream.avail_out = _outbuf.size();
-    _zstream.next_out = _outbuf.ptr();
+    _zstream.next_in = _inbuf.ptr();
 }
 
 GZipScanner::~GZipScanner()
@@ -58,157 +213,441 @@ GZipScanner::~GZipScanner()
     inflateEnd(&_zstream);
 }
 
-void GZipScanner::read(int length, void* res)
+void GZipScanner::setThreads(int threads)
 {
-    if (res == 0)
-        throw Error("zero pointer given");
+    _threads = std::max(threads, 1);
+}
+
+void GZipScanner::setRandomAccess(bool enable)
+{
+    _random_access = enable;
+}
+
+bool GZipScanner::_fill()
+{
+    if (_eof)
+        return false;
 
-    if (_outbuf_start < _outbuf.size() - (int)_zstream.avail_out)
+    if (_mode == MODE_UNKNOWN)
     {
-        int n = std::min(length, CHUNK_SIZE - (int)_zstream.avail_out - _outbuf_start);
+        _mode = MODE_STREAM;
 
-        memcpy(res, _outbuf.ptr() + _outbuf_start, n);
-        _outbuf_start += n;
-        _uncompressed_total += n;
-        length -= n;
-        res = (char*)res + n;
+        // Only BGZF blocks can be inflated independently
+        if (_threads > 1)
+        {
+            long long pos = _source.tell();
+            Array<Bytef> header;
+            int block_size;
+
+            if (_source.length() - pos >= 12)
+            {
+                header.clear_resize(12);
+                _source.read(12, header.ptr());
+                int xlen = header[10] | (header[11] << 8);
+                if (_source.length() - _source.tell() >= xlen)
+                {
+                    header.resize(12 + xlen);
+                    _source.read(xlen, header.ptr() + 12);
+                    if (_isBlockHeader(header.ptr(), header.size(), block_size))
+                        _mode = MODE_BLOCKS;
+                }
+            }
+            _source.seek(pos, SEEK_SET);
+        }
     }
 
-    if (!_read(length, res))
-        throw Error("end of compressed data");
+    while (_mode == MODE_BLOCKS ? _fillBlocks() : _fillStream())
+    {
+        if (_outbuf_end > 0)
+            return true;
+    }
+    return false;
 }
 
-bool GZipScanner::_read(int length, void* res)
+bool GZipScanner::_refillInput()
 {
-    while (length > 0)
+    int left = _zstream.avail_in;
+
+    memmove(_inbuf.ptr(), _zstream.next_in, left);
+    _inbuf_offset += _zstream.next_in - _inbuf.ptr();
+    _zstream.next_in = _inbuf.ptr();
+
+    int n = (int)std::min(_source.length() - _source.tell(), (long long)(_inbuf.size() - left));
+    if (n <= 0)
+        return false;
+
+    _source.read(n, _inbuf.ptr() + left);
+    _zstream.avail_in = left + n;
+    return true;
+}
+
+bool GZipScanner::_startMember(long long out_offset)
+{
+    // zlib does not consume the trailer of a member inflated in raw mode
+    while (_trailer_left > 0)
     {
-        if (_eof)
-            return false;
+        if (_zstream.avail_in == 0 && !_refillInput())
+            throw Error("end of file in source stream");
+        int n = std::min(_trailer_left, (int)_zstream.avail_in);
+        _zstream.next_in += n;
+        _zstream.avail_in -= n;
+        _trailer_left -= n;
+    }
 
-        if (_zstream.avail_in == 0)
-        {
-            _inbuf_end = 0;
+    while (_zstream.avail_in < 2 && _refillInput())
+        ;
 
-            if (_source.isEOF())
-                throw Error("end of file in source stream");
+    if (_zstream.avail_in < 2 || _zstream.next_in[0] != 0x1f || _zstream.next_in[1] != 0x8b)
+    {
+        if (_points.size() == 0)
+            throw Error("end of file in source stream");
+        // Like gzip, ignore the data after the last member
+        return false;
+    }
 
-            do
-            {
-                _inbuf[_inbuf_end++] = _source.readChar();
-            } while (!_source.isEOF() && _inbuf_end < _inbuf.size());
-            _zstream.avail_in = _inbuf_end;
-            _zstream.next_in = _inbuf.ptr();
+    _addAccessPoint(out_offset, _inbuf_offset + (_zstream.next_in - _inbuf.ptr()), -1);
+
+    inflateReset2(&_zstream, 16 + MAX_WBITS);
+    _raw = false;
+    _member_end = false;
+    return true;
+}
+
+bool GZipScanner::_fillStream()
+{
+    _outbuf_offset += _outbuf_end;
+    _outbuf_start = 0;
+    _outbuf_end = 0;
+    _zstream.next_out = _outbuf.ptr();
+    _zstream.avail_out = _outbuf.size();
+
+    while (_zstream.avail_out > 0)
+    {
+        long long out_offset = _outbuf_offset + _outbuf.size() - _zstream.avail_out;
+
+        if (_member_end && !_startMember(out_offset))
+        {
+            _eof = true;
+            break;
         }
 
-        _zstream.avail_out = _outbuf.size();
-        _zstream.next_out = _outbuf.ptr();
-        _outbuf_start = 0;
+        if (_zstream.avail_in == 0 && !_refillInput())
+            throw Error("end of file in source stream");
 
-        int rc = inflate(&_zstream, Z_NO_FLUSH);
+        // Z_BLOCK stops at deflate block boundaries to collect access points
+        int rc = inflate(&_zstream, Z_BLOCK);
 
         if (rc == Z_STREAM_ERROR)
             throw Error("inconsistent stream structure");
-
         if (rc == Z_NEED_DICT)
-        {
-            inflateEnd(&_zstream);
             throw Error("need a dictionary");
-        }
-
         if (rc == Z_MEM_ERROR)
-        {
-            inflateEnd(&_zstream);
             throw Error("not enough memory");
-        }
-
         if (rc == Z_DATA_ERROR)
-        {
-            inflateEnd(&_zstream);
             throw Error("corrupted input data");
-        }
-
         if (rc == Z_BUF_ERROR)
             throw Error("Z_BUF_ERROR (workaround not implemented)");
-
         if (rc != Z_OK && rc != Z_STREAM_END)
             throw Error("unknown zlib error code: %d", rc);
 
-        int n = std::min(length, CHUNK_SIZE - (int)_zstream.avail_out - _outbuf_start);
+        if (rc == Z_STREAM_END)
+        {
+            _member_end = true;
+            if (_raw)
+                _trailer_left = 8;
+        }
+        else if (_random_access && (_zstream.data_type & 128) && !(_zstream.data_type & 64))
+        {
+            out_offset = _outbuf_offset + _outbuf.size() - _zstream.avail_out;
+            if (out_offset - _points.top().out_offset >= ACCESS_POINT_SPAN)
+                _addAccessPoint(out_offset, _inbuf_offset + (_zstream.next_in - _inbuf.ptr()), _zstream.data_type & 7);
+        }
+    }
+
+    _outbuf_end = _outbuf.size() - _zstream.avail_out;
+    return _outbuf_end > 0 || !_eof;
+}
 
-        if (n > 0 && res != 0)
+bool GZipScanner::_isBlockHeader(const Bytef* header, int size, int& block_size)
+{
+    if (size < 12 || header[0] != 0x1f || header[1] != 0x8b || header[2] != Z_DEFLATED || !(header[3] & 4))
+        return false;
+
+    // BGZF keeps the block size in the "BC" extra subfield
+    int end = std::min(size, 12 + (header[10] | (header[11] << 8)));
+    for (int i = 12; i + 4 <= end;)
+    {
+        int len = header[i + 2] | (header[i + 3] << 8);
+        if (header[i] == 'B' && header[i + 1] == 'C' && len == 2 && i + 6 <= end)
         {
-            memcpy(res, _outbuf.ptr(), n);
-            _outbuf_start += n;
-            _uncompressed_total += n;
-            res = (char*)res + n;
+            block_size = (header[i + 4] | (header[i + 5] << 8)) + 1;
+            return true;
         }
+        i += 4 + len;
+    }
+    return false;
+}
 
-        length -= n;
+bool GZipScanner::_fillBlocks()
+{
+    _outbuf_offset += _outbuf_end;
+    _outbuf_start = 0;
+    _outbuf_end = 0;
 
-        if (rc == Z_STREAM_END)
-            _eof = true;
+    // Blocks are read in this thread and inflated in parallel
+    std::vector<InflateTask> tasks;
+    std::vector<int> in_starts;
+    int in_size = 0;
+    int out_size = 0;
+
+    _inbuf.clear();
+    while ((int)tasks.size() < _threads * 4)
+    {
+        long long in_offset = _source.tell();
+        long long left = _source.length() - in_offset;
+        if (left == 0)
+            break;
+        if (left < 12)
+            throw Error("end of file in source stream");
+
+        _inbuf.resize(in_size + 12);
+        _source.read(12, _inbuf.ptr() + in_size);
+        int xlen = _inbuf[in_size + 10] | (_inbuf[in_size + 11] << 8);
+        if (left < 12 + xlen)
+            throw Error("end of file in source stream");
+        _inbuf.resize(in_size + 12 + xlen);
+        _source.read(xlen, _inbuf.ptr() + in_size + 12);
+
+        int block_size;
+        if (!_isBlockHeader(_inbuf.ptr() + in_size, 12 + xlen, block_size))
+            throw Error("corrupted input data");
+        if (block_size < 12 + xlen + 8 || left < block_size)
+            throw Error("end of file in source stream");
+
+        _inbuf.resize(in_size + block_size);
+        _source.read(block_size - 12 - xlen, _inbuf.ptr() + in_size + 12 + xlen);
+
+        _addAccessPoint(_outbuf_offset + out_size, in_offset, -1);
+
+        const Bytef* trailer = _inbuf.ptr() + in_size + block_size - 8;
+        dword isize = readDword(trailer + 4);
+        if (isize > BLOCK_DATA_SIZE)
+            throw Error("corrupted input data");
+
+        InflateTask task;
+        task.in_size = block_size - 12 - xlen - 8;
+        task.out_size = (int)isize;
+        task.crc = readDword(trailer);
+        tasks.push_back(task);
+        in_starts.push_back(in_size + 12 + xlen);
+
+        in_size += block_size;
+        out_size += task.out_size;
     }
 
+    if (tasks.empty())
+    {
+        _eof = true;
+        return false;
+    }
+
+    // The buffers do not move any more, so the tasks can point into them
+    _outbuf.clear_resize(out_size);
+    for (int i = 0, out_start = 0; i < (int)tasks.size(); i++)
+    {
+        tasks[i].in = _inbuf.ptr() + in_starts[i];
+        tasks[i].out = _outbuf.ptr() + out_start;
+        out_start += tasks[i].out_size;
+    }
+
+    if (!_pool)
+        _pool = std::make_unique<InflatePool>(_threads - 1);
+    _pool->run(tasks);
+
+    _outbuf_end = out_size;
     return true;
 }
 
+void GZipScanner::_addAccessPoint(long long out_offset, long long in_offset, int bits)
+{
+    // Points are collected in the order of offsets; after a backward seek
+    // the data is read again and the points are already known
+    if (_points.size() > 0 && _points.top().out_offset >= out_offset)
+        return;
+
+    AccessPoint& point = _points.push();
+    point.out_offset = out_offset;
+    point.in_offset = in_offset;
+    point.bits = bits;
+    point.window.clear();
+
+    if (bits >= 0)
+    {
+        uInt size = 0;
+        inflateGetDictionary(&_zstream, Z_NULL, &size);
+        point.window.clear_resize(size);
+        inflateGetDictionary(&_zstream, point.window.ptr(), &size);
+    }
+}
+
+void GZipScanner::_restore(const AccessPoint& point)
+{
+    _source.seek(point.in_offset - (point.bits > 0 ? 1 : 0), SEEK_SET);
+    _inbuf_offset = _source.tell();
+    _zstream.next_in = _inbuf.ptr();
+    _zstream.avail_in = 0;
+
+    _outbuf_offset = point.out_offset;
+    _outbuf_start = 0;
+    _outbuf_end = 0;
+    _trailer_left = 0;
+    _eof = false;
+
+    if (_mode == MODE_BLOCKS)
+        return;
+
+    if (point.bits < 0)
+    {
+        _raw = false;
+        _member_end = true;
+        return;
+    }
+
+    // Resume inside a member as raw deflate data
+    inflateReset2(&_zstream, -MAX_WBITS);
+    if (point.bits > 0)
+    {
+        if (!_refillInput())
+            throw Error("end of file in source stream");
+        int value = *_zstream.next_in;
+        _zstream.next_in++;
+        _zstream.avail_in--;
+        inflatePrime(&_zstream, point.bits, value >> (8 - point.bits));
+    }
+    if (point.window.size() > 0)
+        inflateSetDictionary(&_zstream, point.window.ptr(), point.window.size());
+    _raw = true;
+    _member_end = false;
+}
+
+void GZipScanner::_skipForward(long long pos)
+{
+    while (tell() < pos)
+    {
+        if (_outbuf_start == _outbuf_end && !_fill())
+            throw Error("end of compressed data");
+        _outbuf_start += (int)std::min(pos - tell(), (long long)(_outbuf_end - _outbuf_start));
+    }
+}
+
+void GZipScanner::read(int length, void* res)
+{
+    if (res == 0)
+        throw Error("zero pointer given");
+
+    while (length > 0)
+    {
+        if (_outbuf_start == _outbuf_end && !_fill())
+            throw Error("end of compressed data");
+
+        int n = std::min(length, _outbuf_end - _outbuf_start);
+        memcpy(res, _outbuf.ptr() + _outbuf_start, n);
+        _outbuf_start += n;
+        length -= n;
+        res = (char*)res + n;
+    }
+}
+
+char GZipScanner::readChar()
+{
+    if (_outbuf_start < _outbuf_end)
+        return (char)_outbuf[_outbuf_start++];
+
+    char c;
+    read(1, &c);
+    return c;
+}
+
 void GZipScanner::readAll(Array<char>& arr)
 {
     arr.clear();
 
     while (!isEOF())
-        arr.push(readByte());
+    {
+        arr.concat((const char*)_outbuf.ptr() + _outbuf_start, _outbuf_end - _outbuf_start);
+        _outbuf_start = _outbuf_end;
+    }
 }
 
 void GZipScanner::skip(int length)
 {
-    QS_DEF(Array<char>, dummy);
-
-    dummy.clear_resize(length);
-    read(length, dummy.ptr());
+    _skipForward(tell() + length);
 }
 
 long long GZipScanner::tell()
 {
-    return _uncompressed_total;
+    return _outbuf_offset + _outbuf_start;
 }
 
 bool GZipScanner::isEOF()
 {
-    if ((unsigned)_outbuf_start + _zstream.avail_out == (unsigned)_outbuf.size())
-    {
-        if (_eof)
-            return true;
-        _read(1, 0);
-    }
-    return _eof && (unsigned)_outbuf_start + _zstream.avail_out == (unsigned)_outbuf.size();
+    return _outbuf_start == _outbuf_end && !_fill();
 }
 
 void GZipScanner::seek(long long pos, int from)
 {
-    throw Error("not implemented");
-}
+    if (from == SEEK_CUR)
+        pos += tell();
+    else if (from == SEEK_END)
+        pos += length();
 
-int GZipScanner::lookNext()
-{
-    if (_outbuf_start < _outbuf.size() - (int)_zstream.avail_out)
-        return _outbuf[_outbuf_start];
+    if (pos < 0)
+        throw Error("negative position %lld", pos);
 
-    if (_eof)
-        return -1;
+    if (pos >= _outbuf_offset && pos <= _outbuf_offset + _outbuf_end)
+    {
+        _outbuf_start = (int)(pos - _outbuf_offset);
+        return;
+    }
 
-    _read(1, 0);
+    // Inflate from the closest access point before the position, unless the
+    // current position is closer
+    int lo = 0, hi = _points.size();
+    while (lo < hi)
+    {
+        int mid = (lo + hi) / 2;
+        if (_points[mid].out_offset <= pos)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
 
-    if (_eof)
-        return -1;
+    if (pos < tell() || (lo > 0 && _points[lo - 1].out_offset > tell()))
+    {
+        if (lo == 0)
+            throw Error("can not seek to %lld", pos);
+        _restore(_points[lo - 1]);
+    }
+
+    _skipForward(pos);
+}
 
-    if (_outbuf_start < _outbuf.size() - (int)_zstream.avail_out)
-        return _outbuf[_outbuf_start];
+int GZipScanner::lookNext()
+{
+    if (_outbuf_start == _outbuf_end && !_fill())
+        return -1;
 
-    throw Error("internal");
+    return _outbuf[_outbuf_start];
 }
 
 long long GZipScanner::length()
 {
-    throw Error("not implemented");
+    long long pos = tell();
+
+    while (!isEOF())
+        _outbuf_start = _outbuf_end;
+
+    long long res = tell();
+    seek(pos, SEEK_SET);
+    return res;
 }
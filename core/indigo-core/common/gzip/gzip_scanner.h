@@ -19,25 +19,45 @@
 #ifndef __gzip_scanner__
 #define __gzip_scanner__
 
+#include "base_cpp/obj_array.h"
 #include "base_cpp/scanner.h"
 #include "base_cpp/tlscont.h"
 
+#include <memory>
 #include <zlib.h>
 
 namespace indigo
 {
 
+    // Reads gzip data, including multi-member files such as BGZF. Seeking is
+    // supported through access points collected while reading: member starts
+    // and, with random access enabled, deflate block boundaries inside long
+    // members with the 32 KB window needed to resume. BGZF input can be
+    // inflated by several threads.
     class GZipScanner : public Scanner
     {
     public:
         enum
         {
-            CHUNK_SIZE = 32768
+            CHUNK_SIZE = 32768,
+            ACCESS_POINT_SPAN = 1048576,
+            WINDOW_SIZE = 32768,
+            // Upper limit of the uncompressed size of a BGZF block
+            BLOCK_DATA_SIZE = 65536
         };
 
         explicit GZipScanner(Scanner& source);
         ~GZipScanner() override;
 
+        // Threads to inflate BGZF blocks with; takes effect if called before
+        // the first read. Other gzip input is always inflated sequentially.
+        void setThreads(int threads);
+
+        // Keep access points with windows every ACCESS_POINT_SPAN bytes of the
+        // data read after the call, so that seeking back does not inflate a
+        // long member from its start. Not needed for sequential reading.
+        void setRandomAccess(bool enable);
+
         void read(int length, void* res) override;
         long long tell() override;
         bool isEOF() override;
@@ -45,23 +65,60 @@ namespace indigo
         int lookNext() override;
         void skip(int length) override;
         long long length() override;
+        char readChar() override;
         void readAll(Array<char>& arr) override;
 
         DECL_ERROR;
 
     protected:
+        enum
+        {
+            MODE_UNKNOWN,
+            MODE_STREAM,
+            MODE_BLOCKS
+        };
+
+        struct InflatePool;
+
+        struct AccessPoint
+        {
+            long long out_offset;
+            long long in_offset;
+            // Unused bits of the byte before in_offset, or -1 for a member start
+            int bits;
+            Array<Bytef> window;
+        };
+
+        bool _fill();
+        bool _fillStream();
+        bool _fillBlocks();
+        bool _refillInput();
+        bool _startMember(long long out_offset);
+        bool _isBlockHeader(const Bytef* header, int size, int& block_size);
+        void _addAccessPoint(long long out_offset, long long in_offset, int bits);
+        void _restore(const AccessPoint& point);
+        void _skipForward(long long pos);
+
         Scanner& _source;
         z_stream _zstream;
 
-        bool _read(int length, void* res);
-
         CP_DECL;
         TL_CP_DECL(Array<Bytef>, _inbuf);
         TL_CP_DECL(Array<Bytef>, _outbuf);
+        // Unread output is [_outbuf_start, _outbuf_end)
         int _outbuf_start;
-        int _inbuf_end;
-        int _uncompressed_total;
+        int _outbuf_end;
+        long long _outbuf_offset;
+        long long _inbuf_offset;
+        int _mode;
+        int _threads;
+        bool _random_access;
+        int _trailer_left;
+        bool _member_end;
+        bool _raw;
         bool _eof;
+        ObjArray<AccessPoint> _points;
+        std::unique_ptr<InflatePool> _pool;
     };
 
 } // namespace indigo
@@ -23,6 +23,7 @@
 #include "base_cpp/reusable_obj_array.h"
 #include "base_cpp/tlscont.h"
 #include "graph/graph.h"
+#include "graph/graph_csr.h"
 
 namespace indigo
 {
@@ -112,6 +113,7 @@ namespace indigo
         TL_CP_DECL(Array<int>, _lab);
         TL_CP_DECL(Array<int>, _ptn);
         TL_CP_DECL(Graph, _graph);
+        TL_CP_DECL(GraphCSR, _csr); // adjacency of _graph for the refinement
 
         TL_CP_DECL(Array<int>, _mapping);
         TL_CP_DECL(Array<int>, _inv_mapping);
@@ -21,6 +21,7 @@
 
 #include "base_cpp/tlscont.h"
 #include "graph/graph.h"
+#include "graph/graph_csr.h"
 
 namespace indigo
 {
@@ -56,6 +57,7 @@ namespace indigo
 
         TL_CP_DECL(Pool<List<int>::Elem>, _pool);
         TL_CP_DECL(Array<int>, _adjacent_edges);
+        TL_CP_DECL(GraphCSR, _csr);
 
         class _Enumerator
         {
@@ -28,6 +28,7 @@
 #include "base_cpp/obj_array.h"
 #include "base_cpp/red_black.h"
 #include "base_cpp/tlscont.h"
+#include "graph/graph_csr.h"
 #include "graph/graph_fast_access.h"
 
 namespace indigo
@@ -66,6 +67,39 @@ namespace indigo
 
         void* userdata;
 
+        // Opt-in parallel search for process(). The search first runs
+        // sequentially for parallel_sequential_steps steps, so that small
+        // searches do not start any threads. The rest of the search tree is
+        // then split at the first parallel_split_depth query vertices into
+        // tasks, which are run by parallel_threads workers; a worker steals
+        // tasks from the others when its own queue is empty. Every worker has
+        // its own enumerator and the userdata returned for it by
+        // cb_create_worker, and the parallel search is not used when that
+        // callback is not set. Workers are created before they start, so the
+        // callbacks must not modify shared state after that without a lock;
+        // they run on threads outside of the caller session. cb_embedding is
+        // an exception: the workers call it one at a time, and not after the
+        // search has stopped. When it returns zero, the whole search stops and
+        // getSubgraphMapping() returns that embedding. The vertex equivalence
+        // heuristic is not used below the split, and the search can not be
+        // continued with processNext() once it has been split.
+        int parallel_threads;
+        int parallel_split_depth;
+        int parallel_sequential_steps;
+        void* (*cb_create_worker)(void* userdata);
+        void (*cb_release_worker)(void* worker_userdata, void* userdata);
+
+        // Candidate domains: processStart() computes for every query vertex
+        // the bitset of target vertices accepted by cb_match_vertex and having
+        // enough neighbours for it, and removes the candidates that have no
+        // candidate of some query neighbour among their own neighbours. The
+        // search then skips pairs out of the domains and drops a pair when an
+        // unmapped query neighbour has no free candidate adjacent to the images
+        // of its mapped neighbours. cb_match_vertex is called with the mapping
+        // of fixed vertices only, so the option may be set only when its result
+        // does not depend on core_sub. Not used with allow_many_to_one.
+        bool use_candidate_domains;
+
         void setSubgraph(Graph& subgraph);
 
         void ignoreSubgraphVertex(int idx);
@@ -115,10 +149,55 @@ namespace indigo
 
         TL_CP_DECL(Pool<RedBlackSet<int>::Node>, _s_pool);
 
-        TL_CP_DECL(GraphFastAccess, _g1_fast);
+        // The subgraph does not change during the enumeration, while vertices
+        // may be added to the supergraph (see validate())
+        TL_CP_DECL(GraphCSR, _g1_csr);
         TL_CP_DECL(GraphFastAccess, _g2_fast);
 
         void _terminatePreviousMatch();
+        void _checkCancellation();
+
+        //
+        // Parallel search
+        //
+
+        struct _ParallelSearch;
+
+        bool _useParallelSearch();
+        bool _processLimited(int steps, int& result);
+        bool _processParallel();
+        void _copyState(EmbeddingEnumerator& other);
+        void _processTask(const int* prefix, int length, _ParallelSearch& search);
+        bool _reportParallelEmbedding();
+
+        // Set for the workers of a parallel search
+        _ParallelSearch* _parallel_search;
+
+        // Mapping found by the parallel search
+        TL_CP_DECL(Array<int>, _parallel_core_1);
+        TL_CP_DECL(Array<int>, _parallel_core_2);
+        bool _parallel_found;
+        bool _parallel_done;
+
+        //
+        // Candidate domains
+        //
+
+        void _buildDomains();
+        bool _refineDomains();
+
+        bool _domainHas(int node1, int node2) const;
+        void _setFree2(int node2, bool free);
+
+        // One bitset of _domain_words words per vertex: the candidates of the
+        // query vertices and the neighbours of the target vertices
+        TL_CP_DECL(Array<qword>, _domains);
+        TL_CP_DECL(Array<qword>, _adjacency2);
+        // Target vertices that are neither mapped nor ignored
+        TL_CP_DECL(Array<qword>, _free2);
+        int _domain_words; // zero when the domains are not used
+        int _domain_size2;
+        bool _domain_wipeout;
 
         //
         // Query nodes sequence calculation
@@ -149,6 +228,8 @@ namespace indigo
         public:
             _Enumerator(EmbeddingEnumerator& context);
             _Enumerator(const _Enumerator& other);
+            // Copies the state of an enumerator of another context, for the parallel search
+            _Enumerator(EmbeddingEnumerator& context, const _Enumerator* other);
 
             bool fix(int node1, int node2, bool safe);
             void setUseEquivalence(bool use);
@@ -159,6 +240,7 @@ namespace indigo
             void restore();
 
             void initForFirstSearch(int t1_len);
+            bool tryPair(int node2);
 
             int _current_node1, _current_node2;
 
@@ -182,6 +264,7 @@ namespace indigo
             bool _checkNode1(int node1);
             bool _checkNode2(int node2, int for_node1);
             bool _checkPair(int node1, int node2);
+            bool _checkDomains(int node1, int node2);
 
             void _initState();
 
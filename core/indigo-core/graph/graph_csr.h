@@ -0,0 +1,113 @@
+/****************************************************************************
+ * Copyright (C) from 2009 to Present EPAM Systems.
+ *
+ * This file is part of Indigo toolkit.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ***************************************************************************/
+
+#ifndef __graph_csr_h__
+#define __graph_csr_h__
+
+#include "base_cpp/array.h"
+#include "base_cpp/exception.h"
+#include "graph/graph.h"
+
+#ifdef _WIN32
+#pragma warning(push)
+#pragma warning(disable : 4251)
+#endif
+
+namespace indigo
+{
+
+    // Read-only snapshot of a graph adjacency in compressed sparse row form.
+    // Neighbors of vertex v are stored contiguously at indices
+    // [offset(v), offset(v + 1)) of the neighbor arrays, in the same order as
+    // the graph lists them. Vertex and edge indices are the ones of the source
+    // graph; removed vertices have no neighbors. The view does not follow
+    // changes of the graph, so it has to be rebuilt after them.
+    class DLLEXPORT GraphCSR
+    {
+    public:
+        GraphCSR();
+        explicit GraphCSR(const Graph& g);
+
+        void build(const Graph& g);
+        void clear();
+
+        // Checks that the graph has the same index ranges and the same number
+        // of vertices and edges as the snapshot
+        bool fits(const Graph& g) const;
+
+        int vertexEnd() const
+        {
+            return _vertex_end;
+        }
+        int edgeEnd() const
+        {
+            return _edges.size();
+        }
+
+        // Indices of the existing vertices in ascending order
+        const int* vertices() const
+        {
+            return _vertices.ptr();
+        }
+        int vertexCount() const
+        {
+            return _vertices.size();
+        }
+
+        int offset(int v) const
+        {
+            return _offsets[v];
+        }
+        int degree(int v) const
+        {
+            return _offsets[v + 1] - _offsets[v];
+        }
+        const int* neiVertices(int v) const
+        {
+            return _nei_vertices.ptr() + _offsets[v];
+        }
+        const int* neiEdges(int v) const
+        {
+            return _nei_edges.ptr() + _offsets[v];
+        }
+
+        const Edge& getEdge(int e) const
+        {
+            return _edges[e];
+        }
+
+        int findEdgeIndex(int beg, int end) const;
+
+        DECL_ERROR;
+
+    private:
+        int _vertex_end;
+        Array<int> _vertices;
+        Array<int> _offsets;
+        Array<int> _nei_vertices;
+        Array<int> _nei_edges;
+        Array<Edge> _edges;
+    };
+
+} // namespace indigo
+
+#ifdef _WIN32
+#pragma warning(pop)
+#endif
+
+#endif // __graph_csr_h__
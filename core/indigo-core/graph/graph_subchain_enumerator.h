@@ -21,6 +21,7 @@
 
 #include "base_cpp/tlscont.h"
 #include "graph/graph.h"
+#include "graph/graph_csr.h"
 
 namespace indigo
 {
@@ -55,6 +56,7 @@ namespace indigo
         TL_CP_DECL(Array<int>, _vertex_states);
         TL_CP_DECL(Array<int>, _chain_vertices);
         TL_CP_DECL(Array<int>, _chain_edges);
+        TL_CP_DECL(GraphCSR, _csr);
     };
 
 } // namespace indigo
@@ -23,6 +23,7 @@
 #include "base_cpp/obj_array.h"
 #include "base_cpp/tlscont.h"
 #include "graph/graph.h"
+#include "graph/graph_csr.h"
 
 namespace indigo
 {
@@ -78,6 +79,7 @@ namespace indigo
         TL_CP_DECL(Array<int>, _edges);    // array with subgraph edges
 
         TL_CP_DECL(Array<int>, _v_processed); // from _graph to _subtree
+        TL_CP_DECL(GraphCSR, _csr);
 
         void _reverseSearch(int front_idx, int cur_maximal_criteria_value);
 
@@ -22,6 +22,7 @@
 #include "base_cpp/array.h"
 #include "base_cpp/tlscont.h"
 #include "graph/graph.h"
+#include "graph/graph_csr.h"
 
 namespace indigo
 {
@@ -76,9 +77,9 @@ namespace indigo
     protected:
         struct StackElem
         {
-            const Vertex* vertex;
             int vertex_idx;
-            int nei_idx;
+            int nei_idx; // position in the neighbor arrays of _csr
+            int nei_end;
             int parent_idx;
         };
 
@@ -97,6 +98,7 @@ namespace indigo
         TL_CP_DECL(Array<int>, _inv_mapping);
         TL_CP_DECL(Array<int>, _edge_mapping);
         TL_CP_DECL(Array<StackElem>, _stack);
+        TL_CP_DECL(GraphCSR, _csr);
 
         int _current_depth;
     };
@@ -29,7 +29,7 @@ AutomorphismSearch::AutomorphismSearch()
     : CP_INIT, TL_CP_GET(_call_stack), TL_CP_GET(_lab), TL_CP_GET(_ptn), TL_CP_GET(_graph), TL_CP_GET(_mapping), TL_CP_GET(_inv_mapping), TL_CP_GET(_degree),
       TL_CP_GET(_tcells), TL_CP_GET(_fix), TL_CP_GET(_mcr), TL_CP_GET(_active), TL_CP_GET(_workperm), TL_CP_GET(_workperm2), TL_CP_GET(_bucket),
       TL_CP_GET(_count), TL_CP_GET(_firstlab), TL_CP_GET(_canonlab), TL_CP_GET(_orbits), TL_CP_GET(_fixedpts), TL_CP_GET(_work_active_cells),
-      TL_CP_GET(_edge_ranks_in_refine)
+      TL_CP_GET(_edge_ranks_in_refine), TL_CP_GET(_csr)
 {
     getcanon = true;
     compare_vertex_degree_first = true;
@@ -152,6 +152,8 @@ void AutomorphismSearch::_prepareGraph(Graph& graph)
         _graph.addEdge(beg, end);
     }
 
+    _csr.build(_graph);
+
     int start = 0;
 
     for (i = 0; i < buckets.size(); i++)
@@ -718,9 +720,9 @@ bool AutomorphismSearch::_isAutomorphism(Array<int>& perm)
 {
     for (int i = _graph.edgeBegin(); i != _graph.edgeEnd(); i = _graph.edgeNext(i))
     {
-        const Edge& edge = _graph.getEdge(i);
+        const Edge& edge = _csr.getEdge(i);
 
-        if (!_graph.haveEdge(perm[edge.beg], perm[edge.end]))
+        if (_csr.findEdgeIndex(perm[edge.beg], perm[edge.end]) == -1)
             return false;
     }
 
@@ -947,7 +949,7 @@ void AutomorphismSearch::_refineBySortingNeighbourhood(int level, int& numcells)
 
 bool AutomorphismSearch::_hasEdgeWithRank(int from, int to, int target_edge_rank)
 {
-    int edge_index = _graph.findEdgeIndex(from, to);
+    int edge_index = _csr.findEdgeIndex(from, to);
 
     if (edge_index == -1)
         return false;
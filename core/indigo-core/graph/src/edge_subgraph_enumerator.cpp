@@ -29,7 +29,7 @@ CP_DEF(EdgeSubgraphEnumerator);
 
 EdgeSubgraphEnumerator::EdgeSubgraphEnumerator(Graph& graph)
     : _graph(graph), CP_INIT, TL_CP_GET(_subgraph), TL_CP_GET(_mapping), TL_CP_GET(_inv_mapping), TL_CP_GET(_edge_mapping), TL_CP_GET(_inv_edge_mapping),
-      TL_CP_GET(_pool), TL_CP_GET(_adjacent_edges)
+      TL_CP_GET(_pool), TL_CP_GET(_adjacent_edges), TL_CP_GET(_csr)
 {
     min_edges = 1;
     max_edges = graph.edgeCount();
@@ -88,18 +88,20 @@ void EdgeSubgraphEnumerator::_Enumerator::process()
         const Edge& edge = _subgraph.getEdge(j);
         int vbeg_idx = _context._mapping[edge.beg];
         int vend_idx = _context._mapping[edge.end];
-        const Vertex& vbeg = _graph.getVertex(vbeg_idx);
-        const Vertex& vend = _graph.getVertex(vend_idx);
+        const int* vbeg_edges = _context._csr.neiEdges(vbeg_idx);
+        const int* vend_edges = _context._csr.neiEdges(vend_idx);
+        int vbeg_degree = _context._csr.degree(vbeg_idx);
+        int vend_degree = _context._csr.degree(vend_idx);
 
-        for (i = vbeg.neiBegin(); i != vbeg.neiEnd(); i = vbeg.neiNext(i))
+        for (i = 0; i < vbeg_degree; i++)
         {
-            int edge_idx = vbeg.neiEdge(i);
+            int edge_idx = vbeg_edges[i];
             if (!_context._adjacent_edges[edge_idx] && _context._inv_edge_mapping[edge_idx] < 0)
                 _addAdjacentEdge(edge_idx);
         }
-        for (i = vend.neiBegin(); i != vend.neiEnd(); i = vend.neiNext(i))
+        for (i = 0; i < vend_degree; i++)
         {
-            int edge_idx = vend.neiEdge(i);
+            int edge_idx = vend_edges[i];
             if (!_context._adjacent_edges[edge_idx] && _context._inv_edge_mapping[edge_idx] < 0)
                 _addAdjacentEdge(edge_idx);
         }
@@ -208,6 +210,7 @@ void EdgeSubgraphEnumerator::process()
     int i;
 
     _subgraph.clear();
+    _csr.build(_graph);
 
     _mapping.clear_resize(_graph.vertexCount());
     _inv_mapping.clear_resize(_graph.vertexEnd());
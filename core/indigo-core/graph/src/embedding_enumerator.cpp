@@ -18,6 +18,15 @@
 
 #include "graph/embedding_enumerator.h"
 
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 #include "base_c/defs.h"
 #include "base_cpp/cancellation_handler.h"
 #include "base_cpp/tlscont.h"
@@ -32,10 +41,14 @@ IMPL_TIMEOUT_EXCEPTION(EmbeddingEnumerator, "embedding enumerator");
 CP_DEF(EmbeddingEnumerator);
 
 EmbeddingEnumerator::EmbeddingEnumerator(Graph& supergraph)
-    : CP_INIT, TL_CP_GET(_core_1), TL_CP_GET(_core_2), TL_CP_GET(_term2), TL_CP_GET(_unterm2), TL_CP_GET(_s_pool), TL_CP_GET(_g1_fast), TL_CP_GET(_g2_fast),
+    : CP_INIT, TL_CP_GET(_core_1), TL_CP_GET(_core_2), TL_CP_GET(_term2), TL_CP_GET(_unterm2), TL_CP_GET(_s_pool), TL_CP_GET(_g1_csr), TL_CP_GET(_g2_fast),
+      TL_CP_GET(_parallel_core_1), TL_CP_GET(_parallel_core_2), TL_CP_GET(_domains), TL_CP_GET(_adjacency2), TL_CP_GET(_free2),
       TL_CP_GET(_query_match_state), TL_CP_GET(_enumerators)
 {
     _g2 = &supergraph;
+    _domain_words = 0;
+    _domain_size2 = 0;
+    _domain_wipeout = false;
     _core_2.clear();
     validate();
 
@@ -47,6 +60,17 @@ EmbeddingEnumerator::EmbeddingEnumerator(Graph& supergraph)
     cb_vertex_add = 0;
     userdata = 0;
 
+    parallel_threads = 0;
+    parallel_split_depth = 3;
+    parallel_sequential_steps = 10000;
+    cb_create_worker = 0;
+    cb_release_worker = 0;
+    _parallel_search = nullptr;
+    _parallel_found = false;
+    _parallel_done = false;
+
+    use_candidate_domains = false;
+
     _cancellation_handler = getCancellationHandler();
     _cancellation_check_number = 0;
 
@@ -82,7 +106,7 @@ void EmbeddingEnumerator::setSubgraph(Graph& subgraph)
 
     _terminatePreviousMatch();
 
-    _g1_fast.setGraph(*_g1);
+    _g1_csr.build(*_g1);
 }
 
 void EmbeddingEnumerator::ignoreSubgraphVertex(int idx)
@@ -131,6 +155,17 @@ int EmbeddingEnumerator::process()
 {
     processStart();
 
+    if (_domain_wipeout)
+        return 1;
+
+    if (_useParallelSearch())
+    {
+        int result;
+        if (_processLimited(parallel_sequential_steps, result))
+            return result;
+        return _processParallel() ? 0 : 1;
+    }
+
     if (processNext())
         return 0;
 
@@ -142,6 +177,12 @@ void EmbeddingEnumerator::processStart()
     if (_g1 == 0)
         throw Error("subgraph not set");
 
+    _parallel_found = false;
+    _parallel_done = false;
+
+    if (!_g1_csr.fits(*_g1))
+        _g1_csr.build(*_g1);
+
     if (_equivalence_handler != NULL)
         _equivalence_handler->prepareForQueries();
 
@@ -169,12 +210,13 @@ void EmbeddingEnumerator::processStart()
     while ((node1 = _getNextNode1()) != -1)
     {
         // Find node parent
-        const Vertex& v = _g1->getVertex(node1);
+        const int* nei_vertices = _g1_csr.neiVertices(node1);
+        int degree = _g1_csr.degree(node1);
 
         int parent = -1;
-        for (int j = v.neiBegin(); j != v.neiEnd(); j = v.neiNext(j))
+        for (int j = 0; j < degree; j++)
         {
-            int nei_vertex = v.neiVertex(j);
+            int nei_vertex = nei_vertices[j];
             if (_core_1[nei_vertex] >= 0)
             {
                 parent = nei_vertex;
@@ -193,6 +235,11 @@ void EmbeddingEnumerator::processStart()
     _core_1.copy(core1_pre);
     _t1_len_pre = t1_len_saved;
     _enumerators[0].initForFirstSearch(_t1_len_pre);
+
+    _domain_words = 0;
+    _domain_wipeout = false;
+    if (use_candidate_domains && !allow_many_to_one)
+        _buildDomains();
 }
 
 void EmbeddingEnumerator::_fixNode1(int node1, int node2)
@@ -202,10 +249,11 @@ void EmbeddingEnumerator::_fixNode1(int node1, int node2)
 
     _core_1[node1] = node2;
 
-    const Vertex& v1 = _g1->getVertex(node1);
-    for (int i = v1.neiBegin(); i != v1.neiEnd(); i = v1.neiNext(i))
+    const int* nei_vertices = _g1_csr.neiVertices(node1);
+    int degree = _g1_csr.degree(node1);
+    for (int i = 0; i < degree; i++)
     {
-        int other1 = v1.neiVertex(i);
+        int other1 = nei_vertices[i];
 
         if (_core_1[other1] == UNMAPPED)
         {
@@ -230,6 +278,12 @@ int EmbeddingEnumerator::_getNextNode1()
 
 bool EmbeddingEnumerator::processNext()
 {
+    if (_parallel_done)
+        throw Error("parallel search can not be continued");
+
+    if (_domain_wipeout)
+        return false;
+
     if (_enumerators.size() > 1)
     {
         _enumerators.top().restore();
@@ -262,20 +316,525 @@ bool EmbeddingEnumerator::processNext()
         else if (command == _RETURN0)
             return true;
 
-        if (_cancellation_handler != nullptr)
+        _checkCancellation();
+    }
+
+    while (_enumerators.size() > 1)
+        _enumerators.pop();
+
+    return false;
+}
+
+void EmbeddingEnumerator::_checkCancellation()
+{
+    if (_cancellation_handler != nullptr)
+    {
+        // Check only each 100th time
+        if ((_cancellation_check_number % 100) == 0)
+            if (_cancellation_handler->isCancelled())
+                throw TimeoutException("%s", _cancellation_handler->cancelledRequestMessage());
+        _cancellation_check_number++;
+    }
+}
+
+struct EmbeddingEnumerator::_ParallelSearch
+{
+    struct TaskQueue
+    {
+        std::mutex lock;
+        std::deque<int> tasks;
+    };
+
+    _ParallelSearch(EmbeddingEnumerator& owner, int workers_count) : owner(owner), queues(workers_count), stop(false), found(false)
+    {
+    }
+
+    // Takes a task from the front of the own queue, or steals one
+    // from the back of the queue of another worker
+    bool popTask(int worker, int& task)
+    {
+        for (int i = 0; i < (int)queues.size(); i++)
+        {
+            TaskQueue& queue = queues[(worker + i) % queues.size()];
+            std::lock_guard<std::mutex> guard(queue.lock);
+
+            if (queue.tasks.empty())
+                continue;
+
+            if (i == 0)
+            {
+                task = queue.tasks.front();
+                queue.tasks.pop_front();
+            }
+            else
+            {
+                task = queue.tasks.back();
+                queue.tasks.pop_back();
+            }
+            return true;
+        }
+        return false;
+    }
+
+    EmbeddingEnumerator& owner;
+    std::vector<TaskQueue> queues;
+    std::atomic<bool> stop;
+
+    std::mutex result_lock;
+    bool found;
+    std::exception_ptr error;
+};
+
+bool EmbeddingEnumerator::_useParallelSearch()
+{
+    // At least one query vertex must be left for the workers after the split
+    return parallel_threads > 1 && parallel_split_depth > 0 && cb_create_worker != 0 && _query_match_state.size() > 2;
+}
+
+// Searches like processNext() until an embedding is found, the search is
+// finished or the given number of steps is made. Returns false in the last
+// case; the search can then be continued by _processParallel().
+bool EmbeddingEnumerator::_processLimited(int steps, int& result)
+{
+    for (int step = 0;; step++)
+    {
+        int command = _enumerators.top().nextPair();
+
+        if (command == _NOWAY)
+        {
+            if (_enumerators.size() == 1)
+            {
+                result = 1;
+                return true;
+            }
+            _enumerators.top().restore();
+            _enumerators.pop();
+
+            // Stop only after a step back, when every enumerator in the
+            // stack is in the middle of its candidates
+            if (step >= steps)
+                return false;
+        }
+        else if (command == _ADD_PAIR)
+        {
+            int node1 = _enumerators.top()._current_node1;
+            int node2 = _enumerators.top()._current_node2;
+
+            _enumerators.reserve(_enumerators.size() + 1);
+            _enumerators.push(_enumerators.top());
+            _enumerators.top().addPair(node1, node2);
+        }
+        else if (command == _RETURN0)
+        {
+            result = 0;
+            return true;
+        }
+
+        _checkCancellation();
+    }
+}
+
+bool EmbeddingEnumerator::_processParallel()
+{
+    // The last element of _query_match_state marks the end of the queue
+    int depth = std::min(parallel_split_depth, _query_match_state.size() - 2);
+
+    // Workers do not share the equivalence handler, so the heuristic is
+    // not used for the prefixes either
+    _enumerators[0].setUseEquivalence(false);
+
+    //
+    // Enumerate the prefixes of the rest of the search tree. The search may
+    // have been stopped deeper than the split, and the candidates left there
+    // make longer prefixes.
+    //
+    QS_DEF(Array<int>, tasks);
+    QS_DEF(Array<int>, task_starts);
+    tasks.clear();
+    task_starts.clear();
+
+    while (1)
+    {
+        int command = _enumerators.top().nextPair();
+
+        if (command == _NOWAY)
+        {
+            if (_enumerators.size() > 1)
+            {
+                _enumerators.top().restore();
+                _enumerators.pop();
+            }
+            else
+                break;
+        }
+        else if (command == _ADD_PAIR)
+        {
+            int node1 = _enumerators.top()._current_node1;
+            int node2 = _enumerators.top()._current_node2;
+            int level = _enumerators.size() - 1;
+
+            if (level + 1 < depth)
+            {
+                _enumerators.reserve(_enumerators.size() + 1);
+                _enumerators.push(_enumerators.top());
+                _enumerators.top().addPair(node1, node2);
+            }
+            else
+            {
+                // The subtree below the pair is a task
+                task_starts.push(tasks.size());
+                for (int i = 0; i < level; i++)
+                    tasks.push(_core_1[_query_match_state[i].atom_index]);
+                tasks.push(node2);
+            }
+        }
+        else if (command == _RETURN0)
+            throw Error("internal error: embedding found before the split depth");
+
+        _checkCancellation();
+    }
+
+    int tasks_count = task_starts.size();
+    int workers_count = std::min(parallel_threads, tasks_count);
+    task_starts.push(tasks.size());
+
+    _parallel_done = true;
+    if (tasks_count == 0)
+        return false;
+
+    //
+    // Run the tasks
+    //
+    std::vector<std::unique_ptr<EmbeddingEnumerator>> workers;
+    _ParallelSearch search(*this, workers_count);
+
+    try
+    {
+        for (int i = 0; i < workers_count; i++)
+        {
+            workers.emplace_back(new EmbeddingEnumerator(*_g2));
+            workers.back()->_copyState(*this);
+            workers.back()->_parallel_search = &search;
+            workers.back()->userdata = cb_create_worker(userdata);
+        }
+    }
+    catch (...)
+    {
+        for (auto& worker : workers)
+            if (cb_release_worker != 0 && worker->userdata != 0)
+                cb_release_worker(worker->userdata, userdata);
+        throw;
+    }
+
+    for (int i = 0; i < tasks_count; i++)
+        search.queues[i % workers_count].tasks.push_back(i);
+
+    std::vector<std::thread> threads;
+
+    for (int i = 0; i < workers_count; i++)
+    {
+        threads.emplace_back([&, i]() {
+            try
+            {
+                int task;
+                while (!search.stop.load(std::memory_order_relaxed) && search.popTask(i, task))
+                    workers[i]->_processTask(tasks.ptr() + task_starts[task], task_starts[task + 1] - task_starts[task], search);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> guard(search.result_lock);
+                if (!search.error)
+                    search.error = std::current_exception();
+                search.stop = true;
+            }
+        });
+    }
+
+    for (auto& thread : threads)
+        thread.join();
+
+    for (auto& worker : workers)
+        if (cb_release_worker != 0)
+            cb_release_worker(worker->userdata, userdata);
+
+    if (search.error)
+        std::rethrow_exception(search.error);
+
+    if (search.found)
+    {
+        _parallel_found = true;
+        return true;
+    }
+
+    return false;
+}
+
+void EmbeddingEnumerator::_copyState(EmbeddingEnumerator& other)
+{
+    _g1 = other._g1;
+    _g1_csr.build(*_g1);
+
+    _core_1.copy(other._core_1);
+    _core_2.copy(other._core_2);
+    _term2.copy(other._term2);
+    _unterm2.copy(other._unterm2);
+    _t1_len_pre = other._t1_len_pre;
+    _query_match_state.copy(other._query_match_state);
+
+    _domains.copy(other._domains);
+    _adjacency2.copy(other._adjacency2);
+    _free2.copy(other._free2);
+    _domain_words = other._domain_words;
+    _domain_size2 = other._domain_size2;
+    _domain_wipeout = other._domain_wipeout;
+
+    allow_many_to_one = other.allow_many_to_one;
+    cb_embedding = other.cb_embedding;
+    cb_match_vertex = other.cb_match_vertex;
+    cb_match_edge = other.cb_match_edge;
+    cb_vertex_remove = other.cb_vertex_remove;
+    cb_edge_add = other.cb_edge_add;
+    cb_vertex_add = other.cb_vertex_add;
+    cb_allow_many_to_one = other.cb_allow_many_to_one;
+    _cancellation_handler = other._cancellation_handler;
+
+    _enumerators.clear();
+    _enumerators.push(*this, &other._enumerators[0]);
+}
+
+void EmbeddingEnumerator::_processTask(const int* prefix, int length, _ParallelSearch& search)
+{
+    int level;
+
+    // Map the prefix of the task, then search below it
+    for (level = 0; level < length; level++)
+    {
+        int node1 = _enumerators.top()._current_node1;
+
+        if (!_enumerators.top().tryPair(prefix[level]))
+            break;
+
+        _enumerators.reserve(_enumerators.size() + 1);
+        _enumerators.push(_enumerators.top());
+        _enumerators.top().addPair(node1, prefix[level]);
+    }
+
+    while (level == length && !search.stop.load(std::memory_order_relaxed))
+    {
+        int command = _enumerators.top().nextPair();
+
+        if (command == _NOWAY)
         {
-            // Check only each 100th time
-            if ((_cancellation_check_number % 100) == 0)
-                if (_cancellation_handler->isCancelled())
-                    throw TimeoutException("%s", _cancellation_handler->cancelledRequestMessage());
-            _cancellation_check_number++;
+            if (_enumerators.size() > length + 1)
+            {
+                _enumerators.top().restore();
+                _enumerators.pop();
+            }
+            else
+                break;
         }
+        else if (command == _ADD_PAIR)
+        {
+            int node1 = _enumerators.top()._current_node1;
+            int node2 = _enumerators.top()._current_node2;
+
+            _enumerators.reserve(_enumerators.size() + 1);
+            _enumerators.push(_enumerators.top());
+            _enumerators.top().addPair(node1, node2);
+        }
+        else if (command == _RETURN0)
+            break;
+
+        _checkCancellation();
     }
 
     while (_enumerators.size() > 1)
+    {
+        _enumerators.top().restore();
         _enumerators.pop();
+    }
+}
 
-    return false;
+// Passes an embedding found by a worker to cb_embedding. Returns true if the
+// worker has to stop. The embedding that stops the search is published in the
+// same critical section, so a worker that has not seen the stop yet can not
+// replace it.
+bool EmbeddingEnumerator::_reportParallelEmbedding()
+{
+    _ParallelSearch& search = *_parallel_search;
+    std::lock_guard<std::mutex> guard(search.result_lock);
+
+    if (search.stop.load(std::memory_order_relaxed))
+        return true;
+
+    if (cb_embedding != 0 && cb_embedding(*_g1, *_g2, _core_1.ptr(), _core_2.ptr(), userdata) != 0)
+        return false;
+
+    search.owner._parallel_core_1.copy(_core_1);
+    search.owner._parallel_core_2.copy(_core_2);
+    search.found = true;
+    search.stop = true;
+    return true;
+}
+
+void EmbeddingEnumerator::_buildDomains()
+{
+    int n1 = _g1->vertexEnd();
+    int n2 = _g2->vertexEnd();
+    int i, j;
+
+    if (n2 == 0)
+        return;
+
+    _domain_words = (n2 + 63) / 64;
+    _domain_size2 = n2;
+
+    _domains.clear_resize(n1 * _domain_words);
+    _domains.zerofill();
+    _adjacency2.clear_resize(n2 * _domain_words);
+    _adjacency2.zerofill();
+    _free2.clear_resize(_domain_words);
+    _free2.zerofill();
+
+    QS_DEF(Array<int>, degree2);
+    degree2.clear_resize(n2);
+    degree2.zerofill();
+
+    for (i = _g2->vertexBegin(); i != _g2->vertexEnd(); i = _g2->vertexNext(i))
+    {
+        if (_core_2[i] == UNMAPPED || _core_2[i] == TERM_OUT)
+            _setFree2(i, true);
+
+        qword* adjacency = _adjacency2.ptr() + i * _domain_words;
+        int nei_count;
+        int* nei_vertices = _g2_fast.getVertexNeiVertices(i, nei_count);
+
+        for (j = 0; j < nei_count; j++)
+        {
+            int other2 = nei_vertices[j];
+
+            adjacency[other2 / 64] |= (qword)1 << (other2 % 64);
+            if (_core_2[other2] != IGNORE)
+                degree2[i]++;
+        }
+    }
+
+    // Fixed vertices have the only candidate
+    for (i = _g1->vertexBegin(); i != _g1->vertexEnd(); i = _g1->vertexNext(i))
+        if (_core_1[i] >= 0)
+            _domains[i * _domain_words + _core_1[i] / 64] |= (qword)1 << (_core_1[i] % 64);
+
+    for (i = 0; i < _query_match_state.size() - 1; i++)
+    {
+        int node1 = _query_match_state[i].atom_index;
+        qword* domain = _domains.ptr() + node1 * _domain_words;
+
+        const int* nei_vertices = _g1_csr.neiVertices(node1);
+        int nei_count = _g1_csr.degree(node1);
+        int degree1 = 0;
+
+        for (j = 0; j < nei_count; j++)
+            if (_core_1[nei_vertices[j]] != IGNORE)
+                degree1++;
+
+        for (j = _g2->vertexBegin(); j != _g2->vertexEnd(); j = _g2->vertexNext(j))
+        {
+            if (degree2[j] < degree1 || !(_free2[j / 64] & ((qword)1 << (j % 64))))
+                continue;
+
+            if (cb_match_vertex != 0 && !cb_match_vertex(*_g1, *_g2, _core_1.ptr(), node1, j, userdata))
+                continue;
+
+            domain[j / 64] |= (qword)1 << (j % 64);
+        }
+    }
+
+    while (_refineDomains())
+        ;
+
+    for (i = 0; i < _query_match_state.size() - 1; i++)
+    {
+        const qword* domain = _domains.ptr() + _query_match_state[i].atom_index * _domain_words;
+
+        for (j = 0; j < _domain_words; j++)
+            if (domain[j] != 0)
+                break;
+
+        if (j == _domain_words)
+        {
+            _domain_wipeout = true;
+            break;
+        }
+    }
+}
+
+bool EmbeddingEnumerator::_refineDomains()
+{
+    // A candidate is removed when some query neighbour has no candidates
+    // among the neighbours of it
+    bool changed = false;
+
+    for (int i = 0; i < _query_match_state.size() - 1; i++)
+    {
+        int node1 = _query_match_state[i].atom_index;
+        qword* domain = _domains.ptr() + node1 * _domain_words;
+
+        const int* nei_vertices = _g1_csr.neiVertices(node1);
+        int nei_count = _g1_csr.degree(node1);
+
+        for (int w = 0; w < _domain_words; w++)
+        {
+            for (int bit = 0; bit < 64 && (domain[w] >> bit) != 0; bit++)
+            {
+                if (!(domain[w] & ((qword)1 << bit)))
+                    continue;
+
+                int node2 = w * 64 + bit;
+                const qword* adjacency = _adjacency2.ptr() + node2 * _domain_words;
+
+                for (int j = 0; j < nei_count; j++)
+                {
+                    int other1 = nei_vertices[j];
+
+                    if (_core_1[other1] == IGNORE)
+                        continue;
+
+                    const qword* other_domain = _domains.ptr() + other1 * _domain_words;
+                    int k;
+
+                    for (k = 0; k < _domain_words; k++)
+                        if ((other_domain[k] & adjacency[k]) != 0)
+                            break;
+
+                    if (k == _domain_words)
+                    {
+                        domain[w] &= ~((qword)1 << bit);
+                        changed = true;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    return changed;
+}
+
+bool EmbeddingEnumerator::_domainHas(int node1, int node2) const
+{
+    return (_domains[node1 * _domain_words + node2 / 64] & ((qword)1 << (node2 % 64))) != 0;
+}
+
+void EmbeddingEnumerator::_setFree2(int node2, bool free)
+{
+    // Target vertices added after processStart() are not tracked
+    if (node2 >= _domain_size2 || _domain_words == 0)
+        return;
+
+    if (free)
+        _free2[node2 / 64] |= (qword)1 << (node2 % 64);
+    else
+        _free2[node2 / 64] &= ~((qword)1 << (node2 % 64));
 }
 
 EmbeddingEnumerator::_Enumerator::_Enumerator(EmbeddingEnumerator& context) : _context(context), _mapped_orbit_ids(context._s_pool)
@@ -309,6 +868,22 @@ EmbeddingEnumerator::_Enumerator::_Enumerator(const EmbeddingEnumerator::_Enumer
     _current_node1_idx = other._current_node1_idx;
 }
 
+EmbeddingEnumerator::_Enumerator::_Enumerator(EmbeddingEnumerator& context, const _Enumerator* other) : _context(context), _mapped_orbit_ids(context._s_pool)
+{
+    _core_len = other->_core_len;
+    _t1_len = other->_t1_len;
+    _t2_len = other->_t2_len;
+
+    _selected_node1 = -1;
+    _selected_node2 = -1;
+
+    _use_equivalence = false;
+
+    _initState();
+    _current_node1_idx = other->_current_node1_idx;
+    _current_node1 = other->_current_node1;
+}
+
 void EmbeddingEnumerator::_Enumerator::_initState()
 {
     _current_node2 = -1;
@@ -353,6 +928,7 @@ void EmbeddingEnumerator::_Enumerator::_addPairNode2(int node1, int node2)
 
     _context._core_1[node1] = node2;
     _context._core_2[node2] = node1;
+    _context._setFree2(node2, false);
 
     _core_len++;
 
@@ -436,9 +1012,9 @@ bool EmbeddingEnumerator::_Enumerator::_checkPair(int node1, int node2)
     int j;
     bool needRemove = false;
 
-    int node1_nei_count;
-    int* node1_nei_v = _context._g1_fast.getVertexNeiVertices(node1, node1_nei_count);
-    int* node1_nei_e = _context._g1_fast.getVertexNeiEdges(node1, node1_nei_count);
+    int node1_nei_count = _context._g1_csr.degree(node1);
+    const int* node1_nei_v = _context._g1_csr.neiVertices(node1);
+    const int* node1_nei_e = _context._g1_csr.neiEdges(node1);
 
     for (j = 0; j < node1_nei_count; j++)
     {
@@ -495,6 +1071,61 @@ bool EmbeddingEnumerator::_Enumerator::_checkPair(int node1, int node2)
     return true;
 }
 
+bool EmbeddingEnumerator::_Enumerator::_checkDomains(int node1, int node2)
+{
+    int words = _context._domain_words;
+
+    if (words == 0 || node2 >= _context._domain_size2)
+        return true;
+
+    if (!_context._domainHas(node1, node2))
+        return false;
+
+    // Forward checking: every unmapped neighbour of node1 must keep a free
+    // candidate adjacent to node2 and to the images of its mapped neighbours
+    const int* core_1 = _context._core_1.ptr();
+    const qword* free2 = _context._free2.ptr();
+    const qword* adjacency2 = _context._adjacency2.ptr();
+    const qword* node2_adjacency = adjacency2 + node2 * words;
+
+    int node1_nei_count = _context._g1_csr.degree(node1);
+    const int* node1_nei_v = _context._g1_csr.neiVertices(node1);
+
+    for (int i = 0; i < node1_nei_count; i++)
+    {
+        int other1 = node1_nei_v[i];
+
+        if (core_1[other1] != UNMAPPED && core_1[other1] != TERM_OUT)
+            continue;
+
+        const qword* domain = _context._domains.ptr() + other1 * words;
+        int other1_nei_count = _context._g1_csr.degree(other1);
+        const int* other1_nei_v = _context._g1_csr.neiVertices(other1);
+        int w;
+
+        for (w = 0; w < words; w++)
+        {
+            qword bits = domain[w] & free2[w] & node2_adjacency[w];
+
+            for (int j = 0; j < other1_nei_count && bits != 0; j++)
+            {
+                int image = core_1[other1_nei_v[j]];
+
+                if (image >= 0 && image < _context._domain_size2)
+                    bits &= adjacency2[image * words + w];
+            }
+
+            if (bits != 0)
+                break;
+        }
+
+        if (w == words)
+            return false;
+    }
+
+    return true;
+}
+
 void EmbeddingEnumerator::_Enumerator::restore()
 {
     int i, size;
@@ -516,6 +1147,7 @@ void EmbeddingEnumerator::_Enumerator::restore()
     {
         _context._core_1[_selected_node1] = _node1_prev_value;
         _context._core_2[_selected_node2] = _node2_prev_value;
+        _context._setFree2(_selected_node2, _node2_prev_value == UNMAPPED || _node2_prev_value == TERM_OUT);
 
         if (_context.cb_vertex_remove != 0)
             _context.cb_vertex_remove(*_context._g1, _selected_node1, _context.userdata);
@@ -532,6 +1164,13 @@ void EmbeddingEnumerator::_Enumerator::initForFirstSearch(int t1_len)
     _current_node1 = _context._query_match_state[_current_node1_idx].atom_index;
 }
 
+bool EmbeddingEnumerator::_Enumerator::tryPair(int node2)
+{
+    _current_node2 = node2;
+
+    return _checkNode2(node2, _current_node1) && _checkDomains(_current_node1, node2) && _checkPair(_current_node1, node2);
+}
+
 int EmbeddingEnumerator::_Enumerator::nextPair()
 {
     if (_current_node1 == -1)
@@ -539,6 +1178,8 @@ int EmbeddingEnumerator::_Enumerator::nextPair()
         // _RETURN0 should be returned only once.
         _current_node1 = -2;
         // all nodes of subgraph are mapped
+        if (_context._parallel_search != nullptr)
+            return _context._reportParallelEmbedding() ? _RETURN0 : _NOWAY;
         if (_context.cb_embedding == 0 ||
             _context.cb_embedding(*_context._g1, *_context._g2, _context._core_1.ptr(), _context._core_2.ptr(), _context.userdata) == 0)
             return _RETURN0;
@@ -566,6 +1207,9 @@ int EmbeddingEnumerator::_Enumerator::nextPair()
             if (!_checkNode2(_current_node2, _current_node1))
                 continue;
 
+            if (!_checkDomains(_current_node1, _current_node2))
+                continue;
+
             if (!_checkPair(_current_node1, _current_node2))
                 continue;
 
@@ -601,6 +1245,9 @@ int EmbeddingEnumerator::_Enumerator::nextPair()
             if (!_checkNode2(_current_node2, _current_node1))
                 continue;
 
+            if (!_checkDomains(_current_node1, _current_node2))
+                continue;
+
             if (!_checkPair(_current_node1, _current_node2))
                 continue;
 
@@ -644,11 +1291,15 @@ void EmbeddingEnumerator::_Enumerator::reset()
 
 const int* EmbeddingEnumerator::getSubgraphMapping()
 {
+    if (_parallel_found)
+        return _parallel_core_1.ptr();
     return _core_1.ptr();
 }
 
 const int* EmbeddingEnumerator::getSupergraphMapping()
 {
+    if (_parallel_found)
+        return _parallel_core_2.ptr();
     return _core_2.ptr();
 }
 
@@ -0,0 +1,102 @@
+/****************************************************************************
+ * Copyright (C) from 2009 to Present EPAM Systems.
+ *
+ * This file is part of Indigo toolkit.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ***************************************************************************/
+
+#include "graph/graph_csr.h"
+
+using namespace indigo;
+
+IMPL_ERROR(GraphCSR, "graph CSR");
+
+GraphCSR::GraphCSR()
+{
+    clear();
+}
+
+GraphCSR::GraphCSR(const Graph& g)
+{
+    build(g);
+}
+
+void GraphCSR::clear()
+{
+    _vertex_end = 0;
+    _vertices.clear();
+    _offsets.clear_resize(1);
+    _offsets[0] = 0;
+    _nei_vertices.clear();
+    _nei_edges.clear();
+    _edges.clear();
+}
+
+void GraphCSR::build(const Graph& g)
+{
+    _vertex_end = g.vertexEnd();
+    _vertices.clear();
+    _offsets.clear_resize(_vertex_end + 1);
+    _offsets.zerofill();
+
+    // Every edge appears twice in the neighbor lists
+    _nei_vertices.clear_resize(g.edgeCount() * 2);
+    _nei_edges.clear_resize(g.edgeCount() * 2);
+
+    int pos = 0;
+
+    for (int v = 0; v < _vertex_end; v++)
+    {
+        _offsets[v] = pos;
+
+        if (!g.hasVertex(v))
+            continue;
+
+        _vertices.push(v);
+
+        const Vertex& vertex = g.getVertex(v);
+        for (int i = vertex.neiBegin(); i != vertex.neiEnd(); i = vertex.neiNext(i))
+        {
+            if (pos >= _nei_vertices.size())
+                throw Error("neighbor lists do not match the edges");
+            _nei_vertices[pos] = vertex.neiVertex(i);
+            _nei_edges[pos] = vertex.neiEdge(i);
+            pos++;
+        }
+    }
+    _offsets[_vertex_end] = pos;
+
+    _edges.clear_resize(g.edgeEnd());
+    for (int e = 0; e < _edges.size(); e++)
+        _edges[e].beg = _edges[e].end = -1;
+    for (int e = g.edgeBegin(); e != g.edgeEnd(); e = g.edgeNext(e))
+        _edges[e] = g.getEdge(e);
+}
+
+bool GraphCSR::fits(const Graph& g) const
+{
+    return _vertex_end == g.vertexEnd() && _edges.size() == g.edgeEnd() && _vertices.size() == g.vertexCount() && _offsets[_vertex_end] == g.edgeCount() * 2;
+}
+
+int GraphCSR::findEdgeIndex(int beg, int end) const
+{
+    const int* nei_vertices = neiVertices(beg);
+    int count = degree(beg);
+
+    for (int i = 0; i < count; i++)
+        if (nei_vertices[i] == end)
+            return _nei_edges[_offsets[beg] + i];
+
+    return -1;
+}
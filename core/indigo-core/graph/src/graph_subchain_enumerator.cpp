@@ -24,7 +24,7 @@ CP_DEF(GraphSubchainEnumerator);
 
 GraphSubchainEnumerator::GraphSubchainEnumerator(Graph& graph, int min_edges, int max_edges, int mode)
     : _graph(graph), _max_edges(max_edges), _min_edges(min_edges), _mode(mode), CP_INIT, TL_CP_GET(_vertex_states), TL_CP_GET(_chain_vertices),
-      TL_CP_GET(_chain_edges)
+      TL_CP_GET(_chain_edges), TL_CP_GET(_csr)
 {
     context = 0;
     cb_handle_chain = 0;
@@ -47,6 +47,8 @@ void GraphSubchainEnumerator::processChains()
 {
     int i;
 
+    _csr.build(_graph);
+
     for (i = _graph.vertexBegin(); i < _graph.vertexEnd(); i = _graph.vertexNext(i))
     {
         _chain_vertices.push(i);
@@ -65,14 +67,14 @@ void GraphSubchainEnumerator::processChains()
 
 void GraphSubchainEnumerator::_DFS(int from)
 {
-    int i;
-
-    const Vertex& v = _graph.getVertex(from);
+    const int* nei_vertices = _csr.neiVertices(from);
+    const int* nei_edges = _csr.neiEdges(from);
+    int degree = _csr.degree(from);
 
-    for (i = v.neiBegin(); i != v.neiEnd(); i = v.neiNext(i))
+    for (int i = 0; i < degree; i++)
     {
-        int nei_idx = v.neiVertex(i);
-        int edge_idx = v.neiEdge(i);
+        int nei_idx = nei_vertices[i];
+        int edge_idx = nei_edges[i];
 
         if (_mode == MODE_NO_DUPLICATE_VERTICES)
         {
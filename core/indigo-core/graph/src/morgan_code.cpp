@@ -18,6 +18,7 @@
 
 #include "graph/morgan_code.h"
 #include "base_cpp/tlscont.h"
+#include "graph/graph_csr.h"
 
 using namespace indigo;
 
@@ -28,25 +29,33 @@ MorganCode::MorganCode(const Graph& g) : _g(g)
 void MorganCode::calculate(Array<long>& codes, int coeff, int iteration_count)
 {
     QS_DEF(Array<long>, next_codes);
+    QS_DEF(GraphCSR, csr);
+
+    csr.build(_g);
+
+    const int* vertices = csr.vertices();
+    int vertex_count = csr.vertexCount();
 
     next_codes.clear_resize(_g.vertexEnd());
     codes.clear_resize(_g.vertexEnd());
 
     int i, j, k;
 
-    for (i = _g.vertexBegin(); i < _g.vertexEnd(); i = _g.vertexNext(i))
-        codes[i] = _g.getVertex(i).degree();
+    for (i = 0; i < vertex_count; i++)
+        codes[vertices[i]] = csr.degree(vertices[i]);
 
     for (j = 0; j < iteration_count; j++)
     {
-        for (i = _g.vertexBegin(); i < _g.vertexEnd(); i = _g.vertexNext(i))
+        for (i = 0; i < vertex_count; i++)
         {
-            next_codes[i] = coeff * codes[i];
+            int v = vertices[i];
+            const int* nei_vertices = csr.neiVertices(v);
+            int degree = csr.degree(v);
 
-            const Vertex& vertex = _g.getVertex(i);
+            next_codes[v] = coeff * codes[v];
 
-            for (k = vertex.neiBegin(); k < vertex.neiEnd(); k = vertex.neiNext(k))
-                next_codes[i] += codes[vertex.neiVertex(k)];
+            for (k = 0; k < degree; k++)
+                next_codes[v] += codes[nei_vertices[k]];
         }
 
         memcpy(codes.ptr(), next_codes.ptr(), sizeof(long) * _g.vertexEnd());
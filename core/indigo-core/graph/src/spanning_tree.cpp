@@ -28,13 +28,14 @@ CP_DEF(SpanningTree);
 
 SpanningTree::SpanningTree(Graph& graph, const Filter* vertex_filter, const Filter* edge_filter)
     : _graph(graph), CP_INIT, TL_CP_GET(_edges_list), TL_CP_GET(_depth_counters), TL_CP_GET(_tree), TL_CP_GET(_mapping), TL_CP_GET(_inv_mapping),
-      TL_CP_GET(_edge_mapping), TL_CP_GET(_stack)
+      TL_CP_GET(_edge_mapping), TL_CP_GET(_stack), TL_CP_GET(_csr)
 {
     int i;
 
     _vertex_filter = vertex_filter;
     _edge_filter = edge_filter;
 
+    _csr.build(_graph);
     _tree.clear();
     _edges_list.clear();
     _mapping.clear_resize(_graph.vertexCount());
@@ -73,8 +74,8 @@ SpanningTree::SpanningTree(Graph& graph, const Filter* vertex_filter, const Filt
             break;
 
         StackElem& elem = _stack.push();
-        elem.vertex = &_graph.getVertex(_mapping[start]);
-        elem.nei_idx = elem.vertex->neiBegin();
+        elem.nei_idx = _csr.offset(_mapping[start]);
+        elem.nei_end = elem.nei_idx + _csr.degree(_mapping[start]);
         elem.vertex_idx = start;
         elem.parent_idx = -1;
         _depth_counters[start] = ++_current_depth;
@@ -84,6 +85,9 @@ SpanningTree::SpanningTree(Graph& graph, const Filter* vertex_filter, const Filt
 
 void SpanningTree::_build()
 {
+    const int* nei_vertices = _csr.neiVertices(0);
+    const int* nei_edges = _csr.neiEdges(0);
+
     while (_stack.size() > 0)
     {
         StackElem& elem = _stack.top();
@@ -91,36 +95,36 @@ void SpanningTree::_build()
         int v = elem.vertex_idx;
         int i = elem.nei_idx;
 
-        if (i < elem.vertex->neiEnd())
+        if (i < elem.nei_end)
         {
-            elem.nei_idx = elem.vertex->neiNext(i);
+            elem.nei_idx++;
 
-            int nei_v = elem.vertex->neiVertex(i);
+            int nei_v = nei_vertices[i];
             if (_vertex_filter != 0 && !_vertex_filter->valid(nei_v))
                 continue;
 
             if (_edge_filter != 0)
             {
-                int nei_edge = elem.vertex->neiEdge(i);
+                int nei_edge = nei_edges[i];
                 if (!_edge_filter->valid(nei_edge))
                     continue;
             }
 
-            int w = _inv_mapping[elem.vertex->neiVertex(i)];
+            int w = _inv_mapping[nei_v];
 
             if (_depth_counters[w] == 0)
             {
                 int idx = _tree.addEdge(v, w);
 
-                _edge_mapping[idx] = elem.vertex->neiEdge(i);
+                _edge_mapping[idx] = nei_edges[i];
 
                 StackElem& newelem = _stack.push();
 
                 _depth_counters[w] = ++_current_depth;
                 newelem.parent_idx = v;
                 newelem.vertex_idx = w;
-                newelem.vertex = &_graph.getVertex(_mapping[w]);
-                newelem.nei_idx = newelem.vertex->neiBegin();
+                newelem.nei_idx = _csr.offset(_mapping[w]);
+                newelem.nei_end = newelem.nei_idx + _csr.degree(_mapping[w]);
             }
             else if (w != elem.parent_idx && _depth_counters[w] < _depth_counters[v])
             {
@@ -130,7 +134,7 @@ void SpanningTree::_build()
                 edge.end_idx = w;
                 edge.ext_beg_idx = _mapping[v];
                 edge.ext_end_idx = _mapping[w];
-                edge.ext_edge_idx = elem.vertex->neiEdge(i);
+                edge.ext_edge_idx = nei_edges[i];
                 _edges_list.push(edge);
             }
         }
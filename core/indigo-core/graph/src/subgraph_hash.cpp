@@ -24,7 +24,8 @@ using namespace indigo;
 CP_DEF(SubgraphHash);
 
 SubgraphHash::SubgraphHash(Graph& g)
-    : _g(g), CP_INIT, TL_CP_GET(_codes), TL_CP_GET(_oldcodes), TL_CP_GET(_gf), TL_CP_GET(_default_vertex_codes), TL_CP_GET(_default_edge_codes)
+    : _g(g), CP_INIT, TL_CP_GET(_codes), TL_CP_GET(_oldcodes), TL_CP_GET(_gf), TL_CP_GET(_default_vertex_codes), TL_CP_GET(_default_edge_codes),
+      TL_CP_GET(_sets_codes), TL_CP_GET(_sets_oldcodes), TL_CP_GET(_sets_ranks), TL_CP_GET(_sets_first_adds)
 {
     max_iterations = _g.vertexEnd();
     _different_codes_count = 0;
@@ -43,6 +44,8 @@ SubgraphHash::SubgraphHash(Graph& g)
 
     _gf.setGraph(g);
     _gf.prepareEdges();
+
+    _code_sets_count = 0;
 }
 
 dword SubgraphHash::getHash()
@@ -139,3 +142,135 @@ int SubgraphHash::getDifferentCodesCount()
 {
     return _different_codes_count;
 }
+
+void SubgraphHash::setCodeSets(int count, const Array<int>* const* vertex_codes_sets, const Array<int>* const* edge_codes_sets)
+{
+    if (count < 1 || count > MAX_CODE_SETS)
+        throw Exception("SubgraphHash: invalid number of code sets: %d", count);
+
+    _code_sets_count = count;
+    for (int k = 0; k < count; k++)
+        _vertex_codes_sets[k] = vertex_codes_sets[k];
+
+    _sets_codes.clear_resize(_g.vertexEnd() * MAX_CODE_SETS);
+    _sets_oldcodes.clear_resize(_g.vertexEnd() * MAX_CODE_SETS);
+    _sets_ranks.clear_resize(_g.edgeEnd() * MAX_CODE_SETS);
+    _sets_first_adds.clear_resize(_g.edgeEnd() * MAX_CODE_SETS * 2);
+
+    const Edge* graph_edges = _gf.getEdges();
+
+    for (int e = _g.edgeBegin(); e != _g.edgeEnd(); e = _g.edgeNext(e))
+    {
+        const Edge& edge = graph_edges[e];
+
+        for (int k = 0; k < count; k++)
+        {
+            int edge_rank = edge_codes_sets[k]->at(e);
+            dword v1_code = vertex_codes_sets[k]->at(edge.beg);
+            dword v2_code = vertex_codes_sets[k]->at(edge.end);
+
+            _sets_ranks[e * MAX_CODE_SETS + k] = edge_rank + 1721;
+            _sets_first_adds[(e * MAX_CODE_SETS + k) * 2] = v2_code * v2_code + (v2_code + 23) * (edge_rank + 1721);
+            _sets_first_adds[(e * MAX_CODE_SETS + k) * 2 + 1] = v1_code * v1_code + (v1_code + 23) * (edge_rank + 1721);
+        }
+    }
+}
+
+void SubgraphHash::getHashes(const Array<int>& vertices, const Array<int>& edges, int sets_mask, dword* hashes, int* different_codes_counts)
+{
+    int i, k, iter;
+    int sets[MAX_CODE_SETS];
+    int sets_count = 0;
+
+    for (k = 0; k < _code_sets_count; k++)
+        if (sets_mask & (1 << k))
+            sets[sets_count++] = k;
+
+    if (sets_count == 0)
+        return;
+
+    dword* codes_ptr = _sets_codes.ptr();
+    dword* oldcodes_ptr = _sets_oldcodes.ptr();
+    const dword* ranks_ptr = _sets_ranks.ptr();
+    const dword* first_adds_ptr = _sets_first_adds.ptr();
+
+    const int* v = vertices.ptr();
+    const int* e = edges.ptr();
+    const Edge* graph_edges = _gf.getEdges();
+
+    for (i = 0; i < vertices.size(); i++)
+        for (k = 0; k < sets_count; k++)
+            codes_ptr[v[i] * MAX_CODE_SETS + sets[k]] = _vertex_codes_sets[sets[k]]->at(v[i]);
+
+    if (max_iterations > 0)
+    {
+        for (i = 0; i < edges.size(); i++)
+        {
+            const Edge& edge = graph_edges[e[i]];
+            const dword* adds = first_adds_ptr + e[i] * MAX_CODE_SETS * 2;
+
+            for (k = 0; k < sets_count; k++)
+            {
+                codes_ptr[edge.beg * MAX_CODE_SETS + sets[k]] += adds[sets[k] * 2];
+                codes_ptr[edge.end * MAX_CODE_SETS + sets[k]] += adds[sets[k] * 2 + 1];
+            }
+        }
+    }
+
+    for (iter = 1; iter < max_iterations; iter++)
+    {
+        for (i = 0; i < vertices.size(); i++)
+            for (k = 0; k < sets_count; k++)
+                oldcodes_ptr[v[i] * MAX_CODE_SETS + sets[k]] = codes_ptr[v[i] * MAX_CODE_SETS + sets[k]];
+
+        for (i = 0; i < edges.size(); i++)
+        {
+            const Edge& edge = graph_edges[e[i]];
+            const dword* ranks = ranks_ptr + e[i] * MAX_CODE_SETS;
+
+            for (k = 0; k < sets_count; k++)
+            {
+                int set = sets[k];
+                dword v1_code = oldcodes_ptr[edge.beg * MAX_CODE_SETS + set];
+                dword v2_code = oldcodes_ptr[edge.end * MAX_CODE_SETS + set];
+
+                codes_ptr[edge.beg * MAX_CODE_SETS + set] += v2_code * v2_code + (v2_code + 23) * ranks[set];
+                codes_ptr[edge.end * MAX_CODE_SETS + set] += v1_code * v1_code + (v1_code + 23) * ranks[set];
+            }
+        }
+    }
+
+    for (k = 0; k < sets_count; k++)
+    {
+        int set = sets[k];
+        dword result = 0;
+
+        for (i = 0; i < vertices.size(); i++)
+        {
+            dword code = codes_ptr[v[i] * MAX_CODE_SETS + set];
+
+            result += code * (code + 6849) + 29;
+        }
+        hashes[set] = result;
+
+        if (different_codes_counts != 0)
+        {
+            // The old codes are not needed any more and mark the used codes
+            for (i = 0; i < vertices.size(); i++)
+                oldcodes_ptr[v[i] * MAX_CODE_SETS + set] = 0;
+
+            int count = 0;
+            for (i = 0; i < vertices.size(); i++)
+            {
+                if (oldcodes_ptr[v[i] * MAX_CODE_SETS + set])
+                    continue;
+                count++;
+                dword cur_code = codes_ptr[v[i] * MAX_CODE_SETS + set];
+                for (int j = 0; j < vertices.size(); j++)
+                    if (codes_ptr[v[j] * MAX_CODE_SETS + set] == cur_code)
+                        oldcodes_ptr[v[j] * MAX_CODE_SETS + set] = 1;
+            }
+            different_codes_counts[set] = count;
+        }
+    }
+}
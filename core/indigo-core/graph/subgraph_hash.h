@@ -48,6 +48,20 @@ namespace indigo
 
         const Array<int>*vertex_codes, *edge_codes;
 
+        enum
+        {
+            MAX_CODE_SETS = 4
+        };
+
+        // Hashing of one subgraph with several sets of vertex and edge codes
+        // at once. getHashes() gives the same hashes and different codes
+        // counts as getHash() gives for each set separately, but walks the
+        // subgraph only once. The terms of the first iteration depend only on
+        // the edge and its ends, so they are computed in setCodeSets() once
+        // and every subgraph containing the edge reuses them.
+        void setCodeSets(int count, const Array<int>* const* vertex_codes_sets, const Array<int>* const* edge_codes_sets);
+        void getHashes(const Array<int>& vertices, const Array<int>& edges, int sets_mask, dword* hashes, int* different_codes_counts);
+
     private:
         Graph& _g;
         int _different_codes_count;
@@ -59,6 +73,13 @@ namespace indigo
 
         TL_CP_DECL(Array<int>, _default_vertex_codes);
         TL_CP_DECL(Array<int>, _default_edge_codes);
+
+        int _code_sets_count;
+        const Array<int>* _vertex_codes_sets[MAX_CODE_SETS];
+        TL_CP_DECL(Array<dword>, _sets_codes);      // MAX_CODE_SETS codes per vertex
+        TL_CP_DECL(Array<dword>, _sets_oldcodes);   // MAX_CODE_SETS codes per vertex
+        TL_CP_DECL(Array<dword>, _sets_ranks);      // MAX_CODE_SETS ranks per edge
+        TL_CP_DECL(Array<dword>, _sets_first_adds); // first iteration terms for both ends of every edge
     };
 
 } // namespace indigo
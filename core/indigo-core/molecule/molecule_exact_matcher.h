@@ -28,6 +28,7 @@
 #include "molecule/elements.h"
 #include "molecule/molecule.h"
 #include "molecule/molecule_cis_trans.h"
+#include "molecule/molecule_match_features.h"
 #include "molecule/molecule_stereocenters.h"
 #include "molecule/molecule_substructure_matcher.h"
 
@@ -65,6 +66,11 @@ namespace indigo
         void ignoreTargetAtom(int idx);
         void ignoreQueryAtom(int idx);
 
+        // Set precomputed features of the molecules to reject atom pairs
+        // without calling BaseMolecule. Each table is used only if it fits
+        // its molecule and has the NUMBER, ISOTOPE and CHARGE columns.
+        void setFeatures(const MoleculeMatchFeatures* query_features, const MoleculeMatchFeatures* target_features);
+
         static void parseConditions(const char* params, int& flags, float& rms_threshold);
 
         static bool matchAtoms(BaseMolecule& query, BaseMolecule& target, int sub_idx, int super_idx, int flags);
@@ -83,6 +89,8 @@ namespace indigo
         EmbeddingEnumerator _ee;
         Obj<GraphDecomposer> _query_decomposer;
         Obj<GraphDecomposer> _target_decomposer;
+        const MoleculeMatchFeatures* _query_features;
+        const MoleculeMatchFeatures* _target_features;
 
         struct _MatchToken
         {
@@ -94,6 +102,7 @@ namespace indigo
 
         static bool _matchAtoms(Graph& subgraph, Graph& supergraph, const int* core_sub, int sub_idx, int super_idx, void* userdata);
         static bool _matchBonds(Graph& subgraph, Graph& supergraph, int sub_idx, int super_idx, void* userdata);
+        bool _rejectByFeatures(int sub_idx, int super_idx);
         static int _embedding(Graph& subgraph, Graph& supergraph, int* core_sub, int* core_super, void* userdata);
 
         void _collectConnectedComponentsInfo();
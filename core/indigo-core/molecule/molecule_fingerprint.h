@@ -125,6 +125,9 @@ namespace indigo
         bool skip_any_atoms_bonds; // don't build 'any atoms, any bonds' part of the fingerprint
 
         void process();
+        // Builds the fingerprint of another molecule with the same settings,
+        // reusing the memory allocated for the previous ones
+        void process(BaseMolecule& mol);
 
         const byte* get();
         byte* getOrd();
@@ -156,11 +159,19 @@ namespace indigo
 
         void _handleSubgraph(Graph& graph, const Array<int>& vertices, const Array<int>& edges);
 
-        dword _canonicalizeFragment(BaseMolecule& mol, const Array<int>& vertices, const Array<int>& edges, bool use_atoms, bool use_bonds,
-                                    int* different_vertex_count);
+        // Parts of the fingerprint that a fragment variant sets bits in
+        enum
+        {
+            _PART_SIM = 0x01,
+            _PART_ORD = 0x02,
+            _PART_ANY = 0x04,
+            _PART_TAU = 0x08
+        };
 
-        void _canonicalizeFragmentAndSetBits(BaseMolecule& mol, const Array<int>& vertices, const Array<int>& edges, bool use_atoms, bool use_bonds,
-                                             int subgraph_type, dword& bits_to_set);
+        int _fragmentParts(const Array<int>& vertices, const Array<int>& edges, bool use_atoms, bool use_bonds, int subgraph_type);
+
+        void _canonicalizeFragmentAndSetBits(BaseMolecule& mol, const Array<int>& vertices, const Array<int>& edges, bool use_atoms, bool use_bonds, int parts,
+                                             dword hash, int different_vertex_count, dword& bits_to_set);
 
         void _makeFingerprint(BaseMolecule& mol);
         void _makeFingerprint_calcOrdSim(BaseMolecule& mol);
@@ -214,6 +225,9 @@ namespace indigo
         typedef std::unordered_map<HashBits, int, Hasher> HashesMap;
         TL_CP_DECL(HashesMap, _ord_hashes);
 
+        TL_CP_DECL(Array<char>, _atom_is_query);
+        TL_CP_DECL(Array<char>, _bond_is_query);
+
     private:
         MoleculeFingerprintBuilder(const MoleculeFingerprintBuilder&); // no implicit copy
     };
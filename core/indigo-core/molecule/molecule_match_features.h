@@ -0,0 +1,119 @@
+/****************************************************************************
+ * Copyright (C) from 2009 to Present EPAM Systems.
+ *
+ * This file is part of Indigo toolkit.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ***************************************************************************/
+
+#ifndef __molecule_match_features__
+#define __molecule_match_features__
+
+#include <climits>
+
+#include "base_cpp/array.h"
+#include "base_cpp/exception.h"
+
+#ifdef _WIN32
+#pragma warning(push)
+#pragma warning(disable : 4251)
+#endif
+
+namespace indigo
+{
+
+    class BaseMolecule;
+    class Output;
+    class Scanner;
+
+    // Snapshot of the atom and bond properties used by the matchers, stored
+    // column-wise. Every value is computed the same way as the matchers do it
+    // through BaseMolecule, so a table can be built once per target and
+    // shared by all the queries matched against it. The table is bound to
+    // the atom and bond indices of the molecule it was built from.
+    class DLLEXPORT MoleculeMatchFeatures
+    {
+    public:
+        enum
+        {
+            NUMBER,
+            CHARGE,
+            ISOTOPE,
+            TOTAL_H,
+            DEGREE,
+            CONNECTIVITY, // degree plus implicit hydrogens
+            VALENCE,
+            AROMATICITY,
+            RING_BONDS,
+            SSSR_RINGS,
+            SMALLEST_RING_SIZE,
+            RING_SIZES, // bit N is set if the atom belongs to an SSSR ring of size N < 32
+            ATOM_COLUMNS_COUNT
+        };
+
+        enum
+        {
+            BOND_ORDER,
+            BOND_TOPOLOGY,
+            BOND_COLUMNS_COUNT
+        };
+
+        // Value of an atom property that cannot be computed or is not
+        // defined for the atom, e.g. total hydrogens of a pseudoatom
+        static const int UNKNOWN = INT_MIN;
+
+        static const dword ALL_COLUMNS = 0xFFFFFFFFU;
+
+        MoleculeMatchFeatures();
+
+        void clear();
+
+        // Computes the selected columns; columns are bit masks of the column indices
+        void build(BaseMolecule& mol, dword atom_columns = ALL_COLUMNS, dword bond_columns = ALL_COLUMNS);
+
+        bool hasAtomColumn(int column) const;
+        bool hasBondColumn(int column) const;
+
+        // Checks that the table was built for a molecule of the same size
+        bool fits(BaseMolecule& mol) const;
+
+        int atomValue(int column, int idx) const;
+        int bondValue(int column, int idx) const;
+
+        const int* atomColumn(int column) const;
+        const int* bondColumn(int column) const;
+
+        void save(Output& output) const;
+        void load(Scanner& scanner);
+
+        DECL_ERROR;
+
+    protected:
+        static int _calcAtomValue(BaseMolecule& mol, int column, int idx);
+        static void _calcRingSizes(BaseMolecule& mol, Array<int>& values);
+
+        int _vertex_end;
+        int _edge_end;
+        dword _atom_columns;
+        dword _bond_columns;
+        Array<int> _atom_values[ATOM_COLUMNS_COUNT];
+        Array<int> _bond_values[BOND_COLUMNS_COUNT];
+    };
+
+} // namespace indigo
+
+#ifdef _WIN32
+#pragma warning(pop)
+#endif
+
+#endif
@@ -19,7 +19,6 @@
 #ifndef PROJECT_MOLECULE_MORGAN_FINGERPRINT_H
 #define PROJECT_MOLECULE_MORGAN_FINGERPRINT_H
 
-#include <set>
 #include <vector>
 
 #include "base_c/defs.h"
@@ -40,6 +39,11 @@ namespace indigo
         void packFingerprintECFP(int fp_depth, Array<byte>& res);
         void packFingerprintFCFP(int fp_depth, Array<byte>& res);
 
+        // Unfolded count vector: distinct feature hashes in ascending order
+        // and the number of features having each of them
+        void calculateCountsECFP(int fp_depth, Array<dword>& hashes, Array<int>& counts);
+        void calculateCountsFCFP(int fp_depth, Array<dword>& hashes, Array<int>& counts);
+
     private:
         enum
         {
@@ -53,6 +57,7 @@ namespace indigo
         void initDescriptors(MoleculeMorganFingerprintBuilder::InitialStateCallback initialStateCallback);
         void buildDescriptors(int fp_depth);
         void calculateNewAtomDescriptors(int iterationNumber);
+        void calculateCounts(Array<dword>& hashes, Array<int>& counts);
 
         /**
          * ECFP: (hash of 7 ints)
@@ -77,35 +82,38 @@ namespace indigo
          *  */
         static dword initialStateCallback_FCFP(BaseMolecule& mol, int idx);
 
-        struct BondDescriptor
-        {
-            int bond_type;
-            int vertex_idx;
-            int edge_idx;
-        };
-
-        struct FeatureDescriptor
-        {
-            uint32_t hash;
-            std::set<int> bond_set;
-
-            bool operator==(const FeatureDescriptor& rhs) const;
-
-            bool operator<(const FeatureDescriptor& rhs) const;
-        };
-
-        struct AtomDescriptor
-        {
-            FeatureDescriptor descr;
-            FeatureDescriptor new_descr;
-            std::vector<BondDescriptor> bond_descriptors;
-        };
-
-        int bondDescriptorCmp(const BondDescriptor& bd1, const BondDescriptor& bd2);
+        // Bond sets are bit sets over the edge indices, _set_words qwords each
+        qword bondSetHash(const qword* set) const;
+        int findSlot(const std::vector<int>& table, const std::vector<qword>& sets, const std::vector<qword>& set_hashes, const qword* set,
+                     qword set_hash) const;
 
         BaseMolecule& mol;
-        std::vector<FeatureDescriptor> features;
-        std::vector<AtomDescriptor> atom_descriptors;
+        int _set_words;
+
+        // Neighbours of the atoms as flat arrays; atoms are numbered densely
+        // in the order of vertex indices
+        std::vector<int> _nei_begin;
+        std::vector<int> _nei_atom;
+        std::vector<int> _nei_bond_type;
+        std::vector<int> _nei_edge;
+
+        // Current and next environment of every atom
+        std::vector<dword> _atom_hashes;
+        std::vector<dword> _new_atom_hashes;
+        std::vector<qword> _atom_sets;
+        std::vector<qword> _new_atom_sets;
+        std::vector<qword> _sort_keys;
+        std::vector<qword> _atom_set_hashes;
+
+        // Features found so far, with a hash table over their bond sets
+        std::vector<dword> _feature_hashes;
+        std::vector<qword> _feature_sets;
+        std::vector<qword> _feature_set_hashes;
+        std::vector<int> _feature_table;
+
+        // Distinct environments of the current iteration
+        std::vector<int> _candidates;
+        std::vector<int> _candidate_table;
     };
 
 }; // namespace indigo
@@ -0,0 +1,137 @@
+/****************************************************************************
+ * Copyright (C) from 2009 to Present EPAM Systems.
+ *
+ * This file is part of Indigo toolkit.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ***************************************************************************/
+
+#ifndef __molecule_query_program__
+#define __molecule_query_program__
+
+#include "base_cpp/obj_array.h"
+#include "base_cpp/red_black.h"
+#include "molecule/molecule_match_features.h"
+#include "molecule/query_molecule.h"
+
+#ifdef _WIN32
+#pragma warning(push)
+#pragma warning(disable : 4251)
+#endif
+
+namespace indigo
+{
+
+    class AromaticityMatcher;
+
+    // Query atom and bond expression trees lowered into flat programs.
+    // Every program is a prefix-ordered array of instructions where each
+    // instruction knows where its subtree ends, so operands are walked
+    // without following node pointers. Leaves compare the columns of
+    // MoleculeMatchFeatures, lists of elements are tested with a bitmask, and
+    // constraints that cannot be lowered are delegated to
+    // MoleculeSubstructureMatcher.
+    class DLLEXPORT MoleculeQueryProgram
+    {
+    public:
+        typedef ObjArray<RedBlackStringMap<int>> FragmentMatchCache;
+
+        MoleculeQueryProgram();
+
+        void compile(QueryMolecule& query);
+        void clear();
+        bool isCompiled() const;
+        // Checks that atoms or bonds were not added to the query after compilation
+        bool fits(QueryMolecule& query) const;
+
+        // Target features are computed on the first match after reset,
+        // so the target must not change between them
+        void resetTarget();
+
+        // Features built in advance for the target. They are used when they
+        // fit the target and contain all the columns the program needs,
+        // otherwise the program builds its own.
+        void setTargetFeatures(const MoleculeMatchFeatures* features);
+
+        bool matchAtom(int sub_idx, BaseMolecule& target, int super_idx, FragmentMatchCache* fmcache, dword flags);
+        bool matchBond(int sub_idx, BaseMolecule& target, int super_idx, AromaticityMatcher* am, dword flags);
+
+        DECL_ERROR;
+
+    protected:
+        enum
+        {
+            _OP_TRUE,
+            _OP_AND,
+            _OP_OR,
+            _OP_NOT,
+            _OP_RANGE,    // feature value within [value_min, value_max]
+            _OP_CHARGE,   // charge range, disabled by MATCH_ATOM_CHARGE
+            _OP_VALENCE,  // valence range, disabled by MATCH_ATOM_VALENCE
+            _OP_ELEMENTS, // atom number in the bitmask _element_masks[value_min]
+            _OP_BOND_ORDER,
+            _OP_FALLBACK // original node is matched by MoleculeSubstructureMatcher
+        };
+
+        struct _Instruction
+        {
+            int op;
+            int feature; // column of MoleculeMatchFeatures
+            int end; // index of the instruction after the subtree
+            int value_min;
+            int value_max;
+            QueryMolecule::Node* node;
+        };
+
+        struct _ElementMask
+        {
+            qword bits[2];
+        };
+
+        bool _evalAtom(int pos, BaseMolecule& target, int super_idx, FragmentMatchCache* fmcache, dword flags);
+        bool _evalBond(int pos, BaseMolecule& target, int sub_idx, int super_idx, AromaticityMatcher* am, dword flags);
+
+        void _emitAtom(QueryMolecule::Atom* atom);
+        void _emitBond(QueryMolecule::Bond* bond);
+        int _addInstruction(Array<_Instruction>& code, int op, QueryMolecule::Node* node);
+        void _collectOperands(QueryMolecule::Node* node, int op, Array<QueryMolecule::Node*>& operands);
+        static int _atomFeature(int type);
+        static bool _isElement(QueryMolecule::Node* node);
+
+        void _prepareTarget(BaseMolecule& target);
+
+        Array<_Instruction> _atom_code;
+        Array<_Instruction> _bond_code;
+        Array<int> _atom_start;
+        Array<int> _bond_start;
+        Array<_ElementMask> _element_masks;
+
+        // Columns the program reads
+        dword _atom_columns;
+        dword _bond_columns;
+
+        const MoleculeMatchFeatures* _external_features;
+        MoleculeMatchFeatures _own_features;
+        const MoleculeMatchFeatures* _features;
+
+        bool _compiled;
+        bool _target_ready;
+    };
+
+} // namespace indigo
+
+#ifdef _WIN32
+#pragma warning(pop)
+#endif
+
+#endif
@@ -25,6 +25,7 @@
 #include "molecule/molecule.h"
 #include "molecule/molecule_arom_match.h"
 #include "molecule/molecule_pi_systems_matcher.h"
+#include "molecule/molecule_query_program.h"
 #include "molecule/query_molecule.h"
 #include <memory>
 
@@ -63,6 +64,9 @@ namespace indigo
         // Set vertex neibourhood counters for effective matching
         void setNeiCounters(const MoleculeAtomNeighbourhoodCounters* query_counters, const MoleculeAtomNeighbourhoodCounters* target_counters);
 
+        // Set precomputed target features to avoid computing them for every query
+        void setTargetFeatures(const MoleculeMatchFeatures* features);
+
         // Property indicating that first atom in the query should be ignored because
         // it will be used later. For example, it is fixed during fragment matching
         bool not_ignore_first_atom;
@@ -84,6 +88,19 @@ namespace indigo
         int match_3d;        // 0 or AFFINE or CONFORMATION
         float rms_threshold; // for AFFINE and CONFORMATION
 
+        // Number of threads for find(); 0 or 1 for the sequential search.
+        // The parallel search is used only for queries without R-groups,
+        // recursive SMARTS and 3D constraints, and without the pi-systems
+        // matcher. The first embedding it finds may differ from the one found
+        // by the sequential search, and findNext() can not continue it.
+        int parallel_threads;
+
+        // Precompute the candidate target atoms of every query atom and prune
+        // the search with them (see EmbeddingEnumerator::use_candidate_domains).
+        // Ignored for queries with component-level grouping, R-groups and
+        // AFFINE matching, which check the atoms against the current mapping.
+        bool use_candidate_domains;
+
         void ignoreQueryAtom(int idx);
         void ignoreTargetAtom(int idx);
         bool fix(int query_atom_idx, int target_atom_idx);
@@ -178,7 +195,11 @@ namespace indigo
 
         static int _embedding(Graph& subgraph, Graph& supergraph, int* core_sub, int* core_super, void* userdata);
 
+        static void* _createWorker(void* userdata);
+        static void _releaseWorker(void* worker_userdata, void* userdata);
+
         int _embedding_common(int* core_sub, int* core_super);
+        int _acceptEmbedding(int* core_sub, int* core_super);
         int _embedding_markush(int* core_sub, int* core_super);
 
         static bool _canUseEquivalenceHeuristic(QueryMolecule& query);
@@ -189,6 +210,10 @@ namespace indigo
 
         static int _countSubstituents(Molecule& mol, int idx);
 
+        bool _canUseCandidateDomains();
+        bool _canUseParallelSearch();
+        void _prepareParallelSearch();
+
         bool _checkRGroupConditions();
         bool _attachRGroupAndContinue(int* core1, int* core2, QueryMolecule* fragment, bool two_attachment_points, int att_idx1, int att_idx2, int rgroup_idx,
                                       bool rest_h);
@@ -213,8 +238,17 @@ namespace indigo
         Obj<AromaticityMatcher> _am;
         Obj<MoleculePiSystemsMatcher> _pi_systems_matcher;
 
+        // Query atoms and bonds compiled in setQuery for the main embedding enumerator
+        MoleculeQueryProgram _program;
+
         bool _h_unfold; // implicit target hydrogens unfolded
 
+        // Parallel search: the matchers of the workers pass embeddings to their
+        // owner; the embedding enumerator reports them one at a time
+        MoleculeSubstructureMatcher* _parallel_owner;
+        MoleculeMatchFeatures _parallel_features;
+        bool _parallel_prepared;
+
         CP_DECL;
         TL_CP_DECL(Array<int>, _3d_constrained_atoms);
         TL_CP_DECL(Array<int>, _unfolded_target_h);
@@ -24,6 +24,7 @@
 #include "graph/embeddings_storage.h"
 #include "molecule/molecule.h"
 #include "molecule/molecule_layered_molecules.h"
+#include "molecule/molecule_match_features.h"
 #include "molecule/molecule_tautomer.h"
 #include "molecule/molecule_tautomer_enumerator.h"
 
@@ -97,6 +98,12 @@ namespace indigo
         };
 
         SubstructureSearchBreadcrumps _breadcrumps;
+
+        // Atom numbers do not change between the tautomers, so query atoms
+        // with a definite number are checked against them first
+        MoleculeMatchFeatures _target_features;
+        Array<int> _query_numbers;
+
         bool _needAromatize;
         bool _allLayersFound;
         int _layerBeg;
@@ -54,6 +54,17 @@ namespace indigo
         int currentNumber();
         int count();
 
+        // Offsets of the records read so far and the position where reading
+        // stopped; setOffsets() restores them, e.g. from a saved index
+        const Array<long long>& offsets() const;
+        long long maxOffset() const;
+        void setOffsets(const Array<long long>& offsets, long long max_offset);
+
+        // Threads to inflate gzip input with, see GZipScanner::setThreads()
+        void setDecompressionThreads(int threads);
+        // Faster seeking in gzip input, see GZipScanner::setRandomAccess()
+        void setRandomAccess(bool enable);
+
         CP_DECL;
         /*
          * Data buffer with reaction or molecule for current record
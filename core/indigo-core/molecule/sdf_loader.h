@@ -27,6 +27,41 @@ namespace indigo
 {
 
     class Scanner;
+    class BufferScanner;
+
+    // Lazy view of an SDF record. Nothing is copied or parsed in advance:
+    // the molfile and the data items are located in the record text on
+    // request. Line breaks inside multi-line values are kept as in the input.
+    class DLLEXPORT SdfRecord
+    {
+    public:
+        SdfRecord();
+
+        void reset(const char* data, int size);
+
+        const char* ptr() const;
+        int size() const;
+
+        // Connection table part of the record, before the first data header
+        void getMolfile(const char*& molfile, int& size) const;
+        // Returns false if the record has no data item with this name; the
+        // last item wins if the name is repeated, as in SdfLoader::properties
+        bool getProperty(const char* name, const char*& value, int& size) const;
+        // Adds all the data items to the map, with '\n' line breaks
+        void getProperties(PropertiesMap& properties) const;
+        // Copies the record text as SdfLoader::readNext() stores it in `data`:
+        // with '\n' line breaks and without the empty line ending the molfile
+        void getData(Array<char>& data) const;
+
+        // Copies a value found by getProperty() with '\n' line breaks
+        static void copyValue(const char* value, int size, Array<char>& out);
+
+    protected:
+        const char* _data;
+        int _size;
+
+        bool _nextItem(const char*& p, const char*& name, int& name_size, const char*& value, int& value_size) const;
+    };
 
     class SdfLoader
     {
@@ -44,6 +79,14 @@ namespace indigo
 
         bool isEOF();
         void readNext();
+        // Reads the next record without filling `data` and `properties`. For
+        // the input held in memory (BufferScanner, MappedFileScanner) the record
+        // points to the scanner buffer and stays valid while the scanner
+        // lives; for other input it points to `data` until the next read. The
+        // records end where readNext() ends them.
+        void readNextRecord(SdfRecord& record);
+        // Whether readNextRecord() returns the records in the scanner buffer
+        bool recordsInBuffer() const;
 
         long long tell();
         int currentNumber();
@@ -51,6 +94,21 @@ namespace indigo
 
         void readAt(int index);
 
+        // Offsets of the records read so far and the position where reading
+        // stopped; setOffsets() restores them, e.g. from a saved index
+        const Array<long long>& offsets() const;
+        long long maxOffset() const;
+        void setOffsets(const Array<long long>& offsets, long long max_offset);
+
+        // Threads to inflate gzip input with, see GZipScanner::setThreads()
+        void setDecompressionThreads(int threads);
+        // Faster seeking in gzip input, see GZipScanner::setRandomAccess()
+        void setRandomAccess(bool enable);
+
+        // When cleared, readNext() leaves `properties` empty; the data items
+        // are still kept in `data` and can be read with SdfRecord
+        bool parse_properties;
+
         CP_DECL;
         TL_CP_DECL(Array<char>, data);
         TL_CP_DECL(PropertiesMap, properties);
@@ -60,6 +118,8 @@ namespace indigo
     protected:
         Scanner* _scanner;
         bool _own_scanner;
+        // Set when the input is read from memory without a copy
+        BufferScanner* _buffer;
         TL_CP_DECL(Array<long long>, _offsets);
         TL_CP_DECL(Array<char>, _preread);
         int _current_number;
@@ -26,6 +26,8 @@ MoleculeExactMatcher::MoleculeExactMatcher(BaseMolecule& query, BaseMolecule& ta
 {
     flags = 0;
     rms_threshold = 0;
+    _query_features = nullptr;
+    _target_features = nullptr;
 
     _ee.cb_match_vertex = _matchAtoms;
     _ee.cb_match_edge = _matchBonds;
@@ -36,6 +38,65 @@ MoleculeExactMatcher::MoleculeExactMatcher(BaseMolecule& query, BaseMolecule& ta
     _ee.setSubgraph(query);
 }
 
+void MoleculeExactMatcher::setFeatures(const MoleculeMatchFeatures* query_features, const MoleculeMatchFeatures* target_features)
+{
+    const auto usable = [](const MoleculeMatchFeatures* features, BaseMolecule& mol) {
+        return features != nullptr && features->fits(mol) && features->hasAtomColumn(MoleculeMatchFeatures::NUMBER) &&
+               features->hasAtomColumn(MoleculeMatchFeatures::ISOTOPE) && features->hasAtomColumn(MoleculeMatchFeatures::CHARGE);
+    };
+
+    if (usable(query_features, _query) && usable(target_features, _target))
+    {
+        _query_features = query_features;
+        _target_features = target_features;
+    }
+    else
+    {
+        _query_features = nullptr;
+        _target_features = nullptr;
+    }
+}
+
+bool MoleculeExactMatcher::_rejectByFeatures(int sub_idx, int super_idx)
+{
+    // Only the conditions that make matchAtoms() fail for sure are checked here
+    int qnumber = _query_features->atomValue(MoleculeMatchFeatures::NUMBER, sub_idx);
+    int tnumber = _target_features->atomValue(MoleculeMatchFeatures::NUMBER, super_idx);
+    if (qnumber == MoleculeMatchFeatures::UNKNOWN || tnumber == MoleculeMatchFeatures::UNKNOWN)
+        return false;
+    if (qnumber != tnumber)
+        return true;
+
+    // R-sites are compared by their bits only
+    if (qnumber == ELEM_RSITE)
+        return false;
+
+    if (flags & CONDITION_ISOTOPE)
+    {
+        int qisotope = _query_features->atomValue(MoleculeMatchFeatures::ISOTOPE, sub_idx);
+        int tisotope = _target_features->atomValue(MoleculeMatchFeatures::ISOTOPE, super_idx);
+        if (qisotope != MoleculeMatchFeatures::UNKNOWN && tisotope != MoleculeMatchFeatures::UNKNOWN && qisotope != tisotope)
+            return true;
+    }
+
+    if (flags & CONDITION_ELECTRONS)
+    {
+        int qcharge = _query_features->atomValue(MoleculeMatchFeatures::CHARGE, sub_idx);
+        int tcharge = _target_features->atomValue(MoleculeMatchFeatures::CHARGE, super_idx);
+        if (qcharge != MoleculeMatchFeatures::UNKNOWN && tcharge != MoleculeMatchFeatures::UNKNOWN)
+        {
+            if (qcharge == CHARGE_UNKNOWN)
+                qcharge = 0;
+            if (tcharge == CHARGE_UNKNOWN)
+                tcharge = 0;
+            if (qcharge != tcharge)
+                return true;
+        }
+    }
+
+    return false;
+}
+
 void MoleculeExactMatcher::ignoreTargetAtom(int idx)
 {
     _ee.ignoreSupergraphVertex(idx);
@@ -154,6 +215,9 @@ bool MoleculeExactMatcher::_matchAtoms(Graph& subgraph, Graph& supergraph, const
             return false;
     }
 
+    if (self->_query_features != nullptr && self->_rejectByFeatures(sub_idx, super_idx))
+        return false;
+
     return matchAtoms(query, target, sub_idx, super_idx, flags);
 }
 
@@ -39,7 +39,8 @@ CP_DEF(MoleculeFingerprintBuilder);
 MoleculeFingerprintBuilder::MoleculeFingerprintBuilder(BaseMolecule& mol, const MoleculeFingerprintParameters& parameters)
     : cancellation(getCancellationHandler()), _mol(mol), _parameters(parameters), CP_INIT, TL_CP_GET(_total_fingerprint), TL_CP_GET(_atom_codes),
       TL_CP_GET(_bond_codes), TL_CP_GET(_atom_codes_empty), TL_CP_GET(_bond_codes_empty), TL_CP_GET(_atom_hydrogens), TL_CP_GET(_atom_charges),
-      TL_CP_GET(_vertex_connectivity), TL_CP_GET(_fragment_vertex_degree), TL_CP_GET(_bond_orders), TL_CP_GET(_ord_hashes)
+      TL_CP_GET(_vertex_connectivity), TL_CP_GET(_fragment_vertex_degree), TL_CP_GET(_bond_orders), TL_CP_GET(_ord_hashes),
+      TL_CP_GET(_atom_is_query), TL_CP_GET(_bond_is_query)
 {
     _total_fingerprint.resize(_parameters.fingerprintSize());
     cb_fragment = 0;
@@ -61,7 +62,7 @@ MoleculeFingerprintBuilder::MoleculeFingerprintBuilder(BaseMolecule& mol, const
 
 void MoleculeFingerprintBuilder::_initHashCalculations(BaseMolecule& mol, const Filter& vfilter)
 {
-    subgraph_hash.create(mol);
+    subgraph_hash.recreate(mol);
 
     _atom_codes.clear_resize(mol.vertexEnd());
     _atom_codes_empty.clear_resize(mol.vertexEnd());
@@ -78,6 +79,23 @@ void MoleculeFingerprintBuilder::_initHashCalculations(BaseMolecule& mol, const
         _bond_codes_empty[i] = 0;
     }
 
+    // Variants of every fragment: with atoms and bonds, with atoms only,
+    // with bonds only and with neither of them
+    const Array<int>* vertex_codes_sets[] = {&_atom_codes, &_atom_codes, &_atom_codes_empty, &_atom_codes_empty};
+    const Array<int>* edge_codes_sets[] = {&_bond_codes, &_bond_codes_empty, &_bond_codes, &_bond_codes_empty};
+    subgraph_hash->setCodeSets(4, vertex_codes_sets, edge_codes_sets);
+
+    // Query atoms and bonds are checked for every fragment
+    _atom_is_query.clear_resize(mol.vertexEnd());
+    _bond_is_query.clear_resize(mol.edgeEnd());
+    for (int i : mol.vertices())
+        _atom_is_query[i] = (mol.getAtomNumber(i) == -1);
+    for (int i : mol.edges())
+    {
+        int bond_order = mol.getBondOrder(i);
+        _bond_is_query[i] = (bond_order == -1 || (query && mol.asQueryMolecule().aromaticity.canBeAromatic(i) && bond_order != BOND_AROMATIC));
+    }
+
     // Count number of hydrogens and find non-carbon atoms
     _atom_hydrogens.clear_resize(mol.vertexEnd());
     _atom_charges.clear_resize(mol.vertexEnd());
@@ -159,9 +177,15 @@ MoleculeFingerprintBuilder::~MoleculeFingerprintBuilder()
 }
 
 void MoleculeFingerprintBuilder::process()
+{
+    process(_mol);
+}
+
+void MoleculeFingerprintBuilder::process(BaseMolecule& mol)
 {
     _total_fingerprint.zerofill();
-    _makeFingerprint(_mol);
+    _ord_hashes.clear();
+    _makeFingerprint(mol);
 }
 /*
  * Accepted types: 'sim', 'sub', 'sub-res', 'sub-tau', 'full'
@@ -217,7 +241,7 @@ void MoleculeFingerprintBuilder::parseFingerprintType(const char* type, bool que
 }
 
 /**
- * Accepted types: 'SIM', 'CHEM', 'ECFP2', 'ECFP4', 'ECFP6', 'FCFP2', 'FCFP4', 'FCFP6'
+ * Accepted types: 'SIM', 'CHEM', 'ECFP2', 'ECFP4', 'ECFP6', 'ECFP8', 'FCFP2', 'FCFP4', 'FCFP6', 'FCFP8'
  * */
 SimilarityType MoleculeFingerprintBuilder::parseSimilarityType(const char* type)
 {
@@ -235,21 +259,16 @@ SimilarityType MoleculeFingerprintBuilder::parseSimilarityType(const char* type)
         return SimilarityType::ECFP6;
     else if (strcasecmp(type, "ECFP8") == 0)
         return SimilarityType::ECFP8;
+    else if (strcasecmp(type, "FCFP2") == 0)
+        return SimilarityType::FCFP2;
+    else if (strcasecmp(type, "FCFP4") == 0)
+        return SimilarityType::FCFP4;
+    else if (strcasecmp(type, "FCFP6") == 0)
+        return SimilarityType::FCFP6;
+    else if (strcasecmp(type, "FCFP8") == 0)
+        return SimilarityType::FCFP8;
     else
         throw Exception("Unknown similarity type '%s'", type);
-
-    /* TODO: implement FCFP fingerprints
-    else if(strcasecmp(type, "FCFP2") == 0)
-       return SimilarityType::FCFP2;
-    else if(strcasecmp(type, "FCFP4") == 0)
-       return SimilarityType::FCFP4;
-    else if(strcasecmp(type, "FCFP6") == 0)
-       return SimilarityType::FCFP6;
-    else if(strcasecmp(type, "FCFP8") == 0)
-       return SimilarityType::FCFP8;
-    else
-       throw Exception("Unknown similarity type '%s'", type);
-    */
 }
 
 const char* MoleculeFingerprintBuilder::printSimilarityType(SimilarityType type)
@@ -357,29 +376,6 @@ int MoleculeFingerprintBuilder::_maximalSubgraphCriteriaValue(Graph& graph, cons
     return ret;
 }
 
-dword MoleculeFingerprintBuilder::_canonicalizeFragment(BaseMolecule& mol, const Array<int>& vertices, const Array<int>& edges, bool use_atoms, bool use_bonds,
-                                                        int* different_vertex_count)
-{
-    if (use_bonds)
-        subgraph_hash->edge_codes = &_bond_codes;
-    else
-        subgraph_hash->edge_codes = &_bond_codes_empty;
-
-    if (use_atoms)
-        subgraph_hash->vertex_codes = &_atom_codes;
-    else
-        subgraph_hash->vertex_codes = &_atom_codes_empty;
-
-    subgraph_hash->max_iterations = (edges.size() + 1) / 2;
-    subgraph_hash->calc_different_codes_count = true;
-
-    dword ret = subgraph_hash->getHash(vertices, edges);
-    if (different_vertex_count != 0)
-        *different_vertex_count = subgraph_hash->getDifferentCodesCount();
-
-    return ret;
-}
-
 void MoleculeFingerprintBuilder::_addOrdHashBits(dword hash, int bits_per_fragment)
 {
     HashBits hash_bits(hash, bits_per_fragment);
@@ -421,58 +417,60 @@ int MoleculeFingerprintBuilder::_calculateFragmentExternalConn(BaseMolecule& mol
     return sum;
 }
 
-void MoleculeFingerprintBuilder::_canonicalizeFragmentAndSetBits(BaseMolecule& mol, const Array<int>& vertices, const Array<int>& edges, bool use_atoms,
-                                                                 bool use_bonds, int subgraph_type, dword& bits_set)
+int MoleculeFingerprintBuilder::_fragmentParts(const Array<int>& vertices, const Array<int>& edges, bool use_atoms, bool use_bonds, int subgraph_type)
 {
-    bool set_sim = false, set_ord = false, set_any = false, set_tau = false;
+    int parts = 0;
 
     if (subgraph_type == TautomerSuperStructure::ORIGINAL)
     {
         // SIM is made of: rings of size up to 6, trees of size up to 4 edges
         if (use_atoms && use_bonds && !skip_sim && _parameters.sim_qwords > 0 && _parameters.similarity_type == SimilarityType::SIM)
         {
-            set_sim = true;
-            if (vertices.size() > 6)
-                set_sim = false;
-            else if (edges.size() == vertices.size() - 1 && edges.size() > 4)
-                set_sim = false;
+            if (vertices.size() <= 6 && !(edges.size() == vertices.size() - 1 && edges.size() > 4))
+                parts |= _PART_SIM;
         }
 
         // ORD and ANY are made of all fragments having more than 2 vertices
         if (use_atoms && use_bonds)
         {
             if (!skip_ord && _parameters.ord_qwords > 0)
-                set_ord = true;
+                parts |= _PART_ORD;
         }
         else if (_parameters.any_qwords > 0)
         {
             if (use_atoms)
             {
                 if (!skip_any_bonds)
-                    set_any = true;
+                    parts |= _PART_ANY;
             }
             else if (use_bonds)
             {
                 if (!skip_any_atoms)
-                    set_any = true;
+                    parts |= _PART_ANY;
             }
             else if (!skip_any_atoms_bonds)
-                set_any = true;
+                parts |= _PART_ANY;
         }
     }
 
     // TAU is made of fragments without bond types
     if (!use_bonds && !skip_tau && _parameters.tau_qwords > 0)
-        set_tau = true;
+        parts |= _PART_TAU;
+
+    return parts;
+}
+
+void MoleculeFingerprintBuilder::_canonicalizeFragmentAndSetBits(BaseMolecule& mol, const Array<int>& vertices, const Array<int>& edges, bool use_atoms,
+                                                                 bool use_bonds, int parts, dword hash, int different_vertex_count, dword& bits_set)
+{
+    bool set_sim = (parts & _PART_SIM) != 0;
+    bool set_ord = (parts & _PART_ORD) != 0;
+    bool set_any = (parts & _PART_ANY) != 0;
+    bool set_tau = (parts & _PART_TAU) != 0;
 
     if (!set_any && !set_ord && !set_sim && !set_tau)
         return;
 
-    // different_vertex_count is equal to the number of orbits
-    // if codes have no collisions
-    int different_vertex_count;
-    dword hash = _canonicalizeFragment(mol, vertices, edges, use_atoms, use_bonds, &different_vertex_count);
-
     // Calculate bits count factor based on different_vertex_count
     int bits_per_fragment;
     if (2 * vertices.size() > 3 * different_vertex_count)
@@ -567,35 +565,54 @@ void MoleculeFingerprintBuilder::_handleSubgraph(Graph& graph, const Array<int>&
 
     // Check if fragment has query atoms or query bonds
     for (i = 0; i < vertices.size(); i++)
-        if (mol.getAtomNumber(vertices[i]) == -1)
+        if (_atom_is_query[vertices[i]])
             break;
 
     bool has_query_atoms = (i != vertices.size());
 
     for (i = 0; i < edges.size(); i++)
-    {
-        int e = edges[i];
-        int bond_order = mol.getBondOrder(e);
-        if (bond_order == -1 || (query && mol.asQueryMolecule().aromaticity.canBeAromatic(e) && bond_order != BOND_AROMATIC))
+        if (_bond_is_query[edges[i]])
             break;
-    }
 
     bool has_query_bonds = (i != edges.size());
 
-    dword bits_set = 0;
+    // Parts of the fingerprint for every variant of the fragment, in the
+    // order of the code sets passed to subgraph_hash
+    int parts[4] = {0, 0, 0, 0};
     if (!has_query_atoms && !has_query_bonds)
-        _canonicalizeFragmentAndSetBits(mol, vertices, edges, true, true, subgraph_type, bits_set);
+        parts[0] = _fragmentParts(vertices, edges, true, true, subgraph_type);
+    if (!query || !has_query_atoms)
+        parts[1] = _fragmentParts(vertices, edges, true, false, subgraph_type);
+    if (!query || !has_query_bonds)
+        parts[2] = _fragmentParts(vertices, edges, false, true, subgraph_type);
+    parts[3] = _fragmentParts(vertices, edges, false, false, subgraph_type);
+
+    int sets_mask = 0;
+    for (i = 0; i < 4; i++)
+        if (parts[i] != 0)
+            sets_mask |= (1 << i);
+
+    if (sets_mask == 0)
+        return;
+
+    // different_vertex_count is equal to the number of orbits
+    // if codes have no collisions
+    dword hashes[4];
+    int different_vertex_counts[4];
+    subgraph_hash->max_iterations = (edges.size() + 1) / 2;
+    subgraph_hash->getHashes(vertices, edges, sets_mask, hashes, different_vertex_counts);
+
+    dword bits_set = 0;
+    _canonicalizeFragmentAndSetBits(mol, vertices, edges, true, true, parts[0], hashes[0], different_vertex_counts[0], bits_set);
 
     dword bits_set_a = bits_set;
-    if (!query || !has_query_atoms)
-        _canonicalizeFragmentAndSetBits(mol, vertices, edges, true, false, subgraph_type, bits_set_a);
+    _canonicalizeFragmentAndSetBits(mol, vertices, edges, true, false, parts[1], hashes[1], different_vertex_counts[1], bits_set_a);
 
     dword bits_set_b = bits_set;
-    if (!query || !has_query_bonds)
-        _canonicalizeFragmentAndSetBits(mol, vertices, edges, false, true, subgraph_type, bits_set_b);
+    _canonicalizeFragmentAndSetBits(mol, vertices, edges, false, true, parts[2], hashes[2], different_vertex_counts[2], bits_set_b);
 
     dword bits_set_ab = (bits_set_a | bits_set_b);
-    _canonicalizeFragmentAndSetBits(mol, vertices, edges, false, false, subgraph_type, bits_set_ab);
+    _canonicalizeFragmentAndSetBits(mol, vertices, edges, false, false, parts[3], hashes[3], different_vertex_counts[3], bits_set_ab);
 }
 
 void MoleculeFingerprintBuilder::_makeFingerprint(BaseMolecule& mol)
@@ -0,0 +1,246 @@
+/****************************************************************************
+ * Copyright (C) from 2009 to Present EPAM Systems.
+ *
+ * This file is part of Indigo toolkit.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ***************************************************************************/
+
+#include "molecule/molecule_match_features.h"
+#include "base_cpp/output.h"
+#include "base_cpp/scanner.h"
+#include "molecule/base_molecule.h"
+#include "molecule/molecule.h"
+
+using namespace indigo;
+
+IMPL_ERROR(MoleculeMatchFeatures, "molecule match features");
+
+const int MoleculeMatchFeatures::UNKNOWN;
+const dword MoleculeMatchFeatures::ALL_COLUMNS;
+
+MoleculeMatchFeatures::MoleculeMatchFeatures()
+{
+    clear();
+}
+
+void MoleculeMatchFeatures::clear()
+{
+    _vertex_end = 0;
+    _edge_end = 0;
+    _atom_columns = 0;
+    _bond_columns = 0;
+}
+
+void MoleculeMatchFeatures::build(BaseMolecule& mol, dword atom_columns, dword bond_columns)
+{
+    if (!fits(mol))
+        clear();
+
+    _vertex_end = mol.vertexEnd();
+    _edge_end = mol.edgeEnd();
+
+    for (int c = 0; c < ATOM_COLUMNS_COUNT; c++)
+    {
+        if (!(atom_columns & (1U << c)) || hasAtomColumn(c))
+            continue;
+
+        Array<int>& values = _atom_values[c];
+        values.clear_resize(_vertex_end);
+        values.fill(UNKNOWN);
+        if (c == RING_SIZES)
+            _calcRingSizes(mol, values);
+        else
+            for (int i = mol.vertexBegin(); i != mol.vertexEnd(); i = mol.vertexNext(i))
+                values[i] = _calcAtomValue(mol, c, i);
+        _atom_columns |= 1U << c;
+    }
+
+    for (int c = 0; c < BOND_COLUMNS_COUNT; c++)
+    {
+        if (!(bond_columns & (1U << c)) || hasBondColumn(c))
+            continue;
+
+        Array<int>& values = _bond_values[c];
+        values.clear_resize(_edge_end);
+        values.fill(UNKNOWN);
+        for (int i = mol.edgeBegin(); i != mol.edgeEnd(); i = mol.edgeNext(i))
+            values[i] = (c == BOND_ORDER ? mol.getBondOrder(i) : mol.getEdgeTopology(i));
+        _bond_columns |= 1U << c;
+    }
+}
+
+int MoleculeMatchFeatures::_calcAtomValue(BaseMolecule& mol, int column, int idx)
+{
+    // Values are computed exactly as MoleculeSubstructureMatcher::matchQueryAtom
+    // does it, and every case where it gives up is UNKNOWN
+    try
+    {
+        switch (column)
+        {
+        case NUMBER:
+            return mol.getAtomNumber(idx);
+        case CHARGE:
+            return mol.getAtomCharge(idx);
+        case ISOTOPE:
+            return mol.getAtomIsotope(idx);
+        case TOTAL_H:
+            if (mol.isPseudoAtom(idx) || mol.isRSite(idx) || mol.isTemplateAtom(idx))
+                return UNKNOWN;
+            return mol.getAtomTotalH(idx);
+        case DEGREE:
+            return mol.getVertex(idx).degree();
+        case CONNECTIVITY: {
+            int conn = mol.getVertex(idx).degree();
+            if (!mol.isPseudoAtom(idx) && !mol.isRSite(idx))
+                conn += mol.asMolecule().getImplicitH_NoThrow(idx, 0);
+            return conn;
+        }
+        case VALENCE: {
+            if (mol.isPseudoAtom(idx) || mol.isRSite(idx))
+                return UNKNOWN;
+            int valence = mol.getAtomValence_NoThrow(idx, -1);
+            return valence == -1 ? UNKNOWN : valence;
+        }
+        case AROMATICITY:
+            return mol.getAtomAromaticity(idx);
+        case RING_BONDS:
+            return mol.getAtomRingBondsCount(idx);
+        case SSSR_RINGS:
+            return mol.vertexCountSSSR(idx);
+        case SMALLEST_RING_SIZE:
+            return mol.vertexSmallestRingSize(idx);
+        default:
+            throw Error("unknown atom column %d", column);
+        }
+    }
+    catch (Exception&)
+    {
+        return UNKNOWN;
+    }
+}
+
+void MoleculeMatchFeatures::_calcRingSizes(BaseMolecule& mol, Array<int>& values)
+{
+    for (int i = mol.vertexBegin(); i != mol.vertexEnd(); i = mol.vertexNext(i))
+        values[i] = 0;
+
+    for (int r = 0; r < mol.sssrCount(); r++)
+    {
+        List<int>& ring = mol.sssrVertices(r);
+        if (ring.size() >= 32)
+            continue;
+
+        for (int j = ring.begin(); j != ring.end(); j = ring.next(j))
+            values[ring[j]] |= 1 << ring.size();
+    }
+}
+
+bool MoleculeMatchFeatures::hasAtomColumn(int column) const
+{
+    return (_atom_columns & (1U << column)) != 0;
+}
+
+bool MoleculeMatchFeatures::hasBondColumn(int column) const
+{
+    return (_bond_columns & (1U << column)) != 0;
+}
+
+bool MoleculeMatchFeatures::fits(BaseMolecule& mol) const
+{
+    return _vertex_end == mol.vertexEnd() && _edge_end == mol.edgeEnd();
+}
+
+int MoleculeMatchFeatures::atomValue(int column, int idx) const
+{
+    return _atom_values[column][idx];
+}
+
+int MoleculeMatchFeatures::bondValue(int column, int idx) const
+{
+    return _bond_values[column][idx];
+}
+
+const int* MoleculeMatchFeatures::atomColumn(int column) const
+{
+    if (!hasAtomColumn(column))
+        throw Error("atom column %d is not built", column);
+    return _atom_values[column].ptr();
+}
+
+const int* MoleculeMatchFeatures::bondColumn(int column) const
+{
+    if (!hasBondColumn(column))
+        throw Error("bond column %d is not built", column);
+    return _bond_values[column].ptr();
+}
+
+// Signed values are zigzag-encoded, so small negative ones stay short
+static unsigned int _zigzag(int value)
+{
+    return ((unsigned int)value << 1) ^ (unsigned int)(value >> 31);
+}
+
+static int _unzigzag(unsigned int value)
+{
+    return (int)(value >> 1) ^ -(int)(value & 1);
+}
+
+void MoleculeMatchFeatures::save(Output& output) const
+{
+    output.writePackedUInt(_vertex_end);
+    output.writePackedUInt(_edge_end);
+    output.writePackedUInt(_atom_columns);
+    output.writePackedUInt(_bond_columns);
+
+    for (int c = 0; c < ATOM_COLUMNS_COUNT; c++)
+        if (hasAtomColumn(c))
+            for (int i = 0; i < _vertex_end; i++)
+                output.writePackedUInt(_zigzag(_atom_values[c][i]));
+
+    for (int c = 0; c < BOND_COLUMNS_COUNT; c++)
+        if (hasBondColumn(c))
+            for (int i = 0; i < _edge_end; i++)
+                output.writePackedUInt(_zigzag(_bond_values[c][i]));
+}
+
+void MoleculeMatchFeatures::load(Scanner& scanner)
+{
+    clear();
+
+    int vertex_end = scanner.readPackedUInt();
+    int edge_end = scanner.readPackedUInt();
+    dword atom_columns = scanner.readPackedUInt();
+    dword bond_columns = scanner.readPackedUInt();
+
+    for (int c = 0; c < ATOM_COLUMNS_COUNT; c++)
+        if (atom_columns & (1U << c))
+        {
+            _atom_values[c].clear_resize(vertex_end);
+            for (int i = 0; i < vertex_end; i++)
+                _atom_values[c][i] = _unzigzag(scanner.readPackedUInt());
+        }
+
+    for (int c = 0; c < BOND_COLUMNS_COUNT; c++)
+        if (bond_columns & (1U << c))
+        {
+            _bond_values[c].clear_resize(edge_end);
+            for (int i = 0; i < edge_end; i++)
+                _bond_values[c][i] = _unzigzag(scanner.readPackedUInt());
+        }
+
+    _vertex_end = vertex_end;
+    _edge_end = edge_end;
+    _atom_columns = atom_columns & ((1U << ATOM_COLUMNS_COUNT) - 1);
+    _bond_columns = bond_columns & ((1U << BOND_COLUMNS_COUNT) - 1);
+}
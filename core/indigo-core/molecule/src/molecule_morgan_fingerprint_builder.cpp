@@ -19,13 +19,12 @@
 #include "molecule/molecule_morgan_fingerprint_builder.h"
 #include <algorithm>
 #include <cmath>
+#include <cstring>
 #include <molecule/elements.h>
-#include <set>
-#include <vector>
 
 using namespace indigo;
 
-MoleculeMorganFingerprintBuilder::MoleculeMorganFingerprintBuilder(BaseMolecule& mol) : mol(mol)
+MoleculeMorganFingerprintBuilder::MoleculeMorganFingerprintBuilder(BaseMolecule& mol) : mol(mol), _set_words(1)
 {
 }
 
@@ -34,12 +33,7 @@ void MoleculeMorganFingerprintBuilder::calculateDescriptorsECFP(int fp_depth, Ar
     initDescriptors(initialStateCallback_ECFP);
     buildDescriptors(fp_depth);
 
-    res.clear();
-
-    for (auto& feature : features)
-    {
-        res.push(feature.hash);
-    }
+    res.copy(_feature_hashes.data(), (int)_feature_hashes.size());
 }
 
 void MoleculeMorganFingerprintBuilder::calculateDescriptorsFCFP(int fp_depth, Array<dword>& res)
@@ -47,12 +41,7 @@ void MoleculeMorganFingerprintBuilder::calculateDescriptorsFCFP(int fp_depth, Ar
     initDescriptors(initialStateCallback_FCFP);
     buildDescriptors(fp_depth);
 
-    res.clear();
-
-    for (auto& feature : features)
-    {
-        res.push(feature.hash);
-    }
+    res.copy(_feature_hashes.data(), (int)_feature_hashes.size());
 }
 
 void MoleculeMorganFingerprintBuilder::packFingerprintECFP(int fp_depth, Array<byte>& res)
@@ -67,9 +56,9 @@ void MoleculeMorganFingerprintBuilder::packFingerprintECFP(int fp_depth, Array<b
 
     res.zerofill();
 
-    for (auto& feature : features)
+    for (dword hash : _feature_hashes)
     {
-        setBits(feature.hash, res.ptr(), size);
+        setBits(hash, res.ptr(), size);
     }
 }
 
@@ -85,10 +74,45 @@ void MoleculeMorganFingerprintBuilder::packFingerprintFCFP(int fp_depth, Array<b
 
     res.zerofill();
 
-    for (auto& feature : features)
+    for (dword hash : _feature_hashes)
+    {
+        setBits(hash, res.ptr(), size);
+    }
+}
+
+void MoleculeMorganFingerprintBuilder::calculateCountsECFP(int fp_depth, Array<dword>& hashes, Array<int>& counts)
+{
+    initDescriptors(initialStateCallback_ECFP);
+    buildDescriptors(fp_depth);
+    calculateCounts(hashes, counts);
+}
+
+void MoleculeMorganFingerprintBuilder::calculateCountsFCFP(int fp_depth, Array<dword>& hashes, Array<int>& counts)
+{
+    initDescriptors(initialStateCallback_FCFP);
+    buildDescriptors(fp_depth);
+    calculateCounts(hashes, counts);
+}
+
+void MoleculeMorganFingerprintBuilder::calculateCounts(Array<dword>& hashes, Array<int>& counts)
+{
+    hashes.copy(_feature_hashes.data(), (int)_feature_hashes.size());
+    std::sort(hashes.ptr(), hashes.ptr() + hashes.size());
+
+    counts.clear();
+
+    int n = 0;
+    for (int i = 0; i < hashes.size(); i++)
     {
-        setBits(feature.hash, res.ptr(), size);
+        if (n > 0 && hashes[n - 1] == hashes[i])
+        {
+            counts.top()++;
+            continue;
+        }
+        hashes[n++] = hashes[i];
+        counts.push(1);
     }
+    hashes.resize(n);
 }
 
 void MoleculeMorganFingerprintBuilder::setBits(dword hash, byte* fp, int size)
@@ -109,91 +133,195 @@ void MoleculeMorganFingerprintBuilder::setBits(dword hash, byte* fp, int size)
 
 void MoleculeMorganFingerprintBuilder::initDescriptors(InitialStateCallback initialStateCallback)
 {
-    features.clear();
-    atom_descriptors.clear();
+    std::vector<int> dense(mol.vertexEnd(), -1);
+    int atoms_count = 0;
+
+    for (int idx : mol.vertices())
+        dense[idx] = atoms_count++;
+
+    _set_words = std::max(1, (mol.edgeEnd() + 63) / 64);
+
+    _nei_begin.clear();
+    _nei_atom.clear();
+    _nei_bond_type.clear();
+    _nei_edge.clear();
+    _atom_hashes.clear();
 
     for (int idx : mol.vertices())
     {
-        AtomDescriptor atom_descriptor;
-        atom_descriptor.descr.hash = initialStateCallback(mol, idx);
+        _nei_begin.push_back((int)_nei_atom.size());
+        _atom_hashes.push_back(initialStateCallback(mol, idx));
 
         const Vertex& vertex = mol.getVertex(idx);
 
         for (int nei_idx : vertex.neighbors())
         {
             int edge_idx = vertex.neiEdge(nei_idx);
-            int vertex_idx = vertex.neiVertex(nei_idx);
-
-            int bond_type = mol.getBondOrder(edge_idx);
 
-            atom_descriptor.bond_descriptors.push_back(BondDescriptor{bond_type, vertex_idx, edge_idx});
+            _nei_atom.push_back(dense[vertex.neiVertex(nei_idx)]);
+            _nei_bond_type.push_back(mol.getBondOrder(edge_idx));
+            _nei_edge.push_back(edge_idx);
         }
-
-        atom_descriptors.push_back(atom_descriptor);
     }
+    _nei_begin.push_back((int)_nei_atom.size());
+
+    _new_atom_hashes.resize(atoms_count);
+    _atom_sets.assign((size_t)atoms_count * _set_words, 0);
+    _new_atom_sets.resize(_atom_sets.size());
+    _atom_set_hashes.resize(atoms_count);
 }
 
 void MoleculeMorganFingerprintBuilder::buildDescriptors(int fp_depth)
 {
+    int atoms_count = (int)_atom_hashes.size();
+
+    // Open addressing tables with the load factor below one half
+    int table_size = 1;
+    while (table_size < 2 * atoms_count)
+        table_size *= 2;
+    _candidate_table.resize(table_size);
+
+    int features_table_size = 1;
+    while (features_table_size < 2 * atoms_count * std::max(fp_depth, 1))
+        features_table_size *= 2;
+    _feature_table.assign(features_table_size, -1);
+
+    _feature_hashes.clear();
+    _feature_sets.clear();
+    _feature_set_hashes.clear();
+
     for (int i = 0; i < fp_depth; i++)
     {
         calculateNewAtomDescriptors(i);
 
         // Update all atom descriptors simultaneously
-        std::vector<FeatureDescriptor> new_features;
-        for (auto& atom : atom_descriptors)
+        _atom_hashes.swap(_new_atom_hashes);
+        _atom_sets.swap(_new_atom_sets);
+
+        // Atoms with the same bond set describe the same feature, the lesser hash is preferred
+        std::fill(_candidate_table.begin(), _candidate_table.end(), -1);
+
+        for (int atom = 0; atom < atoms_count; atom++)
         {
-            atom.descr = atom.new_descr;
+            const qword* set = _atom_sets.data() + (size_t)atom * _set_words;
+            _atom_set_hashes[atom] = bondSetHash(set);
 
-            const auto& duplicate = std::find(new_features.begin(), new_features.end(), atom.descr);
-            if (duplicate == new_features.end())
-            {
-                new_features.push_back(atom.descr);
-            }
-            else if (atom.descr.hash < duplicate->hash)
-            { // the leaser hash is preferred
-                new_features.erase(duplicate);
-                new_features.push_back(atom.descr);
-            }
+            int slot = findSlot(_candidate_table, _atom_sets, _atom_set_hashes, set, _atom_set_hashes[atom]);
+            int& other = _candidate_table[slot];
+
+            if (other == -1 || _atom_hashes[atom] < _atom_hashes[other])
+                other = atom;
+        }
+
+        _candidates.clear();
+        for (int atom : _candidate_table)
+        {
+            if (atom != -1)
+                _candidates.push_back(atom);
         }
 
         // Features are sorted by their iteration number, then by their hash
-        std::sort(new_features.begin(), new_features.end(), [](const FeatureDescriptor& fd1, const FeatureDescriptor& fd2) { return fd1.hash < fd2.hash; });
+        std::sort(_candidates.begin(), _candidates.end(), [this](int a1, int a2) { return _atom_hashes[a1] < _atom_hashes[a2]; });
 
         // Update features
-        for (auto& feature : new_features)
+        for (int atom : _candidates)
         {
-            if (std::find(features.begin(), features.end(), feature) == features.end())
-            {
-                features.push_back(feature); // add unique
-            }
+            const qword* set = _atom_sets.data() + (size_t)atom * _set_words;
+            int slot = findSlot(_feature_table, _feature_sets, _feature_set_hashes, set, _atom_set_hashes[atom]);
+
+            if (_feature_table[slot] != -1)
+                continue;
+
+            _feature_table[slot] = (int)_feature_hashes.size();
+            _feature_hashes.push_back(_atom_hashes[atom]);
+            _feature_sets.insert(_feature_sets.end(), set, set + _set_words);
+            _feature_set_hashes.push_back(_atom_set_hashes[atom]);
         }
     }
 }
 
 void MoleculeMorganFingerprintBuilder::calculateNewAtomDescriptors(int iterationNumber)
 {
-    for (auto& atom : atom_descriptors)
+    int atoms_count = (int)_atom_hashes.size();
+
+    for (int atom = 0; atom < atoms_count; atom++)
     {
-        std::sort(atom.bond_descriptors.begin(), atom.bond_descriptors.end(),
-                  [&](const BondDescriptor& bd1, const BondDescriptor& bd2) { return bondDescriptorCmp(bd1, bd2) < 0; });
+        int begin = _nei_begin[atom];
+        int end = _nei_begin[atom + 1];
+        qword* new_set = _new_atom_sets.data() + (size_t)atom * _set_words;
+
+        // Neighbours are ordered by the bond type, then by their hash; both are packed
+        // into one key, and atom degrees are small enough for the insertion sort
+        _sort_keys.resize(end - begin);
+        for (int k = begin; k < end; k++)
+        {
+            qword key = ((qword)((dword)_nei_bond_type[k] ^ 0x80000000U) << 32) | _atom_hashes[_nei_atom[k]];
+            int j = k - begin;
 
-        atom.new_descr.hash = (dword)iterationNumber * MAGIC_HASH_NUMBER + atom.descr.hash;
-        atom.new_descr.bond_set.clear();
+            while (j > 0 && _sort_keys[j - 1] > key)
+            {
+                _sort_keys[j] = _sort_keys[j - 1];
+                j--;
+            }
+            _sort_keys[j] = key;
+        }
+
+        dword hash = (dword)iterationNumber * MAGIC_HASH_NUMBER + _atom_hashes[atom];
 
-        for (auto& bond : atom.bond_descriptors)
+        for (qword key : _sort_keys)
         {
-            FeatureDescriptor& descr = atom_descriptors[bond.vertex_idx].descr;
+            hash = MAGIC_HASH_NUMBER * hash + ((dword)(key >> 32) ^ 0x80000000U);
+            hash = MAGIC_HASH_NUMBER * hash + (dword)key;
+        }
+
+        _new_atom_hashes[atom] = hash;
 
-            atom.new_descr.hash = MAGIC_HASH_NUMBER * atom.new_descr.hash + bond.bond_type;
-            atom.new_descr.hash = MAGIC_HASH_NUMBER * atom.new_descr.hash + descr.hash;
+        std::fill(new_set, new_set + _set_words, 0);
+        for (int k = begin; k < end; k++)
+        {
+            const qword* nei_set = _atom_sets.data() + (size_t)_nei_atom[k] * _set_words;
 
-            atom.new_descr.bond_set.insert(bond.edge_idx);
-            atom.new_descr.bond_set.insert(descr.bond_set.begin(), descr.bond_set.end());
+            for (int w = 0; w < _set_words; w++)
+                new_set[w] |= nei_set[w];
+
+            new_set[_nei_edge[k] / 64] |= (qword)1 << (_nei_edge[k] % 64);
         }
     }
 }
 
+qword MoleculeMorganFingerprintBuilder::bondSetHash(const qword* set) const
+{
+    qword hash = 0xcbf29ce484222325ULL;
+
+    for (int w = 0; w < _set_words; w++)
+    {
+        hash ^= set[w];
+        hash *= 0x100000001b3ULL;
+        hash ^= hash >> 29;
+    }
+
+    return hash;
+}
+
+int MoleculeMorganFingerprintBuilder::findSlot(const std::vector<int>& table, const std::vector<qword>& sets, const std::vector<qword>& set_hashes,
+                                               const qword* set, qword set_hash) const
+{
+    int mask = (int)table.size() - 1;
+    int slot = (int)(set_hash & mask);
+
+    while (table[slot] != -1)
+    {
+        int idx = table[slot];
+
+        if (set_hashes[idx] == set_hash && memcmp(sets.data() + (size_t)idx * _set_words, set, _set_words * sizeof(qword)) == 0)
+            break;
+
+        slot = (slot + 1) & mask;
+    }
+
+    return slot;
+}
+
 dword MoleculeMorganFingerprintBuilder::initialStateCallback_ECFP(BaseMolecule& mol, int idx)
 {
     int nonhydrogen_neighbors = 0;
@@ -219,35 +347,74 @@ dword MoleculeMorganFingerprintBuilder::initialStateCallback_ECFP(BaseMolecule&
     return key;
 }
 
-dword MoleculeMorganFingerprintBuilder::initialStateCallback_FCFP(BaseMolecule& mol, int idx)
+// Checks whether the atom has a double bond to an atom of the given element,
+// not counting the atom [exclude]
+static bool _hasDoubleBondTo(BaseMolecule& mol, int idx, int element, int exclude)
 {
-    throw Exception("FCFP is not implemented"); // TODO: implement ionizability
+    const Vertex& vertex = mol.getVertex(idx);
 
-    dword key = 0;
+    for (int i : vertex.neighbors())
+    {
+        int nei_idx = vertex.neiVertex(i);
 
-    key |= (mol.getAtomAromaticity(0) == ATOM_AROMATIC) << 4;
-    key |= Element::isHalogen(mol.getAtomNumber(idx)) << 5;
+        if (nei_idx != exclude && mol.getBondOrder(vertex.neiEdge(i)) == BOND_DOUBLE && mol.getAtomNumber(nei_idx) == element)
+            return true;
+    }
 
-    return key;
+    return false;
 }
 
-int MoleculeMorganFingerprintBuilder::bondDescriptorCmp(const BondDescriptor& bd1, const BondDescriptor& bd2)
+dword MoleculeMorganFingerprintBuilder::initialStateCallback_FCFP(BaseMolecule& mol, int idx)
 {
-    if (bd1.bond_type != bd2.bond_type)
-        return bd1.bond_type < bd2.bond_type ? -1 : 1;
+    const Vertex& vertex = mol.getVertex(idx);
 
-    AtomDescriptor& ad1 = atom_descriptors[bd1.vertex_idx];
-    AtomDescriptor& ad2 = atom_descriptors[bd2.vertex_idx];
+    int number = mol.getAtomNumber(idx);
+    int charge = mol.getAtomCharge(idx);
+    int total_h = mol.getAtomTotalH(idx);
+    bool aromatic = mol.getAtomAromaticity(idx) == ATOM_AROMATIC;
 
-    return ad1.descr.hash < ad2.descr.hash ? -1 : 1;
-}
+    int nonhydrogen_neighbors = 0;
+    bool amide = false;       // N-C(=O)
+    bool acid = false;        // O-[C,S,P]=O
+    bool basic_amine = true;  // N with single bonds to aliphatic atoms, none of them C=[O,S,N]
 
-bool MoleculeMorganFingerprintBuilder::FeatureDescriptor::operator==(const FeatureDescriptor& rhs) const
-{
-    return bond_set == rhs.bond_set;
-}
+    for (int i : vertex.neighbors())
+    {
+        int nei_idx = vertex.neiVertex(i);
+        int nei_number = mol.getAtomNumber(nei_idx);
 
-bool MoleculeMorganFingerprintBuilder::FeatureDescriptor::operator<(const MoleculeMorganFingerprintBuilder::FeatureDescriptor& rhs) const
-{
-    return bond_set < rhs.bond_set;
+        if (nei_number == ELEM_H)
+            continue;
+        nonhydrogen_neighbors++;
+
+        bool carbonyl = nei_number == ELEM_C && (_hasDoubleBondTo(mol, nei_idx, ELEM_O, idx) || _hasDoubleBondTo(mol, nei_idx, ELEM_S, idx) ||
+                                                 _hasDoubleBondTo(mol, nei_idx, ELEM_N, idx));
+
+        if (nei_number == ELEM_C && _hasDoubleBondTo(mol, nei_idx, ELEM_O, idx))
+            amide = true;
+
+        if ((nei_number == ELEM_C || nei_number == ELEM_S || nei_number == ELEM_P) && mol.getBondOrder(vertex.neiEdge(i)) == BOND_SINGLE &&
+            _hasDoubleBondTo(mol, nei_idx, ELEM_O, idx))
+            acid = true;
+
+        if (mol.getBondOrder(vertex.neiEdge(i)) != BOND_SINGLE || mol.getAtomAromaticity(nei_idx) == ATOM_AROMATIC || carbonyl)
+            basic_amine = false;
+    }
+
+    bool acceptor = (number == ELEM_O && charge <= 0) ||
+                    (number == ELEM_N && charge <= 0 && !(aromatic && total_h > 0) && nonhydrogen_neighbors + total_h < 4 && !amide);
+    bool donor = (number == ELEM_N || number == ELEM_O) && total_h > 0;
+    bool negative = charge < 0 || (number == ELEM_O && total_h > 0 && acid);
+    bool positive = charge > 0 || (number == ELEM_N && charge == 0 && !aromatic && basic_amine);
+
+    dword key = 0;
+
+    key |= (dword)acceptor << 0;
+    key |= (dword)donor << 1;
+    key |= (dword)negative << 2;
+    key |= (dword)positive << 3;
+    key |= (dword)aromatic << 4;
+    key |= (dword)Element::isHalogen(number) << 5;
+
+    return key;
 }
@@ -0,0 +1,426 @@
+/****************************************************************************
+ * Copyright (C) from 2009 to Present EPAM Systems.
+ *
+ * This file is part of Indigo toolkit.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ***************************************************************************/
+
+#include "molecule/molecule_query_program.h"
+#include "molecule/base_molecule.h"
+#include "molecule/elements.h"
+#include "molecule/molecule.h"
+#include "molecule/molecule_arom_match.h"
+#include "molecule/molecule_substructure_matcher.h"
+
+using namespace indigo;
+
+IMPL_ERROR(MoleculeQueryProgram, "molecule query program");
+
+MoleculeQueryProgram::MoleculeQueryProgram()
+{
+    _external_features = nullptr;
+    clear();
+}
+
+void MoleculeQueryProgram::clear()
+{
+    _atom_code.clear();
+    _bond_code.clear();
+    _atom_start.clear();
+    _bond_start.clear();
+    _element_masks.clear();
+
+    _atom_columns = 0;
+    _bond_columns = 0;
+    _features = nullptr;
+
+    _compiled = false;
+    _target_ready = false;
+}
+
+bool MoleculeQueryProgram::isCompiled() const
+{
+    return _compiled;
+}
+
+bool MoleculeQueryProgram::fits(QueryMolecule& query) const
+{
+    return _atom_start.size() == query.vertexEnd() && _bond_start.size() == query.edgeEnd();
+}
+
+void MoleculeQueryProgram::resetTarget()
+{
+    _target_ready = false;
+}
+
+void MoleculeQueryProgram::setTargetFeatures(const MoleculeMatchFeatures* features)
+{
+    _external_features = features;
+    _target_ready = false;
+}
+
+void MoleculeQueryProgram::compile(QueryMolecule& query)
+{
+    clear();
+
+    _atom_start.clear_resize(query.vertexEnd());
+    _atom_start.fill(-1);
+    for (int i = query.vertexBegin(); i != query.vertexEnd(); i = query.vertexNext(i))
+    {
+        _atom_start[i] = _atom_code.size();
+        _emitAtom(&query.getAtom(i));
+    }
+
+    _bond_start.clear_resize(query.edgeEnd());
+    _bond_start.fill(-1);
+    for (int i = query.edgeBegin(); i != query.edgeEnd(); i = query.edgeNext(i))
+    {
+        _bond_start[i] = _bond_code.size();
+        _emitBond(&query.getBond(i));
+    }
+
+    _compiled = true;
+}
+
+int MoleculeQueryProgram::_addInstruction(Array<_Instruction>& code, int op, QueryMolecule::Node* node)
+{
+    _Instruction& instr = code.push();
+    instr.op = op;
+    instr.feature = -1;
+    instr.end = code.size();
+    instr.value_min = 0;
+    instr.value_max = 0;
+    instr.node = node;
+    return code.size() - 1;
+}
+
+void MoleculeQueryProgram::_collectOperands(QueryMolecule::Node* node, int op, Array<QueryMolecule::Node*>& operands)
+{
+    // Nested operations of the same kind are merged into one operand list
+    for (int i = 0; i < node->children.size(); i++)
+    {
+        QueryMolecule::Node* child = node->children[i];
+        if (child->type == op)
+            _collectOperands(child, op, operands);
+        else if (child->type == QueryMolecule::OP_NONE && op == QueryMolecule::OP_AND)
+            continue;
+        else
+            operands.push(child);
+    }
+}
+
+int MoleculeQueryProgram::_atomFeature(int type)
+{
+    switch (type)
+    {
+    case QueryMolecule::ATOM_NUMBER:
+        return MoleculeMatchFeatures::NUMBER;
+    case QueryMolecule::ATOM_ISOTOPE:
+        return MoleculeMatchFeatures::ISOTOPE;
+    case QueryMolecule::ATOM_CHARGE:
+        return MoleculeMatchFeatures::CHARGE;
+    case QueryMolecule::ATOM_VALENCE:
+        return MoleculeMatchFeatures::VALENCE;
+    case QueryMolecule::ATOM_AROMATICITY:
+        return MoleculeMatchFeatures::AROMATICITY;
+    case QueryMolecule::ATOM_RING_BONDS:
+    case QueryMolecule::ATOM_RING_BONDS_AS_DRAWN:
+        return MoleculeMatchFeatures::RING_BONDS;
+    case QueryMolecule::ATOM_SSSR_RINGS:
+        return MoleculeMatchFeatures::SSSR_RINGS;
+    case QueryMolecule::ATOM_SMALLEST_RING_SIZE:
+        return MoleculeMatchFeatures::SMALLEST_RING_SIZE;
+    case QueryMolecule::ATOM_CONNECTIVITY:
+        return MoleculeMatchFeatures::CONNECTIVITY;
+    case QueryMolecule::ATOM_TOTAL_H:
+        return MoleculeMatchFeatures::TOTAL_H;
+    default:
+        return -1;
+    }
+}
+
+bool MoleculeQueryProgram::_isElement(QueryMolecule::Node* node)
+{
+    if (node->type != QueryMolecule::ATOM_NUMBER)
+        return false;
+
+    QueryMolecule::Atom* atom = (QueryMolecule::Atom*)node;
+    return atom->value_min == atom->value_max && atom->value_min >= 0 && atom->value_min < 128;
+}
+
+void MoleculeQueryProgram::_emitAtom(QueryMolecule::Atom* atom)
+{
+    switch (atom->type)
+    {
+    case QueryMolecule::OP_NONE:
+        _addInstruction(_atom_code, _OP_TRUE, atom);
+        return;
+    case QueryMolecule::OP_NOT: {
+        int pos = _addInstruction(_atom_code, _OP_NOT, atom);
+        _emitAtom(atom->child(0));
+        _atom_code[pos].end = _atom_code.size();
+        return;
+    }
+    case QueryMolecule::OP_AND:
+    case QueryMolecule::OP_OR: {
+        // Not a QS_DEF array as the function is recursive
+        Array<QueryMolecule::Node*> operands;
+        _collectOperands(atom, atom->type, operands);
+
+        // Lists of elements like [C,N,O] become a single bitmask test
+        int elements_count = 0;
+        if (atom->type == QueryMolecule::OP_OR)
+            for (int i = 0; i < operands.size(); i++)
+                if (_isElement(operands[i]))
+                    elements_count++;
+
+        if (elements_count < 2)
+            elements_count = 0;
+
+        // Operations with a single operand are replaced by the operand, empty
+        // ones are kept as their loops return the right value
+        int lowered_count = operands.size() - elements_count + (elements_count > 0 ? 1 : 0);
+        int pos = -1;
+        if (lowered_count != 1)
+            pos = _addInstruction(_atom_code, atom->type == QueryMolecule::OP_AND ? _OP_AND : _OP_OR, atom);
+
+        if (elements_count > 0)
+        {
+            int mask_pos = _addInstruction(_atom_code, _OP_ELEMENTS, atom);
+            _ElementMask& mask = _element_masks.push();
+            mask.bits[0] = mask.bits[1] = 0;
+            for (int i = 0; i < operands.size(); i++)
+                if (_isElement(operands[i]))
+                {
+                    int number = ((QueryMolecule::Atom*)operands[i])->value_min;
+                    mask.bits[number / 64] |= ((qword)1) << (number % 64);
+                }
+            _atom_code[mask_pos].value_min = _element_masks.size() - 1;
+            _atom_columns |= 1U << MoleculeMatchFeatures::NUMBER;
+        }
+
+        // Operands matched through precomputed features go first, so the expensive
+        // delegated checks are reached only when the cheap ones pass. The result
+        // does not depend on the order.
+        for (int pass = 0; pass < 2; pass++)
+            for (int i = 0; i < operands.size(); i++)
+            {
+                if (elements_count > 0 && _isElement(operands[i]))
+                    continue;
+                bool cheap = _atomFeature(operands[i]->type) >= 0;
+                if (cheap == (pass == 0))
+                    _emitAtom((QueryMolecule::Atom*)operands[i]);
+            }
+
+        if (pos >= 0)
+            _atom_code[pos].end = _atom_code.size();
+        return;
+    }
+    default:
+        break;
+    }
+
+    int feature = _atomFeature(atom->type);
+    if (feature < 0)
+    {
+        _addInstruction(_atom_code, _OP_FALLBACK, atom);
+        return;
+    }
+
+    int op = _OP_RANGE;
+    if (feature == MoleculeMatchFeatures::CHARGE)
+        op = _OP_CHARGE;
+    else if (feature == MoleculeMatchFeatures::VALENCE)
+        op = _OP_VALENCE;
+
+    int pos = _addInstruction(_atom_code, op, atom);
+    _atom_code[pos].feature = feature;
+    _atom_code[pos].value_min = atom->value_min;
+    _atom_code[pos].value_max = atom->value_max;
+    _atom_columns |= 1U << feature;
+}
+
+void MoleculeQueryProgram::_emitBond(QueryMolecule::Bond* bond)
+{
+    switch (bond->type)
+    {
+    case QueryMolecule::OP_NONE:
+        _addInstruction(_bond_code, _OP_TRUE, bond);
+        return;
+    case QueryMolecule::OP_NOT:
+    case QueryMolecule::OP_AND:
+    case QueryMolecule::OP_OR: {
+        int op = bond->type == QueryMolecule::OP_NOT ? _OP_NOT : (bond->type == QueryMolecule::OP_AND ? _OP_AND : _OP_OR);
+        int pos = _addInstruction(_bond_code, op, bond);
+        for (int i = 0; i < bond->children.size(); i++)
+            _emitBond(bond->child(i));
+        _bond_code[pos].end = _bond_code.size();
+        return;
+    }
+    case QueryMolecule::BOND_ORDER: {
+        int pos = _addInstruction(_bond_code, _OP_BOND_ORDER, bond);
+        _bond_code[pos].feature = MoleculeMatchFeatures::BOND_ORDER;
+        _bond_code[pos].value_min = _bond_code[pos].value_max = bond->value;
+        _bond_columns |= 1U << MoleculeMatchFeatures::BOND_ORDER;
+        return;
+    }
+    case QueryMolecule::BOND_TOPOLOGY: {
+        int pos = _addInstruction(_bond_code, _OP_RANGE, bond);
+        _bond_code[pos].feature = MoleculeMatchFeatures::BOND_TOPOLOGY;
+        _bond_code[pos].value_min = _bond_code[pos].value_max = bond->value;
+        _bond_columns |= 1U << MoleculeMatchFeatures::BOND_TOPOLOGY;
+        return;
+    }
+    default:
+        _addInstruction(_bond_code, _OP_FALLBACK, bond);
+        return;
+    }
+}
+
+void MoleculeQueryProgram::_prepareTarget(BaseMolecule& target)
+{
+    _features = _external_features;
+
+    if (_features != nullptr && _features->fits(target))
+    {
+        for (int c = 0; c < MoleculeMatchFeatures::ATOM_COLUMNS_COUNT; c++)
+            if ((_atom_columns & (1U << c)) && !_features->hasAtomColumn(c))
+                _features = nullptr;
+        for (int c = 0; c < MoleculeMatchFeatures::BOND_COLUMNS_COUNT; c++)
+            if ((_bond_columns & (1U << c)) && !_features->hasBondColumn(c))
+                _features = nullptr;
+    }
+    else
+        _features = nullptr;
+
+    if (_features == nullptr)
+    {
+        // Hydrogens unfolded in the target are not covered by the stored
+        // features, so the whole table is rebuilt in this case
+        _own_features.clear();
+        _own_features.build(target, _atom_columns, _bond_columns);
+        _features = &_own_features;
+    }
+
+    _target_ready = true;
+}
+
+bool MoleculeQueryProgram::matchAtom(int sub_idx, BaseMolecule& target, int super_idx, FragmentMatchCache* fmcache, dword flags)
+{
+    if (!_target_ready)
+        _prepareTarget(target);
+
+    return _evalAtom(_atom_start[sub_idx], target, super_idx, fmcache, flags);
+}
+
+bool MoleculeQueryProgram::matchBond(int sub_idx, BaseMolecule& target, int super_idx, AromaticityMatcher* am, dword flags)
+{
+    if (!_target_ready)
+        _prepareTarget(target);
+
+    return _evalBond(_bond_start[sub_idx], target, sub_idx, super_idx, am, flags);
+}
+
+bool MoleculeQueryProgram::_evalAtom(int pos, BaseMolecule& target, int super_idx, FragmentMatchCache* fmcache, dword flags)
+{
+    const _Instruction& instr = _atom_code[pos];
+
+    switch (instr.op)
+    {
+    case _OP_TRUE:
+        return true;
+    case _OP_AND:
+        for (int i = pos + 1; i < instr.end; i = _atom_code[i].end)
+            if (!_evalAtom(i, target, super_idx, fmcache, flags))
+                return false;
+        return true;
+    case _OP_OR:
+        for (int i = pos + 1; i < instr.end; i = _atom_code[i].end)
+            if (_evalAtom(i, target, super_idx, fmcache, flags))
+                return true;
+        return false;
+    case _OP_NOT:
+        return !_evalAtom(pos + 1, target, super_idx, fmcache, flags ^ MoleculeSubstructureMatcher::MATCH_DISABLED_AS_TRUE);
+    case _OP_CHARGE:
+    case _OP_VALENCE:
+    case _OP_RANGE: {
+        if (instr.op == _OP_CHARGE && !(flags & MoleculeSubstructureMatcher::MATCH_ATOM_CHARGE))
+            return (flags & MoleculeSubstructureMatcher::MATCH_DISABLED_AS_TRUE) != 0;
+        if (instr.op == _OP_VALENCE && !(flags & MoleculeSubstructureMatcher::MATCH_ATOM_VALENCE))
+            return (flags & MoleculeSubstructureMatcher::MATCH_DISABLED_AS_TRUE) != 0;
+
+        // Unknown values are matched by the original node, which either
+        // rejects the atom or reports the error
+        int value = _features->atomValue(instr.feature, super_idx);
+        if (value == MoleculeMatchFeatures::UNKNOWN)
+            return MoleculeSubstructureMatcher::matchQueryAtom((QueryMolecule::Atom*)instr.node, target, super_idx, fmcache, flags);
+        return value >= instr.value_min && value <= instr.value_max;
+    }
+    case _OP_ELEMENTS: {
+        int number = _features->atomValue(MoleculeMatchFeatures::NUMBER, super_idx);
+        if (number < 0 || number >= 128)
+            return false;
+        return (_element_masks[instr.value_min].bits[number / 64] >> (number % 64)) & 1;
+    }
+    case _OP_FALLBACK:
+        return MoleculeSubstructureMatcher::matchQueryAtom((QueryMolecule::Atom*)instr.node, target, super_idx, fmcache, flags);
+    default:
+        throw Error("bad atom instruction: %d", instr.op);
+    }
+}
+
+bool MoleculeQueryProgram::_evalBond(int pos, BaseMolecule& target, int sub_idx, int super_idx, AromaticityMatcher* am, dword flags)
+{
+    const _Instruction& instr = _bond_code[pos];
+
+    switch (instr.op)
+    {
+    case _OP_TRUE:
+        return true;
+    case _OP_AND:
+        for (int i = pos + 1; i < instr.end; i = _bond_code[i].end)
+            if (!_evalBond(i, target, sub_idx, super_idx, am, flags))
+                return false;
+        return true;
+    case _OP_OR:
+        for (int i = pos + 1; i < instr.end; i = _bond_code[i].end)
+            if (_evalBond(i, target, sub_idx, super_idx, am, flags))
+                return true;
+        return false;
+    case _OP_NOT:
+        return !_evalBond(pos + 1, target, sub_idx, super_idx, am, flags ^ MoleculeSubstructureMatcher::MATCH_DISABLED_AS_TRUE);
+    case _OP_BOND_ORDER: {
+        if (!(flags & MoleculeSubstructureMatcher::MATCH_BOND_TYPE))
+            return (flags & MoleculeSubstructureMatcher::MATCH_DISABLED_AS_TRUE) != 0;
+
+        int order = _features->bondValue(MoleculeMatchFeatures::BOND_ORDER, super_idx);
+        if (am != 0)
+        {
+            if (order == BOND_AROMATIC)
+                return am->canFixQueryBond(sub_idx, true);
+            else if (!am->canFixQueryBond(sub_idx, false))
+                return false;
+        }
+        return order == instr.value_min;
+    }
+    case _OP_RANGE: {
+        int value = _features->bondValue(instr.feature, super_idx);
+        return value >= instr.value_min && value <= instr.value_max;
+    }
+    case _OP_FALLBACK:
+        return MoleculeSubstructureMatcher::matchQueryBond((QueryMolecule::Bond*)instr.node, target, sub_idx, super_idx, am, flags);
+    default:
+        throw Error("bad bond instruction: %d", instr.op);
+    }
+}
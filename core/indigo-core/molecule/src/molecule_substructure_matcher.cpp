@@ -69,6 +69,8 @@ MoleculeSubstructureMatcher::MoleculeSubstructureMatcher(BaseMolecule& target)
     _query = 0;
     match_3d = 0;
     rms_threshold = 0;
+    parallel_threads = 0;
+    use_candidate_domains = false;
 
     highlight = false;
     find_all_embeddings = false;
@@ -88,6 +90,9 @@ MoleculeSubstructureMatcher::MoleculeSubstructureMatcher(BaseMolecule& target)
     restore_unfolded_h = true;
     _h_unfold = false;
 
+    _parallel_owner = 0;
+    _parallel_prepared = false;
+
     _query_nei_counters = 0;
     _target_nei_counters = 0;
 
@@ -261,6 +266,8 @@ void MoleculeSubstructureMatcher::setQuery(QueryMolecule& query)
     _ee->cb_vertex_remove = _removeAtom;
     _ee->cb_edge_add = _addBond;
     _ee->cb_embedding = _embedding;
+    _ee->cb_create_worker = _createWorker;
+    _ee->cb_release_worker = _releaseWorker;
     _ee->userdata = this;
 
     _ee->setSubgraph(*_query);
@@ -270,6 +277,13 @@ void MoleculeSubstructureMatcher::setQuery(QueryMolecule& query)
             _ee->ignoreSubgraphVertex(i);
     }
 
+    // Markush queries are modified during the matching, and query targets
+    // have no definite feature values, so they are matched by expression trees
+    if (_markush.get() == nullptr && !_target.isQueryMolecule())
+        _program.compile(*_query);
+    else
+        _program.clear();
+
     _embeddings_storage.free();
 }
 
@@ -288,6 +302,11 @@ void MoleculeSubstructureMatcher::setNeiCounters(const MoleculeAtomNeighbourhood
     _target_nei_counters = target_counters;
 }
 
+void MoleculeSubstructureMatcher::setTargetFeatures(const MoleculeMatchFeatures* features)
+{
+    _program.setTargetFeatures(features);
+}
+
 bool MoleculeSubstructureMatcher::find()
 {
     if (_query == 0)
@@ -312,6 +331,10 @@ bool MoleculeSubstructureMatcher::find()
 
     _used_target_h.zerofill();
 
+    if (_program.isCompiled() && !_program.fits(*_query))
+        _program.compile(*_query);
+    _program.resetTarget();
+
     if (use_aromaticity_matcher && AromaticityMatcher::isNecessary(*_query))
         _am.create(*_query, _target, arom_options);
     else
@@ -325,6 +348,13 @@ bool MoleculeSubstructureMatcher::find()
     _3d_constraints_checker.recreate(_query->spatial_constraints);
     _createEmbeddingsStorage();
 
+    // The workers are prepared when the enumerator creates them, that is,
+    // only when the search is long enough to be split
+    _parallel_prepared = false;
+    _ee->parallel_threads = _canUseParallelSearch() ? parallel_threads : 0;
+
+    _ee->use_candidate_domains = use_candidate_domains && _canUseCandidateDomains();
+
     int result = _ee->process();
 
     if (_h_unfold && restore_unfolded_h)
@@ -340,6 +370,82 @@ bool MoleculeSubstructureMatcher::find()
     }
 }
 
+bool MoleculeSubstructureMatcher::_canUseCandidateDomains()
+{
+    // _matchAtoms() must not depend on the atoms mapped so far
+    if (_markush.get() != nullptr || match_3d == AFFINE)
+        return false;
+
+    for (int i = 0; i < _query->components.size(); i++)
+        if (_query->components[i] > 0)
+            return false;
+
+    return true;
+}
+
+bool MoleculeSubstructureMatcher::_canUseParallelSearch()
+{
+    // Markush queries and query targets are not compiled
+    if (parallel_threads <= 1 || !_program.isCompiled())
+        return false;
+
+    if (match_3d != 0 || _query->spatial_constraints.haveConstraints() || _pi_systems_matcher.get() != 0 || highlight)
+        return false;
+
+    // Recursive SMARTS are matched by nested matchers, which may unfold hydrogens in the target
+    for (int i = _query->vertexBegin(); i != _query->vertexEnd(); i = _query->vertexNext(i))
+        if (_query->getAtom(i).hasConstraint(QueryMolecule::ATOM_FRAGMENT))
+            return false;
+
+    return true;
+}
+
+void MoleculeSubstructureMatcher::_prepareParallelSearch()
+{
+    // The workers read the target concurrently, so the values BaseMolecule
+    // computes lazily are computed here, and the workers share the features
+    _parallel_features.build(_target);
+
+    if (_query->components.size() > 0 && _target.vertexCount() > 0)
+        _target.vertexComponent(_target.vertexBegin());
+}
+
+void* MoleculeSubstructureMatcher::_createWorker(void* userdata)
+{
+    MoleculeSubstructureMatcher* self = (MoleculeSubstructureMatcher*)userdata;
+
+    // The workers are created one by one before any of them starts
+    if (!self->_parallel_prepared)
+    {
+        self->_prepareParallelSearch();
+        self->_parallel_prepared = true;
+    }
+
+    auto worker = std::make_unique<MoleculeSubstructureMatcher>(self->_target);
+
+    worker->_parallel_owner = self;
+    worker->_query = self->_query;
+    worker->_query_nei_counters = self->_query_nei_counters;
+    worker->_target_nei_counters = self->_target_nei_counters;
+    worker->_h_unfold = self->_h_unfold;
+    worker->_unfolded_target_h.copy(self->_unfolded_target_h);
+    worker->_3d_constrained_atoms.copy(self->_3d_constrained_atoms);
+
+    worker->_program.compile(*self->_query);
+    worker->_program.setTargetFeatures(&self->_parallel_features);
+
+    if (self->_am.get() != 0)
+        worker->_am.create(*self->_query, self->_target, self->arom_options);
+    worker->_3d_constraints_checker.create(self->_query->spatial_constraints);
+
+    return worker.release();
+}
+
+void MoleculeSubstructureMatcher::_releaseWorker(void* worker_userdata, void* userdata)
+{
+    delete (MoleculeSubstructureMatcher*)worker_userdata;
+}
+
 void MoleculeSubstructureMatcher::_createEmbeddingsStorage()
 {
     _embeddings_storage.create();
@@ -366,6 +472,7 @@ bool MoleculeSubstructureMatcher::findNext()
 {
     if (_h_unfold)
         _target.asMolecule().unfoldHydrogens(&_unfolded_target_h, -1, true);
+    _program.resetTarget();
 
     bool found = _ee->processNext();
 
@@ -636,9 +743,12 @@ bool MoleculeSubstructureMatcher::_matchAtoms(Graph& subgraph, Graph& supergraph
         }
     }
 
-    QueryMolecule::Atom& sub_atom = query.getAtom(sub_idx);
-
-    if (!matchQueryAtom(&sub_atom, target, super_idx, self->fmcache, match_atoms_flags))
+    if (&subgraph == (Graph*)self->_query && self->_program.isCompiled())
+    {
+        if (!self->_program.matchAtom(sub_idx, target, super_idx, self->fmcache, match_atoms_flags))
+            return false;
+    }
+    else if (!matchQueryAtom(&query.getAtom(sub_idx), target, super_idx, self->fmcache, match_atoms_flags))
         return false;
 
     if (query.stereocenters.getType(sub_idx) > target.stereocenters.getType(super_idx))
@@ -693,6 +803,10 @@ bool MoleculeSubstructureMatcher::_matchBonds(Graph& subgraph, Graph& supergraph
 
     QueryMolecule& query = (QueryMolecule&)subgraph;
     BaseMolecule& target = (BaseMolecule&)supergraph;
+
+    if (&subgraph == (Graph*)self->_query && self->_program.isCompiled())
+        return self->_program.matchBond(sub_idx, target, super_idx, self->_am.get(), flags);
+
     QueryMolecule::Bond& sub_bond = query.getBond(sub_idx);
 
     if (!matchQueryBond(&sub_bond, target, sub_idx, super_idx, self->_am.get(), flags))
@@ -822,6 +936,16 @@ int MoleculeSubstructureMatcher::_embedding_common(int* core_sub, int* core_supe
         if (!_checkRGroupConditions())
             return 1;
 
+    if (_parallel_owner != 0)
+        return _parallel_owner->_acceptEmbedding(core_sub, core_super);
+
+    return _acceptEmbedding(core_sub, core_super);
+}
+
+int MoleculeSubstructureMatcher::_acceptEmbedding(int* core_sub, int* core_super)
+{
+    QueryMolecule& query = *_query;
+
     if (find_unique_embeddings || save_for_iteration)
     {
         if (!_embeddings_storage->addEmbedding(_target, query, core_sub))
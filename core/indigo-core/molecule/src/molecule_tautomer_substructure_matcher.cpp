@@ -76,6 +76,18 @@ void MoleculeTautomerSubstructureMatcher::setQuery(QueryMolecule& query)
 
     _ee->setSubgraph(*_query);
 
+    _target_features.clear();
+    _target_features.build(_tautomerEnumerator.layeredMolecules, 1U << MoleculeMatchFeatures::NUMBER, 0);
+
+    _query_numbers.clear_resize(_query->vertexEnd());
+    for (int i = _query->vertexBegin(); i != _query->vertexEnd(); i = _query->vertexNext(i))
+    {
+        int number;
+        if (!_query->getAtom(i).sureValue(QueryMolecule::ATOM_NUMBER, number))
+            number = MoleculeMatchFeatures::UNKNOWN;
+        _query_numbers[i] = number;
+    }
+
     _embeddings_storage.free();
     _masks.clear();
 }
@@ -102,6 +114,16 @@ bool MoleculeTautomerSubstructureMatcher::_matchAtoms(Graph& subgraph, Graph& su
 
 bool MoleculeTautomerSubstructureMatcher::_matchAtomsHyper(Graph& subgraph, Graph& supergraph, const int* core_sub, int sub_idx, int super_idx, void* userdata)
 {
+    MoleculeTautomerSubstructureMatcher& self = *((SubstructureSearchBreadcrumps*)userdata)->self;
+
+    int query_number = self._query_numbers[sub_idx];
+    if (query_number != MoleculeMatchFeatures::UNKNOWN)
+    {
+        int target_number = self._target_features.atomValue(MoleculeMatchFeatures::NUMBER, super_idx);
+        if (target_number != MoleculeMatchFeatures::UNKNOWN && target_number != query_number)
+            return false;
+    }
+
     // Currently use common atom match procedure
     return _matchAtoms(subgraph, supergraph, core_sub, sub_idx, super_idx, userdata);
 }
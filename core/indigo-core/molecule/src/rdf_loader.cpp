@@ -332,3 +332,31 @@ void RdfLoader::readAt(int index)
         } while (index + 1 != _offsets.size());
     }
 }
+
+const Array<long long>& RdfLoader::offsets() const
+{
+    return _offsets;
+}
+
+long long RdfLoader::maxOffset() const
+{
+    return _max_offset;
+}
+
+void RdfLoader::setOffsets(const Array<long long>& offsets, long long max_offset)
+{
+    _offsets.copy(offsets);
+    _max_offset = max_offset;
+}
+
+void RdfLoader::setDecompressionThreads(int threads)
+{
+    if (_ownScanner)
+        static_cast<GZipScanner*>(_scanner)->setThreads(threads);
+}
+
+void RdfLoader::setRandomAccess(bool enable)
+{
+    if (_ownScanner)
+        static_cast<GZipScanner*>(_scanner)->setRandomAccess(enable);
+}
@@ -25,6 +25,198 @@ using namespace indigo;
 
 IMPL_ERROR(SdfLoader, "SDF loader");
 
+// Returns the start of the next line and sets line_end to the end of the
+// current one, without the line break
+static const char* _nextLine(const char* p, const char* end, const char*& line_end)
+{
+    while (p < end && *p != '\n' && *p != '\r')
+        p++;
+    line_end = p;
+    if (p < end && *p == '\r')
+        p++;
+    if (p < end && *p == '\n' && (p == line_end || p[-1] == '\r'))
+        p++;
+    return p;
+}
+
+// Whether readNext() takes the line for a data header, which is followed by
+// a value: the line has a non-empty name in angle brackets
+static bool _isDataHeader(const char* line, int size)
+{
+    const char* open = (const char*)memchr(line, '<', size);
+    if (open == nullptr)
+        return false;
+    const char* close = (const char*)memchr(open, '>', line + size - open);
+    return close != nullptr && close > open + 1;
+}
+
+SdfRecord::SdfRecord() : _data(nullptr), _size(0)
+{
+}
+
+void SdfRecord::reset(const char* data, int size)
+{
+    _data = data;
+    _size = size;
+}
+
+const char* SdfRecord::ptr() const
+{
+    return _data;
+}
+
+int SdfRecord::size() const
+{
+    return _size;
+}
+
+void SdfRecord::getMolfile(const char*& molfile, int& size) const
+{
+    const char* end = _data + _size;
+    const char* p = _data;
+    const char* line_end;
+
+    while (p < end && *p != '>')
+        p = _nextLine(p, end, line_end);
+
+    molfile = _data;
+    size = (int)(p - _data);
+}
+
+bool SdfRecord::_nextItem(const char*& p, const char*& name, int& name_size, const char*& value, int& value_size) const
+{
+    const char* end = _data + _size;
+    const char* line_end;
+
+    while (p < end)
+    {
+        const char* line = p;
+        p = _nextLine(p, end, line_end);
+        if (*line != '>')
+            continue;
+
+        // Data header looks like "> 25 <NAME> (ID)"
+        const char* open = (const char*)memchr(line, '<', line_end - line);
+        if (open == nullptr)
+            continue;
+        const char* close = (const char*)memchr(open, '>', line_end - open);
+        if (close == nullptr)
+            continue;
+        name = open + 1;
+        name_size = (int)(close - name);
+
+        // The value lasts until an empty line
+        value = p;
+        const char* value_end = p;
+        while (p < end)
+        {
+            const char* next = _nextLine(p, end, line_end);
+            if (line_end == p)
+                break;
+            value_end = line_end;
+            p = next;
+        }
+        value_size = (int)(value_end - value);
+        return true;
+    }
+    return false;
+}
+
+bool SdfRecord::getProperty(const char* name, const char*& value, int& size) const
+{
+    const char* p = _data;
+    const char* item_name;
+    const char* item_value;
+    int name_size, value_size;
+    int name_len = (int)strlen(name);
+    bool found = false;
+
+    while (_nextItem(p, item_name, name_size, item_value, value_size))
+    {
+        if (name_size == name_len && strncmp(item_name, name, name_len) == 0)
+        {
+            value = item_value;
+            size = value_size;
+            found = true;
+        }
+    }
+    return found;
+}
+
+void SdfRecord::getProperties(PropertiesMap& properties) const
+{
+    const char* p = _data;
+    const char* name;
+    const char* value;
+    int name_size, value_size;
+
+    QS_DEF(Array<char>, name_buf);
+
+    while (_nextItem(p, name, name_size, value, value_size))
+    {
+        if (name_size > 0)
+        {
+            name_buf.copy(name, name_size);
+            name_buf.push(0);
+            Array<char>& buf = properties.insert(name_buf.ptr());
+            copyValue(value, value_size, buf);
+            buf.push(0);
+        }
+    }
+}
+
+void SdfRecord::getData(Array<char>& data) const
+{
+    const char* end = _data + _size;
+    const char* p = _data;
+    const char* line_end;
+
+    // Space characters before the record are kept as they are
+    while (p < end && isspace((unsigned char)*p))
+        p++;
+    data.copy(_data, (int)(p - _data));
+
+    bool items = false;
+    bool pending_empty_line = false;
+    while (p < end)
+    {
+        const char* line = p;
+        p = _nextLine(p, end, line_end);
+        if (*line == '>')
+            items = true;
+
+        // An empty line of the molfile is written only when another line of
+        // the molfile follows it
+        if (!items)
+        {
+            if (pending_empty_line)
+                data.push('\n');
+            pending_empty_line = (line_end == line);
+            if (pending_empty_line)
+                continue;
+        }
+        data.concat(line, (int)(line_end - line));
+        data.push('\n');
+    }
+}
+
+void SdfRecord::copyValue(const char* value, int size, Array<char>& out)
+{
+    const char* end = value + size;
+    const char* p = value;
+    const char* line_end;
+
+    out.clear();
+    while (p < end)
+    {
+        if (p > value)
+            out.push('\n');
+        const char* line = p;
+        p = _nextLine(p, end, line_end);
+        out.concat(line, (int)(line_end - line));
+    }
+}
+
 CP_DEF(SdfLoader);
 
 SdfLoader::SdfLoader(Scanner& scanner) : CP_INIT, TL_CP_GET(data), TL_CP_GET(properties), TL_CP_GET(_offsets), TL_CP_GET(_preread)
@@ -49,7 +241,9 @@ SdfLoader::SdfLoader(Scanner& scanner) : CP_INIT, TL_CP_GET(data), TL_CP_GET(pro
         _scanner = &scanner;
         _own_scanner = false;
     }
+    _buffer = dynamic_cast<BufferScanner*>(_scanner);
     _current_number = 0;
+    parse_properties = true;
     _max_offset = 0LL;
     _offsets.clear();
     _preread.clear();
@@ -83,8 +277,9 @@ int SdfLoader::count()
         _current_number = _offsets.size();
     }
 
+    SdfRecord record;
     while (!isEOF())
-        readNext();
+        readNextRecord(record);
 
     int res = _current_number;
 
@@ -130,6 +325,7 @@ void SdfLoader::readNext()
     properties.clear();
 
     bool pending_emptyline = false;
+    bool has_items = false;
 
     long long last_offset = -1LL;
     while (!_scanner->isEOF())
@@ -137,7 +333,10 @@ void SdfLoader::readNext()
         last_offset = _scanner->tell();
         _scanner->readLine(str, true);
         if (str.size() > 0 && str[0] == '>')
+        {
+            has_items = true;
             break;
+        }
         if (str.size() > 3 && strncmp(str.ptr(), "$$$$", 4) == 0)
             break;
         if (pending_emptyline)
@@ -154,7 +353,8 @@ void SdfLoader::readNext()
             throw Error("data size exceeded the acceptable size %d bytes, Please check for correct file format", MAX_DATA_SIZE);
     }
 
-    while (1)
+    // At the end of input the last line of the molfile is already written
+    while (has_items)
     {
         if (strncmp(str.ptr(), "$$$$", 4) == 0)
             break;
@@ -189,10 +389,11 @@ void SdfLoader::readNext()
             word.push(0);
 
             _scanner->readLine(str, true);
-            auto& propBuf = properties.insert(word.ptr());
+            Array<char>* propBuf = parse_properties ? &properties.insert(word.ptr()) : nullptr;
             //         auto& propBuf = properties.valueBuf(word.ptr());
             //         int idx = properties.findOrInsert(word.ptr());
-            propBuf.copy(str);
+            if (propBuf != nullptr)
+                propBuf->copy(str);
             output.writeStringCR(str.ptr());
             if (str.size() > 1)
             {
@@ -203,11 +404,11 @@ void SdfLoader::readNext()
 
                     _scanner->readLine(str, true);
                     output.writeStringCR(str.ptr());
-                    if (str.size() > 1)
+                    if (str.size() > 1 && propBuf != nullptr)
                     {
-                        propBuf.pop(); // Remove string end marker (0)
-                        propBuf.push('\n');
-                        propBuf.appendString(str.ptr(), true);
+                        propBuf->pop(); // Remove string end marker (0)
+                        propBuf->push('\n');
+                        propBuf->appendString(str.ptr(), true);
                     }
                 } while (str.size() > 1);
             }
@@ -223,6 +424,109 @@ void SdfLoader::readNext()
         _max_offset = _scanner->tell();
 }
 
+void SdfLoader::readNextRecord(SdfRecord& record)
+{
+    if (_scanner->isEOF())
+        throw Error("end of stream");
+
+    properties.clear();
+    data.clear();
+
+    // Space characters before the record were consumed by isEOF()
+    int n_preread = _preread.size();
+    long long start = _scanner->tell() - n_preread;
+    _offsets.expand(_current_number + 1);
+    _offsets[_current_number++] = start;
+
+    const char* begin = nullptr;
+    const char* buffer_end = nullptr;
+    if (_buffer != nullptr)
+    {
+        // The space characters are still in the buffer right before the current position
+        begin = (const char*)_buffer->curptr() - n_preread;
+        buffer_end = begin + (_scanner->length() - start);
+    }
+    else
+        data.copy(_preread);
+    _preread.clear();
+
+    QS_DEF(Array<char>, str);
+    const char* line;
+    int size;
+
+    // Lines of the input held in memory are not copied, the other lines are
+    // added to `data`
+    auto read_line = [&]() {
+        if (_buffer != nullptr)
+        {
+            const char* line_end;
+            line = (const char*)_buffer->curptr();
+            const char* next = _nextLine(line, buffer_end, line_end);
+            size = (int)(line_end - line);
+            _scanner->skip((int)(next - line));
+        }
+        else
+        {
+            _scanner->readLine(str, false);
+            line = str.ptr();
+            size = str.size();
+        }
+    };
+    auto keep_line = [&]() {
+        if (_buffer == nullptr)
+        {
+            data.concat(line, size);
+            data.push('\n');
+        }
+    };
+
+    // The same lines as in readNext(): the record ends with a "$$$$" line,
+    // except when it is the value of a data item, which lasts until an
+    // empty line
+    long long end = -1LL;
+    bool items = false;
+    while (!_scanner->isEOF())
+    {
+        long long line_offset = _scanner->tell();
+        read_line();
+        if (size >= 4 && strncmp(line, "$$$$", 4) == 0)
+        {
+            end = line_offset;
+            break;
+        }
+        keep_line();
+        if (size > 0 && line[0] == '>')
+            items = true;
+
+        if (items && _isDataHeader(line, size) && !_scanner->isEOF())
+        {
+            do
+            {
+                read_line();
+                keep_line();
+            } while (size > 0 && !_scanner->isEOF());
+        }
+
+        if (_scanner->tell() - start > MAX_DATA_SIZE)
+            throw Error("data size exceeded the acceptable size %d bytes, Please check for correct file format", MAX_DATA_SIZE);
+    }
+    if (end < 0)
+        end = _scanner->tell();
+
+    if (_buffer != nullptr)
+        record.reset(begin, (int)(end - start));
+    else
+        record.reset(data.ptr(), data.size());
+
+    if (_scanner->tell() > _max_offset)
+        _max_offset = _scanner->tell();
+}
+
+bool SdfLoader::recordsInBuffer() const
+{
+    return _buffer != nullptr;
+}
+
 void SdfLoader::readAt(int index)
 {
     if (index < _offsets.size())
@@ -242,9 +546,39 @@ void SdfLoader::readAt(int index)
 
         _preread.clear();
         _current_number = _offsets.size();
-        do
-        {
-            readNext();
-        } while (index + 1 != _offsets.size());
+
+        // The records before the requested one are only skipped
+        SdfRecord record;
+        while (index > _offsets.size())
+            readNextRecord(record);
+        readNext();
     }
 }
+
+const Array<long long>& SdfLoader::offsets() const
+{
+    return _offsets;
+}
+
+long long SdfLoader::maxOffset() const
+{
+    return _max_offset;
+}
+
+void SdfLoader::setOffsets(const Array<long long>& offsets, long long max_offset)
+{
+    _offsets.copy(offsets);
+    _max_offset = max_offset;
+}
+
+void SdfLoader::setDecompressionThreads(int threads)
+{
+    if (_own_scanner)
+        static_cast<GZipScanner*>(_scanner)->setThreads(threads);
+}
+
+void SdfLoader::setRandomAccess(bool enable)
+{
+    if (_own_scanner)
+        static_cast<GZipScanner*>(_scanner)->setRandomAccess(enable);
+}
@@ -18,8 +18,13 @@
 
 #include <gtest/gtest.h>
 
+#include <thread>
+#include <vector>
+
+#include <base_c/bitarray.h>
 #include <base_cpp/output.h>
 #include <base_cpp/scanner.h>
+#include <base_cpp/tlscont.h>
 #include <molecule/cmf_loader.h>
 #include <molecule/cmf_saver.h>
 #include <molecule/cml_saver.h>
@@ -68,6 +73,52 @@ TEST_F(IndigoCoreContainersTest, test_qsdef)
     ASSERT_EQ(res, 0);
 }
 
+TEST_F(IndigoCoreContainersTest, test_session_local_container)
+{
+    _SessionLocalContainer<Array<int>> container;
+    const qword first = TL_ALLOC_SESSION_ID();
+    const qword second = TL_ALLOC_SESSION_ID();
+
+    container.createOrGetLocalCopy(first).push(1);
+    container.createOrGetLocalCopy(second).push(2);
+    ASSERT_EQ(1, container.getLocalCopy(first)[0]);
+    ASSERT_EQ(2, container.getLocalCopy(second)[0]);
+    ASSERT_EQ(1, container.createOrGetLocalCopy(first)[0]);
+
+    // A removed copy must not be returned from the per-thread cache
+    container.removeLocalCopy(first);
+    ASSERT_FALSE(container.hasLocalCopy(first));
+    ASSERT_TRUE(container.hasLocalCopy(second));
+    ASSERT_EQ(0, container.createOrGetLocalCopy(first).size());
+
+    // Copies removed by one thread are dropped from the caches of others
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; i++)
+    {
+        threads.emplace_back([&container, second]() {
+            for (int j = 0; j < 1000; j++)
+            {
+                const qword id = TL_ALLOC_SESSION_ID();
+                container.createOrGetLocalCopy(id).push(j);
+                ASSERT_EQ(j, container.getLocalCopy(id)[0]);
+                ASSERT_EQ(2, container.getLocalCopy(second)[0]);
+                container.removeLocalCopy(id);
+                ASSERT_FALSE(container.hasLocalCopy(id));
+                TL_RELEASE_SESSION_ID(id);
+            }
+        });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    container.removeLocalCopy(second);
+    ASSERT_THROW(container.getLocalCopy(second), std::out_of_range);
+    TL_RELEASE_SESSION_ID(first);
+    TL_RELEASE_SESSION_ID(second);
+}
+
 TEST_F(IndigoCoreContainersTest, test_array)
 {
     Array<int> array;
@@ -94,3 +145,34 @@ TEST_F(IndigoCoreContainersTest, test_red_black_map)
     map.clear();
     ASSERT_EQ(map.size(), 0);
 }
+
+TEST_F(IndigoCoreContainersTest, test_bit_ones_counts)
+{
+    // Lengths around the 8/32/64 byte boundaries exercise the wide kernels together with their tails
+    Array<byte> bits1, bits2;
+    unsigned seed = 12345;
+    for (int n_bytes = 0; n_bytes <= 200; n_bytes++)
+    {
+        bits1.clear_resize(n_bytes);
+        bits2.clear_resize(n_bytes);
+        int ones1 = 0, ones2 = 0, common = 0;
+        for (int i = 0; i < n_bytes; i++)
+        {
+            seed = seed * 1103515245 + 12345;
+            bits1[i] = (byte)(seed >> 16);
+            seed = seed * 1103515245 + 12345;
+            bits2[i] = (byte)(seed >> 16);
+            ones1 += bitGetOnesCountByte(bits1[i]);
+            ones2 += bitGetOnesCountByte(bits2[i]);
+            common += bitGetOnesCountByte(bits1[i] & bits2[i]);
+        }
+
+        int fused1 = -1, fused2 = -1;
+        ASSERT_EQ(bitCommonOnesWithCounts(bits1.ptr(), bits2.ptr(), n_bytes, &fused1, &fused2), common);
+        ASSERT_EQ(fused1, ones1);
+        ASSERT_EQ(fused2, ones2);
+        ASSERT_EQ(bitCommonOnesWithCounts(bits1.ptr(), bits2.ptr(), n_bytes, nullptr, &fused2), common);
+        ASSERT_EQ(bitCommonOnes(bits1.ptr(), bits2.ptr(), n_bytes), common);
+        ASSERT_EQ(bitGetOnesCount(bits1.ptr(), n_bytes), ones1);
+    }
+}
@@ -20,8 +20,16 @@
 #include <rapidjson/stringbuffer.h>
 #include <rapidjson/writer.h>
 
+#include <cstdio>
+#ifndef _WIN32
+#include <utime.h>
+#endif
+
 #include <base_cpp/output.h>
+#include <base_cpp/record_offset_index.h>
 #include <base_cpp/scanner.h>
+#include <gzip/gzip_output.h>
+#include <gzip/gzip_scanner.h>
 #include <molecule/cmf_loader.h>
 #include <molecule/cmf_saver.h>
 #include <molecule/cml_saver.h>
@@ -371,3 +379,348 @@ TEST_F(IndigoCoreFormatsTest, json_load_save)
     std::string json_out{out.ptr(), static_cast<std::size_t>(out.size())};
     // ASSERT_EQ(json, json_out);
 }
+
+TEST_F(IndigoCoreFormatsTest, buffer_scanner_lines)
+{
+    const char* text = "a\r\nb\rc\n\rd\n\ne";
+    const char* lines[] = {"a", "b", "c", "", "d", "", "e"};
+
+    BufferScanner scanner(text);
+    Array<char> line;
+    for (auto expected : lines)
+    {
+        scanner.readLine(line, true);
+        EXPECT_STREQ(expected, line.ptr());
+    }
+    EXPECT_TRUE(scanner.isEOF());
+
+    // Unlike readLine(), skipLine() treats "\n\r" as a single line break
+    const long long offsets[] = {3, 5, 8, 10, 11};
+    scanner.seek(0, SEEK_SET);
+    for (auto expected : offsets)
+    {
+        EXPECT_TRUE(scanner.skipLine());
+        EXPECT_EQ(expected, scanner.tell());
+    }
+    EXPECT_FALSE(scanner.skipLine());
+    EXPECT_TRUE(scanner.isEOF());
+}
+
+TEST_F(IndigoCoreFormatsTest, mapped_file_scanner)
+{
+    std::string path = dataPath("molecules/resonance/resonance.sdf");
+    FileScanner file_scanner(path.c_str());
+    MappedFileScanner mapped_scanner(path.c_str());
+
+    ASSERT_EQ(file_scanner.length(), mapped_scanner.length());
+
+    Array<char> file_line, mapped_line;
+    while (!file_scanner.isEOF())
+    {
+        ASSERT_FALSE(mapped_scanner.isEOF());
+        file_scanner.readLine(file_line, true);
+        mapped_scanner.readLine(mapped_line, true);
+        ASSERT_STREQ(file_line.ptr(), mapped_line.ptr());
+        ASSERT_EQ(file_scanner.tell(), mapped_scanner.tell());
+    }
+    EXPECT_TRUE(mapped_scanner.isEOF());
+
+    // Regular files are mapped, the rest falls back to FileScanner
+    auto scanner = MappedFileScanner::open(ENCODING_ASCII, path.c_str());
+    EXPECT_NE(nullptr, dynamic_cast<MappedFileScanner*>(scanner.get()));
+
+    FileScanner sdf_scanner(path.c_str());
+    SdfLoader file_sdf(sdf_scanner);
+    SdfLoader mapped_sdf(*scanner);
+    file_sdf.readAt(138);
+    mapped_sdf.readAt(138);
+    EXPECT_EQ(file_sdf.data.size(), mapped_sdf.data.size());
+    EXPECT_EQ(0, memcmp(file_sdf.data.ptr(), mapped_sdf.data.ptr(), file_sdf.data.size()));
+}
+
+TEST_F(IndigoCoreFormatsTest, record_offset_index)
+{
+    std::string path = dataPath("molecules/resonance/resonance.sdf");
+    FileScanner scanner(path.c_str());
+    SdfLoader loader(scanner);
+    int count = loader.count();
+
+    Array<char> buf;
+    ArrayOutput output(buf);
+    RecordOffsetIndex::save(output, scanner, ENCODING_ASCII, path.c_str(), loader.offsets(), loader.maxOffset());
+    EXPECT_EQ(0, scanner.tell());
+
+    Array<long long> offsets;
+    long long end_offset;
+    BufferScanner input(buf);
+    ASSERT_TRUE(RecordOffsetIndex::load(input, scanner, ENCODING_ASCII, path.c_str(), offsets, end_offset));
+    ASSERT_EQ(count, offsets.size());
+    EXPECT_EQ(loader.maxOffset(), end_offset);
+
+    // Random access without reading the preceding records
+    FileScanner indexed_scanner(path.c_str());
+    SdfLoader indexed(indexed_scanner);
+    indexed.setOffsets(offsets, end_offset);
+    EXPECT_EQ(count, indexed.count());
+    indexed.readAt(count - 1);
+    loader.readAt(count - 1);
+    EXPECT_EQ(loader.data.size(), indexed.data.size());
+    EXPECT_EQ(0, memcmp(loader.data.ptr(), indexed.data.ptr(), loader.data.size()));
+
+    // An index of another file is rejected
+    BufferScanner other_input(buf);
+    BufferScanner other_source("C\nCC\n");
+    EXPECT_FALSE(RecordOffsetIndex::load(other_input, other_source, ENCODING_ASCII, nullptr, offsets, end_offset));
+
+    BufferScanner truncated(buf.ptr(), buf.size() / 2);
+    EXPECT_FALSE(RecordOffsetIndex::load(truncated, scanner, ENCODING_ASCII, path.c_str(), offsets, end_offset));
+
+    // So is an index of the same data whose offsets do not start lines
+    BufferScanner smiles("C\nCC\nCCC\n");
+    Array<long long> shifted_offsets;
+    shifted_offsets.push(0);
+    shifted_offsets.push(3);
+    Array<char> shifted_buf;
+    ArrayOutput shifted_output(shifted_buf);
+    RecordOffsetIndex::save(shifted_output, smiles, ENCODING_ASCII, nullptr, shifted_offsets, 9);
+    BufferScanner shifted_input(shifted_buf);
+    EXPECT_FALSE(RecordOffsetIndex::load(shifted_input, smiles, ENCODING_ASCII, nullptr, offsets, end_offset));
+}
+
+#ifndef _WIN32
+TEST_F(IndigoCoreFormatsTest, record_offset_index_mtime)
+{
+    // A copy of the file with the same content is rejected after its modification time changes
+    std::string path = testing::TempDir() + "record_offset_index.sdf";
+    {
+        FileScanner source(dataPath("molecules/resonance/resonance.sdf").c_str());
+        Array<char> data;
+        source.readAll(data);
+        FileOutput copy(path.c_str());
+        copy.write(data.ptr(), data.size());
+    }
+
+    Array<char> buf;
+    {
+        FileScanner scanner(path.c_str());
+        SdfLoader loader(scanner);
+        loader.count();
+        ArrayOutput output(buf);
+        RecordOffsetIndex::save(output, scanner, ENCODING_ASCII, path.c_str(), loader.offsets(), loader.maxOffset());
+    }
+
+    Array<long long> offsets;
+    long long end_offset;
+    FileScanner scanner(path.c_str());
+    BufferScanner input(buf);
+    EXPECT_TRUE(RecordOffsetIndex::load(input, scanner, ENCODING_ASCII, path.c_str(), offsets, end_offset));
+
+    struct utimbuf times;
+    times.actime = 1000000000;
+    times.modtime = 1000000000;
+    ASSERT_EQ(0, utime(path.c_str(), &times));
+    BufferScanner touched_input(buf);
+    EXPECT_FALSE(RecordOffsetIndex::load(touched_input, scanner, ENCODING_ASCII, path.c_str(), offsets, end_offset));
+
+    std::remove(path.c_str());
+}
+#endif
+
+TEST_F(IndigoCoreFormatsTest, sdf_lazy_record)
+{
+    std::string path = dataPath("molecules/basic/sugars.sdf");
+    FileScanner file_scanner(path.c_str());
+    MappedFileScanner mapped_scanner(path.c_str());
+    SdfLoader loader(file_scanner);
+    SdfLoader lazy_loader(mapped_scanner);
+    ASSERT_TRUE(lazy_loader.recordsInBuffer());
+    SdfRecord record;
+    Array<char> data, value_buf;
+
+    auto count = [](PropertiesMap& properties) {
+        int n = 0;
+        for (auto i : properties.elements())
+            n += (i >= 0);
+        return n;
+    };
+
+    while (!loader.isEOF())
+    {
+        ASSERT_FALSE(lazy_loader.isEOF());
+        loader.readNext();
+        lazy_loader.readNextRecord(record);
+        EXPECT_EQ(loader.tell(), lazy_loader.tell());
+
+        // The record is not copied out of the file mapping
+        EXPECT_EQ(0, lazy_loader.data.size());
+        EXPECT_GE(record.ptr(), (const char*)mapped_scanner.curptr() - mapped_scanner.tell());
+        EXPECT_LE(record.ptr() + record.size(), (const char*)mapped_scanner.curptr());
+
+        record.getData(data);
+        EXPECT_EQ(std::string(loader.data.ptr(), loader.data.size()), std::string(data.ptr(), data.size()));
+
+        const char* value;
+        int size;
+        for (auto i : loader.properties.elements())
+        {
+            ASSERT_TRUE(record.getProperty(loader.properties.key(i), value, size));
+            SdfRecord::copyValue(value, size, value_buf);
+            EXPECT_EQ(std::string(loader.properties.value(i)), std::string(value_buf.ptr(), value_buf.size()));
+        }
+        EXPECT_FALSE(record.getProperty("NO_SUCH_PROPERTY", value, size));
+
+        PropertiesMap properties;
+        record.getProperties(properties);
+        EXPECT_EQ(count(loader.properties), count(properties));
+
+        QueryMolecule mol, lazy_mol;
+        BufferScanner data_scanner(loader.data);
+        MolfileLoader data_loader(data_scanner);
+        data_loader.stereochemistry_options.ignore_errors = true;
+        data_loader.loadQueryMolecule(mol);
+        record.getMolfile(value, size);
+        BufferScanner molfile_scanner(value, size);
+        MolfileLoader molfile_loader(molfile_scanner);
+        molfile_loader.stereochemistry_options.ignore_errors = true;
+        molfile_loader.loadQueryMolecule(lazy_mol);
+        EXPECT_EQ(mol.vertexCount(), lazy_mol.vertexCount());
+        EXPECT_EQ(mol.edgeCount(), lazy_mol.edgeCount());
+    }
+    EXPECT_TRUE(lazy_loader.isEOF());
+}
+
+TEST_F(IndigoCoreFormatsTest, sdf_record_bounds)
+{
+    const char* inputs[] = {
+        // Empty name line, empty lines in the molfile and CRLF line breaks
+        "\r\n  -INDIGO-\r\n\r\nM  END\r\n\r\n> <A>\r\nfirst\r\nsecond\r\n\r\n$$$$\r\nname\r\n\r\n\r\nM  END\r\n$$$$\r\n",
+        // A value without an empty line after it lasts over the "$$$$" line
+        "name\n\n\nM  END\n> <A>\nx\n$$$$\nname\n\n\nM  END\n> <B>\ny\n\n$$$$\n",
+        // The last record ends without "$$$$", after its molfile
+        "name\n\n\nM  END\n$$$$\n\n  name\n\n\nM  END\n\n",
+        "name\n\n\nM  END\n> <A> (1)\nx\n\nnot a header\n> <B>\n\n"};
+
+    std::string path = testing::TempDir() + "sdf_record_bounds.sdf";
+    for (const char* input : inputs)
+    {
+        {
+            FileOutput file(path.c_str());
+            file.writeString(input);
+        }
+        BufferScanner scanner(input);
+        BufferScanner record_scanner(input);
+        FileScanner file_scanner(path.c_str());
+        SdfLoader loader(scanner);
+        SdfLoader record_loader(record_scanner);
+        SdfLoader file_loader(file_scanner);
+        ASSERT_FALSE(file_loader.recordsInBuffer());
+        SdfRecord record, file_record;
+        Array<char> data, file_data;
+
+        // Records found in the buffer and in the stream have the text that readNext() reads
+        while (!loader.isEOF())
+        {
+            ASSERT_FALSE(record_loader.isEOF());
+            ASSERT_FALSE(file_loader.isEOF());
+            loader.readNext();
+            record_loader.readNextRecord(record);
+            file_loader.readNextRecord(file_record);
+            EXPECT_EQ(loader.tell(), record_loader.tell());
+            EXPECT_EQ(loader.tell(), file_loader.tell());
+
+            record.getData(data);
+            file_record.getData(file_data);
+            EXPECT_EQ(std::string(loader.data.ptr(), loader.data.size()), std::string(data.ptr(), data.size())) << input;
+            EXPECT_EQ(std::string(loader.data.ptr(), loader.data.size()), std::string(file_data.ptr(), file_data.size())) << input;
+        }
+        EXPECT_TRUE(record_loader.isEOF());
+        EXPECT_TRUE(file_loader.isEOF());
+        EXPECT_EQ(loader.count(), record_loader.count());
+    }
+    std::remove(path.c_str());
+}
+
+TEST_F(IndigoCoreFormatsTest, gzip_seek)
+{
+    std::string path = dataPath("molecules/basic/Compound_0000001_0000250.sdf.gz");
+    FileScanner file_scanner(path.c_str());
+    GZipScanner gz_scanner(file_scanner);
+    Array<char> text;
+    gz_scanner.readAll(text);
+    ASSERT_EQ(1245893, text.size());
+
+    Array<char> bgzf;
+    {
+        ArrayOutput output(bgzf);
+        BlockGZipOutput gz_output(output, 6);
+        gz_output.write(text.ptr(), text.size());
+    }
+
+    // Positions in the first block, across block boundaries and past the
+    // first window access point of the plain gzip member
+    const long long positions[] = {text.size() - 10, 5, 1100000, 700000, 0, 1048576, BlockGZipOutput::BLOCK_SIZE * 3 - 4};
+    char buf[10];
+
+    // Without random access the plain member is inflated from its start
+    for (bool random_access : {false, true})
+    {
+        FileScanner member_file_scanner(path.c_str());
+        GZipScanner member_scanner(member_file_scanner);
+        member_scanner.setRandomAccess(random_access);
+
+        EXPECT_EQ(text.size(), member_scanner.length());
+        for (long long pos : positions)
+        {
+            member_scanner.seek(pos, SEEK_SET);
+            member_scanner.read(sizeof(buf), buf);
+            EXPECT_EQ(0, memcmp(text.ptr() + pos, buf, sizeof(buf)));
+        }
+    }
+
+    for (int threads : {1, 4})
+    {
+        BufferScanner bgzf_scanner(bgzf);
+        GZipScanner bgzf_gz_scanner(bgzf_scanner);
+        bgzf_gz_scanner.setThreads(threads);
+
+        Array<char> bgzf_text;
+        bgzf_gz_scanner.readAll(bgzf_text);
+        ASSERT_EQ(text.size(), bgzf_text.size());
+        EXPECT_EQ(0, memcmp(text.ptr(), bgzf_text.ptr(), text.size()));
+
+        for (long long pos : positions)
+        {
+            bgzf_gz_scanner.seek(pos, SEEK_SET);
+            bgzf_gz_scanner.read(sizeof(buf), buf);
+            EXPECT_EQ(0, memcmp(text.ptr() + pos, buf, sizeof(buf)));
+        }
+    }
+
+    // A block that claims more data than BGZF allows is rejected
+    {
+        Array<char> corrupted;
+        corrupted.copy(bgzf);
+        int block_size = ((byte)corrupted[16] | ((byte)corrupted[17] << 8)) + 1;
+        corrupted[block_size - 1] = (char)0xFF;
+        BufferScanner corrupted_scanner(corrupted);
+        GZipScanner corrupted_gz_scanner(corrupted_scanner);
+        corrupted_gz_scanner.setThreads(4);
+        Array<char> corrupted_text;
+        EXPECT_THROW(corrupted_gz_scanner.readAll(corrupted_text), GZipScanner::Error);
+    }
+
+    // Random access to the records of a compressed SDF
+    BufferScanner text_scanner(text);
+    BufferScanner bgzf_scanner(bgzf);
+    SdfLoader text_loader(text_scanner);
+    SdfLoader gz_loader(bgzf_scanner);
+    gz_loader.setDecompressionThreads(4);
+    EXPECT_EQ(text_loader.count(), gz_loader.count());
+    for (int index : {200, 3, 244})
+    {
+        text_loader.readAt(index);
+        gz_loader.readAt(index);
+        ASSERT_EQ(text_loader.data.size(), gz_loader.data.size());
+        EXPECT_EQ(0, memcmp(text_loader.data.ptr(), gz_loader.data.ptr(), text_loader.data.size()));
+    }
+}
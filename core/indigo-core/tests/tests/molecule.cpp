@@ -19,10 +19,16 @@
 #include <gtest/gtest.h>
 
 #include <base_cpp/output.h>
+#include <base_cpp/scanner.h>
+#include <graph/graph_csr.h>
+#include <graph/graph_subtree_enumerator.h>
+#include <graph/subgraph_hash.h>
 #include <molecule/crippen.h>
 #include <molecule/hybridization.h>
 #include <molecule/lipinski.h>
+#include <molecule/molecule_match_features.h>
 #include <molecule/molecule_mass.h>
+#include <molecule/molecule_morgan_fingerprint_builder.h>
 #include <molecule/smiles_loader.h>
 #include <molecule/tpsa.h>
 
@@ -319,3 +325,211 @@ TEST_F(IndigoCoreMoleculeTest, atom_reorder_nonquery)
     loadMolecule("SC(=N)O |$R1;;;OH$|", molecule);
     EXPECT_STREQ("SC(O)=N |$R1;;OH;$|", smiles(molecule).c_str());
 }
+
+TEST_F(IndigoCoreMoleculeTest, matchFeatures)
+{
+    Molecule molecule;
+    loadMolecule("[13CH3]C1CC1c1ccccc1[O-]", molecule);
+
+    MoleculeMatchFeatures features;
+    features.build(molecule);
+    EXPECT_TRUE(features.fits(molecule));
+
+    for (int i = molecule.vertexBegin(); i != molecule.vertexEnd(); i = molecule.vertexNext(i))
+    {
+        EXPECT_EQ(molecule.getAtomNumber(i), features.atomValue(MoleculeMatchFeatures::NUMBER, i));
+        EXPECT_EQ(molecule.getAtomCharge(i), features.atomValue(MoleculeMatchFeatures::CHARGE, i));
+        EXPECT_EQ(molecule.getAtomIsotope(i), features.atomValue(MoleculeMatchFeatures::ISOTOPE, i));
+        EXPECT_EQ(molecule.getAtomTotalH(i), features.atomValue(MoleculeMatchFeatures::TOTAL_H, i));
+        EXPECT_EQ(molecule.vertexSmallestRingSize(i), features.atomValue(MoleculeMatchFeatures::SMALLEST_RING_SIZE, i));
+    }
+
+    // The cyclopropane atoms belong to a ring of size 3 only
+    EXPECT_EQ(1 << 3, features.atomValue(MoleculeMatchFeatures::RING_SIZES, 2));
+    EXPECT_EQ(0, features.atomValue(MoleculeMatchFeatures::RING_SIZES, 0));
+
+    Array<char> buf;
+    ArrayOutput output(buf);
+    features.save(output);
+
+    MoleculeMatchFeatures loaded;
+    BufferScanner scanner(buf);
+    loaded.load(scanner);
+    EXPECT_TRUE(loaded.fits(molecule));
+    for (int c = 0; c < MoleculeMatchFeatures::ATOM_COLUMNS_COUNT; c++)
+        for (int i = molecule.vertexBegin(); i != molecule.vertexEnd(); i = molecule.vertexNext(i))
+            EXPECT_EQ(features.atomValue(c, i), loaded.atomValue(c, i));
+    for (int c = 0; c < MoleculeMatchFeatures::BOND_COLUMNS_COUNT; c++)
+        for (int i = molecule.edgeBegin(); i != molecule.edgeEnd(); i = molecule.edgeNext(i))
+            EXPECT_EQ(features.bondValue(c, i), loaded.bondValue(c, i));
+}
+
+TEST_F(IndigoCoreMoleculeTest, graphCSR)
+{
+    Molecule molecule;
+    loadMolecule("OC1CC(N)CCC1c1ccccc1", molecule);
+
+    // Leave holes in the vertex and edge indices
+    molecule.removeAtom(0);
+    molecule.removeAtom(4);
+
+    GraphCSR csr(molecule);
+    EXPECT_TRUE(csr.fits(molecule));
+    EXPECT_EQ(molecule.vertexCount(), csr.vertexCount());
+    EXPECT_EQ(0, csr.degree(0));
+
+    int k = 0;
+    for (int v = molecule.vertexBegin(); v != molecule.vertexEnd(); v = molecule.vertexNext(v), k++)
+    {
+        EXPECT_EQ(v, csr.vertices()[k]);
+
+        const Vertex& vertex = molecule.getVertex(v);
+        ASSERT_EQ(vertex.degree(), csr.degree(v));
+
+        int j = 0;
+        for (int i = vertex.neiBegin(); i != vertex.neiEnd(); i = vertex.neiNext(i), j++)
+        {
+            EXPECT_EQ(vertex.neiVertex(i), csr.neiVertices(v)[j]);
+            EXPECT_EQ(vertex.neiEdge(i), csr.neiEdges(v)[j]);
+            EXPECT_EQ(vertex.neiEdge(i), csr.findEdgeIndex(v, vertex.neiVertex(i)));
+        }
+    }
+
+    for (int e = molecule.edgeBegin(); e != molecule.edgeEnd(); e = molecule.edgeNext(e))
+    {
+        EXPECT_EQ(molecule.getEdge(e).beg, csr.getEdge(e).beg);
+        EXPECT_EQ(molecule.getEdge(e).end, csr.getEdge(e).end);
+    }
+    EXPECT_EQ(-1, csr.findEdgeIndex(1, 8));
+
+    molecule.addAtom(6);
+    EXPECT_FALSE(csr.fits(molecule));
+}
+
+namespace
+{
+    struct SubgraphHashContext
+    {
+        SubgraphHash* single;
+        SubgraphHash* sets;
+        Array<int>* vertex_codes[2];
+        Array<int>* edge_codes[2];
+        int count;
+    };
+
+    void checkSubgraphHashes(Graph& /*graph*/, const Array<int>& vertices, const Array<int>& edges, void* context)
+    {
+        SubgraphHashContext& ctx = *static_cast<SubgraphHashContext*>(context);
+        dword hashes[2];
+        int different_codes_counts[2];
+
+        ctx.sets->max_iterations = (edges.size() + 1) / 2;
+        ctx.sets->getHashes(vertices, edges, 3, hashes, different_codes_counts);
+
+        for (int k = 0; k < 2; k++)
+        {
+            ctx.single->vertex_codes = ctx.vertex_codes[k];
+            ctx.single->edge_codes = ctx.edge_codes[k];
+            ctx.single->max_iterations = (edges.size() + 1) / 2;
+            ctx.single->calc_different_codes_count = true;
+            EXPECT_EQ(ctx.single->getHash(vertices, edges), hashes[k]);
+            EXPECT_EQ(ctx.single->getDifferentCodesCount(), different_codes_counts[k]);
+        }
+        ctx.count++;
+    }
+}
+
+TEST_F(IndigoCoreMoleculeTest, subgraphHashSets)
+{
+    Molecule molecule;
+    loadMolecule("OC1CC(N)CCC1c1ccc(cc1)C(=O)NC1CC1", molecule);
+    molecule.removeAtom(0);
+
+    Array<int> atom_codes, bond_codes, empty_atom_codes, empty_bond_codes;
+    atom_codes.clear_resize(molecule.vertexEnd());
+    empty_atom_codes.clear_resize(molecule.vertexEnd());
+    bond_codes.clear_resize(molecule.edgeEnd());
+    empty_bond_codes.clear_resize(molecule.edgeEnd());
+    for (int v : molecule.vertices())
+    {
+        atom_codes[v] = molecule.atomCode(v);
+        empty_atom_codes[v] = 0;
+    }
+    for (int e : molecule.edges())
+    {
+        bond_codes[e] = molecule.bondCode(e);
+        empty_bond_codes[e] = 0;
+    }
+
+    SubgraphHash single(molecule);
+    SubgraphHash sets(molecule);
+    const Array<int>* vertex_codes_sets[] = {&atom_codes, &empty_atom_codes};
+    const Array<int>* edge_codes_sets[] = {&bond_codes, &empty_bond_codes};
+    sets.setCodeSets(2, vertex_codes_sets, edge_codes_sets);
+
+    SubgraphHashContext context = {&single, &sets, {&atom_codes, &empty_atom_codes}, {&bond_codes, &empty_bond_codes}, 0};
+
+    GraphSubtreeEnumerator enumerator(molecule);
+    enumerator.min_vertices = 1;
+    enumerator.max_vertices = 6;
+    enumerator.callback = checkSubgraphHashes;
+    enumerator.context = &context;
+    enumerator.process();
+
+    EXPECT_GT(context.count, 100);
+}
+
+TEST_F(IndigoCoreMoleculeTest, morganFingerprint)
+{
+    Molecule molecule, holed;
+    loadMolecule("OC1CC(N)CCC1c1ccc(cc1)C(=O)NC1CC1", molecule);
+    loadMolecule("C.OC1CC(N)CCC1c1ccc(cc1)C(=O)NC1CC1", holed);
+    holed.removeAtom(0);
+
+    Array<dword> descriptors, holed_descriptors, hashes;
+    Array<int> counts;
+    MoleculeMorganFingerprintBuilder builder(molecule);
+    MoleculeMorganFingerprintBuilder holed_builder(holed);
+
+    for (int depth = 1; depth <= 4; depth++)
+    {
+        builder.calculateDescriptorsECFP(depth, descriptors);
+        holed_builder.calculateDescriptorsECFP(depth, holed_descriptors);
+        ASSERT_GT(descriptors.size(), 0);
+        ASSERT_EQ(descriptors.size(), holed_descriptors.size());
+        for (int i = 0; i < descriptors.size(); i++)
+            EXPECT_EQ(descriptors[i], holed_descriptors[i]);
+
+        builder.calculateCountsECFP(depth, hashes, counts);
+        ASSERT_EQ(hashes.size(), counts.size());
+        int total = 0;
+        for (int i = 0; i < hashes.size(); i++)
+        {
+            if (i > 0)
+                EXPECT_LT(hashes[i - 1], hashes[i]);
+            total += counts[i];
+        }
+        EXPECT_EQ(descriptors.size(), total);
+    }
+
+    // Halogens are indistinguishable by their pharmacophoric features
+    Molecule chloro, bromo;
+    loadMolecule("OC(=O)c1ccccc1Cl", chloro);
+    loadMolecule("OC(=O)c1ccccc1Br", bromo);
+
+    Array<dword> chloro_descriptors, bromo_descriptors;
+    MoleculeMorganFingerprintBuilder chloro_builder(chloro);
+    MoleculeMorganFingerprintBuilder bromo_builder(bromo);
+
+    chloro_builder.calculateDescriptorsFCFP(2, chloro_descriptors);
+    bromo_builder.calculateDescriptorsFCFP(2, bromo_descriptors);
+    ASSERT_GT(chloro_descriptors.size(), 0);
+    ASSERT_EQ(chloro_descriptors.size(), bromo_descriptors.size());
+    for (int i = 0; i < chloro_descriptors.size(); i++)
+        EXPECT_EQ(chloro_descriptors[i], bromo_descriptors[i]);
+
+    chloro_builder.calculateDescriptorsECFP(2, chloro_descriptors);
+    bromo_builder.calculateDescriptorsECFP(2, bromo_descriptors);
+    EXPECT_FALSE(chloro_descriptors.size() == bromo_descriptors.size() &&
+                 memcmp(chloro_descriptors.ptr(), bromo_descriptors.ptr(), chloro_descriptors.sizeInBytes()) == 0);
+}
@@ -144,3 +144,23 @@ TEST_F(IndigoCoreSmartsTest, smiles)
 {
     EXPECT_STREQ(smilesLoadSaveLoad("C |$Carbon$|", false).c_str(), "C");
 }
+
+TEST_F(IndigoCoreSmartsTest, compiledExpressions)
+{
+    // Element lists, nested operations and negations are lowered into flat programs
+    EXPECT_TRUE(substructureMatch("CCO", "[C,N,O]"));
+    EXPECT_FALSE(substructureMatch("CCO", "[N,S,P]"));
+    EXPECT_TRUE(substructureMatch("CCN", "[!C;!O]"));
+    EXPECT_FALSE(substructureMatch("CCO", "[!C;!O;!#1]"));
+    EXPECT_TRUE(substructureMatch("C[NH3+]", "[N,O;+;H3]"));
+    EXPECT_FALSE(substructureMatch("CN", "[N,O;+;H3]"));
+    EXPECT_TRUE(substructureMatch("c1ccccc1O", "[c;R1;X3][O,S;H1]"));
+    EXPECT_FALSE(substructureMatch("C1CCCCC1O", "[c;R1;X3][O,S;H1]"));
+    EXPECT_TRUE(substructureMatch("C1CC1C", "[r3;!R2]-[C;R0]"));
+    EXPECT_FALSE(substructureMatch("C1CCC1C", "[r3;!R2]-[C;R0]"));
+    EXPECT_TRUE(substructureMatch("[13CH4]", "[13C,15N]"));
+    EXPECT_FALSE(substructureMatch("C", "[13C,15N]"));
+    EXPECT_TRUE(substructureMatch("C=CC#N", "C!-C"));
+    EXPECT_TRUE(substructureMatch("C1CC1", "C@C"));
+    EXPECT_FALSE(substructureMatch("CCC", "C@C"));
+}